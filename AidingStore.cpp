@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssAidingStore"
+
+#include "AidingStore.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "AtomicFile.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static int64_t clockMs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+AidingStore::AidingStore(std::string path) : mPath(std::move(path)) {
+    std::string contents;
+    if (::android::base::ReadFileToString(mPath, &contents)) {
+        Record record;
+        if (contents.size() == sizeof(record)) memcpy(&record, contents.data(), sizeof(record));
+        if (contents.size() == sizeof(record) && record.magic == Record::MAGIC &&
+            record.version == Record::VERSION) {
+            mRecord = record;
+            LOG(INFO) << "Last position and time loaded from " << mPath;
+        } else {
+            LOG(WARNING) << "Ignoring " << mPath << ", not an aiding record";
+        }
+    }
+    mWriterThread = std::thread(&AidingStore::writerThreadFunc, this);
+}
+
+AidingStore::~AidingStore() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mCondition.notify_one();
+    if (mWriterThread.joinable()) mWriterThread.join();
+}
+
+void AidingStore::onLocation(const GnssLocation& location) {
+    if (!(location.gnssLocationFlags & GnssLocation::HAS_LAT_LONG)) return;
+    const int64_t realtimeMs = clockMs(CLOCK_REALTIME);
+    // The system clock when the fix was taken, against the GNSS time of the fix.
+    const int64_t ageMs = (location.elapsedRealtime.flags & ElapsedRealtime::HAS_TIMESTAMP_NS)
+            ? std::max<int64_t>(clockMs(CLOCK_BOOTTIME) -
+                                location.elapsedRealtime.timestampNs / 1000000, 0)
+            : 0;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecord.latitudeDegrees = location.latitudeDegrees;
+    mRecord.longitudeDegrees = location.longitudeDegrees;
+    mRecord.altitudeMeters = location.altitudeMeters;
+    mRecord.accuracyMeters = (location.gnssLocationFlags & GnssLocation::HAS_HORIZONTAL_ACCURACY)
+            ? location.horizontalAccuracyMeters
+            : MIN_POSITION_ACCURACY_M;
+    mRecord.timeOffsetMs = location.timestampMillis - (realtimeMs - ageMs);
+    mRecord.timeUncertaintyMs = static_cast<int64_t>(
+            location.elapsedRealtime.timeUncertaintyNs / 1e6) + 1;
+    mRecord.savedRealtimeMs = realtimeMs;
+    mRecord.flags |= Record::HAS_POSITION | Record::HAS_TIME;
+    updatedLocked(false);
+}
+
+void AidingStore::onInjectedTime(int64_t timeMs, int64_t timeReferenceMs, int32_t uncertaintyMs) {
+    const int64_t realtimeMs = clockMs(CLOCK_REALTIME);
+    const int64_t nowUtcMs = timeMs + (clockMs(CLOCK_BOOTTIME) - timeReferenceMs);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecord.timeOffsetMs = nowUtcMs - realtimeMs;
+    mRecord.timeUncertaintyMs = std::max(uncertaintyMs, 0);
+    mRecord.savedRealtimeMs = realtimeMs;
+    mRecord.flags |= Record::HAS_TIME;
+    updatedLocked(false);
+}
+
+void AidingStore::onInjectedLocation(const GnssLocation& location) {
+    if (!(location.gnssLocationFlags & GnssLocation::HAS_LAT_LONG)) return;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecord.latitudeDegrees = location.latitudeDegrees;
+    mRecord.longitudeDegrees = location.longitudeDegrees;
+    mRecord.altitudeMeters = (location.gnssLocationFlags & GnssLocation::HAS_ALTITUDE)
+            ? location.altitudeMeters
+            : 0;
+    mRecord.accuracyMeters = (location.gnssLocationFlags & GnssLocation::HAS_HORIZONTAL_ACCURACY)
+            ? location.horizontalAccuracyMeters
+            : MIN_POSITION_ACCURACY_M;
+    mRecord.flags |= Record::HAS_POSITION;
+    updatedLocked(false);
+}
+
+void AidingStore::clear(bool position, bool time) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (position) mRecord.flags &= ~Record::HAS_POSITION;
+    if (time) mRecord.flags &= ~Record::HAS_TIME;
+    updatedLocked(true);
+}
+
+void AidingStore::flush() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mDirty) return;
+    mUrgent = true;
+    mCondition.notify_one();
+}
+
+bool AidingStore::timeAid(ReceiverConfig::TimeAid& aid) {
+    const int64_t realtimeMs = clockMs(CLOCK_REALTIME);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!(mRecord.flags & Record::HAS_TIME)) return false;
+    const int64_t ageMs = realtimeMs - mRecord.savedRealtimeMs;
+    if (ageMs < 0) return false;
+    const double uncertaintyMs = mRecord.timeUncertaintyMs + ageMs * CLOCK_DRIFT;
+    if (uncertaintyMs > MAX_TIME_UNCERTAINTY_MS) return false;
+    aid.unixMs = realtimeMs + mRecord.timeOffsetMs;
+    aid.atMs = clockMs(CLOCK_BOOTTIME);
+    return true;
+}
+
+bool AidingStore::positionAid(ReceiverConfig::PositionAid& aid) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!(mRecord.flags & Record::HAS_POSITION)) return false;
+    aid.latitudeDegrees = mRecord.latitudeDegrees;
+    aid.longitudeDegrees = mRecord.longitudeDegrees;
+    aid.altitudeMeters = mRecord.altitudeMeters;
+    aid.accuracyMeters = std::max(mRecord.accuracyMeters, MIN_POSITION_ACCURACY_M);
+    return true;
+}
+
+void AidingStore::updatedLocked(bool urgent) {
+    const bool wasDirty = mDirty;
+    mDirty = true;
+    if (urgent) mUrgent = true;
+    // Otherwise the writer is already waiting for the interval to run out.
+    if (urgent || !wasDirty) mCondition.notify_one();
+}
+
+void AidingStore::writerThreadFunc() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        const int64_t nowMs = clockMs(CLOCK_BOOTTIME);
+        const int64_t dueMs = mLastSaveMs + SAVE_INTERVAL_MS;
+        if (mDirty && (mUrgent || mQuit || mLastSaveMs == 0 || nowMs >= dueMs)) {
+            const Record record = mRecord;
+            mDirty = false;
+            mUrgent = false;
+            mLastSaveMs = nowMs;
+            lock.unlock();
+            if (!writeFileAtomically(mPath, &record, sizeof(record))) {
+                LOG(WARNING) << "Cannot save the last position to " << mPath << ": "
+                             << strerror(errno);
+            }
+            lock.lock();
+            continue;
+        }
+        if (mQuit) return;
+        if (mDirty) {
+            mCondition.wait_for(lock, std::chrono::milliseconds(dueMs - nowMs));
+        } else {
+            mCondition.wait(lock);
+        }
+    }
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/gnss/GnssLocation.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ReceiverConfig.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+using ::aidl::android::hardware::gnss::GnssLocation;
+
+// The last known position and GNSS time, kept in a file across HAL restarts and reboots so the
+// receiver can be aided to a hot start. Fixes and injected data update it in memory; a thread
+// of its own writes it out at most every SAVE_INTERVAL_MS, and on flush(), to a temporary file
+// that is synced and renamed over the old one.
+//
+// Time is kept as the offset of GNSS time from CLOCK_REALTIME, which survives a reboot as long
+// as the system clock does; an offset from a clock that has since gone backwards is not used.
+class AidingStore {
+public:
+    explicit AidingStore(std::string path);
+    ~AidingStore();
+
+    // Dispatcher thread, for every published location: a copy under a lock.
+    void onLocation(const GnssLocation& location);
+    // From the framework. |timeMs| is UTC at CLOCK_BOOTTIME |timeReferenceMs|.
+    void onInjectedTime(int64_t timeMs, int64_t timeReferenceMs, int32_t uncertaintyMs);
+    void onInjectedLocation(const GnssLocation& location);
+    // Forgets the position or time, in the file too.
+    void clear(bool position, bool time);
+    // Writes what is not on disk yet without waiting for the interval.
+    void flush();
+
+    // Aiding for the receiver now, if there is any worth sending.
+    bool timeAid(ReceiverConfig::TimeAid& aid);
+    bool positionAid(ReceiverConfig::PositionAid& aid);
+
+private:
+    // Also the file layout, native byte order.
+    struct Record {
+        static constexpr uint32_t MAGIC = 0x41534e47;  // "GNSA"
+        static constexpr uint32_t VERSION = 1;
+        enum : uint32_t { HAS_POSITION = 1, HAS_TIME = 2 };
+
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t flags = 0;
+        float accuracyMeters = 0;
+        double latitudeDegrees = 0;
+        double longitudeDegrees = 0;
+        double altitudeMeters = 0;
+        int64_t timeOffsetMs = 0;     // GNSS UTC minus CLOCK_REALTIME
+        int64_t timeUncertaintyMs = 0;
+        int64_t savedRealtimeMs = 0;  // CLOCK_REALTIME of the last update
+    };
+
+    // Wakes the writer, which otherwise waits out SAVE_INTERVAL_MS since the last write.
+    void updatedLocked(bool urgent);
+    void writerThreadFunc();
+
+    static constexpr int64_t SAVE_INTERVAL_MS = 60 * 1000;
+    // An offset less certain than this, once drift is added, is not worth a time aid: the
+    // receiver searches a wider window than a cold start would.
+    static constexpr double MAX_TIME_UNCERTAINTY_MS = 3000;
+    // CLOCK_REALTIME drift since the last update: the Pi 5 RTC, if not network time, is good
+    // to this, so an offset stays usable for a day and a half.
+    static constexpr double CLOCK_DRIFT = 20e-6;
+    // Floor on a position aid's error: a stored fix is a hint, not a measurement.
+    static constexpr float MIN_POSITION_ACCURACY_M = 50.0f;
+
+    const std::string mPath;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    Record mRecord;
+    bool mDirty = false;
+    bool mUrgent = false;
+    bool mQuit = false;
+    int64_t mLastSaveMs = 0;  // CLOCK_BOOTTIME, 0 before the first write
+    std::thread mWriterThread;  // last, started once the rest is set up
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
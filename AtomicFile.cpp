@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AtomicFile.h"
+
+#include <android-base/file.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+bool writeFileAtomically(const std::string& path, const void* data, size_t size) {
+    const std::string temporary = path + ".tmp";
+    const int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) return false;
+    const bool written = ::android::base::WriteFully(fd, data, size) && fsync(fd) == 0;
+    int error = errno;
+    close(fd);
+    if (written && rename(temporary.c_str(), path.c_str()) == 0) return true;
+    if (written) error = errno;
+    unlink(temporary.c_str());
+    errno = error;
+    return false;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Replaces |path| with |size| bytes of |data|. They are written to "<path>.tmp" and synced to
+// the disk before the rename, so |path| never points at a torn write. On failure the temporary
+// file is removed and errno says why.
+bool writeFileAtomically(const std::string& path, const void* data, size_t size);
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "BinaryFramer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr uint32_t CRC24Q_POLY = 0x1864CFB;
+
+static constexpr std::array<uint32_t, 256> makeCrc24qTable() {
+    std::array<uint32_t, 256> table = {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 16;
+        for (int bit = 0; bit < 8; bit++) {
+            crc <<= 1;
+            if (crc & 0x1000000) crc ^= CRC24Q_POLY;
+        }
+        table[i] = crc & 0xFFFFFF;
+    }
+    return table;
+}
+static constexpr std::array<uint32_t, 256> kCrc24q = makeCrc24qTable();
+
+static uint32_t crc24q(const uint8_t* p, size_t n) {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < n; i++) crc = ((crc << 8) ^ kCrc24q[(crc >> 16) ^ p[i]]) & 0xFFFFFF;
+    return crc;
+}
+
+const char* BinaryFramer::findSync(const char* p, const char* end) {
+    const void* ubx = memchr(p, UBX_SYNC1, end - p);
+    const char* limit = ubx != nullptr ? static_cast<const char*>(ubx) : end;
+    const void* rtcm = memchr(p, RTCM3_PREAMBLE, limit - p);
+    limit = rtcm != nullptr ? static_cast<const char*>(rtcm) : limit;
+    const void* airoha = memchr(p, AIROHA_SYNC1, limit - p);
+    return airoha != nullptr ? static_cast<const char*>(airoha) : limit;
+}
+
+void BinaryFramer::reset() {
+    mState = State::IDLE;
+    mProtocol = BinaryProtocol::UBX;
+    mLength = 0;
+    mNeeded = 0;
+    mArrivalNs = 0;
+}
+
+bool BinaryFramer::next(const char*& cursor, const char* end, BinaryFrame& out) {
+    while (cursor < end) {
+        switch (mState) {
+            case State::IDLE: {
+                const uint8_t c = static_cast<uint8_t>(*cursor);
+                if (c == UBX_SYNC1) {
+                    mProtocol = BinaryProtocol::UBX;
+                } else if (c == RTCM3_PREAMBLE) {
+                    mProtocol = BinaryProtocol::RTCM3;
+                } else if (c == AIROHA_SYNC1) {
+                    mProtocol = BinaryProtocol::AIROHA;
+                } else {
+                    cursor++;
+                    return false;
+                }
+                mArrivalNs = (mChunkEnd != nullptr && cursor < mChunkEnd)
+                        ? mChunkEndTimeNs - (mChunkEnd - cursor) * mByteTimeNs
+                        : 0;
+                mFrame[0] = c;
+                mLength = 1;
+                cursor++;
+                mState = State::SYNC;
+                break;
+            }
+            case State::SYNC: {
+                // Checked before it is consumed, so a stray sync byte costs only itself.
+                const uint8_t c = static_cast<uint8_t>(*cursor);
+                bool valid = false;
+                switch (mProtocol) {
+                    case BinaryProtocol::UBX:
+                        valid = c == UBX_SYNC2;
+                        mNeeded = UBX_HEADER;
+                        break;
+                    case BinaryProtocol::RTCM3:
+                        valid = (c & 0xFC) == 0;
+                        mNeeded = RTCM3_HEADER;
+                        break;
+                    case BinaryProtocol::AIROHA:
+                        valid = c == AIROHA_SYNC2;
+                        mNeeded = AIROHA_HEADER;
+                        break;
+                }
+                if (!valid) {
+                    mState = State::IDLE;
+                    return false;
+                }
+                mFrame[mLength++] = c;
+                cursor++;
+                mState = State::HEADER;
+                break;
+            }
+            case State::HEADER:
+            case State::BODY: {
+                const size_t n = std::min<size_t>(mNeeded - mLength, end - cursor);
+                memcpy(mFrame + mLength, cursor, n);
+                mLength += n;
+                cursor += n;
+                if (mLength < mNeeded) return false;
+                if (mState == State::HEADER) {
+                    size_t payload, trailer;
+                    if (mProtocol == BinaryProtocol::UBX) {
+                        payload = mFrame[4] | (mFrame[5] << 8);
+                        trailer = UBX_TRAILER;
+                    } else if (mProtocol == BinaryProtocol::RTCM3) {
+                        payload = ((mFrame[1] & 0x03) << 8) | mFrame[2];
+                        trailer = RTCM3_TRAILER;
+                    } else {
+                        // The length counts the whole packet; one too short for its own header
+                        // wraps round to oversize.
+                        payload = size_t(mFrame[2] | (mFrame[3] << 8)) - AIROHA_HEADER -
+                                  AIROHA_TRAILER;
+                        trailer = AIROHA_TRAILER;
+                    }
+                    if (payload > MAX_PAYLOAD) {
+                        mStats.oversize++;
+                        mState = State::IDLE;
+                        return false;
+                    }
+                    mNeeded += payload + trailer;
+                    mState = State::BODY;
+                    break;
+                }
+                mState = State::IDLE;
+                return complete(out);
+            }
+        }
+    }
+    return false;
+}
+
+bool BinaryFramer::complete(BinaryFrame& out) {
+    if (mProtocol == BinaryProtocol::UBX) {
+        const size_t payload = mLength - UBX_HEADER - UBX_TRAILER;
+        uint8_t a = 0, b = 0;
+        for (size_t i = 2; i < UBX_HEADER + payload; i++) {
+            a += mFrame[i];
+            b += a;
+        }
+        if (a != mFrame[mLength - 2] || b != mFrame[mLength - 1]) {
+            mStats.checksumErrors++;
+            return false;
+        }
+        out.messageId = static_cast<uint16_t>((mFrame[2] << 8) | mFrame[3]);
+        out.payload = mFrame + UBX_HEADER;
+        out.payloadLength = payload;
+    } else if (mProtocol == BinaryProtocol::AIROHA) {
+        const size_t payload = mLength - AIROHA_HEADER - AIROHA_TRAILER;
+        uint8_t checksum = 0;
+        for (size_t i = 2; i < AIROHA_HEADER + payload; i++) checksum ^= mFrame[i];
+        const uint8_t* trailer = mFrame + mLength - AIROHA_TRAILER;
+        if (checksum != trailer[0] || trailer[1] != '\r' || trailer[2] != '\n') {
+            mStats.checksumErrors++;
+            return false;
+        }
+        out.messageId = static_cast<uint16_t>(mFrame[4] | (mFrame[5] << 8));
+        out.payload = mFrame + AIROHA_HEADER;
+        out.payloadLength = payload;
+    } else {
+        const size_t payload = mLength - RTCM3_HEADER - RTCM3_TRAILER;
+        const uint8_t* crc = mFrame + mLength - RTCM3_TRAILER;
+        if (crc24q(mFrame, mLength - RTCM3_TRAILER) != (uint32_t(crc[0]) << 16 | crc[1] << 8 | crc[2])) {
+            mStats.checksumErrors++;
+            return false;
+        }
+        out.payload = mFrame + RTCM3_HEADER;
+        out.payloadLength = payload;
+        // The message number is the first 12 bits of every RTCM 3 message.
+        out.messageId = payload >= 2 ? static_cast<uint16_t>((out.payload[0] << 4) | (out.payload[1] >> 4)) : 0;
+    }
+    out.protocol = mProtocol;
+    out.arrivalNs = mArrivalNs;
+    mStats.frames++;
+    return true;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
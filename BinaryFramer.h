@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+enum class BinaryProtocol : uint8_t { UBX, RTCM3, AIROHA };
+
+// A checksum-verified binary message. |payload| points into the framer's buffer and is only
+// valid until the next call to BinaryFramer::next().
+struct BinaryFrame {
+    BinaryProtocol protocol = BinaryProtocol::UBX;
+    uint16_t messageId = 0;  // UBX: class << 8 | id; RTCM3: message number; AIROHA: packet id
+    const uint8_t* payload = nullptr;
+    size_t payloadLength = 0;
+    int64_t arrivalNs = 0;   // when the sync byte arrived, see setChunkTiming()
+};
+
+// Streaming framer for the binary protocols a receiver can interleave with NMEA:
+//  - u-blox UBX: B5 62, class, id, 16-bit length, payload, 8-bit Fletcher checksum;
+//  - RTCM 3: D3, 10-bit length, payload, CRC-24Q;
+//  - Airoha (MediaTek) binary packets: 04 24, 16-bit total length, 16-bit id, payload, 8-bit
+//    XOR checksum, CR LF. The LC29H answers assistance uploads with these.
+// None of the sync bytes can occur in NMEA, which is printable 7-bit ASCII, so findSync() splits
+// a mixed stream without decoding it. Frames failing their checksum are dropped.
+class BinaryFramer {
+public:
+    // UBX-NAV-SAT and UBX-RXM-RAWX with 128 signals fit; RTCM 3 is limited to 1023 bytes.
+    static constexpr size_t MAX_PAYLOAD = 4096;
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t checksumErrors = 0;
+        uint64_t oversize = 0;
+    };
+
+    BinaryFramer() { reset(); }
+
+    // First byte in [p, end) that may start a binary frame, or |end|.
+    static const char* findSync(const char* p, const char* end);
+
+    // True while a frame is partially received; its remaining bytes must come next.
+    bool inFrame() const { return mState != State::IDLE; }
+
+    // Continues the frame in progress or, when idle, starts one at |cursor|, which must point
+    // at a byte returned by findSync(). Returns true and fills |out| once a valid frame is
+    // complete; returns false when the input runs out first or the bytes turn out not to be a
+    // frame (in which case |cursor| has moved past the sync byte only).
+    bool next(const char*& cursor, const char* end, BinaryFrame& out);
+
+    // As NmeaFramer::setChunkTiming().
+    void setChunkTiming(const char* chunkEnd, int64_t endTimeNs, int64_t byteTimeNs) {
+        mChunkEnd = chunkEnd;
+        mChunkEndTimeNs = endTimeNs;
+        mByteTimeNs = byteTimeNs;
+    }
+
+    void reset();
+    const Stats& stats() const { return mStats; }
+
+private:
+    enum class State : uint8_t { IDLE, SYNC, HEADER, BODY };
+
+    static constexpr uint8_t UBX_SYNC1 = 0xB5;
+    static constexpr uint8_t UBX_SYNC2 = 0x62;
+    static constexpr uint8_t RTCM3_PREAMBLE = 0xD3;
+    static constexpr uint8_t AIROHA_SYNC1 = 0x04;
+    static constexpr uint8_t AIROHA_SYNC2 = 0x24;
+    static constexpr size_t UBX_HEADER = 6;    // sync, class, id, length
+    static constexpr size_t UBX_TRAILER = 2;
+    static constexpr size_t RTCM3_HEADER = 3;  // preamble, reserved + length
+    static constexpr size_t RTCM3_TRAILER = 3;
+    static constexpr size_t AIROHA_HEADER = 6;  // sync, length, id
+    static constexpr size_t AIROHA_TRAILER = 3; // checksum, CR LF
+
+    bool complete(BinaryFrame& out);
+
+    State mState;
+    BinaryProtocol mProtocol;
+    size_t mLength;
+    size_t mNeeded;  // bytes of the frame known so far to be required
+    int64_t mArrivalNs;
+    const char* mChunkEnd = nullptr;
+    int64_t mChunkEndTimeNs = 0;
+    int64_t mByteTimeNs = 0;
+    // Airoha framing has the most overhead of the three.
+    uint8_t mFrame[AIROHA_HEADER + MAX_PAYLOAD + AIROHA_TRAILER];
+    Stats mStats;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
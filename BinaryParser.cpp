@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "BinaryParser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+#include "NmeaDecode.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "fields are read in place");
+
+static constexpr uint16_t UBX_NAV_PVT = 0x0107;
+static constexpr uint16_t UBX_NAV_SAT = 0x0135;
+static constexpr uint16_t UBX_RXM_RAWX = 0x0215;
+// MSM4 to MSM7 of every constellation: 1074..1077 for GPS up to 1134..1137 for NavIC.
+static constexpr uint16_t RTCM_MSM_FIRST = 1071;
+static constexpr uint16_t RTCM_MSM_LAST = 1137;
+static constexpr size_t NAV_PVT_LENGTH = 92;
+static constexpr size_t NAV_SAT_HEADER = 8;
+static constexpr size_t NAV_SAT_BLOCK = 12;
+static constexpr size_t RAWX_HEADER = 16;
+static constexpr size_t RAWX_BLOCK = 32;
+static constexpr int32_t MS_PER_DAY = 24 * 3600 * 1000;
+static constexpr int32_t MS_PER_WEEK = 7 * MS_PER_DAY;
+static constexpr int64_t NS_PER_MS = 1000000;
+static constexpr int64_t NS_PER_DAY = MS_PER_DAY * NS_PER_MS;
+static constexpr int64_t NS_PER_WEEK = MS_PER_WEEK * NS_PER_MS;
+
+static constexpr double SPEED_OF_LIGHT = 299792458.0;
+// BeiDou time runs 14 s behind GPS time; GLONASS time is UTC + 3 h.
+static constexpr int32_t BDT_OFFSET_MS = 14000;
+static constexpr int32_t GLONASS_UTC_OFFSET_MS = 3 * 3600 * 1000;
+
+// MSM carries no quality figures; these are typical of a mass-market receiver.
+static constexpr int64_t MSM_PSEUDORANGE_UNCERTAINTY_NS = 10;
+static constexpr double MSM_RATE_UNCERTAINTY_MPS = 0.05;
+static constexpr double MSM_ADR_UNCERTAINTY_M = 0.01;
+
+static constexpr double L1_HZ = 1575.42e6;   // also E1, B1C
+static constexpr double L2_HZ = 1227.60e6;
+static constexpr double L5_HZ = 1176.45e6;   // also E5a, B2a
+static constexpr double E5B_HZ = 1207.14e6;  // also B2I, B2b
+static constexpr double E5_HZ = 1191.795e6;
+static constexpr double E6_HZ = 1278.75e6;   // also QZSS L6
+static constexpr double B1I_HZ = 1561.098e6;
+static constexpr double B3_HZ = 1268.52e6;
+static constexpr double G1_HZ = 1602.0e6;    // GLONASS FDMA channel 0
+static constexpr double G1_STEP_HZ = 562.5e3;
+static constexpr double G2_HZ = 1246.0e6;
+static constexpr double G2_STEP_HZ = 437.5e3;
+
+template <typename T>
+static T read(const uint8_t* p) {
+    T value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// UBX gnssId to constellation; svids already follow the Android ranges except QZSS.
+static bool ubxSatellite(uint8_t gnssId, uint8_t ubxSvid, Constellation& constellation, int& svid) {
+    static constexpr Constellation kConstellations[] = {
+        Constellation::GPS, Constellation::SBAS, Constellation::GALILEO, Constellation::BEIDOU,
+        Constellation::UNKNOWN /* IMES */, Constellation::QZSS, Constellation::GLONASS,
+        Constellation::IRNSS,
+    };
+    if (gnssId >= std::size(kConstellations) || ubxSvid == 0 || ubxSvid == 255) return false;
+    constellation = kConstellations[gnssId];
+    svid = constellation == Constellation::QZSS ? ubxSvid + 192 : ubxSvid;
+    return constellation != Constellation::UNKNOWN;
+}
+
+struct Signal {
+    double carrierFrequencyHz;
+    char codeType;
+};
+
+// UBX sigId of RXM-RAWX. GLONASS frequencies are for channel 0.
+static bool ubxSignal(Constellation constellation, uint8_t sigId, Signal& out) {
+    switch (constellation) {
+        case Constellation::GPS:
+            switch (sigId) {
+                case 0: out = {L1_HZ, 'C'}; return true;
+                case 3: out = {L2_HZ, 'L'}; return true;
+                case 4: out = {L2_HZ, 'S'}; return true;
+                case 6: out = {L5_HZ, 'I'}; return true;
+                case 7: out = {L5_HZ, 'Q'}; return true;
+            }
+            return false;
+        case Constellation::SBAS:
+            if (sigId == 0) out = {L1_HZ, 'C'};
+            return sigId == 0;
+        case Constellation::GALILEO:
+            switch (sigId) {
+                case 0: out = {L1_HZ, 'C'}; return true;
+                case 1: out = {L1_HZ, 'B'}; return true;
+                case 3: out = {L5_HZ, 'I'}; return true;
+                case 4: out = {L5_HZ, 'Q'}; return true;
+                case 5: out = {E5B_HZ, 'I'}; return true;
+                case 6: out = {E5B_HZ, 'Q'}; return true;
+                case 8: out = {E6_HZ, 'B'}; return true;
+                case 9: out = {E6_HZ, 'C'}; return true;
+                case 10: out = {E6_HZ, 'A'}; return true;
+            }
+            return false;
+        case Constellation::BEIDOU:
+            switch (sigId) {
+                case 0: case 1: out = {B1I_HZ, 'I'}; return true;
+                case 2: case 3: out = {E5B_HZ, 'I'}; return true;
+                case 4: case 10: out = {B3_HZ, 'I'}; return true;
+                case 5: out = {L1_HZ, 'P'}; return true;
+                case 6: out = {L1_HZ, 'D'}; return true;
+                case 7: out = {L5_HZ, 'P'}; return true;
+                case 8: out = {L5_HZ, 'D'}; return true;
+            }
+            return false;
+        case Constellation::QZSS:
+            switch (sigId) {
+                case 0: out = {L1_HZ, 'C'}; return true;
+                case 1: out = {L1_HZ, 'Z'}; return true;
+                case 4: out = {L2_HZ, 'S'}; return true;
+                case 5: out = {L2_HZ, 'L'}; return true;
+                case 8: out = {L5_HZ, 'I'}; return true;
+                case 9: out = {L5_HZ, 'Q'}; return true;
+                case 12: out = {L1_HZ, 'E'}; return true;
+            }
+            return false;
+        case Constellation::GLONASS:
+            if (sigId == 0) out = {G1_HZ, 'C'};
+            if (sigId == 2) out = {G2_HZ, 'C'};
+            return sigId == 0 || sigId == 2;
+        case Constellation::IRNSS:
+            if (sigId == 0) out = {L5_HZ, 'A'};
+            return sigId == 0;
+        default:
+            return false;
+    }
+}
+
+// RTCM 3 MSM signal ID (1..32, bit 1 being the most significant of the signal mask).
+static bool msmSignal(Constellation constellation, int signalId, Signal& out) {
+    switch (constellation) {
+        case Constellation::GPS:
+        case Constellation::QZSS:
+        case Constellation::SBAS:
+            switch (signalId) {
+                case 2: out = {L1_HZ, 'C'}; return true;
+                case 3: out = {L1_HZ, 'P'}; return true;
+                case 4: out = {L1_HZ, 'W'}; return true;
+                case 8: out = {L2_HZ, 'C'}; return true;
+                case 9: case 10: case 11:
+                    // QZSS puts its L6 signals where GPS has L2 P(Y).
+                    if (constellation == Constellation::QZSS) {
+                        out = {E6_HZ, "SLX"[signalId - 9]};
+                        return true;
+                    }
+                    out = {L2_HZ, signalId == 9 ? 'P' : 'W'};
+                    return signalId != 11;
+                case 15: out = {L2_HZ, 'S'}; return true;
+                case 16: out = {L2_HZ, 'L'}; return true;
+                case 17: out = {L2_HZ, 'X'}; return true;
+                case 22: out = {L5_HZ, 'I'}; return true;
+                case 23: out = {L5_HZ, 'Q'}; return true;
+                case 24: out = {L5_HZ, 'X'}; return true;
+                case 30: out = {L1_HZ, 'S'}; return true;
+                case 31: out = {L1_HZ, 'L'}; return true;
+                case 32: out = {L1_HZ, 'X'}; return true;
+            }
+            return false;
+        case Constellation::GLONASS:
+            switch (signalId) {
+                case 2: out = {G1_HZ, 'C'}; return true;
+                case 3: out = {G1_HZ, 'P'}; return true;
+                case 8: out = {G2_HZ, 'C'}; return true;
+                case 9: out = {G2_HZ, 'P'}; return true;
+            }
+            return false;
+        case Constellation::GALILEO: {
+            static constexpr char kCodes[] = "CABXZ";
+            if (signalId >= 2 && signalId <= 6) out = {L1_HZ, kCodes[signalId - 2]};
+            else if (signalId >= 8 && signalId <= 12) out = {E6_HZ, kCodes[signalId - 8]};
+            else if (signalId >= 14 && signalId <= 16) out = {E5B_HZ, "IQX"[signalId - 14]};
+            else if (signalId >= 18 && signalId <= 20) out = {E5_HZ, "IQX"[signalId - 18]};
+            else if (signalId >= 22 && signalId <= 24) out = {L5_HZ, "IQX"[signalId - 22]};
+            else return false;
+            return true;
+        }
+        case Constellation::BEIDOU:
+            if (signalId >= 2 && signalId <= 4) out = {B1I_HZ, "IQX"[signalId - 2]};
+            else if (signalId >= 8 && signalId <= 10) out = {B3_HZ, "IQX"[signalId - 8]};
+            else if (signalId >= 14 && signalId <= 16) out = {E5B_HZ, "IQX"[signalId - 14]};
+            else if (signalId >= 22 && signalId <= 24) out = {L5_HZ, "DPX"[signalId - 22]};
+            else if (signalId == 25) out = {E5B_HZ, 'D'};
+            else if (signalId >= 30 && signalId <= 32) out = {L1_HZ, "DPX"[signalId - 30]};
+            else return false;
+            return true;
+        case Constellation::IRNSS:
+            if (signalId == 22) out = {L5_HZ, 'A'};
+            return signalId == 22;
+        default:
+            return false;
+    }
+}
+
+static double glonassFrequencyHz(double nominalHz, int channel) {
+    return nominalHz + channel * (nominalHz == G1_HZ ? G1_STEP_HZ : G2_STEP_HZ);
+}
+
+static uint32_t measurementState(Constellation constellation, double carrierFrequencyHz) {
+    if (constellation == Constellation::GLONASS) {
+        return MEASUREMENT_STATE_CODE_LOCK | MEASUREMENT_STATE_GLO_TOD_DECODED |
+               MEASUREMENT_STATE_GLO_TOD_KNOWN;
+    }
+    uint32_t state = MEASUREMENT_STATE_CODE_LOCK | MEASUREMENT_STATE_TOW_DECODED |
+                     MEASUREMENT_STATE_TOW_KNOWN;
+    if (constellation == Constellation::GALILEO && carrierFrequencyHz == L1_HZ) {
+        state |= MEASUREMENT_STATE_GAL_E1BC_CODE_LOCK;
+    }
+    return state;
+}
+
+static int64_t wrap(int64_t value, int64_t period) {
+    value %= period;
+    return value < 0 ? value + period : value;
+}
+
+// MSB-first reader for RTCM 3 bit fields. Reading past the end yields zeros and sets !ok().
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t length) : mData(data), mBits(length * 8) {}
+
+    // Up to 32 bits, unsigned.
+    uint32_t u(unsigned n) {
+        if (mPos + n > mBits) {
+            mPos = mBits;
+            mOk = false;
+            return 0;
+        }
+        const unsigned skip = mPos & 7;
+        size_t byte = mPos >> 3;
+        uint64_t value = 0;
+        unsigned have = 0;
+        while (have < skip + n) {
+            value = value << 8 | mData[byte++];
+            have += 8;
+        }
+        mPos += n;
+        return static_cast<uint32_t>((value >> (have - skip - n)) & ((uint64_t{1} << n) - 1));
+    }
+    // Up to 32 bits, two's complement.
+    int32_t s(unsigned n) {
+        return static_cast<int32_t>(u(n) << (32 - n)) >> (32 - n);
+    }
+    uint64_t u64(unsigned n) {
+        if (n <= 32) return u(n);
+        const uint64_t high = u(n - 32);
+        return high << 32 | u(32);
+    }
+    void skip(unsigned n) { u64(n); }
+    bool ok() const { return mOk; }
+
+private:
+    const uint8_t* mData;
+    size_t mBits;
+    size_t mPos = 0;
+    bool mOk = true;
+};
+
+bool BinaryParser::parse(const BinaryFrame& frame) {
+    using Decoder = bool (BinaryParser::*)(const BinaryFrame&);
+    struct Entry {
+        BinaryProtocol protocol;
+        uint16_t firstId;
+        uint16_t lastId;
+        Decoder decode;
+    };
+    static constexpr Entry kDecoders[] = {
+        {BinaryProtocol::UBX, UBX_NAV_PVT, UBX_NAV_PVT, &BinaryParser::parseNavPvt},
+        {BinaryProtocol::UBX, UBX_NAV_SAT, UBX_NAV_SAT, &BinaryParser::parseNavSat},
+        {BinaryProtocol::UBX, UBX_RXM_RAWX, UBX_RXM_RAWX, &BinaryParser::parseRxmRawx},
+        {BinaryProtocol::RTCM3, RTCM_MSM_FIRST, RTCM_MSM_LAST, &BinaryParser::parseMsm},
+    };
+    for (const Entry& entry : kDecoders) {
+        if (entry.protocol == frame.protocol && frame.messageId >= entry.firstId &&
+            frame.messageId <= entry.lastId) {
+            return (this->*entry.decode)(frame);
+        }
+    }
+    return false;
+}
+
+bool BinaryParser::parseNavPvt(const BinaryFrame& frame) {
+    if (frame.payloadLength < NAV_PVT_LENGTH) return false;
+    const uint8_t* p = frame.payload;
+    NmeaFix fix;
+    fix.arrivalNs = frame.arrivalNs;
+
+    const uint8_t valid = p[11];
+    if (valid & 0x02) {
+        // |nano| is signed: the time is hh:mm:ss plus or minus up to a second.
+        int64_t ms = p[8] * 3600000LL + p[9] * 60000LL + p[10] * 1000LL;
+        ms += std::lround(read<int32_t>(p + 16) * 1e-6);
+        int32_t dayOffset = 0;
+        if (ms < 0) {
+            ms += MS_PER_DAY;
+            dayOffset = -1;
+        } else if (ms >= MS_PER_DAY) {
+            ms -= MS_PER_DAY;
+            dayOffset = 1;
+        }
+        fix.utcMsOfDay = static_cast<int32_t>(ms);
+        if (valid & 0x01) {
+            fix.utcDaysSinceEpoch = daysFromCivil(read<uint16_t>(p + 4), p[6], p[7]) + dayOffset;
+        }
+        mUtcMsOfDay = fix.utcMsOfDay;
+    }
+
+    const uint8_t fixType = p[20];
+    const uint8_t flags = p[21];
+    fix.numSatellites = p[23];
+    // 2D, 3D or GNSS + dead reckoning, and the receiver vouches for it.
+    if ((flags & 0x01) && fixType >= 2 && fixType <= 4) {
+        // Same scale as GGA's quality field.
+        const uint8_t carrier = flags >> 6;
+        fix.fixQuality = carrier == 2 ? 4 : carrier == 1 ? 5 : (flags & 0x02) ? 2 : 1;
+        fix.longitudeDegrees = read<int32_t>(p + 24) * 1e-7;
+        fix.latitudeDegrees = read<int32_t>(p + 28) * 1e-7;
+        fix.horizontalAccuracyMeters = read<uint32_t>(p + 40) * 1e-3;
+        fix.speedMetersPerSec = read<int32_t>(p + 60) * 1e-3;
+        fix.speedAccuracyMetersPerSecond = read<uint32_t>(p + 68) * 1e-3;
+        fix.bearingDegrees = read<int32_t>(p + 64) * 1e-5;
+        if (fix.bearingDegrees < 0) fix.bearingDegrees += 360;
+        fix.bearingAccuracyDegrees = std::min(180.0, read<uint32_t>(p + 72) * 1e-5);
+        fix.flags = FIX_HAS_LAT_LONG | FIX_HAS_HORIZONTAL_ACCURACY | FIX_HAS_SPEED |
+                    FIX_HAS_SPEED_ACCURACY | FIX_HAS_BEARING | FIX_HAS_BEARING_ACCURACY;
+        if (fixType != 2) {
+            // Height above the ellipsoid, which is what GnssLocation asks for.
+            fix.altitudeMeters = read<int32_t>(p + 32) * 1e-3;
+            fix.verticalAccuracyMeters = read<uint32_t>(p + 44) * 1e-3;
+            fix.flags |= FIX_HAS_ALTITUDE | FIX_HAS_VERTICAL_ACCURACY;
+        }
+    }
+    mFix = fix;
+    mHasFix = true;
+    return true;
+}
+
+bool BinaryParser::parseNavSat(const BinaryFrame& frame) {
+    if (frame.payloadLength < NAV_SAT_HEADER) return false;
+    const uint8_t* p = frame.payload;
+    const size_t count = std::min<size_t>(p[5], (frame.payloadLength - NAV_SAT_HEADER) / NAV_SAT_BLOCK);
+
+    mSatellites.age(mUtcMsOfDay);
+    mSatellites.clearUsedInFix();
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* block = p + NAV_SAT_HEADER + i * NAV_SAT_BLOCK;
+        Constellation constellation;
+        int svid;
+        if (!ubxSatellite(block[0], block[1], constellation, svid)) continue;
+        if (mSatellites.blocked(constellation, svid)) continue;
+        // NAV-SAT has no signal breakdown, so the entry carries no signal ID or frequency.
+        NmeaSatellite& sat = mSatellites.update(constellation, svid, 0, mUtcMsOfDay);
+        sat.cn0DbHz = block[2];
+        sat.elevationDegrees = static_cast<int8_t>(block[3]);
+        sat.azimuthDegrees = read<int16_t>(block + 4);
+        if (read<uint32_t>(block + 8) & 0x08) mSatellites.setUsedInFix(constellation, svid);
+    }
+    return true;
+}
+
+bool BinaryParser::parseRxmRawx(const BinaryFrame& frame) {
+    if (frame.payloadLength < RAWX_HEADER) return false;
+    const uint8_t* p = frame.payload;
+    const size_t count = std::min<size_t>(p[11], (frame.payloadLength - RAWX_HEADER) / RAWX_BLOCK);
+    const uint8_t recStat = p[12];
+
+    // Drop a half-collected MSM epoch rather than mix the two.
+    mMsmOpen = false;
+    RawEpoch& epoch = mRawEpochs[mRawEpoch ^ 1];
+    epoch.arrivalNs = frame.arrivalNs;
+    epoch.gpsTowNs = std::llround(read<double>(p) * 1e9);
+    epoch.gpsWeek = read<uint16_t>(p + 8);
+    epoch.leapSeconds = (recStat & 0x01) ? static_cast<int8_t>(p[10]) : -1;
+    epoch.clockReset = (recStat & 0x02) != 0;
+    epoch.count = 0;
+    const int32_t leapSeconds = epoch.leapSeconds >= 0 ? epoch.leapSeconds : NOMINAL_LEAP_SECONDS;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* block = p + RAWX_HEADER + i * RAWX_BLOCK;
+        const uint8_t trkStat = block[30];
+        Constellation constellation;
+        int svid;
+        Signal signal{};
+        if (!(trkStat & 0x01)) continue;  // no valid pseudorange
+        if (!ubxSatellite(block[20], block[21], constellation, svid)) continue;
+        if (mSatellites.blocked(constellation, svid)) continue;
+        if (!ubxSignal(constellation, block[22], signal)) continue;
+        if (constellation == Constellation::GLONASS) {
+            signal.carrierFrequencyHz = glonassFrequencyHz(signal.carrierFrequencyHz, block[23] - 7);
+        }
+        RawMeasurement* m = epoch.add();
+        if (m == nullptr) break;
+
+        // Transmit time = receive time in the constellation's scale - pseudorange / c.
+        int64_t receiveNs = epoch.gpsTowNs;
+        int64_t periodNs = NS_PER_WEEK;
+        if (constellation == Constellation::BEIDOU) {
+            receiveNs -= BDT_OFFSET_MS * NS_PER_MS;
+        } else if (constellation == Constellation::GLONASS) {
+            receiveNs += (GLONASS_UTC_OFFSET_MS - leapSeconds * 1000LL) * NS_PER_MS;
+            periodNs = NS_PER_DAY;
+        }
+        const double pseudorangeM = read<double>(block);
+        const double wavelengthM = SPEED_OF_LIGHT / signal.carrierFrequencyHz;
+
+        m->constellation = constellation;
+        m->svid = svid;
+        m->codeType = signal.codeType;
+        m->carrierFrequencyHz = signal.carrierFrequencyHz;
+        m->state = measurementState(constellation, signal.carrierFrequencyHz);
+        m->receivedSvTimeNs = wrap(receiveNs - std::llround(pseudorangeM / SPEED_OF_LIGHT * 1e9), periodNs);
+        m->receivedSvTimeUncertaintyNs =
+                std::max<int64_t>(1, std::llround(0.01 * (1 << (block[27] & 0x0F)) / SPEED_OF_LIGHT * 1e9));
+        m->cn0DbHz = block[26];
+        m->hasPseudorangeRate = true;
+        m->pseudorangeRateMps = -read<float>(block + 16) * wavelengthM;
+        m->pseudorangeRateUncertaintyMps = 0.002 * (1 << (block[29] & 0x0F)) * wavelengthM;
+        m->adrState = 0;
+        m->accumulatedDeltaRangeMeters = 0;
+        m->accumulatedDeltaRangeUncertaintyMeters = 0;
+        if (trkStat & 0x02) {
+            m->adrState = ADR_STATE_VALID;
+            if (trkStat & 0x04) m->adrState |= ADR_STATE_HALF_CYCLE_RESOLVED;
+            if (read<uint16_t>(block + 24) == 0) m->adrState |= ADR_STATE_RESET;
+            m->accumulatedDeltaRangeMeters = read<double>(block + 8) * wavelengthM;
+            m->accumulatedDeltaRangeUncertaintyMeters = 0.004 * (block[28] & 0x0F) * wavelengthM;
+        }
+    }
+    mRawEpoch ^= 1;
+    mHasRawEpoch = true;
+    return true;
+}
+
+bool BinaryParser::parseMsm(const BinaryFrame& frame) {
+    static constexpr Constellation kConstellations[] = {
+        Constellation::GPS, Constellation::GLONASS, Constellation::GALILEO, Constellation::SBAS,
+        Constellation::QZSS, Constellation::BEIDOU, Constellation::IRNSS,
+    };
+    static constexpr unsigned MAX_CELLS = 64;
+    const int type = frame.messageId % 10;
+    const size_t group = frame.messageId / 10 - 107;
+    if (type < 4 || type > 7 || group >= std::size(kConstellations)) return false;
+    const Constellation constellation = kConstellations[group];
+    const bool extended = type == 5 || type == 7;  // with Doppler
+    const bool high = type >= 6;                   // high resolution
+
+    BitReader bits(frame.payload, frame.payloadLength);
+    bits.skip(12 + 12);  // message number, reference station
+    const uint32_t epochTime = bits.u(30);
+    const bool more = bits.u(1) != 0;
+    bits.skip(3 + 7 + 2 + 2 + 1 + 3);  // IODS, reserved, clock steering, ext clock, smoothing
+    const uint64_t satelliteMask = bits.u64(64);
+    const uint32_t signalMask = bits.u(32);
+    const unsigned satellites = __builtin_popcountll(satelliteMask);
+    const unsigned signals = __builtin_popcount(signalMask);
+    if (satellites * signals > MAX_CELLS) return false;
+    const uint64_t cellMask = bits.u64(satellites * signals);
+    const unsigned cells = __builtin_popcountll(cellMask);
+
+    uint8_t roughMs[MAX_CELLS], extInfo[MAX_CELLS] = {};
+    uint16_t roughModMs[MAX_CELLS];
+    int16_t roughRate[MAX_CELLS] = {};
+    for (unsigned i = 0; i < satellites; i++) roughMs[i] = bits.u(8);
+    if (extended) for (unsigned i = 0; i < satellites; i++) extInfo[i] = bits.u(4);
+    for (unsigned i = 0; i < satellites; i++) roughModMs[i] = bits.u(10);
+    if (extended) for (unsigned i = 0; i < satellites; i++) roughRate[i] = bits.s(14);
+
+    const unsigned prBits = high ? 20 : 15, phaseBits = high ? 24 : 22;
+    const unsigned lockBits = high ? 10 : 4, cnrBits = high ? 10 : 6;
+    int32_t finePr[MAX_CELLS], finePhase[MAX_CELLS], fineRate[MAX_CELLS] = {};
+    uint16_t lock[MAX_CELLS], cnr[MAX_CELLS];
+    uint8_t half[MAX_CELLS];
+    for (unsigned i = 0; i < cells; i++) finePr[i] = bits.s(prBits);
+    for (unsigned i = 0; i < cells; i++) finePhase[i] = bits.s(phaseBits);
+    for (unsigned i = 0; i < cells; i++) lock[i] = bits.u(lockBits);
+    for (unsigned i = 0; i < cells; i++) half[i] = bits.u(1);
+    for (unsigned i = 0; i < cells; i++) cnr[i] = bits.u(cnrBits);
+    if (extended) for (unsigned i = 0; i < cells; i++) fineRate[i] = bits.s(15);
+    if (!bits.ok()) return false;
+
+    // Every constellation's messages of one epoch share a receiver instant; key them by GPS
+    // time of day. GLONASS carries day of week (7 if unknown) and Moscow time of day.
+    int64_t scaleMs = epochTime, periodMs = MS_PER_WEEK, gpsTowMs = epochTime, gpsTodMs = -1;
+    if (constellation == Constellation::BEIDOU) {
+        gpsTowMs = wrap(gpsTowMs + BDT_OFFSET_MS, MS_PER_WEEK);
+    } else if (constellation == Constellation::GLONASS) {
+        const uint32_t dayOfWeek = epochTime >> 27;
+        scaleMs = epochTime & ((1u << 27) - 1);
+        periodMs = MS_PER_DAY;
+        const int64_t gpsMs = scaleMs - GLONASS_UTC_OFFSET_MS + NOMINAL_LEAP_SECONDS * 1000;
+        gpsTowMs = dayOfWeek < 7 ? wrap(dayOfWeek * MS_PER_DAY + gpsMs, MS_PER_WEEK) : -1;
+        gpsTodMs = wrap(gpsMs, MS_PER_DAY);
+    }
+    if (gpsTowMs >= 0) gpsTodMs = gpsTowMs % MS_PER_DAY;
+    const int32_t keyMs = static_cast<int32_t>(gpsTodMs);
+    if (mMsmOpen && keyMs != mMsmKeyMs) completeMsmEpoch();
+
+    RawEpoch& epoch = mRawEpochs[mRawEpoch ^ 1];
+    if (!mMsmOpen) {
+        epoch.arrivalNs = frame.arrivalNs;
+        epoch.gpsTowNs = -1;
+        epoch.gpsWeek = -1;
+        epoch.leapSeconds = -1;
+        epoch.clockReset = false;
+        epoch.count = 0;
+        mMsmOpen = true;
+        mMsmKeyMs = keyMs;
+    }
+    if (epoch.gpsTowNs < 0 && gpsTowMs >= 0) epoch.gpsTowNs = gpsTowMs * NS_PER_MS;
+
+    const double prUnitMs = high ? 1.0 / (1 << 29) : 1.0 / (1 << 24);
+    const double phaseUnitMs = high ? 1.0 / (1u << 31) : 1.0 / (1 << 29);
+    const int32_t prInvalid = -(1 << (prBits - 1)), phaseInvalid = -(1 << (phaseBits - 1));
+    const int32_t roughRateInvalid = -(1 << 13), fineRateInvalid = -(1 << 14);
+    const int satelliteOffset = constellation == Constellation::SBAS ? 119
+            : constellation == Constellation::QZSS ? 192 : 0;
+
+    unsigned satellite = 0, cell = 0, cellBit = satellites * signals;
+    for (int satelliteId = 1; satelliteId <= 64; satelliteId++) {
+        if (!(satelliteMask >> (64 - satelliteId) & 1)) continue;
+        // Its cells are still stepped over.
+        const bool blocked = mSatellites.blocked(constellation, satelliteId + satelliteOffset);
+        for (int signalId = 1; signalId <= 32; signalId++) {
+            if (!(signalMask >> (32 - signalId) & 1)) continue;
+            if (!(cellMask >> --cellBit & 1)) continue;
+            const unsigned c = cell++;
+            Signal signal{};
+            if (blocked || roughMs[satellite] == 255 || finePr[c] == prInvalid) continue;
+            if (!msmSignal(constellation, signalId, signal)) continue;
+            if (constellation == Constellation::GLONASS && extended && extInfo[satellite] < 14) {
+                signal.carrierFrequencyHz =
+                        glonassFrequencyHz(signal.carrierFrequencyHz, extInfo[satellite] - 7);
+            }
+            RawMeasurement* m = epoch.add();
+            if (m == nullptr) break;
+
+            // Ranges are in light-milliseconds: whole, 2^-10 and the per-signal fine part.
+            const double roughRangeMs = roughMs[satellite] + roughModMs[satellite] / 1024.0;
+            const double rangeMs = roughRangeMs + finePr[c] * prUnitMs;
+            m->constellation = constellation;
+            m->svid = satelliteId + satelliteOffset;
+            m->codeType = signal.codeType;
+            m->carrierFrequencyHz = signal.carrierFrequencyHz;
+            m->state = measurementState(constellation, signal.carrierFrequencyHz);
+            m->receivedSvTimeNs = wrap(scaleMs * NS_PER_MS - std::llround(rangeMs * NS_PER_MS),
+                                       periodMs * NS_PER_MS);
+            m->receivedSvTimeUncertaintyNs = MSM_PSEUDORANGE_UNCERTAINTY_NS;
+            m->cn0DbHz = high ? cnr[c] / 16.0f : cnr[c];
+            m->hasPseudorangeRate = extended && roughRate[satellite] != roughRateInvalid &&
+                                    fineRate[c] != fineRateInvalid;
+            m->pseudorangeRateMps =
+                    m->hasPseudorangeRate ? roughRate[satellite] + fineRate[c] * 1e-4 : 0;
+            m->pseudorangeRateUncertaintyMps = m->hasPseudorangeRate ? MSM_RATE_UNCERTAINTY_MPS : 0;
+            m->adrState = 0;
+            m->accumulatedDeltaRangeMeters = 0;
+            m->accumulatedDeltaRangeUncertaintyMeters = 0;
+            if (finePhase[c] != phaseInvalid) {
+                m->adrState = ADR_STATE_VALID;
+                if (!half[c]) m->adrState |= ADR_STATE_HALF_CYCLE_RESOLVED;
+                if (lock[c] == 0) m->adrState |= ADR_STATE_RESET;
+                m->accumulatedDeltaRangeMeters =
+                        (roughRangeMs + finePhase[c] * phaseUnitMs) * SPEED_OF_LIGHT * 1e-3;
+                m->accumulatedDeltaRangeUncertaintyMeters = MSM_ADR_UNCERTAINTY_M;
+            }
+        }
+        satellite++;
+    }
+    if (!more) completeMsmEpoch();
+    return true;
+}
+
+void BinaryParser::completeMsmEpoch() {
+    if (mMsmOpen && mRawEpochs[mRawEpoch ^ 1].count > 0) {
+        mRawEpoch ^= 1;
+        mHasRawEpoch = true;
+    }
+    mMsmOpen = false;
+    mMsmKeyMs = -1;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "BinaryFramer.h"
+#include "NmeaTypes.h"
+#include "SatelliteTable.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Decodes binary receiver messages into the same fix and satellite state as NmeaParser, with
+// the full resolution of the receiver's own solution (millimetres, nanoseconds) and its own
+// accuracy estimates instead of DOP-based guesses. Decoders are looked up by protocol and
+// message ID, so another message or protocol is one table entry and one function.
+//
+// Supported: UBX-NAV-PVT (a complete epoch) and UBX-NAV-SAT (satellites in view, used-in-fix),
+// and raw measurements from UBX-RXM-RAWX or RTCM 3 MSM4 to MSM7 (what Airoha-based receivers
+// such as the LC29H output). MSM splits an epoch into one message per constellation, so those
+// are collected until the message with the multiple-message bit clear.
+// Not thread-safe: driven by the reader thread, like NmeaParser.
+class BinaryParser {
+public:
+    // Satellites are merged into |satellites|, normally NmeaParser's table.
+    explicit BinaryParser(SatelliteTable& satellites) : mSatellites(satellites) {}
+
+    // Returns true if the frame was recognised and decoded.
+    bool parse(const BinaryFrame& frame);
+
+    // A navigation solution completes an epoch; it is held until consumed.
+    bool hasFix() const { return mHasFix; }
+    const NmeaFix& fix() const { return mFix; }
+    void consumeFix() { mHasFix = false; }
+
+    // Likewise a complete raw measurement epoch.
+    bool hasRawEpoch() const { return mHasRawEpoch; }
+    const RawEpoch& rawEpoch() const { return mRawEpochs[mRawEpoch]; }
+    void consumeRawEpoch() { mHasRawEpoch = false; }
+
+private:
+    bool parseNavPvt(const BinaryFrame& frame);
+    bool parseNavSat(const BinaryFrame& frame);
+    bool parseRxmRawx(const BinaryFrame& frame);
+    bool parseMsm(const BinaryFrame& frame);
+    // Publishes the MSM epoch being collected, if it has any measurements.
+    void completeMsmEpoch();
+
+    SatelliteTable& mSatellites;
+    NmeaFix mFix;
+    bool mHasFix = false;
+    int32_t mUtcMsOfDay = -1;  // of the last solution, to age satellites by
+
+    // Two buffers so that collecting the next MSM epoch does not overwrite the published one.
+    RawEpoch mRawEpochs[2];
+    size_t mRawEpoch = 0;      // published
+    bool mHasRawEpoch = false;
+    bool mMsmOpen = false;     // collecting into mRawEpochs[mRawEpoch ^ 1]
+    int32_t mMsmKeyMs = -1;    // GPS time of day of the epoch being collected
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
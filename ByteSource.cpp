@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssNmeaReader"
+
+#include "ByteSource.h"
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// 8N1: ten bits on the wire per byte.
+static constexpr int UART_BITS_PER_BYTE = 10;
+
+static int64_t getBoottimeNs() {
+    struct timespec ts; clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t byteTimeAt(int baudRate) {
+    return baudRate > 0 ? UART_BITS_PER_BYTE * 1000000000LL / baudRate : 0;
+}
+
+std::unique_ptr<ByteSource> ByteSource::create(const std::string& device, size_t index,
+                                               int baudRate) {
+    using ::android::base::StartsWith;
+    static constexpr std::string_view PTY = "pty:";
+    static constexpr std::string_view REPLAY = "replay:";
+    static constexpr std::string_view REPLAY_FAST = "replay-fast:";
+    if (StartsWith(device, PTY)) {
+        return std::make_unique<PtySource>(device.substr(PTY.size()), baudRate);
+    }
+    if (StartsWith(device, REPLAY)) {
+        return std::make_unique<ReplaySource>(device.substr(REPLAY.size()), index, true);
+    }
+    if (StartsWith(device, REPLAY_FAST)) {
+        return std::make_unique<ReplaySource>(device.substr(REPLAY_FAST.size()), index, false);
+    }
+    return std::make_unique<UartSource>(device, baudRate);
+}
+
+static speed_t toSpeed(int baudRate) {
+    switch (baudRate) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B0;
+    }
+}
+
+bool UartSource::open() {
+    // Non-blocking: the event loop reads only what is there and never sleeps in read().
+    mFd = ::open(name().c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (mFd < 0) {
+        LOG(ERROR) << "Failed to open UART " << name() << ": " << strerror(errno);
+        return false;
+    }
+
+    struct termios tty;
+    memset(&tty, 0, sizeof(tty));
+    if (tcgetattr(mFd, &tty) != 0) { close(); return false; }
+
+    speed_t speed = toSpeed(mBaudRate);
+    if (speed == B0) {
+        LOG(ERROR) << "Unsupported baud rate " << mBaudRate;
+        close();
+        return false;
+    }
+    cfsetospeed(&tty, speed);
+    cfsetispeed(&tty, speed);
+
+    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
+    tty.c_cflag |= (CLOCAL | CREAD);
+    tty.c_cflag &= ~(PARENB | PARODD | CSTOPB | CRTSCTS);
+    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+    tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tty.c_oflag &= ~OPOST;
+
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+
+    if (tcsetattr(mFd, TCSANOW, &tty) != 0) { close(); return false; }
+
+    tcflush(mFd, TCIOFLUSH);
+    mByteTimeNs = byteTimeAt(mBaudRate);
+    LOG(INFO) << "UART opened: " << name() << " @ " << mBaudRate;
+    return true;
+}
+
+void UartSource::close() {
+    if (mFd >= 0) { ::close(mFd); mFd = -1; }
+}
+
+ssize_t UartSource::read(char* buffer, size_t size, int64_t& endNs) {
+    const ssize_t bytesRead = ::read(mFd, buffer, size);
+    // The chunk's last byte arrived just now.
+    endNs = getBoottimeNs();
+    return bytesRead;
+}
+
+bool UartSource::write(std::string_view text) {
+    return ::write(mFd, text.data(), text.size()) >= 0;
+}
+
+void UartSource::drain() {
+    // Closing a non-blocking descriptor would not wait for the output to go.
+    tcdrain(mFd);
+}
+
+bool UartSource::setBaudRate(int baudRate) {
+    struct termios tty;
+    speed_t speed = toSpeed(baudRate);
+    if (speed == B0 || tcgetattr(mFd, &tty) != 0) return false;
+    cfsetospeed(&tty, speed);
+    cfsetispeed(&tty, speed);
+    // Let the command that asked for the change finish at the old rate first.
+    if (tcsetattr(mFd, TCSADRAIN, &tty) != 0) return false;
+    mByteTimeNs = byteTimeAt(baudRate);
+    return true;
+}
+
+PtySource::PtySource(const std::string& link, int baudRate)
+    : ByteSource("pty:" + link), mLink(link), mBaudRate(baudRate) {}
+
+bool PtySource::open() {
+    mMasterFd = ::open("/dev/ptmx", O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    char slave[64];
+    if (mMasterFd < 0 || grantpt(mMasterFd) != 0 || unlockpt(mMasterFd) != 0 ||
+        ptsname_r(mMasterFd, slave, sizeof(slave)) != 0) {
+        LOG(ERROR) << "Cannot create a pseudo-terminal: " << strerror(errno);
+        close();
+        return false;
+    }
+    // Raw, so neither side's bytes are echoed or translated.
+    struct termios tty;
+    mSlaveFd = ::open(slave, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (mSlaveFd < 0 || tcgetattr(mSlaveFd, &tty) != 0) {
+        LOG(ERROR) << "Cannot open " << slave << ": " << strerror(errno);
+        close();
+        return false;
+    }
+    cfmakeraw(&tty);
+    tcsetattr(mSlaveFd, TCSANOW, &tty);
+    if (!mLink.empty()) {
+        unlink(mLink.c_str());
+        if (symlink(slave, mLink.c_str()) != 0) {
+            LOG(WARNING) << "Cannot link " << mLink << " to " << slave << ": " << strerror(errno);
+        }
+    }
+    mByteTimeNs = byteTimeAt(mBaudRate);
+    LOG(INFO) << "Pseudo-terminal opened: " << slave
+              << (mLink.empty() ? std::string() : " (" + mLink + ")");
+    return true;
+}
+
+void PtySource::close() {
+    if (mMasterFd >= 0 && !mLink.empty()) unlink(mLink.c_str());
+    if (mSlaveFd >= 0) { ::close(mSlaveFd); mSlaveFd = -1; }
+    if (mMasterFd >= 0) { ::close(mMasterFd); mMasterFd = -1; }
+}
+
+ssize_t PtySource::read(char* buffer, size_t size, int64_t& endNs) {
+    const ssize_t bytesRead = ::read(mMasterFd, buffer, size);
+    endNs = getBoottimeNs();
+    return bytesRead;
+}
+
+bool PtySource::write(std::string_view text) {
+    return ::write(mMasterFd, text.data(), text.size()) >= 0;
+}
+
+bool PtySource::setBaudRate(int baudRate) {
+    mByteTimeNs = byteTimeAt(baudRate);
+    return true;
+}
+
+ReplaySource::ReplaySource(const std::string& path, size_t index, bool realTime)
+    : ByteSource((realTime ? "replay:" : "replay-fast:") + path),
+      mPath(path), mIndex(index), mRealTime(realTime) {}
+
+bool ReplaySource::open() {
+    if (!mRecording.open(mPath)) {
+        LOG(ERROR) << "Cannot replay " << mPath << ": " << strerror(errno);
+        return false;
+    }
+    mTimerFd = timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (mTimerFd < 0) {
+        LOG(ERROR) << "Cannot replay " << mPath << ": " << strerror(errno);
+        close();
+        return false;
+    }
+    LOG(INFO) << "Replaying receiver " << mIndex << " from " << mPath << ", "
+              << mRecording.records() << " records, " << (mRealTime ? "real time" : "fast");
+    mLastRecordNs = 0;
+    mReplayNs = getBoottimeNs();
+    mByteTimeNs = 0;
+    advance();
+    return true;
+}
+
+void ReplaySource::close() {
+    if (mTimerFd >= 0) { ::close(mTimerFd); mTimerFd = -1; }
+    mRecording.close();
+    mHavePending = false;
+}
+
+void ReplaySource::advance() {
+    mHavePending = false;
+    FlightRecording::Record record;
+    while (mRecording.next(record)) {
+        // Every source's records advance the replay clock, so receivers replayed together
+        // keep their relative timing.
+        if (mLastRecordNs != 0) {
+            mReplayNs += std::clamp<int64_t>(record.arrivalNs - mLastRecordNs, 0, MAX_GAP_NS);
+        }
+        mLastRecordNs = record.arrivalNs;
+        if (record.source != mIndex) continue;
+        mPending = record;
+        mPendingNs = mReplayNs;
+        mHavePending = true;
+        break;
+    }
+
+    struct itimerspec spec = {};
+    if (mHavePending) {
+        // A deadline in the past fires at once; zero would disarm.
+        const int64_t dueNs = mRealTime ? std::max<int64_t>(mPendingNs, 1) : 1;
+        spec.it_value.tv_sec = dueNs / 1000000000LL;
+        spec.it_value.tv_nsec = dueNs % 1000000000LL;
+    } else {
+        LOG(INFO) << "Replay of receiver " << mIndex << " from " << mPath << " finished";
+    }
+    timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+ssize_t ReplaySource::read(char* buffer, size_t size, int64_t& endNs) {
+    uint64_t expirations;
+    if (::read(mTimerFd, &expirations, sizeof(expirations)) < 0) return -1;
+    if (!mHavePending) {
+        errno = EAGAIN;
+        return -1;
+    }
+    const size_t length = std::min(size, mPending.length);
+    memcpy(buffer, mPending.data, length);
+    endNs = mPendingNs;
+    mByteTimeNs = mPending.byteTimeNs;
+    advance();
+    return static_cast<ssize_t>(length);
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "FlightRecorder.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Where a receiver's bytes come from. The reader watches fd() and calls read() when it is
+// readable; a chunk comes with the CLOCK_BOOTTIME arrival of its last byte and the wire time of
+// one byte, from which the framers time the bytes before it.
+//
+// Backends, chosen by create() from the device string:
+//   /dev/ttyAMA0           the receiver's UART (anything without a prefix)
+//   pty:[/path/link]       a pseudo-terminal the HAL creates, for a simulator or a cat of a
+//                          log to write to; its name is logged and linked from /path/link
+//   replay:/path/capture   a FlightRecorder capture played back in real time
+//   replay-fast:/path/...  the same, as fast as the reader takes it
+class ByteSource {
+public:
+    static std::unique_ptr<ByteSource> create(const std::string& device, size_t index,
+                                              int baudRate);
+    virtual ~ByteSource() = default;
+
+    const std::string& name() const { return mName; }
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    // -1 while closed.
+    virtual int fd() const = 0;
+    // One chunk into |buffer|. As read(2), with errno EAGAIN when there is nothing yet.
+    virtual ssize_t read(char* buffer, size_t size, int64_t& endNs) = 0;
+    virtual int64_t byteTimeNs() const = 0;
+
+    // Receiver commands. A source that cannot take them leaves the receiver as captured.
+    virtual bool writable() const { return true; }
+    virtual bool write(std::string_view text) = 0;
+    // Waits for written commands to be on the wire.
+    virtual void drain() {}
+    virtual bool setBaudRate(int baudRate) = 0;
+    // Played back rather than received live: not worth capturing again.
+    virtual bool isReplay() const { return false; }
+
+protected:
+    explicit ByteSource(std::string name) : mName(std::move(name)) {}
+
+private:
+    std::string mName;
+};
+
+// The receiver on a UART, 8N1 raw.
+class UartSource : public ByteSource {
+public:
+    UartSource(const std::string& device, int baudRate)
+        : ByteSource(device), mBaudRate(baudRate) {}
+    ~UartSource() override { close(); }
+
+    bool open() override;
+    void close() override;
+    int fd() const override { return mFd; }
+    ssize_t read(char* buffer, size_t size, int64_t& endNs) override;
+    int64_t byteTimeNs() const override { return mByteTimeNs; }
+    bool write(std::string_view text) override;
+    void drain() override;
+    bool setBaudRate(int baudRate) override;
+
+private:
+    int mBaudRate;  // power-on rate, set again by each open()
+    int mFd = -1;
+    int64_t mByteTimeNs = 0;
+};
+
+// The master side of a new pseudo-terminal. Whatever is written to the slave side is read as
+// if it came from a UART at the nominal rate; commands go back the other way. The slave is
+// held open too, so writers may come and go without the master seeing a hang-up.
+class PtySource : public ByteSource {
+public:
+    PtySource(const std::string& link, int baudRate);
+    ~PtySource() override { close(); }
+
+    bool open() override;
+    void close() override;
+    int fd() const override { return mMasterFd; }
+    ssize_t read(char* buffer, size_t size, int64_t& endNs) override;
+    int64_t byteTimeNs() const override { return mByteTimeNs; }
+    bool write(std::string_view text) override;
+    // Nothing to change on a pty; the rate only times the bytes.
+    bool setBaudRate(int baudRate) override;
+
+private:
+    std::string mLink;  // empty if no link was asked for
+    int mBaudRate;
+    int mMasterFd = -1;
+    int mSlaveFd = -1;
+    int64_t mByteTimeNs = 0;
+};
+
+// Plays back the chunks one receiver, |index|, delivered in a capture, with their chunking
+// and their byte times. Arrival stamps keep their spacing from the start of the replay, apart
+// from gaps longer than MAX_GAP_NS (the capture spanning restarts, or reboots) which are cut
+// to that. A timerfd stands in for the line: it is readable when the next chunk is due, at
+// once in fast mode. In fast mode the stamps run ahead of the clock, as they would have had the
+// data come in that fast; timeouts on the reader's own clock see the stream as one burst.
+//
+// Nothing is written to the receiver in a capture: commands are dropped, and the reader does
+// not configure a source that is not writable(). The end of the capture is not a hang-up; the
+// line just goes quiet.
+class ReplaySource : public ByteSource {
+public:
+    ReplaySource(const std::string& path, size_t index, bool realTime);
+    ~ReplaySource() override { close(); }
+
+    bool open() override;
+    void close() override;
+    int fd() const override { return mTimerFd; }
+    ssize_t read(char* buffer, size_t size, int64_t& endNs) override;
+    int64_t byteTimeNs() const override { return mByteTimeNs; }
+    bool writable() const override { return false; }
+    bool write(std::string_view text) override { return true; }
+    bool setBaudRate(int baudRate) override { return true; }
+    bool isReplay() const override { return true; }
+
+private:
+    static constexpr int64_t MAX_GAP_NS = 5000000000LL;
+
+    // Moves to this source's next record and arms the timer for it; disarms at the end.
+    void advance();
+
+    std::string mPath;
+    size_t mIndex;
+    bool mRealTime;
+    FlightRecording mRecording;
+    int mTimerFd = -1;
+    bool mHavePending = false;
+    FlightRecording::Record mPending{};
+    int64_t mPendingNs = 0;    // mPending's replayed arrival
+    int64_t mLastRecordNs = 0; // last record seen, of any source, as captured
+    int64_t mReplayNs = 0;     // and as replayed
+    int64_t mByteTimeNs = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssDispatcher"
+
+#include "CallbackDispatcher.h"
+
+#include <android-base/logging.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static int64_t monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t boottimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+CallbackDispatcher::CallbackDispatcher(LocationCallback locationCb, NmeaCallback nmeaCb,
+                                       SvStatusCallback svCb, MeasurementCallback measurementCb)
+    : mLocationCallback(std::move(locationCb)), mNmeaCallback(std::move(nmeaCb)),
+      mSvStatusCallback(std::move(svCb)), mMeasurementCallback(std::move(measurementCb)),
+      mEventFd(-1), mRunning(false), mDiscard(false), mPending(false),
+      mNmeaHighWater(0), mNmeaDropped(0), mLocationsSuperseded(0), mSvStatusCoalesced(0),
+      mMeasurementsCoalesced(0), mLoggedDrops(0), mLastDropLogMs(0) {}
+
+CallbackDispatcher::~CallbackDispatcher() { stop(); }
+
+bool CallbackDispatcher::start() {
+    if (mRunning.load()) return true;
+    mEventFd = eventfd(0, EFD_CLOEXEC);
+    if (mEventFd < 0) {
+        LOG(ERROR) << "eventfd failed: " << strerror(errno);
+        return false;
+    }
+    mRunning.store(true);
+    mDispatchThread = std::thread(&CallbackDispatcher::dispatchThreadFunc, this);
+    return true;
+}
+
+void CallbackDispatcher::stop() {
+    if (!mRunning.load()) return;
+    mRunning.store(false);
+    uint64_t one = 1;
+    (void)write(mEventFd, &one, sizeof(one));
+    if (mDispatchThread.joinable()) mDispatchThread.join();
+    close(mEventFd);
+    mEventFd = -1;
+    // Whatever was still queued belongs to the session that just ended.
+    while (mNmea.front() != nullptr) mNmea.pop();
+    mLocation.take();
+    mSvStatus.take();
+    mMeasurement.take();
+}
+
+void CallbackDispatcher::discard() {
+    if (mEventFd < 0) return;
+    mDiscard.store(true);
+    uint64_t one = 1;
+    (void)write(mEventFd, &one, sizeof(one));
+}
+
+void CallbackDispatcher::postNmea(int64_t timestamp, std::string_view sentence,
+                                  int64_t receivedNs) {
+    NmeaEvent* event = mNmea.reserve();
+    if (event == nullptr) {
+        mNmeaDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    event->timestamp = timestamp;
+    event->receivedNs = receivedNs;
+    event->length = static_cast<uint16_t>(std::min(sentence.size(), NmeaFramer::MAX_SENTENCE_LENGTH));
+    memcpy(event->text, sentence.data(), event->length);
+    mNmea.commit();
+    size_t depth = mNmea.size();
+    if (depth > mNmeaHighWater.load(std::memory_order_relaxed)) {
+        mNmeaHighWater.store(depth, std::memory_order_relaxed);
+    }
+    mPending = true;
+}
+
+void CallbackDispatcher::postLocation(const GnssLocation& location, int64_t receivedNs) {
+    mLocation.back().location = location;
+    mLocation.back().receivedNs = receivedNs;
+    if (mLocation.publish()) mLocationsSuperseded.fetch_add(1, std::memory_order_relaxed);
+    mPending = true;
+}
+
+void CallbackDispatcher::postSvStatus() {
+    if (mSvStatus.publish()) mSvStatusCoalesced.fetch_add(1, std::memory_order_relaxed);
+    mPending = true;
+}
+
+void CallbackDispatcher::postMeasurement() {
+    if (mMeasurement.publish()) mMeasurementsCoalesced.fetch_add(1, std::memory_order_relaxed);
+    mPending = true;
+}
+
+void CallbackDispatcher::wake() {
+    if (!mPending || mEventFd < 0) return;
+    mPending = false;
+    uint64_t one = 1;
+    (void)write(mEventFd, &one, sizeof(one));
+}
+
+CallbackDispatcher::Stats CallbackDispatcher::stats() const {
+    Stats s;
+    s.nmeaQueueDepth = mNmea.size();
+    s.nmeaQueueHighWater = mNmeaHighWater.load(std::memory_order_relaxed);
+    s.nmeaDropped = mNmeaDropped.load(std::memory_order_relaxed);
+    s.locationsSuperseded = mLocationsSuperseded.load(std::memory_order_relaxed);
+    s.svStatusCoalesced = mSvStatusCoalesced.load(std::memory_order_relaxed);
+    s.measurementsCoalesced = mMeasurementsCoalesced.load(std::memory_order_relaxed);
+    s.nmeaLatency = mNmeaLatency.snapshot();
+    s.locationLatency = mLocationLatency.snapshot();
+    s.nmeaCallback = mNmeaCallbackTime.snapshot();
+    s.locationCallback = mLocationCallbackTime.snapshot();
+    s.svStatusCallback = mSvStatusCallbackTime.snapshot();
+    s.measurementCallback = mMeasurementCallbackTime.snapshot();
+    return s;
+}
+
+void CallbackDispatcher::dispatchThreadFunc() {
+    while (mRunning.load()) {
+        uint64_t count;
+        if (read(mEventFd, &count, sizeof(count)) < 0 && errno != EINTR) {
+            LOG(ERROR) << "eventfd read failed: " << strerror(errno);
+            break;
+        }
+        // What is queued is consumed either way; after discard() it is not delivered.
+        const bool discarded = mDiscard.exchange(false);
+        auto deliver = [this, discarded] {
+            return !discarded && mRunning.load() && !mDiscard.load();
+        };
+        // One clock read per callback: each one's end is the next one's start.
+        int64_t nowNs = boottimeNs();
+        auto timed = [&nowNs](LatencyHistogram& histogram) {
+            const int64_t startNs = nowNs;
+            nowNs = boottimeNs();
+            histogram.record(nowNs - startNs);
+        };
+        // NMEA first: a location is usually posted as its epoch's last sentence is read.
+        while (const NmeaEvent* event = mNmea.front()) {
+            if (mNmeaCallback && deliver()) {
+                if (event->receivedNs > 0) mNmeaLatency.record(nowNs - event->receivedNs);
+                mNmeaCallback(event->timestamp, std::string_view(event->text, event->length));
+                timed(mNmeaCallbackTime);
+            }
+            mNmea.pop();
+        }
+        if (const LocationEvent* event = mLocation.take()) {
+            if (mLocationCallback && deliver()) {
+                if (event->receivedNs > 0) mLocationLatency.record(nowNs - event->receivedNs);
+                mLocationCallback(event->location);
+                timed(mLocationCallbackTime);
+            }
+        }
+        if (const std::vector<GnssSvInfo>* svList = mSvStatus.take()) {
+            if (mSvStatusCallback && deliver()) {
+                mSvStatusCallback(*svList);
+                timed(mSvStatusCallbackTime);
+            }
+        }
+        if (const GnssData* data = mMeasurement.take()) {
+            if (mMeasurementCallback && deliver()) {
+                mMeasurementCallback(*data);
+                timed(mMeasurementCallbackTime);
+            }
+        }
+        logDrops();
+    }
+}
+
+void CallbackDispatcher::logDrops() {
+    uint64_t dropped = mNmeaDropped.load(std::memory_order_relaxed);
+    if (dropped == mLoggedDrops) return;
+    int64_t now = monotonicMs();
+    if (now - mLastDropLogMs < DROP_LOG_INTERVAL_MS) return;
+    LOG(WARNING) << "NMEA callbacks too slow, dropped " << (dropped - mLoggedDrops)
+                 << " sentences (high water " << mNmeaHighWater.load() << "/"
+                 << NMEA_QUEUE_CAPACITY << ")";
+    mLoggedDrops = dropped;
+    mLastDropLogMs = now;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
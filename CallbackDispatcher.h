@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/gnss/GnssData.h>
+#include <aidl/android/hardware/gnss/IGnssCallback.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Metrics.h"
+#include "NmeaFramer.h"
+#include "SpscRing.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+using ::aidl::android::hardware::gnss::GnssData;
+using ::aidl::android::hardware::gnss::GnssLocation;
+using GnssSvInfo = ::aidl::android::hardware::gnss::IGnssCallback::GnssSvInfo;
+
+using LocationCallback = std::function<void(const GnssLocation&)>;
+using NmeaCallback = std::function<void(int64_t, std::string_view)>;
+using SvStatusCallback = std::function<void(const std::vector<GnssSvInfo>&)>;
+using MeasurementCallback = std::function<void(const GnssData&)>;
+
+// Moves callbacks off the reader thread, so a slow binder call can never hold up read() on the
+// UART. The reader posts into lock-free queues and a dispatch thread makes the calls:
+//  - locations are latest-wins: a fix that was not delivered before the next is superseded,
+//  - NMEA is lossless up to NMEA_QUEUE_CAPACITY sentences, beyond which sentences are dropped
+//    and counted,
+//  - SV status and raw measurements are coalesced: only the newest snapshot is delivered.
+//
+// Each callback is timed, and NMEA and locations also from when the bytes they came from were
+// read: one clock read per callback, against a binder call that takes thousands of times that.
+class CallbackDispatcher {
+public:
+    struct Stats {
+        size_t nmeaQueueDepth = 0;
+        size_t nmeaQueueHighWater = 0;
+        uint64_t nmeaDropped = 0;
+        uint64_t locationsSuperseded = 0;
+        uint64_t svStatusCoalesced = 0;
+        uint64_t measurementsCoalesced = 0;
+        // From read() to the callback being made.
+        LatencyHistogram::Snapshot nmeaLatency;
+        LatencyHistogram::Snapshot locationLatency;
+        // Time spent in the callbacks.
+        LatencyHistogram::Snapshot nmeaCallback;
+        LatencyHistogram::Snapshot locationCallback;
+        LatencyHistogram::Snapshot svStatusCallback;
+        LatencyHistogram::Snapshot measurementCallback;
+    };
+
+    CallbackDispatcher(LocationCallback locationCb, NmeaCallback nmeaCb, SvStatusCallback svCb,
+                       MeasurementCallback measurementCb);
+    ~CallbackDispatcher();
+
+    // The dispatch thread runs from start() to stop(), across sessions: stop() waits for a
+    // callback in progress, so it is only for the owner's destructor.
+    bool start();
+    void stop();
+    // Drops what is queued without waiting for a callback in progress, at the end of a session.
+    // The dispatch thread does it; anything posted before it has, a new session's first events
+    // included, goes too.
+    void discard();
+
+    // Producer side, reader thread only. Posted events are delivered after the next wake().
+    // |receivedNs| is the CLOCK_BOOTTIME read() of the bytes behind the event, 0 for none.
+    void postNmea(int64_t timestamp, std::string_view sentence, int64_t receivedNs);
+    void postLocation(const GnssLocation& location, int64_t receivedNs);
+    // Fill the returned vector, then postSvStatus(). Its capacity is reused between snapshots.
+    std::vector<GnssSvInfo>& svStatusBuffer() { return mSvStatus.back(); }
+    void postSvStatus();
+    // Likewise for raw measurements: fill, then postMeasurement().
+    GnssData& measurementBuffer() { return mMeasurement.back(); }
+    void postMeasurement();
+    // Wakes the dispatch thread if anything was posted since the last wake. Called once per
+    // batch of input rather than per event to keep the eventfd writes off the hot path.
+    void wake();
+
+    Stats stats() const;
+
+private:
+    struct NmeaEvent {
+        int64_t timestamp;
+        int64_t receivedNs;
+        uint16_t length;
+        char text[NmeaFramer::MAX_SENTENCE_LENGTH + 1];
+    };
+    struct LocationEvent {
+        GnssLocation location;
+        int64_t receivedNs;
+    };
+
+    // A 10 Hz LC29H emits around 25 sentences per epoch, so this absorbs about a second of
+    // stalled callbacks.
+    static constexpr size_t NMEA_QUEUE_CAPACITY = 256;
+    static constexpr int64_t DROP_LOG_INTERVAL_MS = 10000;
+
+    void dispatchThreadFunc();
+    void logDrops();
+
+    LocationCallback mLocationCallback;
+    NmeaCallback mNmeaCallback;
+    SvStatusCallback mSvStatusCallback;
+    MeasurementCallback mMeasurementCallback;
+
+    SpscRing<NmeaEvent, NMEA_QUEUE_CAPACITY> mNmea;
+    TripleBuffer<LocationEvent> mLocation;
+    TripleBuffer<std::vector<GnssSvInfo>> mSvStatus;
+    TripleBuffer<GnssData> mMeasurement;
+
+    int mEventFd;
+    std::thread mDispatchThread;
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mDiscard;
+    bool mPending;  // producer-owned
+
+    std::atomic<size_t> mNmeaHighWater;
+    std::atomic<uint64_t> mNmeaDropped;
+    std::atomic<uint64_t> mLocationsSuperseded;
+    std::atomic<uint64_t> mSvStatusCoalesced;
+    std::atomic<uint64_t> mMeasurementsCoalesced;
+    // Written by the dispatch thread.
+    LatencyHistogram mNmeaLatency;
+    LatencyHistogram mLocationLatency;
+    LatencyHistogram mNmeaCallbackTime;
+    LatencyHistogram mLocationCallbackTime;
+    LatencyHistogram mSvStatusCallbackTime;
+    LatencyHistogram mMeasurementCallbackTime;
+    uint64_t mLoggedDrops;       // consumer-owned
+    int64_t mLastDropLogMs;      // consumer-owned
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
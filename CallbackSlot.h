@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// A client callback published RCU-style: set() swaps in a new one and get() takes a snapshot of
+// whichever is current. Neither waits for the other, nor for a binder call in progress; a call
+// made on a snapshot keeps that callback alive until it returns, so one replaced or cleared
+// meanwhile may still receive the call already under way.
+template <typename T>
+class CallbackSlot {
+public:
+    std::shared_ptr<T> get() const {
+#ifdef __cpp_lib_atomic_shared_ptr
+        return mCallback.load(std::memory_order_acquire);
+#else
+        return std::atomic_load_explicit(&mCallback, std::memory_order_acquire);
+#endif
+    }
+
+    void set(std::shared_ptr<T> callback) {
+#ifdef __cpp_lib_atomic_shared_ptr
+        mCallback.store(std::move(callback), std::memory_order_release);
+#else
+        std::atomic_store_explicit(&mCallback, std::move(callback), std::memory_order_release);
+#endif
+    }
+
+private:
+#ifdef __cpp_lib_atomic_shared_ptr
+    std::atomic<std::shared_ptr<T>> mCallback;
+#else
+    std::shared_ptr<T> mCallback;
+#endif
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DutyCycle.h"
+
+#include <algorithm>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+void DutyCycle::enter(State state, int64_t nowMs) {
+    if (mStateSinceMs >= 0) mTimeInStateMs[mState] += std::max<int64_t>(nowMs - mStateSinceMs, 0);
+    mState = state;
+    mStateSinceMs = nowMs;
+}
+
+void DutyCycle::wake(int64_t nowMs) {
+    mFromStandby = mState == STANDBY;
+    if (mFromStandby) mWakeups++;
+    mWakeMs = nowMs;
+    mDeliveredMs = -1;
+    mTrackUntilMs = nowMs;
+    enter(ACQUIRING, nowMs);
+}
+
+int32_t DutyCycle::leadMs() const {
+    if (mTimeToFixMs < 0) return INITIAL_LEAD_MS;
+    return std::clamp(mTimeToFixMs + LEAD_MARGIN_MS, MIN_LEAD_MS, MAX_LEAD_MS);
+}
+
+void DutyCycle::start(int64_t nowMs) {
+    const bool suspended = mSuspended;
+    mSuspended = false;
+    if (mState == OFF || (suspended && mState == STANDBY)) wake(nowMs);
+}
+
+void DutyCycle::stop(int64_t nowMs) {
+    mSuspended = false;
+    if (mState != OFF) enter(OFF, nowMs);
+}
+
+void DutyCycle::suspend(int64_t nowMs, int32_t holdMs) {
+    if (mState == OFF) return;
+    mSuspended = true;
+    mHoldUntilMs = nowMs + holdMs;
+    // Deliveries from before count for nothing after the resume.
+    mDeliveredMs = -1;
+    if (mState == STANDBY) mWakeAtMs = -1;
+    poll(nowMs);
+}
+
+void DutyCycle::setInterval(int32_t intervalMs, bool allowed, int64_t nowMs) {
+    mIntervalMs = intervalMs;
+    mCycling = allowed && intervalMs >= MIN_CYCLE_INTERVAL_MS;
+    if (mState == STANDBY && !mSuspended) {
+        if (!mCycling) {
+            wake(nowMs);
+            return;
+        }
+        mWakeAtMs = mDeliveredMs + mIntervalMs - leadMs();
+    }
+    poll(nowMs);
+}
+
+void DutyCycle::onFix(int64_t nowMs) {
+    if (mState != ACQUIRING) return;
+    const int32_t timeToFixMs = static_cast<int32_t>(std::min<int64_t>(nowMs - mWakeMs, INT32_MAX));
+    // The first start and interval changes are not hot starts from standby; they teach nothing.
+    if (mFromStandby) {
+        mTimeToFixMs = mTimeToFixMs < 0 ? timeToFixMs : (3 * mTimeToFixMs + timeToFixMs) / 4;
+    }
+    mTrackUntilMs = timeToFixMs > HOT_START_MS ? nowMs + EPHEMERIS_DWELL_MS : nowMs;
+    enter(TRACKING, nowMs);
+}
+
+void DutyCycle::onDelivered(int64_t nowMs) {
+    if (mState != ACQUIRING && mState != TRACKING) return;
+    mDeliveredMs = nowMs;
+    poll(nowMs);
+}
+
+void DutyCycle::poll(int64_t nowMs) {
+    if (mSuspended) {
+        if (engineOn() && nowMs >= mHoldUntilMs) {
+            mWakeAtMs = -1;
+            enter(STANDBY, nowMs);
+        }
+        return;
+    }
+    if (mState == STANDBY) {
+        if (nowMs >= mWakeAtMs) wake(nowMs);
+        return;
+    }
+    if (mState != TRACKING || !mCycling || mDeliveredMs < 0 || nowMs < mTrackUntilMs) return;
+    const int64_t wakeAtMs = mDeliveredMs + mIntervalMs - leadMs();
+    if (wakeAtMs - nowMs < MIN_STANDBY_MS) {
+        // Stay on; the next delivery looks again.
+        mDeliveredMs = -1;
+        return;
+    }
+    mWakeAtMs = wakeAtMs;
+    enter(STANDBY, nowMs);
+}
+
+int64_t DutyCycle::nextDeadlineMs() const {
+    if (mSuspended) return engineOn() ? mHoldUntilMs : -1;
+    if (mState == STANDBY) return mWakeAtMs;
+    // A delivery that did not lead to standby at once is waiting for the ephemeris dwell.
+    return mState == TRACKING && mCycling && mDeliveredMs >= 0 ? mTrackUntilMs : -1;
+}
+
+DutyCycle::Stats DutyCycle::stats(int64_t nowMs) const {
+    Stats stats;
+    std::copy(mTimeInStateMs, mTimeInStateMs + STATE_COUNT, stats.timeInStateMs);
+    if (mStateSinceMs >= 0) stats.timeInStateMs[mState] += std::max<int64_t>(nowMs - mStateSinceMs, 0);
+    stats.wakeups = mWakeups;
+    stats.leadMs = leadMs();
+    return stats;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
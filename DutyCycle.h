@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Decides when the receiver's engine runs. From MIN_CYCLE_INTERVAL_MS up, the engine is put in
+// standby once a fix has been delivered and started again early enough for the next one, from
+// a hot start, to be ready when it is due. That lead is learned from how long earlier
+// wake-ups took to their first fix. A wake-up slower than a hot start has probably had to
+// collect ephemeris, so it keeps tracking EPHEMERIS_DWELL_MS after its fix to finish that.
+//
+// Suspended, with no client but the reader kept running, the engine keeps tracking for a hold
+// time so a session starting again soon finds a fix ready, then stays in standby until resumed.
+//
+// Time in each state is accounted for power statistics, from the first start() on.
+//
+// No I/O here: the reader turns engineOn() into receiver commands. Not thread-safe.
+class DutyCycle {
+public:
+    enum State : uint8_t {
+        OFF,         // reader stopped, engine off
+        ACQUIRING,   // engine on, no fix yet since it was started
+        TRACKING,
+        STANDBY,     // engine off between fixes
+        STATE_COUNT,
+    };
+
+    struct Stats {
+        int64_t timeInStateMs[STATE_COUNT] = {};
+        uint32_t wakeups = 0;  // from standby
+        int32_t leadMs = 0;    // current wake-up lead
+    };
+
+    // Also resumes from suspend(), waking the engine if it is in standby.
+    void start(int64_t nowMs);
+    void stop(int64_t nowMs);
+    // No fixes are wanted; the engine goes to standby |holdMs| from now, or at once if it is
+    // not on, and is not woken again until start().
+    void suspend(int64_t nowMs, int32_t holdMs);
+    // Fixes are wanted every |intervalMs|. With |allowed| false the engine is never put in
+    // standby, whatever the interval: raw measurements need continuous tracking.
+    void setInterval(int32_t intervalMs, bool allowed, int64_t nowMs);
+    // A valid fix came out of the receiver.
+    void onFix(int64_t nowMs);
+    // A fix went out to clients.
+    void onDelivered(int64_t nowMs);
+    // Applies what is due by |nowMs|.
+    void poll(int64_t nowMs);
+    // When poll() next has something to do, or -1 if only a fix or a delivery can change things.
+    int64_t nextDeadlineMs() const;
+
+    State state() const { return mState; }
+    bool engineOn() const { return mState == ACQUIRING || mState == TRACKING; }
+    // Totals up to |nowMs|.
+    Stats stats(int64_t nowMs) const;
+
+private:
+    static constexpr int32_t MIN_CYCLE_INTERVAL_MS = 10000;
+    // Shorter standby is not worth a stop and a start.
+    static constexpr int32_t MIN_STANDBY_MS = 3000;
+    static constexpr int32_t INITIAL_LEAD_MS = 5000;
+    static constexpr int32_t MIN_LEAD_MS = 1000;
+    static constexpr int32_t MAX_LEAD_MS = 30000;
+    // Added to the learned time to fix, so a slightly slow wake-up is still on time.
+    static constexpr int32_t LEAD_MARGIN_MS = 1000;
+    // Time to fix beyond this was not a hot start.
+    static constexpr int32_t HOT_START_MS = 5000;
+    // One full navigation message frame.
+    static constexpr int32_t EPHEMERIS_DWELL_MS = 30000;
+
+    void enter(State state, int64_t nowMs);
+    void wake(int64_t nowMs);
+    int32_t leadMs() const;
+
+    State mState = OFF;
+    int64_t mStateSinceMs = -1;  // -1 until the first start()
+    int64_t mTimeInStateMs[STATE_COUNT] = {};
+    int32_t mIntervalMs = 1000;
+    bool mCycling = false;
+    bool mSuspended = false;
+    int64_t mHoldUntilMs = 0;    // suspended: standby from then on
+    bool mFromStandby = false;   // this wake-up's time to fix is worth learning
+    int64_t mWakeMs = 0;         // engine last started
+    int64_t mDeliveredMs = -1;   // last delivery since then, -1 if none
+    int64_t mTrackUntilMs = 0;   // no standby before this
+    int64_t mWakeAtMs = -1;      // STANDBY: when to start the engine again, -1 for never
+    int32_t mTimeToFixMs = -1;   // smoothed over wake-ups from standby, -1 until the first
+    uint32_t mWakeups = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
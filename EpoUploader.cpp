@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "EpoUploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr uint16_t EPO_DATA = 722;
+static constexpr uint16_t EPO_ACK = 723;
+static constexpr uint8_t EPO_ACK_OK = 1;
+static constexpr uint16_t END_SEQUENCE = 0xFFFF;
+static constexpr int64_t SEGMENT_HOURS = 6;
+static constexpr int64_t MS_PER_HOUR = 3600 * 1000;
+// 1980-01-06 in Unix time. GPS hours are a few leap seconds off UTC ones, which does not
+// matter at this resolution.
+static constexpr int64_t GPS_EPOCH_UNIX_MS = 3657LL * 24 * MS_PER_HOUR;
+
+static int64_t gpsHour(const uint8_t* record) {
+    return record[0] | (record[1] << 8) | (record[2] << 16);
+}
+
+bool EpoUploader::validity(const uint8_t* data, size_t size, int64_t& startUnixMs,
+                           int64_t& endUnixMs) {
+    if (size == 0 || size % RECORD_SIZE != 0) return false;
+    int64_t first = INT64_MAX, last = 0;
+    for (size_t offset = 0; offset < size; offset += RECORD_SIZE) {
+        const int64_t hour = gpsHour(data + offset);
+        if (hour == 0) return false;
+        first = std::min(first, hour);
+        last = std::max(last, hour);
+    }
+    startUnixMs = GPS_EPOCH_UNIX_MS + first * MS_PER_HOUR;
+    endUnixMs = GPS_EPOCH_UNIX_MS + (last + SEGMENT_HOURS) * MS_PER_HOUR;
+    return true;
+}
+
+void EpoUploader::start(std::shared_ptr<const std::vector<uint8_t>> data, int64_t nowUnixMs) {
+    mData = std::move(data);
+    if (mData != nullptr && mData->size() % RECORD_SIZE != 0) mData.reset();
+    mFirst = mNext = mEnd = 0;
+    restart(nowUnixMs);
+}
+
+void EpoUploader::restart(int64_t nowUnixMs) {
+    mActive = false;
+    mInFlight = false;
+    mSequence = 0;
+    if (mData == nullptr) return;
+    const int64_t nowHour = (nowUnixMs - GPS_EPOCH_UNIX_MS) / MS_PER_HOUR;
+    const uint8_t* records = mData->data();
+    const size_t count = mData->size() / RECORD_SIZE;
+    mFirst = 0;
+    while (mFirst < count && gpsHour(records + mFirst * RECORD_SIZE) + SEGMENT_HOURS <= nowHour) {
+        mFirst++;
+    }
+    // Sequence numbers are 16 bits, the last reserved for the end packet.
+    mEnd = std::min(count, mFirst + size_t{END_SEQUENCE} * RECORDS_PER_PACKET);
+    mNext = mFirst;
+    mActive = mFirst < mEnd;
+}
+
+std::string_view EpoUploader::packet(uint16_t sequence, const uint8_t* records, size_t count) {
+    uint8_t* p = mPacket;
+    *p++ = 0x04;
+    *p++ = 0x24;
+    *p++ = PACKET_SIZE & 0xFF;
+    *p++ = PACKET_SIZE >> 8;
+    *p++ = EPO_DATA & 0xFF;
+    *p++ = EPO_DATA >> 8;
+    *p++ = sequence & 0xFF;
+    *p++ = sequence >> 8;
+    // A short last packet, and the end packet, are padded with empty records.
+    const size_t length = count * RECORD_SIZE;
+    if (length > 0) memcpy(p, records, length);
+    memset(p + length, 0, RECORDS_PER_PACKET * RECORD_SIZE - length);
+    p += RECORDS_PER_PACKET * RECORD_SIZE;
+    uint8_t checksum = 0;
+    for (const uint8_t* q = mPacket + 2; q < p; q++) checksum ^= *q;
+    *p++ = checksum;
+    *p++ = '\r';
+    *p++ = '\n';
+    return std::string_view(reinterpret_cast<const char*>(mPacket), PACKET_SIZE);
+}
+
+EpoUploader::Action EpoUploader::send(int64_t nowMs) {
+    Action action;
+    action.kind = Action::WRITE;
+    action.sequence = mSequence;
+    action.data = packet(mSequence, mData->data() + mNext * RECORD_SIZE,
+                         std::min(RECORDS_PER_PACKET, mEnd - mNext));
+    mDeadlineMs = nowMs + ACK_TIMEOUT_MS;
+    mStats.packets++;
+    return action;
+}
+
+bool EpoUploader::onFrame(const BinaryFrame& frame, int64_t nowMs) {
+    if (frame.protocol != BinaryProtocol::AIROHA || frame.messageId != EPO_ACK) return false;
+    if (frame.payloadLength < 3) return true;
+    const uint16_t sequence = static_cast<uint16_t>(frame.payload[0] | (frame.payload[1] << 8));
+    if (!mInFlight || sequence != mSequence) return true;
+
+    if (frame.payload[2] == EPO_ACK_OK) {
+        mNext += std::min(RECORDS_PER_PACKET, mEnd - mNext);
+        mSequence++;
+        mInFlight = false;
+    } else {
+        // Sent again at once, as long as attempts are left.
+        mStats.rejected++;
+        mDeadlineMs = nowMs;
+    }
+    return true;
+}
+
+EpoUploader::Action EpoUploader::poll(int64_t nowMs) {
+    Action action;
+    if (!mActive) return action;
+    if (mInFlight) {
+        if (nowMs < mDeadlineMs) return action;
+        if (mAttempts < MAX_ATTEMPTS) {
+            mAttempts++;
+            mStats.retries++;
+            return send(nowMs);
+        }
+        mStats.failures++;
+        mInFlight = false;
+        mActive = false;
+        action.kind = Action::GAVE_UP;
+        action.sequence = mSequence;
+        return action;
+    }
+    if (mNext < mEnd) {
+        mInFlight = true;
+        mAttempts = 1;
+        return send(nowMs);
+    }
+    mActive = false;
+    mStats.uploads++;
+    action.kind = Action::DONE;
+    action.data = packet(END_SEQUENCE, nullptr, 0);
+    return action;
+}
+
+int64_t EpoUploader::nextDeadlineMs() const {
+    if (!mActive) return -1;
+    return mInFlight ? mDeadlineMs : 0;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "BinaryFramer.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Uploads extended ephemeris (EPO) to an Airoha receiver. An EPO file is a run of 72-byte
+// satellite records grouped in six-hour segments, each record starting with the GPS hour its
+// segment begins at. Records go out three to an EPO data packet (binary id 722, sequence number
+// first); the receiver acknowledges each with an id 723 packet carrying the sequence number and
+// a result, and an end packet with sequence 0xFFFF closes the upload.
+//
+// Flow control is stop-and-wait: the receiver stores each packet before it acknowledges it, so
+// one is in flight at a time, retried a few times on a timeout or a failed result before the
+// upload is given up. Segments already over are skipped.
+//
+// No I/O here, as ReceiverConfig: the reader writes what poll() returns whenever the link is
+// free, so an upload never holds up reading.
+class EpoUploader {
+public:
+    static constexpr size_t RECORD_SIZE = 72;
+
+    struct Action {
+        // DONE: write |data|, the end packet, and the upload is complete.
+        enum Kind : uint8_t { NONE, WRITE, DONE, GAVE_UP } kind = NONE;
+        std::string_view data;  // WRITE, DONE: the packet, valid until the next poll()
+        uint16_t sequence = 0;  // WRITE, GAVE_UP
+    };
+
+    struct Stats {
+        uint32_t packets = 0;
+        uint32_t retries = 0;
+        uint32_t rejected = 0;
+        uint32_t uploads = 0;   // completed
+        uint32_t failures = 0;  // given up
+    };
+
+    // The span an EPO file covers, in Unix ms: from its first segment to the end of its last.
+    // False if |data| is not EPO at all.
+    static bool validity(const uint8_t* data, size_t size, int64_t& startUnixMs,
+                         int64_t& endUnixMs);
+
+    // Starts over with |data| from the segment current at |nowUnixMs|; null cancels.
+    void start(std::shared_ptr<const std::vector<uint8_t>> data, int64_t nowUnixMs);
+    // Starts the current upload over, for a receiver that may have lost what it was sent.
+    void restart(int64_t nowUnixMs);
+    bool active() const { return mActive; }
+    // Consumes EPO acknowledgements; returns false for any other frame.
+    bool onFrame(const BinaryFrame& frame, int64_t nowMs);
+    // Next thing to do. Call while the link is free until it returns NONE.
+    Action poll(int64_t nowMs);
+    // When poll() next has work, or -1 if there is no upload.
+    int64_t nextDeadlineMs() const;
+    // Records sent and acknowledged so far, and in all, of the current or last upload.
+    size_t recordsDone() const { return mNext - mFirst; }
+    size_t recordsTotal() const { return mEnd - mFirst; }
+    const Stats& stats() const { return mStats; }
+
+private:
+    static constexpr size_t RECORDS_PER_PACKET = 3;
+    // Sync, length, id, sequence, records, checksum, CR LF.
+    static constexpr size_t PACKET_SIZE = 8 + RECORDS_PER_PACKET * RECORD_SIZE + 3;
+    static constexpr int MAX_ATTEMPTS = 3;
+    // The receiver writes each packet to flash before acknowledging it.
+    static constexpr int64_t ACK_TIMEOUT_MS = 1000;
+
+    std::string_view packet(uint16_t sequence, const uint8_t* records, size_t count);
+    Action send(int64_t nowMs);
+
+    std::shared_ptr<const std::vector<uint8_t>> mData;
+    bool mActive = false;
+    size_t mFirst = 0;  // records, from the start of mData
+    size_t mNext = 0;   // first record not acknowledged yet
+    size_t mEnd = 0;
+    uint16_t mSequence = 0;
+    bool mInFlight = false;
+    int mAttempts = 0;
+    int64_t mDeadlineMs = -1;
+    uint8_t mPacket[PACKET_SIZE];
+    Stats mStats;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "EpochAssembler.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+void EpochAssembler::beginSentence(uint32_t formatter, int32_t utcMsOfDay, int64_t arrivalNs) {
+    if (utcMsOfDay >= 0 && utcMsOfDay != mBurstUtcMsOfDay) {
+        // First timed sentence of a new burst: whatever ended the previous burst ends the next.
+        if (mBurstUtcMsOfDay >= 0) {
+            mTerminatorFormatter = mBurstLastFormatter;
+            mTerminatorCount = mBurstLastCount;
+        }
+        mBurstUtcMsOfDay = utcMsOfDay;
+        mBurstCount++;
+        mFormatterCount = 0;
+        if (mCurrent.utcMsOfDay >= 0) {
+            close();
+        } else {
+            // Untimed sentences trailing an epoch that already closed belong to the old burst.
+            mCurrent = NmeaFix();
+            mSentencesInEpoch = 0;
+        }
+        mCurrent.utcMsOfDay = utcMsOfDay;
+    } else if (utcMsOfDay >= 0 && mCurrent.utcMsOfDay < 0) {
+        // The learned terminator closed this epoch too early; keep collecting under its time.
+        mCurrent.utcMsOfDay = utcMsOfDay;
+    }
+    if (mSentencesInEpoch == 0) mCurrent.arrivalNs = arrivalNs;
+
+    uint16_t count = 0;
+    for (int i = 0; i < mFormatterCount; i++) {
+        if (mFormatters[i] == formatter) {
+            count = ++mCounts[i];
+            break;
+        }
+    }
+    if (count == 0 && mFormatterCount < MAX_FORMATTERS) {
+        mFormatters[mFormatterCount] = formatter;
+        mCounts[mFormatterCount++] = count = 1;
+    }
+    mBurstLastFormatter = formatter;
+    mBurstLastCount = count;
+    mTerminatorSeen = count != 0 && formatter == mTerminatorFormatter && count == mTerminatorCount;
+    mSentencesInEpoch++;
+}
+
+void EpochAssembler::endSentence() {
+    // If the previous epoch has not been consumed yet, leave this one open for the idle flush.
+    if (mTerminatorSeen && !mHasCompleted) close();
+    mTerminatorSeen = false;
+}
+
+bool EpochAssembler::flush() {
+    return close();
+}
+
+bool EpochAssembler::close() {
+    if (mSentencesInEpoch == 0) return false;
+    mCompleted = mCurrent;
+    mHasCompleted = true;
+    mCurrent = NmeaFix();
+    mSentencesInEpoch = 0;
+    return true;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "NmeaTypes.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Groups the sentences of one receiver epoch so that a published fix never mixes data from two
+// epochs. Epochs are keyed on the UTC time carried by GGA, RMC, GNS, GLL, ZDA and GST. An
+// epoch closes when:
+//  - a sentence with a different UTC time arrives,
+//  - the last sentence of the burst arrives (learned from previous bursts as the formatter and
+//    its occurrence count, so multi-page GSV/GSA bursts are handled), or
+//  - the reader reports that the line has been idle (flush()).
+class EpochAssembler {
+public:
+    // Called before a sentence's data is applied. |formatter| is formatterCode() of the
+    // sentence, |utcMsOfDay| its UTC time or -1 if it carries none, |arrivalNs| when its first
+    // byte arrived. May close the open epoch.
+    void beginSentence(uint32_t formatter, int32_t utcMsOfDay, int64_t arrivalNs = 0);
+    // Called after the sentence's data has been applied to current(). May close the epoch.
+    void endSentence();
+    // Closes the open epoch, if it has any data. Returns true if an epoch was closed.
+    bool flush();
+
+    NmeaFix& current() { return mCurrent; }
+    bool isOpen() const { return mSentencesInEpoch > 0; }
+
+    // A closed epoch is held until consumed; until then a further close is deferred.
+    bool hasCompleted() const { return mHasCompleted; }
+    const NmeaFix& completed() const { return mCompleted; }
+    void consumeCompleted() { mHasCompleted = false; }
+
+    // The burst being received: a counter that advances with every new UTC time, and that time.
+    uint32_t burstCount() const { return mBurstCount; }
+    int32_t burstUtcMsOfDay() const { return mBurstUtcMsOfDay; }
+
+private:
+    bool close();
+
+    // Occurrence counts are tracked for a handful of formatters per burst.
+    static constexpr int MAX_FORMATTERS = 16;
+
+    NmeaFix mCurrent;
+    NmeaFix mCompleted;
+    bool mHasCompleted = false;
+    int mSentencesInEpoch = 0;
+    bool mTerminatorSeen = false;
+
+    // Last sentence of the current burst and the one learned from the previous burst.
+    int32_t mBurstUtcMsOfDay = -1;
+    uint32_t mBurstCount = 0;
+    uint32_t mFormatters[MAX_FORMATTERS] = {};
+    uint16_t mCounts[MAX_FORMATTERS] = {};
+    int mFormatterCount = 0;
+    uint32_t mBurstLastFormatter = 0;
+    uint16_t mBurstLastCount = 0;
+    uint32_t mTerminatorFormatter = 0;
+    uint16_t mTerminatorCount = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "EpochClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+void EpochClock::reset() {
+    *this = EpochClock();
+}
+
+void EpochClock::onPpsEdge(int64_t edgeNs) {
+    if (edgeNs <= 0 || edgeNs == mPpsEdgeNs) return;
+    if (mPpsEdgeNs > 0) {
+        // Consecutive edges are whole seconds apart; anything else is interrupt latency.
+        int64_t interval = edgeNs - mPpsEdgeNs;
+        int64_t seconds = (interval + NS_PER_SEC / 2) / NS_PER_SEC;
+        if (seconds > 0 && seconds <= 4) {
+            double error = std::fabs(static_cast<double>(interval - seconds * NS_PER_SEC));
+            mPpsJitterNs += JITTER_GAIN * (error - mPpsJitterNs);
+        }
+    }
+    mPpsEdgeNs = edgeNs;
+}
+
+EpochClock::Stamp EpochClock::stamp(int32_t utcMsOfDay, int64_t arrivalNs) {
+    if (utcMsOfDay < 0 || arrivalNs <= 0) return {arrivalNs, UNSETTLED_UNCERTAINTY_NS};
+
+    int64_t utcNs = static_cast<int64_t>(utcMsOfDay) * NS_PER_MS;
+    if (mHaveOffset) {
+        // Keep UTC monotonic across midnight so the offset does not jump by a day.
+        int64_t dayBase = mLastUtcNs - (mLastUtcNs % NS_PER_DAY);
+        utcNs += dayBase;
+        if (utcNs < mLastUtcNs - NS_PER_DAY / 2) utcNs += NS_PER_DAY;
+        if (utcNs > mLastUtcNs + NS_PER_DAY / 2) utcNs -= NS_PER_DAY;
+    }
+
+    double measured = static_cast<double>(arrivalNs - utcNs);
+    double predicted = mOffsetNs + mDriftNsPerNs * static_cast<double>(utcNs - mLastUtcNs);
+    double residual = measured - predicted;
+    if (!mHaveOffset || std::fabs(residual) > RESYNC_THRESHOLD_NS) {
+        mHaveOffset = true;
+        mEpochs = 0;
+        mOffsetNs = measured;
+        mDriftNsPerNs = 0;
+        mJitterNs = 0;
+    } else {
+        double dt = static_cast<double>(utcNs - mLastUtcNs);
+        mOffsetNs = predicted + OFFSET_GAIN * residual;
+        if (dt > 0) mDriftNsPerNs += DRIFT_GAIN * residual / dt;
+        mJitterNs += JITTER_GAIN * (std::fabs(residual) - mJitterNs);
+    }
+    mLastUtcNs = utcNs;
+    mEpochs++;
+
+    Stamp out;
+    if (mPpsEdgeNs > 0) {
+        // The edge marks the start of the UTC second the epoch belongs to, or of the next one if
+        // it was fetched after the epoch's output; the epoch has to precede its output by less
+        // than a second.
+        int64_t epochNs = mPpsEdgeNs + static_cast<int64_t>(utcMsOfDay % 1000) * NS_PER_MS;
+        if (epochNs > arrivalNs) epochNs -= NS_PER_SEC;
+        if (epochNs <= arrivalNs && arrivalNs - epochNs < NS_PER_SEC) {
+            out.elapsedRealtimeNs = epochNs;
+            out.timeUncertaintyNs = PPS_FLOOR_NS + mPpsJitterNs;
+            return out;
+        }
+    }
+    out.elapsedRealtimeNs = utcNs + static_cast<int64_t>(std::llround(mOffsetNs));
+    out.timeUncertaintyNs = mEpochs < SETTLE_EPOCHS
+            ? UNSETTLED_UNCERTAINTY_NS
+            : std::max(MAD_TO_SIGMA * mJitterNs, MIN_UNCERTAINTY_NS);
+    return out;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
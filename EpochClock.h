@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Maps receiver epochs (UTC time of day) onto CLOCK_BOOTTIME.
+//
+// Without PPS, the offset between an epoch's UTC time and the arrival of its first byte is
+// tracked with an alpha-beta filter (offset and drift). Receiver epochs are exactly periodic, so
+// the filtered offset gives a better estimate of the epoch instant than any single arrival, and
+// the residuals give the jitter that is reported as the time uncertainty. The estimate still
+// includes the receiver's output latency, which only PPS can remove: with a recent PPS edge the
+// epoch is placed at edge + the epoch's offset into the UTC second.
+class EpochClock {
+public:
+    struct Stamp {
+        int64_t elapsedRealtimeNs = 0;
+        double timeUncertaintyNs = 0;
+    };
+
+    // |utcMsOfDay| and |arrivalNs| are from the closed epoch (NmeaFix). Must be called for every
+    // epoch, including ones that are not published, to keep the filter converged.
+    Stamp stamp(int32_t utcMsOfDay, int64_t arrivalNs);
+
+    // Latest PPS assert edge in CLOCK_BOOTTIME. Repeated edges are ignored.
+    void onPpsEdge(int64_t edgeNs);
+
+    void reset();
+
+    double jitterNs() const { return mJitterNs; }
+    double ppsJitterNs() const { return mPpsJitterNs; }
+
+private:
+    static constexpr int64_t NS_PER_MS = 1000000;
+    static constexpr int64_t NS_PER_SEC = 1000000000;
+    static constexpr int64_t NS_PER_DAY = 86400 * NS_PER_SEC;
+    // Residuals above this are treated as a time jump (receiver reset, suspend) and re-seed.
+    static constexpr int64_t RESYNC_THRESHOLD_NS = 250 * NS_PER_MS;
+    static constexpr double OFFSET_GAIN = 0.1;
+    static constexpr double DRIFT_GAIN = 0.005;
+    static constexpr double JITTER_GAIN = 1.0 / 16;
+    // Mean absolute deviation to standard deviation, for roughly normal residuals.
+    static constexpr double MAD_TO_SIGMA = 1.25;
+    // Until the filter has settled, report a conservative uncertainty.
+    static constexpr int SETTLE_EPOCHS = 8;
+    static constexpr double UNSETTLED_UNCERTAINTY_NS = 10.0 * NS_PER_MS;
+    // About one byte time at 115200 baud, the resolution of the arrival capture.
+    static constexpr double MIN_UNCERTAINTY_NS = 100000.0;
+    // pps-gpio timestamps in the interrupt handler; a few microseconds covers its latency.
+    static constexpr double PPS_FLOOR_NS = 5000.0;
+
+    bool mHaveOffset = false;
+    int mEpochs = 0;
+    int64_t mLastUtcNs = 0;  // unwrapped across midnight
+    double mOffsetNs = 0;    // boottime - utc at mLastUtcNs
+    double mDriftNsPerNs = 0;
+    double mJitterNs = 0;
+
+    int64_t mPpsEdgeNs = 0;
+    double mPpsJitterNs = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssEventLoop"
+
+#include "EventLoop.h"
+
+#include <android-base/logging.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr int64_t NS_PER_SEC = 1000000000;
+
+static struct timespec toTimespec(int64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / NS_PER_SEC;
+    ts.tv_nsec = ns % NS_PER_SEC;
+    return ts;
+}
+
+EventLoop::~EventLoop() {
+    for (Slot& slot : mSlots) {
+        if (slot.timer && slot.fd >= 0) ::close(slot.fd);
+    }
+    if (mEventFd >= 0) ::close(mEventFd);
+    if (mEpollFd >= 0) ::close(mEpollFd);
+}
+
+bool EventLoop::open() {
+    mStopping.store(false);
+    if (mEpollFd >= 0) return true;
+    // Slots never move, so a handler may add or remove others while it runs.
+    mSlots.reserve(MAX_SLOTS);
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        LOG(ERROR) << "epoll_create1 failed: " << strerror(errno);
+        return false;
+    }
+    mEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = WAKE_SLOT;
+    if (mEventFd < 0 || epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &event) != 0) {
+        LOG(ERROR) << "eventfd failed: " << strerror(errno);
+        if (mEventFd >= 0) ::close(mEventFd);
+        ::close(mEpollFd);
+        mEventFd = mEpollFd = -1;
+        return false;
+    }
+    return true;
+}
+
+int EventLoop::addSlot(int fd, bool timer, Handler handler) {
+    size_t index = 0;
+    while (index < mSlots.size() && mSlots[index].fd >= 0) index++;
+    if (index == MAX_SLOTS) {
+        LOG(ERROR) << "Event loop full";
+        return -1;
+    }
+    if (index == mSlots.size()) mSlots.emplace_back();
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = static_cast<uint32_t>(index);
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        LOG(ERROR) << "epoll_ctl add failed: " << strerror(errno);
+        return -1;
+    }
+    Slot& slot = mSlots[index];
+    slot.fd = fd;
+    slot.timer = timer;
+    slot.deadlineNs = -1;
+    slot.intervalNs = 0;
+    slot.handler = std::move(handler);
+    return static_cast<int>(index);
+}
+
+bool EventLoop::watch(int fd, Handler handler) {
+    return addSlot(fd, false, std::move(handler)) >= 0;
+}
+
+void EventLoop::unwatch(int fd) {
+    for (Slot& slot : mSlots) {
+        if (slot.fd != fd || slot.timer) continue;
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+        // Events already fetched for it are skipped by run(). The handler is left alone: this
+        // may be running inside it.
+        slot.fd = -1;
+    }
+}
+
+int EventLoop::addTimer(Handler handler) {
+    int fd = timerfd_create(CLOCK_BOOTTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) {
+        LOG(ERROR) << "timerfd_create failed: " << strerror(errno);
+        return -1;
+    }
+    int timer = addSlot(fd, true, std::move(handler));
+    if (timer < 0) ::close(fd);
+    return timer;
+}
+
+void EventLoop::setTimer(int timer, int64_t deadlineNs, int64_t intervalNs) {
+    if (timer < 0) return;
+    Slot& slot = mSlots[timer];
+    if (deadlineNs < 0) intervalNs = 0;
+    if (slot.deadlineNs == deadlineNs && slot.intervalNs == intervalNs) return;
+    struct itimerspec spec = {};
+    if (deadlineNs >= 0) {
+        // A zero it_value would disarm; a deadline already past fires at once.
+        spec.it_value = toTimespec(deadlineNs > 0 ? deadlineNs : 1);
+        spec.it_interval = toTimespec(intervalNs);
+    }
+    if (timerfd_settime(slot.fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        LOG(ERROR) << "timerfd_settime failed: " << strerror(errno);
+        return;
+    }
+    slot.deadlineNs = deadlineNs;
+    slot.intervalNs = intervalNs;
+}
+
+void EventLoop::disarmAll() {
+    for (size_t i = 0; i < mSlots.size(); i++) {
+        if (mSlots[i].timer) setTimer(static_cast<int>(i), -1);
+    }
+}
+
+void EventLoop::wake() {
+    if (mEventFd < 0) return;
+    uint64_t one = 1;
+    (void)write(mEventFd, &one, sizeof(one));
+}
+
+void EventLoop::stop() {
+    mStopping.store(true);
+    wake();
+}
+
+void EventLoop::run(const Handler& afterEvents) {
+    struct epoll_event events[MAX_EVENTS];
+    afterEvents();
+    while (!mStopping.load()) {
+        int count = epoll_wait(mEpollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            LOG(ERROR) << "epoll_wait failed: " << strerror(errno);
+            return;
+        }
+        for (int i = 0; i < count && !mStopping.load(); i++) {
+            const uint32_t index = events[i].data.u32;
+            if (index == WAKE_SLOT) {
+                uint64_t value;
+                (void)read(mEventFd, &value, sizeof(value));
+                continue;
+            }
+            Slot& slot = mSlots[index];
+            if (slot.fd < 0) continue;
+            if (slot.timer) {
+                // Nothing to read if the timer was re-armed after it fired; then it is not due.
+                uint64_t expirations;
+                if (read(slot.fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    continue;
+                }
+                if (slot.intervalNs == 0) slot.deadlineNs = -1;
+            }
+            slot.handler();
+        }
+        if (!mStopping.load()) afterEvents();
+    }
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Single-threaded epoll loop: file descriptors, CLOCK_BOOTTIME timerfds and an eventfd through
+// which other threads wake or stop it. Nothing is polled; with no input and no timer armed the
+// thread sleeps in epoll_wait() until woken.
+//
+// Handlers are registered before run() or from within the loop's own thread. wake() and stop()
+// may be called from any thread at any time: the eventfd lives as long as the object, so there
+// is never a descriptor closed under another thread's feet.
+class EventLoop {
+public:
+    using Handler = std::function<void()>;
+
+    // Watched descriptors and timers together.
+    static constexpr size_t MAX_SLOTS = 16;
+
+    EventLoop() = default;
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Creates the epoll instance and the eventfd, once, and clears a previous stop(). Call
+    // before each run().
+    bool open();
+    bool isOpen() const { return mEpollFd >= 0; }
+
+    // Runs |handler| whenever |fd| is readable, has an error or was hung up on.
+    bool watch(int fd, Handler handler);
+    void unwatch(int fd);
+
+    // Adds a disarmed timer and returns its id, or -1.
+    int addTimer(Handler handler);
+    // Fires at |deadlineNs| (CLOCK_BOOTTIME) and then every |intervalNs| if positive; a negative
+    // deadline disarms. Re-arming with the same values costs nothing.
+    void setTimer(int timer, int64_t deadlineNs, int64_t intervalNs = 0);
+    void disarmAll();
+
+    // Dispatches events until stop(). |afterEvents| runs once before the first wait and then
+    // after each batch of events, wake() included.
+    void run(const Handler& afterEvents);
+    // Any thread. Makes run() go round once.
+    void wake();
+    // Any thread. run() returns after the batch in progress.
+    void stop();
+
+private:
+    static constexpr int MAX_EVENTS = 8;
+    static constexpr uint32_t WAKE_SLOT = UINT32_MAX;
+
+    struct Slot {
+        int fd = -1;
+        bool timer = false;
+        int64_t deadlineNs = -1;
+        int64_t intervalNs = 0;
+        Handler handler;
+    };
+
+    int addSlot(int fd, bool timer, Handler handler);
+
+    int mEpollFd = -1;
+    int mEventFd = -1;
+    std::atomic<bool> mStopping{false};
+    std::vector<Slot> mSlots;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
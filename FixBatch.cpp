@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "FixBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "NmeaTypes.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr double DEGREE_SCALE = 1e7;
+
+static size_t putVarint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(value);
+    return n;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Non-negative and rounded up, so a batched accuracy is never better than the original.
+static uint32_t quantizeUp(double value, double scale) {
+    const double scaled = std::ceil(value * scale);
+    return scaled <= 0 ? 0 : scaled >= UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(scaled);
+}
+
+static uint32_t quantize(double value, double scale) {
+    const double scaled = std::round(value * scale);
+    return scaled <= 0 ? 0 : scaled >= UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(scaled);
+}
+
+// Deltas of angles wrap modulo 2^32, which also covers crossing the antimeridian.
+static int32_t wrappingDelta(int32_t to, int32_t from) {
+    return static_cast<int32_t>(static_cast<uint32_t>(to) - static_cast<uint32_t>(from));
+}
+
+static int32_t wrappingAdd(int32_t base, int64_t delta) {
+    return static_cast<int32_t>(static_cast<uint32_t>(base) + static_cast<uint32_t>(delta));
+}
+
+FixBatch::FixBatch() : mBuffer(new uint8_t[CAPACITY_BYTES]) {}
+
+void FixBatch::clear() {
+    mHead = 0;
+    mUsed = 0;
+    mCount = 0;
+    mBase = mLast;
+}
+
+void FixBatch::push(const BatchedFix& fix) {
+    uint8_t record[MAX_RECORD_BYTES];
+    size_t n = 0;
+    State next = mLast;
+    record[n++] = fix.flags;
+
+    next.timestampMillis = fix.timestampMillis;
+    next.elapsedRealtimeUs = fix.elapsedRealtimeNs / 1000;
+    n += putVarint(record + n, zigzag(next.timestampMillis - mLast.timestampMillis));
+    n += putVarint(record + n, zigzag(next.elapsedRealtimeUs - mLast.elapsedRealtimeUs));
+    n += putVarint(record + n, quantizeUp(fix.timeUncertaintyNs, 1e-3));
+    if (fix.flags & FIX_HAS_LAT_LONG) {
+        next.latitude = static_cast<int32_t>(std::lround(fix.latitudeDegrees * DEGREE_SCALE));
+        next.longitude = static_cast<int32_t>(std::lround(fix.longitudeDegrees * DEGREE_SCALE));
+        n += putVarint(record + n, zigzag(wrappingDelta(next.latitude, mLast.latitude)));
+        n += putVarint(record + n, zigzag(wrappingDelta(next.longitude, mLast.longitude)));
+    }
+    if (fix.flags & FIX_HAS_ALTITUDE) {
+        const double cm = std::clamp(fix.altitudeMeters * 100, -1e9, 1e9);
+        next.altitude = static_cast<int32_t>(std::lround(cm));
+        n += putVarint(record + n, zigzag(static_cast<int64_t>(next.altitude) - mLast.altitude));
+    }
+    if (fix.flags & FIX_HAS_SPEED) n += putVarint(record + n, quantize(fix.speedMetersPerSec, 100));
+    if (fix.flags & FIX_HAS_BEARING) n += putVarint(record + n, quantize(fix.bearingDegrees, 10) % 3600);
+    if (fix.flags & FIX_HAS_HORIZONTAL_ACCURACY) {
+        n += putVarint(record + n, quantizeUp(fix.horizontalAccuracyMeters, 10));
+    }
+    if (fix.flags & FIX_HAS_VERTICAL_ACCURACY) {
+        n += putVarint(record + n, quantizeUp(fix.verticalAccuracyMeters, 10));
+    }
+    if (fix.flags & FIX_HAS_SPEED_ACCURACY) {
+        n += putVarint(record + n, quantizeUp(fix.speedAccuracyMetersPerSecond, 10));
+    }
+    if (fix.flags & FIX_HAS_BEARING_ACCURACY) {
+        n += putVarint(record + n, quantizeUp(fix.bearingAccuracyDegrees, 10));
+    }
+
+    BatchedFix evicted;
+    while (mUsed + n > CAPACITY_BYTES) {
+        const size_t length = decode(0, mBase, evicted);
+        mHead = (mHead + length) % CAPACITY_BYTES;
+        mUsed -= length;
+        mCount--;
+    }
+    size_t tail = (mHead + mUsed) % CAPACITY_BYTES;
+    const size_t first = std::min(n, CAPACITY_BYTES - tail);
+    std::copy(record, record + first, mBuffer.get() + tail);
+    std::copy(record + first, record + n, mBuffer.get());
+    mUsed += n;
+    mCount++;
+    mLast = next;
+}
+
+uint64_t FixBatch::readVarint(size_t& offset) const {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        const uint8_t byte = byteAt(offset++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+size_t FixBatch::decode(size_t offset, State& state, BatchedFix& out) const {
+    const size_t start = offset;
+    out = BatchedFix();
+    out.flags = byteAt(offset++);
+    state.timestampMillis += unzigzag(readVarint(offset));
+    state.elapsedRealtimeUs += unzigzag(readVarint(offset));
+    out.timestampMillis = state.timestampMillis;
+    out.elapsedRealtimeNs = state.elapsedRealtimeUs * 1000;
+    out.timeUncertaintyNs = static_cast<double>(readVarint(offset)) * 1e3;
+    if (out.flags & FIX_HAS_LAT_LONG) {
+        state.latitude = wrappingAdd(state.latitude, unzigzag(readVarint(offset)));
+        state.longitude = wrappingAdd(state.longitude, unzigzag(readVarint(offset)));
+        out.latitudeDegrees = state.latitude / DEGREE_SCALE;
+        out.longitudeDegrees = state.longitude / DEGREE_SCALE;
+    }
+    if (out.flags & FIX_HAS_ALTITUDE) {
+        state.altitude = static_cast<int32_t>(state.altitude + unzigzag(readVarint(offset)));
+        out.altitudeMeters = state.altitude / 100.0;
+    }
+    if (out.flags & FIX_HAS_SPEED) out.speedMetersPerSec = readVarint(offset) / 100.0;
+    if (out.flags & FIX_HAS_BEARING) out.bearingDegrees = readVarint(offset) / 10.0;
+    if (out.flags & FIX_HAS_HORIZONTAL_ACCURACY) out.horizontalAccuracyMeters = readVarint(offset) / 10.0f;
+    if (out.flags & FIX_HAS_VERTICAL_ACCURACY) out.verticalAccuracyMeters = readVarint(offset) / 10.0f;
+    if (out.flags & FIX_HAS_SPEED_ACCURACY) out.speedAccuracyMetersPerSecond = readVarint(offset) / 10.0f;
+    if (out.flags & FIX_HAS_BEARING_ACCURACY) out.bearingAccuracyDegrees = readVarint(offset) / 10.0f;
+    return offset - start;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
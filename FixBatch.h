@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// A location as batched: GnssLocation's fields, with FixFlags.
+struct BatchedFix {
+    uint8_t flags = 0;
+    double latitudeDegrees = 0;
+    double longitudeDegrees = 0;
+    double altitudeMeters = 0;
+    double speedMetersPerSec = 0;
+    double bearingDegrees = 0;
+    float horizontalAccuracyMeters = 0;
+    float verticalAccuracyMeters = 0;
+    float speedAccuracyMetersPerSecond = 0;
+    float bearingAccuracyDegrees = 0;
+    int64_t timestampMillis = 0;
+    int64_t elapsedRealtimeNs = 0;
+    double timeUncertaintyNs = 0;
+};
+
+// Fixed-size ring of fixes for IGnssBatching, a few hundred KB for thousands of fixes. Each fix
+// is one variable-length record: a flags byte, then zigzag varints of the time and position
+// deltas to the previous fix and of the other fields quantised, present only when their flag
+// is. A walking or driving fix at 1 Hz takes around 20 bytes.
+//
+// Resolution: 1e-7 degree (about 1 cm), 1 cm altitude, 1 cm/s speed, 0.1 degree bearing,
+// 0.1 m, m/s or degree accuracies (rounded up), 1 ms UTC time and 1 us elapsed realtime.
+//
+// The oldest record is evicted to make room by folding its deltas into a base state, so the
+// ring never needs a key frame. Not thread-safe.
+class FixBatch {
+public:
+    static constexpr size_t CAPACITY_BYTES = 256 * 1024;
+    // flags, time and elapsed realtime deltas (64-bit), uncertainty, latitude, longitude,
+    // altitude, speed, bearing (< 3600), four accuracies.
+    static constexpr size_t MAX_RECORD_BYTES = 1 + 10 + 10 + 5 + 5 + 5 + 5 + 5 + 2 + 4 * 5;
+    // What always fits, whatever the fixes; typically several times more do.
+    static constexpr size_t GUARANTEED_FIXES = CAPACITY_BYTES / MAX_RECORD_BYTES;
+
+    FixBatch();
+
+    // True when the next push() may have to evict the oldest fix.
+    bool full() const { return mUsed + MAX_RECORD_BYTES > CAPACITY_BYTES; }
+    // Appends |fix|, evicting the oldest fixes if there is no room.
+    void push(const BatchedFix& fix);
+    // Calls sink(const BatchedFix&) for every fix, oldest first, and empties the batch.
+    template <typename Sink>
+    void drain(Sink&& sink) {
+        State state = mBase;
+        size_t offset = 0;
+        BatchedFix fix;
+        for (size_t i = 0; i < mCount; i++) {
+            offset += decode(offset, state, fix);
+            sink(static_cast<const BatchedFix&>(fix));
+        }
+        clear();
+    }
+    void clear();
+
+    size_t size() const { return mCount; }
+    size_t bytesUsed() const { return mUsed; }
+
+private:
+    // What the deltas are relative to.
+    struct State {
+        int64_t timestampMillis = 0;
+        int64_t elapsedRealtimeUs = 0;
+        int32_t latitude = 0;   // 1e-7 degree
+        int32_t longitude = 0;
+        int32_t altitude = 0;   // cm
+    };
+
+    // Decodes the record at |offset| bytes past the oldest, applying it to |state|; returns
+    // its length.
+    size_t decode(size_t offset, State& state, BatchedFix& out) const;
+    uint8_t byteAt(size_t offset) const {
+        size_t pos = mHead + offset;
+        return mBuffer[pos < CAPACITY_BYTES ? pos : pos - CAPACITY_BYTES];
+    }
+    uint64_t readVarint(size_t& offset) const;
+
+    std::unique_ptr<uint8_t[]> mBuffer;
+    size_t mHead = 0;   // oldest record
+    size_t mUsed = 0;
+    size_t mCount = 0;
+    State mBase;        // before the oldest record
+    State mLast;        // after the newest
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "FixFusion.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+static constexpr double METERS_PER_DEGREE = 6371000.0 * DEG_TO_RAD;
+
+static bool isValid(const NmeaFix& fix) {
+    return fix.fixQuality > 0 && (fix.flags & FIX_HAS_LAT_LONG);
+}
+
+FixFusion::FixFusion(size_t sources)
+    : mSourceCount(std::min(std::max<size_t>(sources, 1), MAX_SOURCES)) {}
+
+void FixFusion::reset() {
+    mPendingMask = 0;
+    mClosedUtcMsOfDay = -1;
+    for (int64_t& t : mLastOfferNs) t = 0;
+}
+
+bool FixFusion::sameEpoch(const NmeaFix& fix, int64_t timeNs) const {
+    if (fix.utcMsOfDay >= 0 && mPendingUtcMsOfDay >= 0) return fix.utcMsOfDay == mPendingUtcMsOfDay;
+    return std::llabs(timeNs - mPendingTimeNs) < UNTIMED_MATCH_NS;
+}
+
+bool FixFusion::isLate(size_t source, const NmeaFix& fix, int64_t timeNs) {
+    // Behind the pending epoch, or not after the last closed one.
+    const bool pending = mPendingMask != 0;
+    const int32_t reference = pending ? mPendingUtcMsOfDay : mClosedUtcMsOfDay;
+    if (fix.utcMsOfDay < 0 || reference < 0) return false;
+    int32_t behind = reference - fix.utcMsOfDay;
+    if (behind < 0) behind += MS_PER_DAY;
+    if (behind >= MS_PER_DAY / 2 || (behind == 0 && pending)) return false;
+    // A repeat of the epoch just closed is late even from a single source.
+    const bool othersLive = (liveMask(timeNs) & ~(1u << source)) != 0;
+    if (behind == 0 || (othersLive && behind <= LATE_WINDOW_MS)) return true;
+    // Time went back: a pending epoch from the other sources is closed as usual by offer().
+    mClosedUtcMsOfDay = -1;
+    return false;
+}
+
+uint32_t FixFusion::liveMask(int64_t nowNs) const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < mSourceCount; i++) {
+        if (mLastOfferNs[i] > 0 && nowNs - mLastOfferNs[i] <= LIVE_TIMEOUT_NS) mask |= 1u << i;
+    }
+    return mask;
+}
+
+void FixFusion::add(size_t source, const NmeaFix& fix, int64_t timeNs, double timeUncertaintyNs) {
+    if (mPendingMask == 0) {
+        mPendingSinceNs = timeNs;
+        mPendingUtcMsOfDay = fix.utcMsOfDay;
+        mPendingTimeNs = timeNs;
+    } else if (mPendingUtcMsOfDay < 0) {
+        mPendingUtcMsOfDay = fix.utcMsOfDay;
+    }
+    // A second solution from the same source for one epoch replaces the first.
+    Entry& entry = mEntries[source];
+    entry.fix = fix;
+    entry.timeNs = timeNs;
+    entry.timeUncertaintyNs = timeUncertaintyNs;
+    mPendingMask |= 1u << source;
+    mLastOfferNs[source] = std::max<int64_t>(timeNs, 1);
+}
+
+const FixFusion::Solution& FixFusion::close() {
+    auto sigma = [](const NmeaFix& fix) {
+        return (fix.flags & FIX_HAS_HORIZONTAL_ACCURACY) && fix.horizontalAccuracyMeters > 0
+                ? fix.horizontalAccuracyMeters
+                : UNKNOWN_ACCURACY_M;
+    };
+
+    // Base: best accuracy, then most satellites; any solution if none is valid.
+    int base = -1;
+    for (size_t i = 0; i < mSourceCount; i++) {
+        if (!(mPendingMask & (1u << i))) continue;
+        if (base < 0) {
+            base = static_cast<int>(i);
+            continue;
+        }
+        const NmeaFix& a = mEntries[i].fix;
+        const NmeaFix& b = mEntries[base].fix;
+        if (isValid(a) != isValid(b)) {
+            if (isValid(a)) base = static_cast<int>(i);
+            continue;
+        }
+        if (sigma(a) < sigma(b) || (sigma(a) == sigma(b) && a.numSatellites > b.numSatellites)) {
+            base = static_cast<int>(i);
+        }
+    }
+
+    const Entry& best = mEntries[base];
+    mResult.fix = best.fix;
+    mResult.timeNs = best.timeNs;
+    mResult.timeUncertaintyNs = best.timeUncertaintyNs;
+    mResult.source = static_cast<size_t>(base);
+    mResult.combined = 1;
+
+    if (isValid(best.fix)) {
+        const double baseSigma = sigma(best.fix);
+        const double cosLat = std::cos(best.fix.latitudeDegrees * DEG_TO_RAD);
+        // Offsets from the base in metres, so the antimeridian needs no special case.
+        double weightSum = 1 / (baseSigma * baseSigma);
+        double north = 0, east = 0, up = 0, upWeightSum = 0;
+        const bool baseAltitude = (best.fix.flags & FIX_HAS_ALTITUDE) != 0;
+        if (baseAltitude) upWeightSum = weightSum;
+        for (size_t i = 0; i < mSourceCount; i++) {
+            if (static_cast<int>(i) == base || !(mPendingMask & (1u << i))) continue;
+            const NmeaFix& fix = mEntries[i].fix;
+            if (!isValid(fix)) continue;
+            double dLon = fix.longitudeDegrees - best.fix.longitudeDegrees;
+            if (dLon > 180) dLon -= 360;
+            if (dLon < -180) dLon += 360;
+            const double dn = (fix.latitudeDegrees - best.fix.latitudeDegrees) * METERS_PER_DEGREE;
+            const double de = dLon * METERS_PER_DEGREE * cosLat;
+            const double s = sigma(fix);
+            const double limit = CONSISTENCY_SIGMAS * std::sqrt(s * s + baseSigma * baseSigma);
+            if (dn * dn + de * de > limit * limit) {
+                mStats.outliers++;
+                continue;
+            }
+            const double w = 1 / (s * s);
+            north += w * dn;
+            east += w * de;
+            weightSum += w;
+            if (baseAltitude && (fix.flags & FIX_HAS_ALTITUDE)) {
+                up += w * (fix.altitudeMeters - best.fix.altitudeMeters);
+                upWeightSum += w;
+            }
+            mResult.combined++;
+        }
+        if (mResult.combined > 1) {
+            mResult.fix.latitudeDegrees += north / weightSum / METERS_PER_DEGREE;
+            double longitude = best.fix.longitudeDegrees +
+                    (cosLat > 1e-9 ? east / weightSum / (METERS_PER_DEGREE * cosLat) : 0);
+            if (longitude > 180) longitude -= 360;
+            if (longitude < -180) longitude += 360;
+            mResult.fix.longitudeDegrees = longitude;
+            if (upWeightSum > 0) mResult.fix.altitudeMeters += up / upWeightSum;
+            mStats.combined++;
+        }
+    }
+
+    mStats.epochs++;
+    mPendingMask = 0;
+    if (mPendingUtcMsOfDay >= 0) mClosedUtcMsOfDay = mPendingUtcMsOfDay;
+    return mResult;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
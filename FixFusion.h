@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "NmeaTypes.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Turns the solutions of several receivers into one per epoch. Solutions are grouped by their
+// UTC time; an epoch is closed as soon as every live source (one that has reported within
+// LIVE_TIMEOUT_NS) has offered its solution, when a later epoch starts, or on flush(). With a
+// single source every offer closes its epoch at once, so fusion adds no latency.
+//
+// Of the valid solutions the one with the best horizontal accuracy (then the most satellites)
+// is the base. Others that agree with it within three combined sigmas are averaged into its
+// position with inverse-variance weights; the rest are outliers and ignored. The result keeps
+// the base's accuracy, time and velocity: receivers on one antenna have correlated errors,
+// so the average is not claimed to be better than its best member.
+//
+// No allocation; one fix is held per source.
+class FixFusion {
+public:
+    static constexpr size_t MAX_SOURCES = 4;
+
+    struct Solution {
+        NmeaFix fix;
+        int64_t timeNs = 0;  // CLOCK_BOOTTIME of the epoch
+        double timeUncertaintyNs = 0;
+        size_t source = 0;   // base of the fused result
+        uint8_t combined = 1;  // solutions averaged into it
+    };
+
+    struct Stats {
+        uint64_t epochs = 0;
+        uint64_t combined = 0;  // epochs averaged from more than one source
+        uint64_t outliers = 0;  // valid solutions left out for disagreeing
+        uint64_t flushed = 0;   // epochs closed before every live source reported
+        uint64_t late = 0;      // solutions dropped for arriving after their epoch closed
+    };
+
+    explicit FixFusion(size_t sources = 1);
+
+    // Offers |source|'s solution. Calls sink(const Solution&) for each epoch this closes: the
+    // pending one if |fix| is for a later epoch, and |fix|'s own if it completes it.
+    template <typename Sink>
+    void offer(size_t source, const NmeaFix& fix, int64_t timeNs, double timeUncertaintyNs,
+               Sink&& sink) {
+        if (source >= mSourceCount) return;
+        if (isLate(source, fix, timeNs)) {
+            // Its epoch has been published already.
+            mLastOfferNs[source] = timeNs;
+            mStats.late++;
+            return;
+        }
+        if (mPendingMask != 0 && !sameEpoch(fix, timeNs)) {
+            mStats.flushed++;
+            sink(static_cast<const Solution&>(close()));
+        }
+        add(source, fix, timeNs, timeUncertaintyNs);
+        if ((mPendingMask & liveMask(timeNs)) == liveMask(timeNs)) {
+            sink(static_cast<const Solution&>(close()));
+        }
+    }
+    // Closes the pending epoch with what has been offered. Returns false if none was pending.
+    template <typename Sink>
+    bool flush(Sink&& sink) {
+        if (mPendingMask == 0) return false;
+        mStats.flushed++;
+        sink(static_cast<const Solution&>(close()));
+        return true;
+    }
+
+    bool pending() const { return mPendingMask != 0; }
+    // When the first solution of the pending epoch was offered.
+    int64_t pendingSinceNs() const { return mPendingSinceNs; }
+    size_t sourceCount() const { return mSourceCount; }
+    const Stats& stats() const { return mStats; }
+    void reset();
+    // Forgets the last closed epoch, so no solution counts as late until the next one closes:
+    // for a receiver that reconnected or restarted, whose time may have gone back.
+    void resync() { mClosedUtcMsOfDay = -1; }
+
+private:
+    // A source that has not offered anything for this long is not waited for.
+    static constexpr int64_t LIVE_TIMEOUT_NS = 2000000000LL;
+    // With other sources live, a solution this far behind the last closed epoch is a straggler
+    // from one of the last few epochs. Further back, or from the only live source, it is a
+    // receiver whose time went back, and the fusion resyncs to it.
+    static constexpr int32_t LATE_WINDOW_MS = 2000;
+    // Solutions without UTC time belong together when this close.
+    static constexpr int64_t UNTIMED_MATCH_NS = 100000000LL;
+    static constexpr double UNKNOWN_ACCURACY_M = 50.0;
+    static constexpr double CONSISTENCY_SIGMAS = 3.0;
+    static constexpr int32_t MS_PER_DAY = 24 * 3600 * 1000;
+
+    struct Entry {
+        NmeaFix fix;
+        int64_t timeNs = 0;
+        double timeUncertaintyNs = 0;
+    };
+
+    bool sameEpoch(const NmeaFix& fix, int64_t timeNs) const;
+    // Also resyncs on a step back too large to be a late solution.
+    bool isLate(size_t source, const NmeaFix& fix, int64_t timeNs);
+    uint32_t liveMask(int64_t nowNs) const;
+    void add(size_t source, const NmeaFix& fix, int64_t timeNs, double timeUncertaintyNs);
+    const Solution& close();
+
+    size_t mSourceCount;
+    Entry mEntries[MAX_SOURCES];
+    int64_t mLastOfferNs[MAX_SOURCES] = {};
+    uint32_t mPendingMask = 0;
+    int64_t mPendingSinceNs = 0;
+    int32_t mPendingUtcMsOfDay = -1;
+    int32_t mClosedUtcMsOfDay = -1;  // last epoch closed
+    int64_t mPendingTimeNs = 0;
+    Solution mResult;
+    Stats mStats;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
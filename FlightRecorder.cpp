@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "FlightRecorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static_assert(sizeof(FlightRecordHeader) == 64 && sizeof(FlightRecordEntry) == 16,
+              "The capture file layout must not depend on the build");
+
+static constexpr size_t ENTRY_SIZE = sizeof(FlightRecordEntry);
+// Smaller rings hold too little to be worth replaying.
+static constexpr size_t MIN_CAPACITY = 4096;
+
+// Records start on 8-byte boundaries, so entries can be read in place.
+static uint64_t recordSize(size_t length) {
+    return (ENTRY_SIZE + length + 7) & ~uint64_t{7};
+}
+
+static bool isValid(const FlightRecordHeader& header, uint64_t capacity) {
+    return header.magic == FlightRecordHeader::MAGIC &&
+           header.version == FlightRecordHeader::VERSION && header.capacity == capacity &&
+           header.head < capacity && header.tail < capacity && header.used <= capacity &&
+           header.head % 8 == 0 && header.tail % 8 == 0 &&
+           (header.tail + header.used) % capacity == header.head;
+}
+
+bool FlightRecorder::open(const std::string& path, size_t capacity) {
+    close();
+    capacity &= ~size_t{7};
+    if (capacity < MIN_CAPACITY) {
+        errno = EINVAL;
+        return false;
+    }
+    const size_t fileSize = sizeof(FlightRecordHeader) + capacity;
+
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+    if (fd < 0) return false;
+    struct stat st;
+    bool resume = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == fileSize;
+    // Blocks are allocated now: a store into a hole the disk has no room for would be SIGBUS.
+    if (!resume && ftruncate(fd, 0) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (const int error = posix_fallocate(fd, 0, fileSize); error != 0) {
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+    void* map = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    mHeader = static_cast<FlightRecordHeader*>(map);
+    mRing = static_cast<uint8_t*>(map) + sizeof(FlightRecordHeader);
+    mMappedSize = fileSize;
+    if (resume && isValid(*mHeader, capacity)) return true;
+
+    FlightRecordHeader header{};
+    header.magic = FlightRecordHeader::MAGIC;
+    header.version = FlightRecordHeader::VERSION;
+    header.capacity = capacity;
+    *mHeader = header;
+    return true;
+}
+
+void FlightRecorder::close() {
+    if (mHeader == nullptr) return;
+    munmap(mHeader, mMappedSize);
+    mHeader = nullptr;
+    mRing = nullptr;
+    mMappedSize = 0;
+}
+
+void FlightRecorder::dropOldest() {
+    FlightRecordHeader& header = *mHeader;
+    const uint64_t toEnd = header.capacity - header.tail;
+    FlightRecordEntry entry{};
+    if (toEnd >= ENTRY_SIZE) memcpy(&entry, mRing + header.tail, ENTRY_SIZE);
+    if (toEnd < ENTRY_SIZE || entry.kind == FlightRecordEntry::WRAP) {
+        header.used -= std::min(toEnd, header.used);
+        header.tail = 0;
+        return;
+    }
+    const uint64_t size = recordSize(entry.length);
+    if (size > header.used) {
+        // Not something append() wrote: give up on the lot rather than walk garbage.
+        header.tail = header.head;
+        header.used = 0;
+        header.records = 0;
+        return;
+    }
+    header.used -= size;
+    header.tail = header.tail + size == header.capacity ? 0 : header.tail + size;
+    if (header.records > 0) header.records--;
+    header.overwritten++;
+}
+
+void FlightRecorder::append(uint8_t source, int64_t arrivalNs, int64_t byteTimeNs,
+                            const char* data, size_t length) {
+    if (mHeader == nullptr) return;
+    FlightRecordHeader& header = *mHeader;
+    const uint64_t capacity = header.capacity;
+    length = std::min({length, MAX_CHUNK, static_cast<size_t>(capacity / 2 - ENTRY_SIZE)});
+    const uint64_t size = recordSize(length);
+    const uint64_t toEnd = capacity - header.head;
+    const uint64_t padding = toEnd < size ? toEnd : 0;
+    while (capacity - header.used < padding + size && header.used > 0) dropOldest();
+
+    uint64_t offset = header.head;
+    if (padding > 0) {
+        if (padding >= ENTRY_SIZE) {
+            FlightRecordEntry wrap{};
+            wrap.kind = FlightRecordEntry::WRAP;
+            memcpy(mRing + offset, &wrap, ENTRY_SIZE);
+        }
+        offset = 0;
+    }
+    FlightRecordEntry entry{};
+    entry.arrivalNs = arrivalNs;
+    entry.byteTimeNs = static_cast<uint32_t>(std::clamp<int64_t>(byteTimeNs, 0, UINT32_MAX));
+    entry.length = static_cast<uint16_t>(length);
+    entry.source = source;
+    memcpy(mRing + offset, &entry, ENTRY_SIZE);
+    memcpy(mRing + offset + ENTRY_SIZE, data, length);
+
+    // The record is complete before the header counts it.
+    std::atomic_signal_fence(std::memory_order_release);
+    header.head = offset + size == capacity ? 0 : offset + size;
+    header.used += padding + size;
+    header.records++;
+}
+
+bool FlightRecording::open(const std::string& path) {
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= sizeof(FlightRecordHeader)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t fileSize = static_cast<size_t>(st.st_size);
+    void* map = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    mHeader = static_cast<const FlightRecordHeader*>(map);
+    mRing = static_cast<const uint8_t*>(map) + sizeof(FlightRecordHeader);
+    mMappedSize = fileSize;
+    mSnapshot = *mHeader;
+    if (!isValid(mSnapshot, fileSize - sizeof(FlightRecordHeader))) {
+        close();
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+void FlightRecording::close() {
+    if (mHeader == nullptr) return;
+    munmap(const_cast<FlightRecordHeader*>(mHeader), mMappedSize);
+    mHeader = nullptr;
+    mRing = nullptr;
+    mMappedSize = 0;
+    mLeft = 0;
+}
+
+void FlightRecording::rewind() {
+    mOffset = mSnapshot.tail;
+    mLeft = mHeader ? mSnapshot.used : 0;
+}
+
+bool FlightRecording::next(Record& record) {
+    const uint64_t capacity = mSnapshot.capacity;
+    while (mLeft > 0) {
+        const uint64_t toEnd = capacity - mOffset;
+        FlightRecordEntry entry{};
+        if (toEnd >= ENTRY_SIZE && mLeft >= ENTRY_SIZE) memcpy(&entry, mRing + mOffset, ENTRY_SIZE);
+        if (toEnd < ENTRY_SIZE || entry.kind == FlightRecordEntry::WRAP) {
+            if (toEnd > mLeft) break;
+            mLeft -= toEnd;
+            mOffset = 0;
+            continue;
+        }
+        const uint64_t size = recordSize(entry.length);
+        if (mLeft < ENTRY_SIZE || entry.kind != 0 || size > mLeft || size > toEnd) break;
+        record.arrivalNs = entry.arrivalNs;
+        record.byteTimeNs = entry.byteTimeNs;
+        record.source = entry.source;
+        record.data = reinterpret_cast<const char*>(mRing + mOffset + ENTRY_SIZE);
+        record.length = entry.length;
+        mLeft -= size;
+        mOffset = mOffset + size == capacity ? 0 : mOffset + size;
+        return true;
+    }
+    mLeft = 0;
+    return false;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
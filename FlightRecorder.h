@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Capture file layout: a header, then a ring of records, each the chunk one read() returned
+// with its CLOCK_BOOTTIME arrival stamp. Records are only ever appended; when the ring is full
+// the oldest are given up for the new one, so the file keeps the latest stretch of traffic and
+// never grows. The file is memory-mapped and shared, so whatever was appended survives the
+// process crashing; the header is updated only after the record it counts is complete.
+struct FlightRecordHeader {
+    static constexpr uint32_t MAGIC = 0x50434e47;  // "GNCP"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;  // bytes of ring after the header
+    uint64_t head;      // where the next record goes
+    uint64_t tail;      // the oldest record
+    uint64_t used;      // bytes between tail and head, padding included
+    uint64_t records;
+    uint64_t overwritten;  // records given up for newer ones
+    uint64_t reserved;
+};
+
+struct FlightRecordEntry {
+    // A record that would not fit before the end of the ring starts over at its beginning; this
+    // marks the rest of the ring as padding. Less than a whole entry left is padding as well.
+    static constexpr uint8_t WRAP = 0xff;
+
+    int64_t arrivalNs;   // last byte of the chunk
+    uint32_t byteTimeNs; // wire time of one byte when it was read
+    uint16_t length;
+    uint8_t source;      // receiver index
+    uint8_t kind;        // 0, or WRAP
+};
+
+// Appends received chunks to a capture file. Not thread-safe; every receiver is read on one
+// thread anyway. No logging: failures are reported by return value and errno.
+class FlightRecorder {
+public:
+    static constexpr size_t MAX_CHUNK = UINT16_MAX;
+
+    FlightRecorder() = default;
+    ~FlightRecorder() { close(); }
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    // Maps |path|, |capacity| bytes of ring. A valid capture of the same capacity is appended
+    // to, so a restart does not lose what led up to it; anything else is started afresh.
+    bool open(const std::string& path, size_t capacity);
+    void close();
+    bool isOpen() const { return mHeader != nullptr; }
+
+    // Chunks over MAX_CHUNK, or over half the ring, are cut short.
+    void append(uint8_t source, int64_t arrivalNs, int64_t byteTimeNs, const char* data,
+                size_t length);
+
+private:
+    void dropOldest();
+
+    FlightRecordHeader* mHeader = nullptr;
+    uint8_t* mRing = nullptr;
+    size_t mMappedSize = 0;
+};
+
+// Reads a capture file back, oldest record first, from a read-only mapping. Meant for a capture
+// that is no longer written to: a recorder appending meanwhile may overwrite records before
+// they are read, and reading stops at the first one that no longer makes sense.
+class FlightRecording {
+public:
+    struct Record {
+        int64_t arrivalNs;
+        int64_t byteTimeNs;
+        uint8_t source;
+        const char* data;  // valid until close()
+        size_t length;
+    };
+
+    FlightRecording() = default;
+    ~FlightRecording() { close(); }
+    FlightRecording(const FlightRecording&) = delete;
+    FlightRecording& operator=(const FlightRecording&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    // Back to the oldest record.
+    void rewind();
+    // The next record, or false at the end.
+    bool next(Record& record);
+    uint64_t records() const { return mHeader ? mSnapshot.records : 0; }
+
+private:
+    const FlightRecordHeader* mHeader = nullptr;
+    const uint8_t* mRing = nullptr;
+    size_t mMappedSize = 0;
+    FlightRecordHeader mSnapshot{};  // the header as it was at open()
+    uint64_t mOffset = 0;
+    uint64_t mLeft = 0;  // bytes of mSnapshot.used not read yet
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "GeofenceIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+// Spherical earth: fences are at most a few hundred km, and the margins are metres.
+static constexpr double METERS_PER_DEGREE_LATITUDE = 6371000.0 * DEG_TO_RAD;
+static constexpr uint8_t ALL_TRANSITIONS =
+        GeofenceIndex::ENTERED | GeofenceIndex::EXITED | GeofenceIndex::UNCERTAIN;
+
+static bool isTransition(uint8_t value) {
+    return value == GeofenceIndex::ENTERED || value == GeofenceIndex::EXITED ||
+           value == GeofenceIndex::UNCERTAIN;
+}
+
+static int64_t cellOf(double degrees, double offset, double cell) {
+    return static_cast<int64_t>(std::floor((degrees + offset) / cell));
+}
+
+static int64_t lonCells(double cell) {
+    return std::llround(360.0 / cell);
+}
+
+static int64_t wrapLonCell(int64_t lonCell, int64_t count) {
+    lonCell %= count;
+    return lonCell < 0 ? lonCell + count : lonCell;
+}
+
+uint64_t GeofenceIndex::cellKey(int level, int64_t latCell, int64_t lonCell) {
+    return static_cast<uint64_t>(level) << 56 | (static_cast<uint64_t>(latCell) & 0xFFFFFFF) << 28 |
+           (static_cast<uint64_t>(lonCell) & 0xFFFFFFF);
+}
+
+int GeofenceIndex::levelFor(const Fence& fence) {
+    const double latExtent = fence.radius / METERS_PER_DEGREE_LATITUDE;
+    const double lonExtent = fence.radius / fence.metersPerDegreeLongitude;
+    // Around the poles and the size of a hemisphere a bounding box stops being one.
+    if (std::fabs(fence.latitude) + latExtent >= 90 || !(lonExtent < 90)) return -1;
+    for (int level = 0; level < LEVELS; level++) {
+        if (latExtent <= CELL_DEGREES[level] && lonExtent <= CELL_DEGREES[level]) return level;
+    }
+    return -1;
+}
+
+template <typename F>
+void GeofenceIndex::forEachCell(const Fence& fence, F&& f) {
+    const double cell = CELL_DEGREES[fence.level];
+    const double latExtent = fence.radius / METERS_PER_DEGREE_LATITUDE;
+    const double lonExtent = fence.radius / fence.metersPerDegreeLongitude;
+    const int64_t count = lonCells(cell);
+    for (int64_t lat = cellOf(fence.latitude - latExtent, 90, cell),
+                 latEnd = cellOf(fence.latitude + latExtent, 90, cell);
+         lat <= latEnd; lat++) {
+        for (int64_t lon = cellOf(fence.longitude - lonExtent, 180, cell),
+                     lonEnd = cellOf(fence.longitude + lonExtent, 180, cell);
+             lon <= lonEnd; lon++) {
+            f(cellKey(fence.level, lat, wrapLonCell(lon, count)));
+        }
+    }
+}
+
+GeofenceIndex::Status GeofenceIndex::add(int32_t id, double latitudeDegrees,
+                                         double longitudeDegrees, double radiusMeters,
+                                         uint8_t lastTransition, uint8_t monitorTransitions,
+                                         int32_t unknownTimerMs, int64_t timeMs) {
+    if (!(latitudeDegrees >= -90 && latitudeDegrees <= 90) ||
+        !(longitudeDegrees >= -180 && longitudeDegrees <= 180) || !(radiusMeters > 0) ||
+        !std::isfinite(radiusMeters)) {
+        return INVALID_ARGUMENT;
+    }
+    if (!isTransition(lastTransition) || monitorTransitions == 0 ||
+        (monitorTransitions & ~ALL_TRANSITIONS) != 0) {
+        return INVALID_TRANSITION;
+    }
+    if (mIds.count(id) != 0) return ID_EXISTS;
+    if (mIds.size() >= MAX_FENCES) return TOO_MANY;
+
+    uint32_t slot;
+    if (!mFree.empty()) {
+        slot = mFree.back();
+        mFree.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(mFences.size());
+        mFences.emplace_back();
+    }
+    Fence& fence = mFences[slot];
+    fence = Fence();
+    fence.id = id;
+    fence.latitude = latitudeDegrees;
+    fence.longitude = longitudeDegrees;
+    fence.radius = radiusMeters;
+    fence.metersPerDegreeLongitude =
+            METERS_PER_DEGREE_LATITUDE * std::cos(latitudeDegrees * DEG_TO_RAD);
+    fence.unknownTimerMs = std::max<int32_t>(unknownTimerMs, 0);
+    fence.startedMs = timeMs;
+    fence.monitor = monitorTransitions;
+    fence.state = static_cast<Transition>(lastTransition);
+    fence.used = true;
+    fence.level = static_cast<int8_t>(levelFor(fence));
+    if (fence.level < 0) {
+        mGlobal.push_back(slot);
+    } else {
+        forEachCell(fence, [this, slot](uint64_t key) { mCells[key].push_back(slot); });
+    }
+    mIds.emplace(id, slot);
+    mActive++;
+    schedule(slot);
+    // The next fix settles it, wherever it is.
+    track(slot);
+    return OK;
+}
+
+void GeofenceIndex::unlink(uint32_t slot) {
+    auto erase = [slot](std::vector<uint32_t>& slots) {
+        auto it = std::find(slots.begin(), slots.end(), slot);
+        if (it == slots.end()) return;
+        *it = slots.back();
+        slots.pop_back();
+    };
+    const Fence& fence = mFences[slot];
+    if (fence.level < 0) {
+        erase(mGlobal);
+        return;
+    }
+    forEachCell(fence, [this, &erase](uint64_t key) {
+        auto it = mCells.find(key);
+        if (it == mCells.end()) return;
+        erase(it->second);
+        if (it->second.empty()) mCells.erase(it);
+    });
+}
+
+GeofenceIndex::Status GeofenceIndex::remove(int32_t id) {
+    auto it = mIds.find(id);
+    if (it == mIds.end()) return ID_UNKNOWN;
+    const uint32_t slot = it->second;
+    unlink(slot);
+    Fence& fence = mFences[slot];
+    if (!fence.paused) {
+        mActive--;
+        unschedule(slot);
+    }
+    // Left in mTracked until the next update() skips it.
+    fence.used = false;
+    mFree.push_back(slot);
+    mIds.erase(it);
+    return OK;
+}
+
+GeofenceIndex::Status GeofenceIndex::pause(int32_t id) {
+    auto it = mIds.find(id);
+    if (it == mIds.end()) return ID_UNKNOWN;
+    Fence& fence = mFences[it->second];
+    if (!fence.paused) {
+        mActive--;
+        unschedule(it->second);
+    }
+    fence.paused = true;
+    return OK;
+}
+
+GeofenceIndex::Status GeofenceIndex::resume(int32_t id, uint8_t monitorTransitions,
+                                            int64_t timeMs) {
+    auto it = mIds.find(id);
+    if (it == mIds.end()) return ID_UNKNOWN;
+    if (monitorTransitions == 0 || (monitorTransitions & ~ALL_TRANSITIONS) != 0) {
+        return INVALID_TRANSITION;
+    }
+    Fence& fence = mFences[it->second];
+    if (fence.paused) mActive++;
+    fence.paused = false;
+    fence.monitor = monitorTransitions;
+    fence.undecidedSinceMs = NO_TIME;
+    fence.startedMs = timeMs;
+    schedule(it->second);
+    // Transitions while paused are reported on the next fix.
+    track(it->second);
+    return OK;
+}
+
+void GeofenceIndex::clear() {
+    mFences.clear();
+    mFree.clear();
+    mIds.clear();
+    mCells.clear();
+    mGlobal.clear();
+    mTracked.clear();
+    mActive = 0;
+    mByTimer.clear();
+    mStarted.clear();
+    mLastFixMs = NO_TIME;
+}
+
+void GeofenceIndex::track(uint32_t slot) {
+    // Duplicates are harmless: update() evaluates a fence once per fix.
+    mTracked.push_back(slot);
+}
+
+void GeofenceIndex::evaluate(uint32_t slot, double latitude, double longitude, double accuracy,
+                             int64_t timeMs, std::vector<Event>& events) {
+    Fence& fence = mFences[slot];
+    mStats.evaluations++;
+    double dLon = longitude - fence.longitude;
+    if (dLon > 180) dLon -= 360;
+    if (dLon < -180) dLon += 360;
+    const double north = (latitude - fence.latitude) * METERS_PER_DEGREE_LATITUDE;
+    const double east = dLon * fence.metersPerDegreeLongitude;
+    const double distance2 = north * north + east * east;
+
+    const double margin = std::min(std::max(accuracy, MIN_MARGIN_M), fence.radius / 2);
+    const double exitDistance = fence.radius + std::max(margin, accuracy);
+    const double enterDistance = fence.radius - margin;
+    Transition decided;
+    if (distance2 >= exitDistance * exitDistance) {
+        decided = EXITED;
+    } else if (accuracy <= fence.radius && distance2 <= enterDistance * enterDistance) {
+        decided = ENTERED;
+    } else {
+        if (fence.undecidedSinceMs == NO_TIME) fence.undecidedSinceMs = timeMs;
+        if (fence.state != UNCERTAIN && timeMs - fence.undecidedSinceMs >= fence.unknownTimerMs) {
+            fence.state = UNCERTAIN;
+            if (fence.monitor & UNCERTAIN) events.push_back({fence.id, UNCERTAIN});
+        }
+        return;
+    }
+    fence.undecidedSinceMs = NO_TIME;
+    if (fence.state == decided) return;
+    fence.state = decided;
+    if (fence.monitor & decided) events.push_back({fence.id, decided});
+}
+
+void GeofenceIndex::update(double latitudeDegrees, double longitudeDegrees, float accuracyMeters,
+                           int64_t timeMs, std::vector<Event>& events) {
+    mStats.fixes++;
+    mStamp++;
+    // Without an estimate, a typical consumer receiver's; it only sets the margins.
+    const double accuracy = accuracyMeters > 0 ? accuracyMeters : 2 * MIN_MARGIN_M;
+    mNextTracked.clear();
+    auto visit = [&](uint32_t slot) {
+        Fence& fence = mFences[slot];
+        if (!fence.used || fence.paused || fence.stamp == mStamp) return;
+        fence.stamp = mStamp;
+        evaluate(slot, latitudeDegrees, longitudeDegrees, accuracy, timeMs, events);
+        if (fence.state != EXITED || fence.undecidedSinceMs != NO_TIME) {
+            mNextTracked.push_back(slot);
+        }
+    };
+
+    for (uint32_t slot : mTracked) visit(slot);
+    for (uint32_t slot : mGlobal) visit(slot);
+    for (int level = 0; level < LEVELS; level++) {
+        const double cell = CELL_DEGREES[level];
+        auto it = mCells.find(cellKey(level, cellOf(latitudeDegrees, 90, cell),
+                                      wrapLonCell(cellOf(longitudeDegrees, 180, cell),
+                                                  lonCells(cell))));
+        if (it == mCells.end()) continue;
+        for (uint32_t slot : it->second) visit(slot);
+    }
+    mTracked.swap(mNextTracked);
+
+    mLastFixMs = timeMs;
+    mExpiryNext = {0, 0};
+    mStarted.clear();
+}
+
+int32_t GeofenceIndex::expiryTimerMs(const Fence& fence) {
+    return std::max(fence.unknownTimerMs, MIN_EXPIRY_MS);
+}
+
+void GeofenceIndex::schedule(uint32_t slot) {
+    const Fence& fence = mFences[slot];
+    mByTimer.insert({expiryTimerMs(fence), slot});
+    mStarted.push_back({fence.startedMs + expiryTimerMs(fence), fence.startedMs, slot});
+    std::push_heap(mStarted.begin(), mStarted.end(), laterDue);
+}
+
+void GeofenceIndex::unschedule(uint32_t slot) {
+    // A stale mStarted entry is recognised in expire().
+    mByTimer.erase({expiryTimerMs(mFences[slot]), slot});
+}
+
+void GeofenceIndex::makeUncertain(uint32_t slot, std::vector<Event>& events) {
+    Fence& fence = mFences[slot];
+    if (fence.state == UNCERTAIN) return;
+    fence.state = UNCERTAIN;
+    if (fence.monitor & UNCERTAIN) events.push_back({fence.id, UNCERTAIN});
+    // An exited fence is not evaluated everywhere; the next fix must settle this one.
+    track(slot);
+}
+
+void GeofenceIndex::expire(int64_t timeMs, std::vector<Event>& events) {
+    while (!mStarted.empty() && mStarted.front().dueMs <= timeMs) {
+        const Started started = mStarted.front();
+        std::pop_heap(mStarted.begin(), mStarted.end(), laterDue);
+        mStarted.pop_back();
+        const Fence& fence = mFences[started.slot];
+        if (fence.used && !fence.paused && fence.startedMs == started.startedMs &&
+            started.dueMs == fence.startedMs + expiryTimerMs(fence)) {
+            makeUncertain(started.slot, events);
+        }
+    }
+    if (mLastFixMs == NO_TIME) return;
+    for (auto it = mByTimer.lower_bound(mExpiryNext); it != mByTimer.end(); ++it) {
+        if (timeMs < mLastFixMs + it->first) break;
+        // Ones started since the fix are in mStarted.
+        if (mFences[it->second].startedMs <= mLastFixMs) makeUncertain(it->second, events);
+        mExpiryNext = {it->first, it->second + 1};
+    }
+}
+
+int64_t GeofenceIndex::nextExpiryMs() const {
+    int64_t nextMs = mStarted.empty() ? NO_TIME : mStarted.front().dueMs;
+    if (mLastFixMs == NO_TIME) return nextMs;
+    auto it = mByTimer.lower_bound(mExpiryNext);
+    if (it == mByTimer.end()) return nextMs;
+    const int64_t dueMs = mLastFixMs + it->first;
+    return nextMs == NO_TIME || dueMs < nextMs ? dueMs : nextMs;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
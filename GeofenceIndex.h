@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Circular geofences and their inside/outside state, evaluated against each fix.
+//
+// Fences are kept in a uniform lat/lon grid at three levels (about 870 m, 14 km and 220 km
+// cells at the equator); each fence is registered in the cells of the finest level where its
+// bounding box spans at most three cells a side, so at most nine. A fix looks up its own cell
+// at each level and evaluates only the fences there, plus the ones it was last inside of or
+// could not decide, which must be re-evaluated wherever the fix is to see them exited. The cost
+// of a fix therefore depends on the fences nearby, not on how many there are.
+//
+// Hysteresis: a fix enters a fence when it is inside by a margin of its accuracy (at least
+// MIN_MARGIN_M, at most half the radius) and exits when it is outside by the same margin or by
+// its full accuracy, whichever is more. A fix less accurate than the radius never enters. A
+// fence that no fix has decided for its unknown timer becomes UNCERTAIN: in update() when the
+// fixes cannot decide it, in expire() when they have stopped.
+//
+// A fix settles every fence, the ones it leaves alone as still exited, so expiry runs from the
+// last fix: fences are kept ordered by timer and expire() walks them once per gap in the fixes,
+// touching only the ones it makes UNCERTAIN. A fence added or resumed since the last fix runs
+// from then instead, from a heap.
+//
+// Not thread-safe; update() does not allocate once the containers have grown.
+class GeofenceIndex {
+public:
+    // Same values as IGnssGeofenceCallback.
+    enum Transition : uint8_t { ENTERED = 1, EXITED = 2, UNCERTAIN = 4 };
+    enum Status : uint8_t { OK, ID_EXISTS, ID_UNKNOWN, TOO_MANY, INVALID_TRANSITION, INVALID_ARGUMENT };
+
+    struct Event {
+        int32_t id;
+        Transition transition;
+    };
+
+    struct Stats {
+        uint64_t fixes = 0;
+        uint64_t evaluations = 0;  // fence distance checks, over all fixes
+    };
+
+    static constexpr size_t MAX_FENCES = 50000;
+    static constexpr double MIN_MARGIN_M = 5.0;
+    // expire() waits at least this long for a fix whatever the unknown timer, so a short timer
+    // does not expire fences between fixes.
+    static constexpr int32_t MIN_EXPIRY_MS = 3000;
+
+    // |lastTransition| is the state the client last saw; |monitorTransitions| the ones to report.
+    // The unknown timer runs from |timeMs| until a fix decides the fence.
+    Status add(int32_t id, double latitudeDegrees, double longitudeDegrees, double radiusMeters,
+               uint8_t lastTransition, uint8_t monitorTransitions, int32_t unknownTimerMs,
+               int64_t timeMs);
+    Status remove(int32_t id);
+    // A paused fence keeps its state but is not evaluated.
+    Status pause(int32_t id);
+    Status resume(int32_t id, uint8_t monitorTransitions, int64_t timeMs);
+    void clear();
+
+    // Evaluates the fences around a fix taken at |timeMs| and appends the monitored transitions
+    // to |events|. |accuracyMeters| <= 0 means unknown.
+    void update(double latitudeDegrees, double longitudeDegrees, float accuracyMeters,
+                int64_t timeMs, std::vector<Event>& events);
+    // Makes UNCERTAIN, as of |timeMs|, the fences whose unknown timer ran out without a fix, and
+    // appends the monitored transitions to |events|.
+    void expire(int64_t timeMs, std::vector<Event>& events);
+    // When expire() may next have a fence to give up on, -1 for none. Can be early, never late.
+    int64_t nextExpiryMs() const;
+
+    size_t size() const { return mIds.size(); }
+    // Fences that are not paused.
+    size_t activeCount() const { return mActive; }
+    const Stats& stats() const { return mStats; }
+
+private:
+    static constexpr int LEVELS = 3;
+    static constexpr double CELL_DEGREES[LEVELS] = {1.0 / 128, 1.0 / 8, 2.0};
+    static constexpr int32_t NO_TIME = -1;
+
+    struct Fence {
+        int32_t id = 0;
+        double latitude = 0;
+        double longitude = 0;
+        double radius = 0;
+        double metersPerDegreeLongitude = 0;
+        int32_t unknownTimerMs = 0;
+        int64_t undecidedSinceMs = NO_TIME;  // first of the fixes since the last decided
+        int64_t startedMs = NO_TIME;  // added or resumed
+        uint32_t stamp = 0;  // last update() that evaluated it
+        int8_t level = -1;   // grid level, -1 for the global list
+        uint8_t monitor = 0;
+        Transition state = UNCERTAIN;
+        bool used = false;
+        bool paused = false;
+    };
+
+    // Calls f(key) for every grid cell the fence's bounding box touches.
+    template <typename F>
+    static void forEachCell(const Fence& fence, F&& f);
+    static uint64_t cellKey(int level, int64_t latCell, int64_t lonCell);
+    static int levelFor(const Fence& fence);
+    static int32_t expiryTimerMs(const Fence& fence);
+
+    void evaluate(uint32_t slot, double latitude, double longitude, double accuracy,
+                  int64_t timeMs, std::vector<Event>& events);
+    void track(uint32_t slot);
+    void unlink(uint32_t slot);
+    // Adds a fence that is not paused to the expiry order, its timer running from |startedMs|.
+    void schedule(uint32_t slot);
+    void unschedule(uint32_t slot);
+    void makeUncertain(uint32_t slot, std::vector<Event>& events);
+
+    // (expiry timer, slot) of the fences that are not paused.
+    using TimerKey = std::pair<int32_t, uint32_t>;
+    // Added or resumed since the last fix, expiring at |dueMs| unless restarted since.
+    struct Started {
+        int64_t dueMs;
+        int64_t startedMs;
+        uint32_t slot;
+    };
+    static bool laterDue(const Started& a, const Started& b) { return a.dueMs > b.dueMs; }
+
+    std::vector<Fence> mFences;
+    std::vector<uint32_t> mFree;
+    std::unordered_map<int32_t, uint32_t> mIds;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> mCells;
+    std::vector<uint32_t> mGlobal;   // fences too large for any grid level
+    std::vector<uint32_t> mTracked;  // inside, uncertain or undecided: evaluated on every fix
+    std::vector<uint32_t> mNextTracked;
+    size_t mActive = 0;
+    uint32_t mStamp = 0;
+    Stats mStats;
+
+    std::set<TimerKey> mByTimer;
+    TimerKey mExpiryNext = {0, 0};  // first of mByTimer not yet expired since the last fix
+    std::vector<Started> mStarted;  // min-heap on dueMs
+    int64_t mLastFixMs = NO_TIME;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -6,28 +6,98 @@
 #define LOG_TAG "GnssHalRpi5"
 
 #include "Gnss.h"
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include <algorithm>
+#include <iterator>
 
 namespace aidl::android::hardware::gnss::implementation {
 
+// Only what is implemented: no satellite PVT or correlation vectors from these receivers.
+static constexpr int32_t CAPABILITIES =
+        IGnssCallback::CAPABILITY_SCHEDULING | IGnssCallback::CAPABILITY_GEOFENCING |
+        IGnssCallback::CAPABILITY_MEASUREMENTS | IGnssCallback::CAPABILITY_ACCUMULATED_DELTA_RANGE |
+        IGnssCallback::CAPABILITY_SATELLITE_BLOCKLIST;
+
 Gnss::Gnss()
-    : mCallback(nullptr),
-      mIsActive(false),
+    : mIsActive(false),
       mReportSvStatus(false),
       mReportNmea(false),
-      mMinIntervalMs(1000) {
+      mMinIntervalMs(1000),
+      mClientIntervalMs{} {
     LOG(INFO) << "GNSS HAL for Raspberry Pi 5 - Initializing";
-    mGnssConfiguration = ndk::SharedRefBase::make<GnssConfiguration>();
-    mGnssPowerIndication = ndk::SharedRefBase::make<GnssPowerIndication>();
-    mGnssMeasurement = ndk::SharedRefBase::make<GnssMeasurementInterface>();
+    mGnssConfiguration = ndk::SharedRefBase::make<GnssConfiguration>(
+        [this](const SvBlocklist& blocklist) {
+            if (mNmeaReader) mNmeaReader->setBlocklist(blocklist);
+        });
+    mGnssDebug = ndk::SharedRefBase::make<GnssDebug>();
+    mGnssPsds = ndk::SharedRefBase::make<GnssPsds>(
+        ::android::base::GetProperty("ro.vendor.gnss.psds_cache", DEFAULT_PSDS_CACHE),
+        [this](std::shared_ptr<const std::vector<uint8_t>> epo) {
+            if (mNmeaReader) mNmeaReader->setAssistanceData(std::move(epo));
+        });
+    mAidingStore = std::make_unique<AidingStore>(
+        ::android::base::GetProperty("ro.vendor.gnss.aiding_file", DEFAULT_AIDING_FILE));
+    // Board-specific draw in microwatts, for the energy estimates.
+    GnssPowerIndication::PowerModel powerModel;
+    auto powerProperty = [](const char* name, double defaultMw) {
+        return ::android::base::GetIntProperty(name, static_cast<int>(defaultMw * 1000)) / 1000.0;
+    };
+    powerModel.acquisitionMw = powerProperty("ro.vendor.gnss.acquisition_uw", powerModel.acquisitionMw);
+    powerModel.trackingMw = powerProperty("ro.vendor.gnss.tracking_uw", powerModel.trackingMw);
+    powerModel.standbyMw = powerProperty("ro.vendor.gnss.standby_uw", powerModel.standbyMw);
+    mGnssPowerIndication = ndk::SharedRefBase::make<GnssPowerIndication>(
+        [this]() { return mNmeaReader ? mNmeaReader->powerStats() : DutyCycle::Stats(); },
+        powerModel);
+    mGnssMeasurement = ndk::SharedRefBase::make<GnssMeasurementInterface>(
+        [this](bool enabled, int32_t intervalMs) {
+            if (mNmeaReader) mNmeaReader->setMeasurementOptions(enabled, intervalMs);
+        });
+
+    mGnssBatching = ndk::SharedRefBase::make<GnssBatching>(
+        [this](int32_t intervalMs) { return startEngineFor(BATCHING, intervalMs); },
+        [this]() { stopEngineFor(BATCHING); });
+    mGnssGeofence = ndk::SharedRefBase::make<GnssGeofence>(
+        [this](int32_t intervalMs) { return startEngineFor(GEOFENCING, intervalMs); },
+        [this]() { stopEngineFor(GEOFENCING); });
 
+    // Extra receivers, on their own UARTs, are listed after the primary. Any of them may be a
+    // pty or a capture replay instead (see ByteSource).
+    std::vector<std::string> devices;
+    for (const std::string& device : ::android::base::Split(
+                 ::android::base::GetProperty("ro.vendor.gnss.devices", "/dev/ttyAMA0"), ",")) {
+        std::string path = ::android::base::Trim(device);
+        if (!path.empty()) devices.push_back(std::move(path));
+    }
+    if (devices.empty()) devices.push_back("/dev/ttyAMA0");
     mNmeaReader = std::make_unique<NmeaReader>(
-        "/dev/ttyAMA0",
-        115200,
+        devices,
+        RECEIVER_UART_BAUD_RATE,
+        "/dev/pps0",
         [this](const GnssLocation& loc) { reportLocation(loc); },
-        [this](int64_t ts, const std::string& nmea) { reportNmea(ts, nmea); },
-        [this](const std::vector<GnssSvInfo>& sv) { reportSvStatus(sv); }
+        [this](int64_t ts, std::string_view nmea) { reportNmea(ts, nmea); },
+        [this](const std::vector<GnssSvInfo>& sv) { reportSvStatus(sv); },
+        [this](const GnssData& data) { reportMeasurement(data); }
     );
+    SvStatusFilter::Thresholds svThresholds;
+    svThresholds.cn0DeltaDbHz = static_cast<float>(::android::base::GetIntProperty(
+            "ro.vendor.gnss.sv_cn0_delta_db", static_cast<int>(svThresholds.cn0DeltaDbHz)));
+    svThresholds.refreshIntervalMs = ::android::base::GetIntProperty(
+            "ro.vendor.gnss.sv_refresh_ms", svThresholds.refreshIntervalMs);
+    mNmeaReader->setSvReportThresholds(svThresholds);
+    mNmeaReader->setPreferredBaudRate(
+            ::android::base::GetIntProperty("ro.vendor.gnss.uart_baud", DEFAULT_UART_BAUD_RATE));
+    // Seconds the receivers keep tracking between sessions, the reader kept open; -1 closes it.
+    const int keepWarmS = ::android::base::GetIntProperty("ro.vendor.gnss.keep_warm_s",
+                                                          DEFAULT_KEEP_WARM_S);
+    mNmeaReader->setKeepWarm(keepWarmS < 0 ? -1 : keepWarmS * 1000);
+    mNmeaReader->setCapture(::android::base::GetProperty("ro.vendor.gnss.capture", ""),
+                            static_cast<size_t>(::android::base::GetIntProperty(
+                                    "ro.vendor.gnss.capture_kb", DEFAULT_CAPTURE_KB)) * 1024);
 }
 
 Gnss::~Gnss() {
@@ -35,84 +105,185 @@ Gnss::~Gnss() {
 }
 
 ndk::ScopedAStatus Gnss::setCallback(const std::shared_ptr<IGnssCallback>& callback) {
-    std::lock_guard<std::mutex> lock(mMutex);
-    mCallback = callback;
-    if (mCallback != nullptr) {
-        int32_t capabilities =
-            static_cast<int32_t>(IGnssCallback::CAPABILITY_SCHEDULING) |
-            static_cast<int32_t>(IGnssCallback::CAPABILITY_SATELLITE_BLOCKLIST) |
-            static_cast<int32_t>(IGnssCallback::CAPABILITY_SATELLITE_PVT) |
-            static_cast<int32_t>(IGnssCallback::CAPABILITY_CORRELATION_VECTOR);
-
-        mCallback->gnssSetCapabilitiesCb(capabilities);
+    mCallback.set(callback);
+    if (callback != nullptr) {
+        callback->gnssSetCapabilitiesCb(CAPABILITIES);
 
         IGnssCallback::GnssSystemInfo systemInfo;
         systemInfo.yearOfHw = 2024;
         systemInfo.name = "Raspberry Pi 5 GNSS (LC29H)";
-        mCallback->gnssSetSystemInfoCb(systemInfo);
+        callback->gnssSetSystemInfoCb(systemInfo);
     }
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Gnss::close() {
     stop();
-    std::lock_guard<std::mutex> lock(mMutex);
-    mCallback = nullptr;
+    {
+        // Nobody to keep warm for.
+        std::lock_guard<std::mutex> lock(mSessionMutex);
+        if (mNmeaReader && !engineClientsActive()) mNmeaReader->stop();
+    }
+    mCallback.set(nullptr);
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Gnss::start() {
     LOG(INFO) << "Gnss::start() called";
-    if (mIsActive.load()) {
-        LOG(INFO) << "Already active";
-        return ndk::ScopedAStatus::ok();
-    }
     if (!mNmeaReader) {
         LOG(ERROR) << "mNmeaReader is NULL!";
         return ndk::ScopedAStatus::fromExceptionCode(EX_SERVICE_SPECIFIC);
     }
-    LOG(INFO) << "Calling NmeaReader->start()...";
-    if (mNmeaReader->start()) {
-        LOG(INFO) << "NmeaReader started OK";
+    {
+        std::lock_guard<std::mutex> lock(mSessionMutex);
+        if (mIsActive.load()) {
+            LOG(INFO) << "Already active";
+            return ndk::ScopedAStatus::ok();
+        }
+        mGnssPsds->onStart();
+        aidReceivers();
+        // Before the reader starts: a suspended one serves its latest fix at once.
         mIsActive.store(true);
-        std::lock_guard<std::mutex> lock(mMutex);
-        if (mCallback) {
-            mCallback->gnssStatusCb(IGnssCallback::GnssStatusValue::SESSION_BEGIN);
-            mCallback->gnssStatusCb(IGnssCallback::GnssStatusValue::ENGINE_ON);
+        updateReaderInterval();
+        if (!mNmeaReader->start()) {
+            LOG(ERROR) << "NmeaReader->start() FAILED!";
+            mIsActive.store(false);
+            updateReaderInterval();
+            return ndk::ScopedAStatus::fromExceptionCode(EX_SERVICE_SPECIFIC);
         }
-        return ndk::ScopedAStatus::ok();
+        LOG(INFO) << "NmeaReader started OK";
+    }
+    if (auto callback = mCallback.get()) {
+        callback->gnssStatusCb(IGnssCallback::GnssStatusValue::SESSION_BEGIN);
+        callback->gnssStatusCb(IGnssCallback::GnssStatusValue::ENGINE_ON);
     }
-    LOG(ERROR) << "NmeaReader->start() FAILED!";
-    return ndk::ScopedAStatus::fromExceptionCode(EX_SERVICE_SPECIFIC);
+    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Gnss::stop() {
-    if (!mIsActive.load()) return ndk::ScopedAStatus::ok();
-    if (mNmeaReader) mNmeaReader->stop();
-    mIsActive.store(false);
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mCallback) {
-        mCallback->gnssStatusCb(IGnssCallback::GnssStatusValue::ENGINE_OFF);
-        mCallback->gnssStatusCb(IGnssCallback::GnssStatusValue::SESSION_END);
+    {
+        std::lock_guard<std::mutex> lock(mSessionMutex);
+        if (!mIsActive.load()) return ndk::ScopedAStatus::ok();
+        // Reports check mIsActive without a lock: one already past the check may still
+        // arrive, but none starts after this.
+        mIsActive.store(false);
+        if (mNmeaReader && !engineClientsActive()) mNmeaReader->suspend();
+        updateReaderInterval();
+        mAidingStore->flush();
+    }
+    if (auto callback = mCallback.get()) {
+        callback->gnssStatusCb(IGnssCallback::GnssStatusValue::ENGINE_OFF);
+        callback->gnssStatusCb(IGnssCallback::GnssStatusValue::SESSION_END);
     }
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Gnss::setPositionMode(const PositionModeOptions& options) {
-    mMinIntervalMs = options.minIntervalMs;
-    if (mNmeaReader) mNmeaReader->setMinInterval(options.minIntervalMs);
+    mMinIntervalMs.store(options.minIntervalMs);
+    updateReaderInterval();
     return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Gnss::startSvStatus() { mReportSvStatus.store(true); return ndk::ScopedAStatus::ok(); }
-ndk::ScopedAStatus Gnss::stopSvStatus() { mReportSvStatus.store(false); return ndk::ScopedAStatus::ok(); }
+bool Gnss::startEngineFor(EngineClient client, int32_t intervalMs) {
+    std::lock_guard<std::mutex> lock(mSessionMutex);
+    mClientIntervalMs[client].store(std::max(intervalMs, 1));
+    updateReaderInterval();
+    mGnssPsds->onStart();
+    aidReceivers();
+    if (mNmeaReader && mNmeaReader->start()) return true;
+    mClientIntervalMs[client].store(0);
+    return false;
+}
+
+void Gnss::stopEngineFor(EngineClient client) {
+    std::lock_guard<std::mutex> lock(mSessionMutex);
+    mClientIntervalMs[client].store(0);
+    if (mNmeaReader && !mIsActive.load() && !engineClientsActive()) {
+        mNmeaReader->suspend();
+        mAidingStore->flush();
+    }
+    updateReaderInterval();
+}
+
+bool Gnss::engineClientsActive() const {
+    for (const auto& interval : mClientIntervalMs) {
+        if (interval.load() > 0) return true;
+    }
+    return false;
+}
+
+void Gnss::updateReaderInterval() {
+    if (!mNmeaReader) return;
+    const int32_t minIntervalMs = mMinIntervalMs.load();
+    int32_t interval = mIsActive.load() ? minIntervalMs : INT32_MAX;
+    for (const auto& client : mClientIntervalMs) {
+        const int32_t clientInterval = client.load();
+        if (clientInterval > 0) interval = std::min(interval, clientInterval);
+    }
+    mNmeaReader->setMinInterval(interval == INT32_MAX ? minIntervalMs : interval);
+}
+
+ndk::ScopedAStatus Gnss::startSvStatus() {
+    mReportSvStatus.store(true);
+    if (mNmeaReader) mNmeaReader->setSvStatusEnabled(true);
+    return ndk::ScopedAStatus::ok();
+}
+ndk::ScopedAStatus Gnss::stopSvStatus() {
+    mReportSvStatus.store(false);
+    if (mNmeaReader) mNmeaReader->setSvStatusEnabled(false);
+    return ndk::ScopedAStatus::ok();
+}
 ndk::ScopedAStatus Gnss::startNmea() { mReportNmea.store(true); return ndk::ScopedAStatus::ok(); }
 ndk::ScopedAStatus Gnss::stopNmea() { mReportNmea.store(false); return ndk::ScopedAStatus::ok(); }
 
-ndk::ScopedAStatus Gnss::injectTime(int64_t, int64_t, int32_t) { return ndk::ScopedAStatus::ok(); }
-ndk::ScopedAStatus Gnss::injectLocation(const GnssLocation&) { return ndk::ScopedAStatus::ok(); }
-ndk::ScopedAStatus Gnss::injectBestLocation(const GnssLocation&) { return ndk::ScopedAStatus::ok(); }
-ndk::ScopedAStatus Gnss::deleteAidingData(GnssAidingData) { return ndk::ScopedAStatus::ok(); }
+void Gnss::aidReceivers() {
+    if (!mNmeaReader) return;
+    ReceiverConfig::TimeAid time;
+    mNmeaReader->setTimeAid(mAidingStore->timeAid(time) ? &time : nullptr);
+    ReceiverConfig::PositionAid position;
+    mNmeaReader->setPositionAid(mAidingStore->positionAid(position) ? &position : nullptr);
+}
+
+// Injected data is kept for the next start as well as sent now; receivers with a fix ignore it.
+ndk::ScopedAStatus Gnss::injectTime(int64_t timeMs, int64_t timeReferenceMs,
+                                    int32_t uncertaintyMs) {
+    mAidingStore->onInjectedTime(timeMs, timeReferenceMs, uncertaintyMs);
+    aidReceivers();
+    return ndk::ScopedAStatus::ok();
+}
+ndk::ScopedAStatus Gnss::injectLocation(const GnssLocation& location) {
+    mAidingStore->onInjectedLocation(location);
+    aidReceivers();
+    return ndk::ScopedAStatus::ok();
+}
+ndk::ScopedAStatus Gnss::injectBestLocation(const GnssLocation& location) {
+    mAidingStore->onInjectedLocation(location);
+    aidReceivers();
+    return ndk::ScopedAStatus::ok();
+}
+
+// The receivers cannot forget one kind of data alone: the restart that discards at least what
+// was asked for. A warm start drops ephemeris only; anything else (almanac, position, time, but
+// also ionosphere, UTC, health and the rest) takes a cold one, which drops everything.
+ndk::ScopedAStatus Gnss::deleteAidingData(GnssAidingData aidingDataFlags) {
+    const int32_t flags = static_cast<int32_t>(aidingDataFlags);
+    auto has = [flags](GnssAidingData data) { return (flags & static_cast<int32_t>(data)) != 0; };
+    if (flags == 0) return ndk::ScopedAStatus::ok();
+    ReceiverConfig::Restart kind = ReceiverConfig::Restart::COLD;
+    const char* name = "cold";
+    if (flags == static_cast<int32_t>(GnssAidingData::EPHEMERIS)) {
+        kind = ReceiverConfig::Restart::WARM;
+        name = "warm";
+    }
+    LOG(INFO) << ::android::base::StringPrintf("Deleting aiding data 0x%x, %s start", flags, name);
+    mAidingStore->clear(has(GnssAidingData::POSITION), has(GnssAidingData::TIME));
+    if (mNmeaReader) {
+        // The remaining aids follow the restart.
+        aidReceivers();
+        mNmeaReader->restartReceivers(kind);
+    }
+    return ndk::ScopedAStatus::ok();
+}
 
 ndk::ScopedAStatus Gnss::getExtensionGnssConfiguration(std::shared_ptr<IGnssConfiguration>* r) {
     *r = mGnssConfiguration;
@@ -128,16 +299,16 @@ ndk::ScopedAStatus Gnss::getExtensionGnssMeasurement(std::shared_ptr<IGnssMeasur
 }
 
 ndk::ScopedAStatus Gnss::getExtensionPsds(std::shared_ptr<IGnssPsds>* r) {
-    *r = nullptr;
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    *r = mGnssPsds;
+    return ndk::ScopedAStatus::ok();
 }
 ndk::ScopedAStatus Gnss::getExtensionGnssBatching(std::shared_ptr<IGnssBatching>* r) {
-    *r = nullptr;
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    *r = mGnssBatching;
+    return ndk::ScopedAStatus::ok();
 }
 ndk::ScopedAStatus Gnss::getExtensionGnssGeofence(std::shared_ptr<IGnssGeofence>* r) {
-    *r = nullptr;
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    *r = mGnssGeofence;
+    return ndk::ScopedAStatus::ok();
 }
 ndk::ScopedAStatus Gnss::getExtensionGnssNavigationMessage(std::shared_ptr<IGnssNavigationMessageInterface>* r) {
     *r = nullptr;
@@ -152,8 +323,8 @@ ndk::ScopedAStatus Gnss::getExtensionAGnssRil(std::shared_ptr<IAGnssRil>* r) {
     return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
 }
 ndk::ScopedAStatus Gnss::getExtensionGnssDebug(std::shared_ptr<IGnssDebug>* r) {
-    *r = nullptr;
-    return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+    *r = mGnssDebug;
+    return ndk::ScopedAStatus::ok();
 }
 ndk::ScopedAStatus Gnss::getExtensionGnssAntennaInfo(std::shared_ptr<IGnssAntennaInfo>* r) {
     *r = nullptr;
@@ -168,19 +339,126 @@ ndk::ScopedAStatus Gnss::getExtensionMeasurementCorrections(std::shared_ptr<meas
     return ndk::ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
 }
 
+static void appendHistogram(std::string* out, const char* name,
+                            const LatencyHistogram::Snapshot& h) {
+    ::android::base::StringAppendF(out, "  %-22s %8llu %8lld %8lld %8lld %8lld %8lld\n", name,
+                                   static_cast<unsigned long long>(h.count),
+                                   static_cast<long long>(h.meanUs()),
+                                   static_cast<long long>(h.quantileUs(0.5)),
+                                   static_cast<long long>(h.quantileUs(0.9)),
+                                   static_cast<long long>(h.quantileUs(0.99)),
+                                   static_cast<long long>(h.maxNs / 1000));
+}
+
+binder_status_t Gnss::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
+    using ::android::base::StringAppendF;
+    static constexpr const char* SENTENCE_NAMES[] = {
+            "other", "GGA", "RMC", "GSV", "GSA", "VTG", "GNS", "GLL", "ZDA", "GST"};
+    static_assert(std::size(SENTENCE_NAMES) == static_cast<size_t>(SentenceType::COUNT),
+                  "A name for every SentenceType");
+
+    std::string out = "GNSS HAL for Raspberry Pi 5\n";
+    const char* session = mIsActive.load() ? "started" : "stopped";
+    if (!mIsActive.load() && mNmeaReader && mNmeaReader->suspended()) {
+        session = "stopped, reader kept warm";
+    }
+    StringAppendF(&out, "Session: %s, interval %d ms, batching %d ms, geofencing %d ms\n",
+                  session, mMinIntervalMs.load(),
+                  mClientIntervalMs[BATCHING].load(), mClientIntervalMs[GEOFENCING].load());
+    if (mNmeaReader) {
+        const NmeaReader::Metrics metrics = mNmeaReader->metrics();
+        for (const NmeaReader::Metrics::Input& input : metrics.inputs) {
+            StringAppendF(&out, "Input %s: %llu bytes, %llu errors\n", input.name.c_str(),
+                          static_cast<unsigned long long>(input.bytes),
+                          static_cast<unsigned long long>(input.errors));
+            StringAppendF(&out, "  NMEA: %llu sentences, %llu bad checksums, %llu truncated, "
+                          "%llu malformed\n",
+                          static_cast<unsigned long long>(input.nmea.sentences),
+                          static_cast<unsigned long long>(input.nmea.checksumErrors),
+                          static_cast<unsigned long long>(input.nmea.overflows),
+                          static_cast<unsigned long long>(input.nmea.malformed));
+            StringAppendF(&out, "  Binary: %llu frames, %llu bad checksums, %llu oversize\n",
+                          static_cast<unsigned long long>(input.binary.frames),
+                          static_cast<unsigned long long>(input.binary.checksumErrors),
+                          static_cast<unsigned long long>(input.binary.oversize));
+            StringAppendF(&out, "  EPO: %llu/%llu records, %llu uploads, %llu given up\n",
+                          static_cast<unsigned long long>(input.assistanceRecords),
+                          static_cast<unsigned long long>(input.assistanceTotal),
+                          static_cast<unsigned long long>(input.assistanceUploads),
+                          static_cast<unsigned long long>(input.assistanceFailures));
+        }
+        out += "Sentences:";
+        for (size_t i = 0; i < std::size(SENTENCE_NAMES); i++) {
+            StringAppendF(&out, " %s %llu", SENTENCE_NAMES[i],
+                          static_cast<unsigned long long>(metrics.sentences[i]));
+        }
+        out += "\n";
+        static constexpr const char* TTFF_NAMES[] = {"without EPO", "with EPO"};
+        for (size_t i = 0; i < std::size(TTFF_NAMES); i++) {
+            const NmeaReader::Metrics::TimeToFirstFix& ttff = metrics.ttff[i];
+            StringAppendF(&out, "TTFF %s: %llu sessions, last %lld ms, mean %lld ms, max %lld ms\n",
+                          TTFF_NAMES[i], static_cast<unsigned long long>(ttff.count),
+                          static_cast<long long>(ttff.lastMs), static_cast<long long>(ttff.meanMs),
+                          static_cast<long long>(ttff.maxMs));
+        }
+
+        const CallbackDispatcher::Stats dispatch = mNmeaReader->dispatchStats();
+        StringAppendF(&out, "Callbacks: NMEA queue %zu (high water %zu), %llu sentences dropped, "
+                      "%llu locations superseded, %llu SV status and %llu measurements coalesced\n",
+                      dispatch.nmeaQueueDepth, dispatch.nmeaQueueHighWater,
+                      static_cast<unsigned long long>(dispatch.nmeaDropped),
+                      static_cast<unsigned long long>(dispatch.locationsSuperseded),
+                      static_cast<unsigned long long>(dispatch.svStatusCoalesced),
+                      static_cast<unsigned long long>(dispatch.measurementsCoalesced));
+        // Percentiles are bucket upper bounds, powers of two.
+        StringAppendF(&out, "  %-22s %8s %8s %8s %8s %8s %8s\n", "us", "count", "mean", "p50",
+                      "p90", "p99", "max");
+        appendHistogram(&out, "read to NMEA", dispatch.nmeaLatency);
+        appendHistogram(&out, "read to location", dispatch.locationLatency);
+        appendHistogram(&out, "NMEA callback", dispatch.nmeaCallback);
+        appendHistogram(&out, "location callback", dispatch.locationCallback);
+        appendHistogram(&out, "SV status callback", dispatch.svStatusCallback);
+        appendHistogram(&out, "measurement callback", dispatch.measurementCallback);
+
+        const DutyCycle::Stats power = mNmeaReader->powerStats();
+        StringAppendF(&out, "Receiver: acquiring %lld ms, tracking %lld ms, standby %lld ms, "
+                      "%u wake-ups, lead %d ms\n",
+                      static_cast<long long>(power.timeInStateMs[DutyCycle::ACQUIRING]),
+                      static_cast<long long>(power.timeInStateMs[DutyCycle::TRACKING]),
+                      static_cast<long long>(power.timeInStateMs[DutyCycle::STANDBY]),
+                      power.wakeups, power.leadMs);
+    }
+    const GnssPsds::Status psds = mGnssPsds->status();
+    if (psds.bytes > 0) {
+        StringAppendF(&out, "PSDS: %zu bytes cached, valid %lld to %lld (Unix s)\n", psds.bytes,
+                      static_cast<long long>(psds.startUnixMs / 1000),
+                      static_cast<long long>(psds.endUnixMs / 1000));
+    } else {
+        out += "PSDS: none cached\n";
+    }
+    return ::android::base::WriteStringToFd(out, fd) ? STATUS_OK : STATUS_UNKNOWN_ERROR;
+}
+
+// Dispatcher thread. No locks: the callback is a snapshot, the rest atomics.
 void Gnss::reportLocation(const GnssLocation& location) {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mCallback && mIsActive.load()) mCallback->gnssLocationCb(location);
+    mGnssDebug->onLocation(location);
+    mAidingStore->onLocation(location);
+    if (mClientIntervalMs[BATCHING].load() > 0) mGnssBatching->reportLocation(location);
+    if (mClientIntervalMs[GEOFENCING].load() > 0) mGnssGeofence->reportLocation(location);
+    if (!mIsActive.load()) return;
+    if (auto callback = mCallback.get()) callback->gnssLocationCb(location);
 }
-void Gnss::reportNmea(int64_t timestamp, const std::string& nmea) {
-    if (!mReportNmea.load()) return;
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mCallback && mIsActive.load()) mCallback->gnssNmeaCb(timestamp, nmea);
+void Gnss::reportNmea(int64_t timestamp, std::string_view nmea) {
+    if (!mReportNmea.load() || !mIsActive.load()) return;
+    if (auto callback = mCallback.get()) callback->gnssNmeaCb(timestamp, std::string(nmea));
 }
 void Gnss::reportSvStatus(const std::vector<GnssSvInfo>& svInfoList) {
-    if (!mReportSvStatus.load()) return;
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mCallback && mIsActive.load()) mCallback->gnssSvStatusCb(svInfoList);
+    mGnssDebug->onSvStatus(svInfoList);
+    if (!mReportSvStatus.load() || !mIsActive.load()) return;
+    if (auto callback = mCallback.get()) callback->gnssSvStatusCb(svInfoList);
+}
+void Gnss::reportMeasurement(const GnssData& data) {
+    if (mIsActive.load()) mGnssMeasurement->reportMeasurement(data);
 }
 
 }
@@ -13,10 +13,17 @@
 #include <atomic>
 #include <mutex>
 #include <memory>
+#include <string_view>
 #include <vector>
 
+#include "AidingStore.h"
+#include "CallbackSlot.h"
+#include "GnssBatching.h"
 #include "GnssConfiguration.h"
+#include "GnssDebug.h"
+#include "GnssGeofence.h"
 #include "GnssPowerIndication.h"
+#include "GnssPsds.h"
 #include "GnssMeasurementInterface.h"
 #include "NmeaReader.h"
 
@@ -72,21 +79,55 @@ public:
     ndk::ScopedAStatus getExtensionMeasurementCorrections(
         std::shared_ptr<measurement_corrections::IMeasurementCorrectionsInterface>* _aidl_return) override;
 
+    // dumpsys: session state, per-receiver counters, callback latencies and power.
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
 private:
     void reportLocation(const GnssLocation& location);
-    void reportNmea(int64_t timestamp, const std::string& nmea);
+    void reportNmea(int64_t timestamp, std::string_view nmea);
     void reportSvStatus(const std::vector<GnssSvInfo>& svInfoList);
+    void reportMeasurement(const GnssData& data);
+    // Users of the engine besides the location session. The engine runs while any of them or
+    // the session needs it, at the fastest interval asked for.
+    enum EngineClient { BATCHING, GEOFENCING, ENGINE_CLIENT_COUNT };
+    bool startEngineFor(EngineClient client, int32_t intervalMs);
+    void stopEngineFor(EngineClient client);
+    bool engineClientsActive() const;
+    void updateReaderInterval();
+    // Hands the stored time and position to the receivers, as aiding.
+    void aidReceivers();
 
-    std::shared_ptr<IGnssCallback> mCallback;
+    // Read without a lock on every report; see CallbackSlot.
+    CallbackSlot<IGnssCallback> mCallback;
     std::shared_ptr<GnssConfiguration> mGnssConfiguration;
     std::shared_ptr<GnssPowerIndication> mGnssPowerIndication;
     std::shared_ptr<GnssMeasurementInterface> mGnssMeasurement;
+    std::shared_ptr<GnssBatching> mGnssBatching;
+    std::shared_ptr<GnssGeofence> mGnssGeofence;
+    std::shared_ptr<GnssDebug> mGnssDebug;
+    std::shared_ptr<GnssPsds> mGnssPsds;
+    std::unique_ptr<AidingStore> mAidingStore;  // fed by the reader's reports, so before it
     std::unique_ptr<NmeaReader> mNmeaReader;
-    std::mutex mMutex;
+    // Serialises starting and stopping the session and the engine. Never held across a
+    // callback, so control calls do not wait on the client and reports never wait at all:
+    // stopping the reader joins its thread but not the dispatcher's, which may be in one.
+    std::mutex mSessionMutex;
     std::atomic<bool> mIsActive;
     std::atomic<bool> mReportSvStatus;
     std::atomic<bool> mReportNmea;
-    int32_t mMinIntervalMs;
+    std::atomic<int32_t> mMinIntervalMs;
+    std::atomic<int32_t> mClientIntervalMs[ENGINE_CLIENT_COUNT];  // 0 while not in use
+
+    // The LC29H powers up at 115200, too slow for 10 Hz with satellites; the HAL moves it up.
+    static constexpr int RECEIVER_UART_BAUD_RATE = 115200;
+    static constexpr int DEFAULT_UART_BAUD_RATE = 460800;
+    // About an hour of 1 Hz output with satellites, or three minutes of a saturated 460800 link.
+    static constexpr int DEFAULT_CAPTURE_KB = 8192;
+    // Long enough to bridge the framework's back-to-back sessions, short enough that a receiver
+    // nobody uses is soon in standby.
+    static constexpr int DEFAULT_KEEP_WARM_S = 60;
+    static constexpr const char* DEFAULT_PSDS_CACHE = "/data/vendor/gnss/psds_long_term.bin";
+    static constexpr const char* DEFAULT_AIDING_FILE = "/data/vendor/gnss/aiding.bin";
 };
 
 }  // namespace aidl::android::hardware::gnss::implementation
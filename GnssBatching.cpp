@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssBatching"
+
+#include "GnssBatching.h"
+
+#include <android-base/logging.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr double EARTH_RADIUS_M = 6371000.0;
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+
+// Equirectangular: exact enough for the few metres a distance filter is about.
+static double distanceMeters(double lat1, double lon1, double lat2, double lon2) {
+    double dLon = lon2 - lon1;
+    if (dLon > 180) dLon -= 360;
+    if (dLon < -180) dLon += 360;
+    const double x = dLon * DEG_TO_RAD * std::cos((lat1 + lat2) / 2 * DEG_TO_RAD);
+    const double y = (lat2 - lat1) * DEG_TO_RAD;
+    return EARTH_RADIUS_M * std::hypot(x, y);
+}
+
+static BatchedFix toBatched(const GnssLocation& location) {
+    BatchedFix fix;
+    fix.flags = static_cast<uint8_t>(location.gnssLocationFlags);
+    fix.latitudeDegrees = location.latitudeDegrees;
+    fix.longitudeDegrees = location.longitudeDegrees;
+    fix.altitudeMeters = location.altitudeMeters;
+    fix.speedMetersPerSec = location.speedMetersPerSec;
+    fix.bearingDegrees = location.bearingDegrees;
+    fix.horizontalAccuracyMeters = static_cast<float>(location.horizontalAccuracyMeters);
+    fix.verticalAccuracyMeters = static_cast<float>(location.verticalAccuracyMeters);
+    fix.speedAccuracyMetersPerSecond = static_cast<float>(location.speedAccuracyMetersPerSecond);
+    fix.bearingAccuracyDegrees = static_cast<float>(location.bearingAccuracyDegrees);
+    fix.timestampMillis = location.timestampMillis;
+    fix.elapsedRealtimeNs = location.elapsedRealtime.timestampNs;
+    fix.timeUncertaintyNs = location.elapsedRealtime.timeUncertaintyNs;
+    return fix;
+}
+
+static GnssLocation toLocation(const BatchedFix& fix) {
+    GnssLocation location;
+    location.gnssLocationFlags = fix.flags;
+    location.latitudeDegrees = fix.latitudeDegrees;
+    location.longitudeDegrees = fix.longitudeDegrees;
+    location.altitudeMeters = fix.altitudeMeters;
+    location.speedMetersPerSec = fix.speedMetersPerSec;
+    location.bearingDegrees = fix.bearingDegrees;
+    location.horizontalAccuracyMeters = fix.horizontalAccuracyMeters;
+    location.verticalAccuracyMeters = fix.verticalAccuracyMeters;
+    location.speedAccuracyMetersPerSecond = fix.speedAccuracyMetersPerSecond;
+    location.bearingAccuracyDegrees = fix.bearingAccuracyDegrees;
+    location.timestampMillis = fix.timestampMillis;
+    location.elapsedRealtime.flags =
+            ElapsedRealtime::HAS_TIMESTAMP_NS | ElapsedRealtime::HAS_TIME_UNCERTAINTY_NS;
+    location.elapsedRealtime.timestampNs = fix.elapsedRealtimeNs;
+    location.elapsedRealtime.timeUncertaintyNs = fix.timeUncertaintyNs;
+    return location;
+}
+
+GnssBatching::GnssBatching(StartEngine startEngine, StopEngine stopEngine)
+    : mStartEngine(std::move(startEngine)), mStopEngine(std::move(stopEngine)) {}
+
+ndk::ScopedAStatus GnssBatching::init(const std::shared_ptr<IGnssBatchingCallback>& callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCallback = callback;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssBatching::getBatchSize(int32_t* size) {
+    *size = static_cast<int32_t>(FixBatch::GUARANTEED_FIXES);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssBatching::start(const Options& options) {
+    if (options.periodNanos < 0 || options.minDistanceMeters < 0) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    const int64_t periodNs = std::max(options.periodNanos, MIN_PERIOD_NS);
+    const bool wakeOnFull = (options.flags & IGnssBatching::WAKEUP_ON_FIFO_FULL) != 0;
+    {
+        // Restarting only changes the options; what is batched so far is kept.
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPeriodNs = periodNs;
+        mMinDistanceMeters = options.minDistanceMeters;
+        mWakeOnFull = wakeOnFull;
+        mActive = true;
+    }
+    LOG(INFO) << "Batching every " << periodNs / 1000000 << " ms, " << options.minDistanceMeters
+              << " m" << (wakeOnFull ? ", wake on full" : "");
+    if (!mStartEngine || !mStartEngine(static_cast<int32_t>(periodNs / 1000000))) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mActive = false;
+        return ndk::ScopedAStatus::fromExceptionCode(EX_SERVICE_SPECIFIC);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssBatching::flush() {
+    std::vector<GnssLocation> locations;
+    std::shared_ptr<IGnssBatchingCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        callback = mCallback;
+        drainLocked(locations);
+    }
+    if (callback == nullptr) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_STATE);
+    deliver(callback, locations);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssBatching::stop() {
+    bool wasActive;
+    {
+        // The batch survives stop() and is returned by the next flush().
+        std::lock_guard<std::mutex> lock(mMutex);
+        wasActive = mActive;
+        mActive = false;
+        mHasLast = false;
+    }
+    if (wasActive && mStopEngine) mStopEngine();
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssBatching::cleanup() {
+    stop();
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBatch.clear();
+    mCallback = nullptr;
+    return ndk::ScopedAStatus::ok();
+}
+
+void GnssBatching::reportLocation(const GnssLocation& location) {
+    std::vector<GnssLocation> full;
+    std::shared_ptr<IGnssBatchingCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mActive || !(location.gnssLocationFlags & GnssLocation::HAS_LAT_LONG)) return;
+        const int64_t timeNs = location.elapsedRealtime.timestampNs;
+        if (mHasLast) {
+            if (timeNs - mLastTimeNs < mPeriodNs - PERIOD_SLACK_NS) return;
+            if (mMinDistanceMeters > 0 &&
+                distanceMeters(mLastLatitude, mLastLongitude, location.latitudeDegrees,
+                               location.longitudeDegrees) < mMinDistanceMeters) {
+                return;
+            }
+        }
+        if (mBatch.full() && mWakeOnFull && mCallback != nullptr) {
+            callback = mCallback;
+            drainLocked(full);
+        }
+        mBatch.push(toBatched(location));
+        mHasLast = true;
+        mLastTimeNs = timeNs;
+        mLastLatitude = location.latitudeDegrees;
+        mLastLongitude = location.longitudeDegrees;
+    }
+    if (callback != nullptr) deliver(callback, full);
+}
+
+void GnssBatching::drainLocked(std::vector<GnssLocation>& out) {
+    out.reserve(out.size() + mBatch.size());
+    mBatch.drain([&out](const BatchedFix& fix) { out.push_back(toLocation(fix)); });
+}
+
+void GnssBatching::deliver(const std::shared_ptr<IGnssBatchingCallback>& callback,
+                           const std::vector<GnssLocation>& locations) {
+    if (!callback->gnssLocationBatchCb(locations).isOk()) {
+        LOG(WARNING) << "gnssLocationBatchCb failed, " << locations.size() << " fixes lost";
+    }
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
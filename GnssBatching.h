@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/gnss/BnGnssBatching.h>
+#include <aidl/android/hardware/gnss/GnssLocation.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FixBatch.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+using ::aidl::android::hardware::gnss::GnssLocation;
+
+// Fixes are collected in a FixBatch and handed over in one gnssLocationBatchCb, on flush() or,
+// with WAKEUP_ON_FIFO_FULL, when the batch fills up; otherwise the oldest fixes make room.
+// While batching, the engine runs even without a location session (see Gnss).
+class GnssBatching : public BnGnssBatching {
+public:
+    // Keeps the receiver running with fixes at least every |intervalMs|, and releases it.
+    using StartEngine = std::function<bool(int32_t intervalMs)>;
+    using StopEngine = std::function<void()>;
+
+    GnssBatching(StartEngine startEngine, StopEngine stopEngine);
+
+    ndk::ScopedAStatus init(const std::shared_ptr<IGnssBatchingCallback>& callback) override;
+    ndk::ScopedAStatus getBatchSize(int32_t* size) override;
+    ndk::ScopedAStatus start(const Options& options) override;
+    ndk::ScopedAStatus flush() override;
+    ndk::ScopedAStatus stop() override;
+    ndk::ScopedAStatus cleanup() override;
+
+    // Dispatcher thread, for every published location.
+    void reportLocation(const GnssLocation& location);
+
+private:
+    // The receiver's fastest rate.
+    static constexpr int64_t MIN_PERIOD_NS = 100000000;
+    // Fixes arrive on receiver epochs, so one a little early still counts as on time.
+    static constexpr int64_t PERIOD_SLACK_NS = 20000000;
+
+    // Moves the batch into |out|, oldest first. Called with mMutex held.
+    void drainLocked(std::vector<GnssLocation>& out);
+    void deliver(const std::shared_ptr<IGnssBatchingCallback>& callback,
+                 const std::vector<GnssLocation>& locations);
+
+    StartEngine mStartEngine;
+    StopEngine mStopEngine;
+
+    std::mutex mMutex;
+    std::shared_ptr<IGnssBatchingCallback> mCallback;
+    FixBatch mBatch;
+    bool mActive = false;
+    int64_t mPeriodNs = 0;
+    float mMinDistanceMeters = 0;
+    bool mWakeOnFull = false;
+    bool mHasLast = false;  // last batched fix, for the period and distance filters
+    int64_t mLastTimeNs = 0;
+    double mLastLatitude = 0;
+    double mLastLongitude = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -1 +1,20 @@
+#define LOG_TAG "GnssConfiguration"
+
 #include "GnssConfiguration.h"
+
+#include <android-base/logging.h>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Each call replaces the whole list; an empty one unblocks everything.
+ndk::ScopedAStatus GnssConfiguration::setBlocklist(const std::vector<BlocklistedSource>& blocklist) {
+    SvBlocklist converted;
+    for (const BlocklistedSource& source : blocklist) {
+        converted.add(static_cast<Constellation>(source.constellation), source.svid);
+    }
+    LOG(INFO) << "Blocklist of " << blocklist.size() << " sources";
+    if (mSink) mSink(converted);
+    return ndk::ScopedAStatus::ok();
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -1,14 +1,28 @@
 #pragma once
 #include <aidl/android/hardware/gnss/BnGnssConfiguration.h>
+
+#include <functional>
+
+#include "SvBlocklist.h"
+
 namespace aidl::android::hardware::gnss::implementation {
+// SUPL and the rest are for a modem-assisted receiver and are accepted and ignored. The
+// blocklist is converted and handed to |sink|, which takes it to the reader.
 class GnssConfiguration : public BnGnssConfiguration {
 public:
+    using Sink = std::function<void(const SvBlocklist&)>;
+
+    explicit GnssConfiguration(Sink sink) : mSink(std::move(sink)) {}
+
     ndk::ScopedAStatus setSuplVersion(int32_t) override { return ndk::ScopedAStatus::ok(); }
     ndk::ScopedAStatus setSuplMode(int32_t) override { return ndk::ScopedAStatus::ok(); }
     ndk::ScopedAStatus setLppProfile(int32_t) override { return ndk::ScopedAStatus::ok(); }
     ndk::ScopedAStatus setGlonassPositioningProtocol(int32_t) override { return ndk::ScopedAStatus::ok(); }
     ndk::ScopedAStatus setEmergencySuplPdn(bool) override { return ndk::ScopedAStatus::ok(); }
     ndk::ScopedAStatus setEsExtensionSec(int32_t) override { return ndk::ScopedAStatus::ok(); }
-    ndk::ScopedAStatus setBlocklist(const std::vector<BlocklistedSource>&) override { return ndk::ScopedAStatus::ok(); }
+    ndk::ScopedAStatus setBlocklist(const std::vector<BlocklistedSource>& blocklist) override;
+
+private:
+    const Sink mSink;
 };
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssDebug"
+
+#include "GnssDebug.h"
+
+#include <time.h>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+using GnssSvFlags = ::aidl::android::hardware::gnss::IGnssCallback::GnssSvFlags;
+
+static int64_t clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void GnssDebug::onLocation(const GnssLocation& location) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLocation = location;
+    mHaveLocation = true;
+}
+
+void GnssDebug::onSvStatus(const std::vector<GnssSvInfo>& svInfoList) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Assigned, not replaced, so the capacity is kept.
+    mSatellites.assign(svInfoList.begin(), svInfoList.end());
+}
+
+ndk::ScopedAStatus GnssDebug::getDebugData(DebugData* debugData) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    *debugData = DebugData();
+    PositionDebug& position = debugData->position;
+    TimeDebug& time = debugData->time;
+    if (mHaveLocation) {
+        const double ageSeconds = (clockNs(CLOCK_BOOTTIME) - mLocation.elapsedRealtime.timestampNs) / 1e9;
+        position.valid = true;
+        position.latitudeDegrees = mLocation.latitudeDegrees;
+        position.longitudeDegrees = mLocation.longitudeDegrees;
+        position.altitudeMeters = static_cast<float>(mLocation.altitudeMeters);
+        position.speedMetersPerSec = static_cast<float>(mLocation.speedMetersPerSec);
+        position.bearingDegrees = static_cast<float>(mLocation.bearingDegrees);
+        position.horizontalAccuracyMeters = mLocation.horizontalAccuracyMeters;
+        position.verticalAccuracyMeters = mLocation.verticalAccuracyMeters;
+        position.speedAccuracyMetersPerSecond = mLocation.speedAccuracyMetersPerSecond;
+        position.bearingAccuracyDegrees = mLocation.bearingAccuracyDegrees;
+        position.ageSeconds = static_cast<float>(ageSeconds);
+        // Receiver time carried forward on the local clock, which drifts meanwhile.
+        time.timeEstimateMs = mLocation.timestampMillis + static_cast<int64_t>(ageSeconds * 1000);
+        time.timeUncertaintyNs = static_cast<float>(mLocation.elapsedRealtime.timeUncertaintyNs +
+                                                    ageSeconds * FREQUENCY_UNCERTAINTY_NS_PER_S);
+    } else {
+        time.timeEstimateMs = clockNs(CLOCK_REALTIME) / 1000000;
+        time.timeUncertaintyNs = UNKNOWN_TIME_UNCERTAINTY_NS;
+    }
+    time.frequencyUncertaintyNsPerSec = FREQUENCY_UNCERTAINTY_NS_PER_S;
+
+    debugData->satelliteDataArray.reserve(mSatellites.size());
+    for (const GnssSvInfo& sv : mSatellites) {
+        // Signals of one satellite are listed once.
+        bool listed = false;
+        for (const SatelliteData& other : debugData->satelliteDataArray) {
+            listed |= other.svid == sv.svid && other.constellation == sv.constellation;
+        }
+        if (listed) continue;
+        SatelliteData satellite;
+        satellite.svid = sv.svid;
+        satellite.constellation = sv.constellation;
+        // Only what a fix proves: a satellite in it has a healthy ephemeris, decoded from the sky.
+        if (sv.svFlag & static_cast<int32_t>(GnssSvFlags::USED_IN_FIX)) {
+            satellite.ephemerisType = SatelliteEphemerisType::EPHEMERIS;
+            satellite.ephemerisHealth = SatelliteEphemerisHealth::GOOD;
+        }
+        debugData->satelliteDataArray.push_back(satellite);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
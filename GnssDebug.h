@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/gnss/BnGnssDebug.h>
+#include <aidl/android/hardware/gnss/GnssLocation.h>
+#include <aidl/android/hardware/gnss/IGnssCallback.h>
+
+#include <mutex>
+#include <vector>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+using ::aidl::android::hardware::gnss::GnssLocation;
+using GnssSvInfo = ::aidl::android::hardware::gnss::IGnssCallback::GnssSvInfo;
+
+// The last location and satellites the HAL reported, for bug reports. DebugData has no room for
+// counters or latencies; those are in the service's dump() (dumpsys).
+class GnssDebug : public BnGnssDebug {
+public:
+    // Dispatch thread. A copy under a lock that is only ever held for copies.
+    void onLocation(const GnssLocation& location);
+    void onSvStatus(const std::vector<GnssSvInfo>& svInfoList);
+
+    ndk::ScopedAStatus getDebugData(DebugData* debugData) override;
+
+private:
+    // The LC29H's TCXO, nominally; nothing measures its drift.
+    static constexpr float FREQUENCY_UNCERTAINTY_NS_PER_S = 500.0f;
+    // Reported for the time before any fix: the system clock, unsynchronised as far as we know.
+    static constexpr float UNKNOWN_TIME_UNCERTAINTY_NS = 1e9f;
+
+    std::mutex mMutex;
+    bool mHaveLocation = false;
+    GnssLocation mLocation;
+    std::vector<GnssSvInfo> mSatellites;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssGeofence"
+
+#include "GnssGeofence.h"
+
+#include <android-base/logging.h>
+#include <time.h>
+
+#include <chrono>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static_assert(GeofenceIndex::ENTERED == IGnssGeofenceCallback::ENTERED &&
+              GeofenceIndex::EXITED == IGnssGeofenceCallback::EXITED &&
+              GeofenceIndex::UNCERTAIN == IGnssGeofenceCallback::UNCERTAIN,
+              "GeofenceIndex transitions are passed through as is");
+
+static int64_t clockMs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+GnssGeofence::GnssGeofence(StartEngine startEngine, StopEngine stopEngine)
+    : mStartEngine(std::move(startEngine)), mStopEngine(std::move(stopEngine)) {
+    mTimerThread = std::thread(&GnssGeofence::timerThreadFunc, this);
+}
+
+GnssGeofence::~GnssGeofence() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mCondition.notify_one();
+    if (mTimerThread.joinable()) mTimerThread.join();
+}
+
+int32_t GnssGeofence::toCallbackStatus(GeofenceIndex::Status status) {
+    switch (status) {
+        case GeofenceIndex::OK: return IGnssGeofenceCallback::OPERATION_SUCCESS;
+        case GeofenceIndex::ID_EXISTS: return IGnssGeofenceCallback::ERROR_ID_EXISTS;
+        case GeofenceIndex::ID_UNKNOWN: return IGnssGeofenceCallback::ERROR_ID_UNKNOWN;
+        case GeofenceIndex::TOO_MANY: return IGnssGeofenceCallback::ERROR_TOO_MANY_GEOFENCES;
+        case GeofenceIndex::INVALID_TRANSITION:
+            return IGnssGeofenceCallback::ERROR_INVALID_TRANSITION;
+        case GeofenceIndex::INVALID_ARGUMENT: break;
+    }
+    return IGnssGeofenceCallback::ERROR_GENERIC;
+}
+
+std::shared_ptr<IGnssGeofenceCallback> GnssGeofence::callback() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCallback;
+}
+
+ndk::ScopedAStatus GnssGeofence::setCallback(
+        const std::shared_ptr<IGnssGeofenceCallback>& callback) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCallback = callback;
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssGeofence::addGeofence(int32_t geofenceId, double latitudeDegrees,
+                                             double longitudeDegrees, double radiusMeters,
+                                             int32_t lastTransition, int32_t monitorTransitions,
+                                             int32_t notificationResponsivenessMs,
+                                             int32_t unknownTimerMs) {
+    // Every fix is evaluated, so responsiveness is the fix interval whatever is asked for.
+    (void)notificationResponsivenessMs;
+    GeofenceIndex::Status status;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        status = lastTransition < 0 || lastTransition > UINT8_MAX || monitorTransitions < 0 ||
+                                 monitorTransitions > UINT8_MAX
+                         ? GeofenceIndex::INVALID_TRANSITION
+                         : mIndex.add(geofenceId, latitudeDegrees, longitudeDegrees, radiusMeters,
+                                      static_cast<uint8_t>(lastTransition),
+                                      static_cast<uint8_t>(monitorTransitions), unknownTimerMs,
+                                      clockMs(CLOCK_BOOTTIME));
+    }
+    mCondition.notify_one();
+    if (status != GeofenceIndex::OK) {
+        LOG(WARNING) << "Geofence " << geofenceId << " not added: " << static_cast<int>(status);
+    }
+    updateEngine();
+    if (auto cb = callback()) cb->gnssGeofenceAddCb(geofenceId, toCallbackStatus(status));
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssGeofence::pauseGeofence(int32_t geofenceId) {
+    GeofenceIndex::Status status;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        status = mIndex.pause(geofenceId);
+    }
+    updateEngine();
+    if (auto cb = callback()) cb->gnssGeofencePauseCb(geofenceId, toCallbackStatus(status));
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssGeofence::resumeGeofence(int32_t geofenceId, int32_t monitorTransitions) {
+    GeofenceIndex::Status status;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        status = monitorTransitions < 0 || monitorTransitions > UINT8_MAX
+                         ? GeofenceIndex::INVALID_TRANSITION
+                         : mIndex.resume(geofenceId, static_cast<uint8_t>(monitorTransitions),
+                                         clockMs(CLOCK_BOOTTIME));
+    }
+    mCondition.notify_one();
+    updateEngine();
+    if (auto cb = callback()) cb->gnssGeofenceResumeCb(geofenceId, toCallbackStatus(status));
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssGeofence::removeGeofence(int32_t geofenceId) {
+    GeofenceIndex::Status status;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        status = mIndex.remove(geofenceId);
+    }
+    updateEngine();
+    if (auto cb = callback()) cb->gnssGeofenceRemoveCb(geofenceId, toCallbackStatus(status));
+    return ndk::ScopedAStatus::ok();
+}
+
+void GnssGeofence::updateEngine() {
+    std::lock_guard<std::mutex> engineLock(mEngineMutex);
+    bool wanted;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        wanted = mIndex.activeCount() > 0;
+    }
+    if (wanted == mEngineRunning) return;
+    if (wanted) {
+        mEngineRunning = mStartEngine && mStartEngine(ENGINE_INTERVAL_MS);
+        if (!mEngineRunning) LOG(ERROR) << "Engine did not start, geofences not monitored";
+    } else {
+        if (mStopEngine) mStopEngine();
+        mEngineRunning = false;
+    }
+}
+
+void GnssGeofence::reportLocation(const GnssLocation& location) {
+    if (!(location.gnssLocationFlags & GnssLocation::HAS_LAT_LONG)) return;
+    std::shared_ptr<IGnssGeofenceCallback> callback;
+    std::lock_guard<std::mutex> reportLock(mReportMutex);
+    mEvents.clear();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLastLocation = location;
+        if (mIndex.activeCount() == 0) return;
+        const float accuracy = (location.gnssLocationFlags & GnssLocation::HAS_HORIZONTAL_ACCURACY)
+                ? static_cast<float>(location.horizontalAccuracyMeters)
+                : 0.0f;
+        mIndex.update(location.latitudeDegrees, location.longitudeDegrees, accuracy,
+                      location.elapsedRealtime.timestampNs / 1000000, mEvents);
+        callback = mCallback;
+    }
+    if (callback == nullptr) return;
+    for (const auto& event : mEvents) {
+        callback->gnssGeofenceTransitionCb(event.id, location, event.transition,
+                                           location.timestampMillis);
+    }
+}
+
+void GnssGeofence::timerThreadFunc() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        if (mQuit) return;
+        const int64_t nowMs = clockMs(CLOCK_BOOTTIME);
+        const int64_t dueMs = mIndex.nextExpiryMs();
+        if (dueMs < 0) {
+            mCondition.wait(lock);
+            continue;
+        }
+        if (nowMs < dueMs) {
+            mCondition.wait_for(lock, std::chrono::milliseconds(dueMs - nowMs));
+            continue;
+        }
+        // Fixes may have decided the fences meanwhile: expire() looks again under both locks.
+        lock.unlock();
+        std::lock_guard<std::mutex> reportLock(mReportMutex);
+        lock.lock();
+        mEvents.clear();
+        mIndex.expire(clockMs(CLOCK_BOOTTIME), mEvents);
+        if (mEvents.empty() || mCallback == nullptr) continue;
+        const std::shared_ptr<IGnssGeofenceCallback> callback = mCallback;
+        const GnssLocation location = mLastLocation;
+        lock.unlock();
+        // No fix to take the time from: the transition is as of now.
+        const int64_t timestampMs = clockMs(CLOCK_REALTIME);
+        LOG(INFO) << mEvents.size() << " geofence(s) uncertain, no fix for their unknown timer";
+        for (const auto& event : mEvents) {
+            callback->gnssGeofenceTransitionCb(event.id, location, event.transition, timestampMs);
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/gnss/BnGnssGeofence.h>
+#include <aidl/android/hardware/gnss/GnssLocation.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "GeofenceIndex.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+using ::aidl::android::hardware::gnss::GnssLocation;
+
+// Geofences evaluated in the HAL on every published location (see GeofenceIndex), so clients
+// get transitions without location updates of their own. The engine runs while any fence is
+// monitored, whether or not there is a location session. A timer thread makes fences UNCERTAIN
+// once their unknown timer runs out with no fix at all, which no location would report.
+class GnssGeofence : public BnGnssGeofence {
+public:
+    // As GnssBatching's.
+    using StartEngine = std::function<bool(int32_t intervalMs)>;
+    using StopEngine = std::function<void()>;
+
+    GnssGeofence(StartEngine startEngine, StopEngine stopEngine);
+    ~GnssGeofence();
+
+    ndk::ScopedAStatus setCallback(const std::shared_ptr<IGnssGeofenceCallback>& callback) override;
+    ndk::ScopedAStatus addGeofence(int32_t geofenceId, double latitudeDegrees,
+                                   double longitudeDegrees, double radiusMeters,
+                                   int32_t lastTransition, int32_t monitorTransitions,
+                                   int32_t notificationResponsivenessMs,
+                                   int32_t unknownTimerMs) override;
+    ndk::ScopedAStatus pauseGeofence(int32_t geofenceId) override;
+    ndk::ScopedAStatus resumeGeofence(int32_t geofenceId, int32_t monitorTransitions) override;
+    ndk::ScopedAStatus removeGeofence(int32_t geofenceId) override;
+
+    // Dispatcher thread, for every published location.
+    void reportLocation(const GnssLocation& location);
+
+private:
+    // Fences are for "am I there yet", not navigation: one fix a second is plenty.
+    static constexpr int32_t ENGINE_INTERVAL_MS = 1000;
+
+    static int32_t toCallbackStatus(GeofenceIndex::Status status);
+    // Starts or stops the engine to match whether any fence is active.
+    void updateEngine();
+    std::shared_ptr<IGnssGeofenceCallback> callback();
+    void timerThreadFunc();
+
+    StartEngine mStartEngine;
+    StopEngine mStopEngine;
+
+    // Held from evaluating the fences to the last transition callback, so the client sees
+    // transitions in the order they were decided, by a location or by the timer.
+    std::mutex mReportMutex;
+    std::vector<GeofenceIndex::Event> mEvents;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;  // fences added or resumed, or quitting
+    std::shared_ptr<IGnssGeofenceCallback> mCallback;
+    GeofenceIndex mIndex;
+    GnssLocation mLastLocation;  // reported with the timer's transitions
+    bool mQuit = false;
+
+    // Serialises engine changes, which are not made under mMutex: they start and stop the
+    // reader under the session lock, and reportLocation() should never wait on that.
+    std::mutex mEngineMutex;
+    bool mEngineRunning = false;
+
+    std::thread mTimerThread;  // last, started once the rest is set up
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
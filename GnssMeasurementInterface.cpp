@@ -1 +1,53 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssMeasurement"
+
 #include "GnssMeasurementInterface.h"
+
+#include <android-base/logging.h>
+
+#include <algorithm>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+GnssMeasurementInterface::GnssMeasurementInterface(ActivationCallback onActivation)
+    : mOnActivation(std::move(onActivation)) {}
+
+ndk::ScopedAStatus GnssMeasurementInterface::setCallback(
+        const std::shared_ptr<IGnssMeasurementCallback>& callback, bool enableFullTracking,
+        bool enableCorrVecOutputs) {
+    Options options;
+    options.enableFullTracking = enableFullTracking;
+    options.enableCorrVecOutputs = enableCorrVecOutputs;
+    options.intervalMs = DEFAULT_INTERVAL_MS;
+    return setCallbackWithOptions(callback, options);
+}
+
+ndk::ScopedAStatus GnssMeasurementInterface::setCallbackWithOptions(
+        const std::shared_ptr<IGnssMeasurementCallback>& callback, const Options& options) {
+    if (callback == nullptr) return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    const int32_t intervalMs = std::max(options.intervalMs, 0);
+    LOG(INFO) << "Measurements every " << intervalMs << " ms"
+              << (options.enableCorrVecOutputs ? ", correlation vectors not supported" : "");
+    mCallback.set(callback);
+    if (mOnActivation) mOnActivation(true, intervalMs);
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssMeasurementInterface::close() {
+    mCallback.set(nullptr);
+    if (mOnActivation) mOnActivation(false, 0);
+    return ndk::ScopedAStatus::ok();
+}
+
+void GnssMeasurementInterface::reportMeasurement(const GnssData& data) {
+    // A snapshot: close() never waits for a slow client, nor this for close().
+    std::shared_ptr<IGnssMeasurementCallback> callback = mCallback.get();
+    if (callback == nullptr) return;
+    if (!callback->gnssMeasurementCb(data).isOk()) LOG(WARNING) << "gnssMeasurementCb failed";
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
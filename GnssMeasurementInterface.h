@@ -6,23 +6,42 @@
 #pragma once
 
 #include <aidl/android/hardware/gnss/BnGnssMeasurementInterface.h>
+#include <aidl/android/hardware/gnss/GnssData.h>
+
+#include <functional>
+#include <memory>
+
+#include "CallbackSlot.h"
 
 namespace aidl::android::hardware::gnss::implementation {
 
+// Raw measurements decoded by the reader (RTCM 3 MSM or UBX-RXM-RAWX). Registering a callback
+// turns the receiver's raw output on and closing turns it off again; the reader builds each
+// epoch's GnssData in a reused buffer and delivers it from the dispatcher thread.
+//
+// Correlation vectors and full tracking are not available from these receivers; the options
+// are accepted and ignored, as the capabilities in Gnss::setCallback() say.
 class GnssMeasurementInterface : public BnGnssMeasurementInterface {
 public:
-    ndk::ScopedAStatus setCallback(
-        const std::shared_ptr<IGnssMeasurementCallback>&, bool, bool) override {
-        return ndk::ScopedAStatus::ok();
-    }
-    
-    // New method required by AIDL V3+
+    // Called with the requested state and minimum report interval (0: every epoch).
+    using ActivationCallback = std::function<void(bool enabled, int32_t intervalMs)>;
+
+    explicit GnssMeasurementInterface(ActivationCallback onActivation);
+
+    ndk::ScopedAStatus setCallback(const std::shared_ptr<IGnssMeasurementCallback>& callback,
+                                   bool enableFullTracking, bool enableCorrVecOutputs) override;
     ndk::ScopedAStatus setCallbackWithOptions(
-        const std::shared_ptr<IGnssMeasurementCallback>&, const Options&) override {
-        return ndk::ScopedAStatus::ok();
-    }
-    
-    ndk::ScopedAStatus close() override { return ndk::ScopedAStatus::ok(); }
+            const std::shared_ptr<IGnssMeasurementCallback>& callback, const Options& options) override;
+    ndk::ScopedAStatus close() override;
+
+    // Dispatcher thread.
+    void reportMeasurement(const GnssData& data);
+
+private:
+    static constexpr int32_t DEFAULT_INTERVAL_MS = 1000;
+
+    ActivationCallback mOnActivation;
+    CallbackSlot<IGnssMeasurementCallback> mCallback;
 };
 
 }  // namespace aidl::android::hardware::gnss::implementation
@@ -1 +1,68 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssPowerIndication"
+
 #include "GnssPowerIndication.h"
+
+#include <android-base/logging.h>
+#include <time.h>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static int64_t boottimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+GnssPowerIndication::GnssPowerIndication(StatsSource statsSource, const PowerModel& model)
+    : mStatsSource(std::move(statsSource)), mModel(model) {}
+
+ndk::ScopedAStatus GnssPowerIndication::setCallback(
+        const std::shared_ptr<IGnssPowerIndicationCallback>& callback) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCallback = callback;
+    }
+    if (callback != nullptr) {
+        callback->setCapabilitiesCb(IGnssPowerIndicationCallback::CAPABILITY_TOTAL |
+                                    IGnssPowerIndicationCallback::CAPABILITY_MULTIBAND_TRACKING |
+                                    IGnssPowerIndicationCallback::CAPABILITY_MULTIBAND_ACQUISITION |
+                                    IGnssPowerIndicationCallback::CAPABILITY_OTHER_MODES);
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssPowerIndication::requestGnssPowerStats() {
+    std::shared_ptr<IGnssPowerIndicationCallback> callback;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        callback = mCallback;
+    }
+    if (callback == nullptr) return ndk::ScopedAStatus::ok();
+
+    const DutyCycle::Stats stats = mStatsSource ? mStatsSource() : DutyCycle::Stats();
+    // mW times ms is uJ.
+    auto energyMj = [&stats](DutyCycle::State state, double powerMw) {
+        return powerMw * static_cast<double>(stats.timeInStateMs[state]) / 1000.0;
+    };
+    GnssPowerStats powerStats;
+    powerStats.elapsedRealtime.flags = ElapsedRealtime::HAS_TIMESTAMP_NS;
+    powerStats.elapsedRealtime.timestampNs = boottimeNs();
+    powerStats.multibandAcquisitionModeEnergyMilliJoule =
+            energyMj(DutyCycle::ACQUIRING, mModel.acquisitionMw);
+    powerStats.multibandTrackingModeEnergyMilliJoule =
+            energyMj(DutyCycle::TRACKING, mModel.trackingMw);
+    const double standbyMj = energyMj(DutyCycle::STANDBY, mModel.standbyMw) +
+                             energyMj(DutyCycle::OFF, mModel.standbyMw);
+    powerStats.otherModesEnergyMilliJoule = {standbyMj};
+    powerStats.totalEnergyMilliJoule = powerStats.multibandAcquisitionModeEnergyMilliJoule +
+                                       powerStats.multibandTrackingModeEnergyMilliJoule + standbyMj;
+    callback->gnssPowerStatsCb(powerStats);
+    return ndk::ScopedAStatus::ok();
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -1,9 +1,46 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
 #pragma once
+
 #include <aidl/android/hardware/gnss/BnGnssPowerIndication.h>
+#include <aidl/android/hardware/gnss/GnssPowerStats.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "DutyCycle.h"
+
 namespace aidl::android::hardware::gnss::implementation {
+
+// Energy estimated from the time the receiver spent in each DutyCycle state and its draw in
+// that state: nothing on the board measures it. The LC29H is dual-band, so acquisition and
+// tracking are reported as multiband; standby, and off while the HAL is stopped, are the one
+// other mode.
 class GnssPowerIndication : public BnGnssPowerIndication {
 public:
-    ndk::ScopedAStatus setCallback(const std::shared_ptr<IGnssPowerIndicationCallback>&) override { return ndk::ScopedAStatus::ok(); }
-    ndk::ScopedAStatus requestGnssPowerStats() override { return ndk::ScopedAStatus::ok(); }
+    // Receiver draw per state. Defaults are nominal LC29H figures at 3.3 V.
+    struct PowerModel {
+        double acquisitionMw = 132.0;
+        double trackingMw = 122.0;
+        double standbyMw = 3.3;
+    };
+    using StatsSource = std::function<DutyCycle::Stats()>;
+
+    GnssPowerIndication(StatsSource statsSource, const PowerModel& model);
+
+    ndk::ScopedAStatus setCallback(
+            const std::shared_ptr<IGnssPowerIndicationCallback>& callback) override;
+    ndk::ScopedAStatus requestGnssPowerStats() override;
+
+private:
+    StatsSource mStatsSource;
+    const PowerModel mModel;
+    std::mutex mMutex;
+    std::shared_ptr<IGnssPowerIndicationCallback> mCallback;
 };
-}
+
+}  // namespace aidl::android::hardware::gnss::implementation
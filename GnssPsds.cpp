@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssPsds"
+
+#include "GnssPsds.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <errno.h>
+#include <time.h>
+
+#include <cstring>
+
+#include "AtomicFile.h"
+#include "EpoUploader.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static int64_t realtimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+GnssPsds::GnssPsds(std::string cachePath, Sink sink)
+    : mCachePath(std::move(cachePath)), mSink(std::move(sink)) {}
+
+ndk::ScopedAStatus GnssPsds::injectPsdsData(PsdsType psdsType, const std::vector<uint8_t>& data) {
+    if (psdsType != PsdsType::LONG_TERM) {
+        LOG(WARNING) << "Only long-term PSDS is supported, not type "
+                     << static_cast<int32_t>(psdsType);
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    int64_t startUnixMs, endUnixMs;
+    if (!EpoUploader::validity(data.data(), data.size(), startUnixMs, endUnixMs)) {
+        LOG(WARNING) << "Injected PSDS is not EPO (" << data.size() << " bytes)";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+    if (endUnixMs <= realtimeMs()) {
+        LOG(WARNING) << "Injected PSDS ran out " << (realtimeMs() - endUnixMs) / 1000 << " s ago";
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    auto epo = std::make_shared<const std::vector<uint8_t>>(data);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Still used if it cannot be kept: the receivers have it until they are power-cycled.
+        if (!writeFileAtomically(mCachePath, epo->data(), epo->size())) {
+            LOG(WARNING) << "Cannot cache PSDS in " << mCachePath << ": " << strerror(errno);
+        }
+        mLoaded = true;
+        mData = epo;
+        mStartUnixMs = startUnixMs;
+        mEndUnixMs = endUnixMs;
+    }
+    LOG(INFO) << "PSDS injected, " << data.size() << " bytes, valid for "
+              << (endUnixMs - realtimeMs()) / 3600000 << " h";
+    mSink(std::move(epo));
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus GnssPsds::setCallback(const std::shared_ptr<IGnssPsdsCallback>& callback) {
+    bool download;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCallback = callback;
+        loadLocked();
+        download = needsDownloadLocked(realtimeMs());
+    }
+    if (callback != nullptr && download) callback->downloadRequestCb(PsdsType::LONG_TERM);
+    return ndk::ScopedAStatus::ok();
+}
+
+void GnssPsds::onStart() {
+    std::shared_ptr<const std::vector<uint8_t>> epo;
+    std::shared_ptr<IGnssPsdsCallback> callback;
+    bool download;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        loadLocked();
+        const int64_t nowUnixMs = realtimeMs();
+        if (mData != nullptr && mEndUnixMs <= nowUnixMs) {
+            LOG(INFO) << "Cached PSDS has run out";
+            mData.reset();
+        }
+        epo = mData;
+        callback = mCallback;
+        download = needsDownloadLocked(nowUnixMs);
+    }
+    mSink(std::move(epo));
+    if (callback != nullptr && download) callback->downloadRequestCb(PsdsType::LONG_TERM);
+}
+
+GnssPsds::Status GnssPsds::status() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    Status status;
+    if (mData != nullptr) {
+        status.bytes = mData->size();
+        status.startUnixMs = mStartUnixMs;
+        status.endUnixMs = mEndUnixMs;
+    }
+    return status;
+}
+
+void GnssPsds::loadLocked() {
+    if (mLoaded) return;
+    mLoaded = true;
+    std::string contents;
+    if (!::android::base::ReadFileToString(mCachePath, &contents)) return;
+    auto epo = std::make_shared<const std::vector<uint8_t>>(contents.begin(), contents.end());
+    if (!EpoUploader::validity(epo->data(), epo->size(), mStartUnixMs, mEndUnixMs)) {
+        LOG(WARNING) << "Ignoring " << mCachePath << ", not EPO";
+        return;
+    }
+    mData = std::move(epo);
+    LOG(INFO) << "Cached PSDS loaded, " << mData->size() << " bytes";
+}
+
+bool GnssPsds::needsDownloadLocked(int64_t nowUnixMs) const {
+    return mData == nullptr || mEndUnixMs - nowUnixMs < REFRESH_MARGIN_MS;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
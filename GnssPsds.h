@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/gnss/BnGnssPsds.h>
+#include <aidl/android/hardware/gnss/IGnssPsdsCallback.h>
+#include <aidl/android/hardware/gnss/PsdsType.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Long-term PSDS, which for the LC29H is Airoha EPO, as the framework downloads it from the
+// server in gps_debug.conf. Each injection is kept in one file, replaced by an atomic rename so
+// a crash leaves either the old data or the new, and handed to the receivers (see EpoUploader).
+// At every session start the cache is handed over again while it is still valid, and the
+// framework is asked for a new file once it is about to run out.
+class GnssPsds : public BnGnssPsds {
+public:
+    using Sink = std::function<void(std::shared_ptr<const std::vector<uint8_t>>)>;
+
+    // |sink| gets the data to upload, null when there is none.
+    GnssPsds(std::string cachePath, Sink sink);
+
+    ndk::ScopedAStatus injectPsdsData(PsdsType psdsType, const std::vector<uint8_t>& data) override;
+    ndk::ScopedAStatus setCallback(const std::shared_ptr<IGnssPsdsCallback>& callback) override;
+
+    // Before the receivers start.
+    void onStart();
+
+    struct Status {
+        size_t bytes = 0;  // 0 if nothing is cached
+        int64_t startUnixMs = 0;
+        int64_t endUnixMs = 0;
+    };
+    Status status();
+
+private:
+    // Reads the cache file the first time it is needed.
+    void loadLocked();
+    // True if the cache is missing or runs out within REFRESH_MARGIN_MS.
+    bool needsDownloadLocked(int64_t nowUnixMs) const;
+
+    // A file a day old or so is worth replacing before it runs out; the framework backs off
+    // on its own when the server has nothing newer.
+    static constexpr int64_t REFRESH_MARGIN_MS = 24LL * 3600 * 1000;
+
+    const std::string mCachePath;
+    const Sink mSink;
+    std::mutex mMutex;
+    std::shared_ptr<IGnssPsdsCallback> mCallback;
+    bool mLoaded = false;
+    std::shared_ptr<const std::vector<uint8_t>> mData;
+    int64_t mStartUnixMs = 0;
+    int64_t mEndUnixMs = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "LocationFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+static constexpr double WGS84_A = 6378137.0;
+static constexpr double WGS84_E2 = 6.69437999014e-3;
+// Corrections larger than this are real jumps (e.g. leaving a tunnel) and are not smoothed.
+static constexpr double MAX_BLEND_M = 50.0;
+static constexpr double UNKNOWN_VELOCITY_VAR = 25.0;
+static constexpr double INITIAL_ACCELERATION_VAR = 4.0;
+static constexpr double DEFAULT_HORIZONTAL_SIGMA_M = 10.0;
+
+void LocationFilter::Axis::init(double position, double positionVar, double velocity,
+                                double velocityVar) {
+    x[0] = position;
+    x[1] = velocity;
+    x[2] = 0;
+    for (auto& row : p) row[0] = row[1] = row[2] = 0;
+    p[0][0] = positionVar;
+    p[1][1] = velocityVar;
+    p[2][2] = INITIAL_ACCELERATION_VAR;
+}
+
+void LocationFilter::Axis::predict(double dt, double jerkPsd) {
+    if (dt <= 0) return;
+    const double dt2 = dt * dt / 2;
+    x[0] += x[1] * dt + x[2] * dt2;
+    x[1] += x[2] * dt;
+
+    // P = F P F' + Q with F = [1 dt dt^2/2; 0 1 dt; 0 0 1], written out.
+    double fp[3][3];
+    for (int j = 0; j < 3; j++) {
+        fp[0][j] = p[0][j] + dt * p[1][j] + dt2 * p[2][j];
+        fp[1][j] = p[1][j] + dt * p[2][j];
+        fp[2][j] = p[2][j];
+    }
+    for (int i = 0; i < 3; i++) {
+        p[i][0] = fp[i][0] + dt * fp[i][1] + dt2 * fp[i][2];
+        p[i][1] = fp[i][1] + dt * fp[i][2];
+        p[i][2] = fp[i][2];
+    }
+    const double dt3 = dt * dt * dt;
+    p[0][0] += jerkPsd * dt3 * dt * dt / 20;
+    p[0][1] += jerkPsd * dt3 * dt / 8;
+    p[0][2] += jerkPsd * dt3 / 6;
+    p[1][1] += jerkPsd * dt3 / 3;
+    p[1][2] += jerkPsd * dt * dt / 2;
+    p[2][2] += jerkPsd * dt;
+    p[1][0] = p[0][1];
+    p[2][0] = p[0][2];
+    p[2][1] = p[1][2];
+}
+
+void LocationFilter::Axis::update(int state, double z, double variance) {
+    const double s = p[state][state] + variance;
+    if (s <= 0) return;
+    const double innovation = z - x[state];
+    const double row[3] = {p[state][0], p[state][1], p[state][2]};
+    for (int i = 0; i < 3; i++) {
+        const double k = p[i][state] / s;
+        x[i] += k * innovation;
+        for (int j = 0; j < 3; j++) p[i][j] -= k * row[j];
+    }
+}
+
+void LocationFilter::setOrigin(double latitudeDegrees, double longitudeDegrees,
+                               double altitudeMeters) {
+    mOriginLatitude = latitudeDegrees;
+    mOriginLongitude = longitudeDegrees;
+    mOriginAltitude = altitudeMeters;
+    const double sinLat = std::sin(latitudeDegrees * DEG_TO_RAD);
+    const double w = 1 - WGS84_E2 * sinLat * sinLat;
+    mMetersPerDegreeLatitude = WGS84_A * (1 - WGS84_E2) / (w * std::sqrt(w)) * DEG_TO_RAD;
+    mMetersPerDegreeLongitude =
+            WGS84_A / std::sqrt(w) * std::cos(latitudeDegrees * DEG_TO_RAD) * DEG_TO_RAD;
+}
+
+void LocationFilter::rebase() {
+    const double east = mAxes[0].x[0], north = mAxes[1].x[0];
+    if (std::hypot(east, north) < REBASE_DISTANCE_M) return;
+    setOrigin(mOriginLatitude + north / mMetersPerDegreeLatitude,
+              mOriginLongitude + east / mMetersPerDegreeLongitude, mOriginAltitude);
+    mAxes[0].x[0] = 0;
+    mAxes[1].x[0] = 0;
+}
+
+void LocationFilter::update(const NmeaFix& fix, int64_t timeNs) {
+    if (!(fix.flags & FIX_HAS_LAT_LONG)) return;
+    if (mInitialized && timeNs <= mTimeNs) return;
+
+    double hSigma = (fix.flags & FIX_HAS_HORIZONTAL_ACCURACY) && fix.horizontalAccuracyMeters > 0
+            ? fix.horizontalAccuracyMeters / M_SQRT2
+            : DEFAULT_HORIZONTAL_SIGMA_M;
+    const double hVar = hSigma * hSigma;
+    // NMEA carries no vertical estimate; 1.5x horizontal is typical.
+    const double vVar = (fix.flags & FIX_HAS_VERTICAL_ACCURACY) && fix.verticalAccuracyMeters > 0
+            ? fix.verticalAccuracyMeters * fix.verticalAccuracyMeters
+            : 2.25 * hVar;
+
+    const bool hasVelocity = (fix.flags & FIX_HAS_SPEED) && (fix.flags & FIX_HAS_BEARING);
+    double vEast = 0, vNorth = 0, velocityVar = UNKNOWN_VELOCITY_VAR;
+    if (hasVelocity) {
+        const double bearing = fix.bearingDegrees * DEG_TO_RAD;
+        vEast = fix.speedMetersPerSec * std::sin(bearing);
+        vNorth = fix.speedMetersPerSec * std::cos(bearing);
+        const double crossTrack = fix.speedMetersPerSec * BEARING_SIGMA_DEG * DEG_TO_RAD;
+        velocityVar = VELOCITY_SIGMA_MPS * VELOCITY_SIGMA_MPS + crossTrack * crossTrack;
+    }
+    const bool hasAltitude = (fix.flags & FIX_HAS_ALTITUDE) != 0;
+
+    if (!mInitialized || timeNs - mTimeNs > MAX_GAP_NS) {
+        setOrigin(fix.latitudeDegrees, fix.longitudeDegrees, hasAltitude ? fix.altitudeMeters : 0);
+        mAxes[0].init(0, hVar, vEast, velocityVar);
+        mAxes[1].init(0, hVar, vNorth, velocityVar);
+        mAxes[2].init(0, hasAltitude ? vVar : 1e6, 0, 1.0);
+        for (double& b : mBlend) b = 0;
+        mHasAltitude = hasAltitude;
+        mTimeNs = timeNs;
+        mInitialized = true;
+        return;
+    }
+
+    const double dt = static_cast<double>(timeNs - mTimeNs) / NS_PER_SEC;
+    const double decay = std::exp(-dt / BLEND_TIME_CONSTANT_S);
+    double shown[3];
+    for (int k = 0; k < 3; k++) {
+        mAxes[k].predict(dt, k == 2 ? VERTICAL_JERK_PSD : HORIZONTAL_JERK_PSD);
+        shown[k] = mAxes[k].x[0] + mBlend[k] * decay;
+    }
+
+    mAxes[0].update(0, (fix.longitudeDegrees - mOriginLongitude) * mMetersPerDegreeLongitude, hVar);
+    mAxes[1].update(0, (fix.latitudeDegrees - mOriginLatitude) * mMetersPerDegreeLatitude, hVar);
+    if (hasVelocity) {
+        mAxes[0].update(1, vEast, velocityVar);
+        mAxes[1].update(1, vNorth, velocityVar);
+    }
+    if (hasAltitude) {
+        mAxes[2].update(0, fix.altitudeMeters - mOriginAltitude, vVar);
+        mHasAltitude = true;
+    }
+
+    // Keep the output where it was and let the correction fade in.
+    for (int k = 0; k < 3; k++) {
+        mBlend[k] = shown[k] - mAxes[k].x[0];
+        if (std::fabs(mBlend[k]) > MAX_BLEND_M) mBlend[k] = 0;
+    }
+    mTimeNs = timeNs;
+    rebase();
+}
+
+bool LocationFilter::predict(int64_t timeNs, Estimate& out) const {
+    if (!mInitialized || timeNs - mTimeNs > MAX_EXTRAPOLATION_NS) return false;
+    const double dt = std::max<double>(0, static_cast<double>(timeNs - mTimeNs) / NS_PER_SEC);
+    const double decay = std::exp(-dt / BLEND_TIME_CONSTANT_S);
+
+    Axis axes[3] = {mAxes[0], mAxes[1], mAxes[2]};
+    double position[3];
+    for (int k = 0; k < 3; k++) {
+        axes[k].predict(dt, k == 2 ? VERTICAL_JERK_PSD : HORIZONTAL_JERK_PSD);
+        position[k] = axes[k].x[0] + mBlend[k] * decay;
+    }
+
+    out.latitudeDegrees = mOriginLatitude + position[1] / mMetersPerDegreeLatitude;
+    out.longitudeDegrees = mOriginLongitude + position[0] / mMetersPerDegreeLongitude;
+    out.altitudeMeters = mOriginAltitude + position[2];
+    out.hasAltitude = mHasAltitude;
+
+    const double vEast = axes[0].x[1], vNorth = axes[1].x[1];
+    const double varEast = axes[0].p[1][1], varNorth = axes[1].p[1][1];
+    const double speed = std::hypot(vEast, vNorth);
+    out.speedMetersPerSec = speed;
+    double bearing = std::atan2(vEast, vNorth) / DEG_TO_RAD;
+    out.bearingDegrees = bearing < 0 ? bearing + 360 : bearing;
+
+    out.horizontalAccuracyMeters = static_cast<float>(std::sqrt(axes[0].p[0][0] + axes[1].p[0][0]));
+    out.verticalAccuracyMeters = static_cast<float>(std::sqrt(axes[2].p[0][0]));
+    if (speed > 0.5) {
+        // Split the velocity covariance along and across the direction of travel.
+        const double along = (vEast * vEast * varEast + vNorth * vNorth * varNorth) / (speed * speed);
+        const double across = (vNorth * vNorth * varEast + vEast * vEast * varNorth) / (speed * speed);
+        out.speedAccuracyMetersPerSecond = static_cast<float>(std::sqrt(along));
+        out.bearingAccuracyDegrees =
+                static_cast<float>(std::min(180.0, std::atan2(std::sqrt(across), speed) / DEG_TO_RAD));
+    } else {
+        out.speedAccuracyMetersPerSecond = static_cast<float>(std::sqrt(varEast + varNorth));
+        out.bearingAccuracyDegrees = 180.0f;
+    }
+    return true;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "NmeaTypes.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Kalman predictor that turns receiver epochs into positions at any requested instant, for
+// output rates above the receiver's. Runs in a local east/north/up frame around a recent fix,
+// with each axis an independent constant-acceleration model driven by white jerk, so a step is
+// a few dozen flops per axis and needs no matrix inversion (updates are scalar).
+//
+// A measurement update moves the filter, but the output does not jump: the difference between
+// what was being extrapolated and the corrected state is carried as an offset that decays over
+// BLEND_TIME_CONSTANT_S.
+class LocationFilter {
+public:
+    struct Estimate {
+        double latitudeDegrees = 0;
+        double longitudeDegrees = 0;
+        double altitudeMeters = 0;
+        double speedMetersPerSec = 0;
+        double bearingDegrees = 0;
+        float horizontalAccuracyMeters = 0;
+        float verticalAccuracyMeters = 0;
+        float speedAccuracyMetersPerSecond = 0;
+        float bearingAccuracyDegrees = 0;
+        bool hasAltitude = false;
+    };
+
+    // Applies a fix taken at |timeNs| (CLOCK_BOOTTIME). Fixes without FIX_HAS_LAT_LONG are
+    // ignored; a fix after a long gap restarts the filter.
+    void update(const NmeaFix& fix, int64_t timeNs);
+    // Extrapolates to |timeNs| without changing the filter. Returns false before the first fix
+    // or more than MAX_EXTRAPOLATION_NS past the last one.
+    bool predict(int64_t timeNs, Estimate& out) const;
+    void reset() { mInitialized = false; }
+
+    bool initialized() const { return mInitialized; }
+    int64_t lastUpdateNs() const { return mTimeNs; }
+
+private:
+    struct Axis {
+        double x[3];     // position (m), velocity (m/s), acceleration (m/s^2)
+        double p[3][3];  // covariance
+
+        void init(double position, double positionVar, double velocity, double velocityVar);
+        void predict(double dt, double jerkPsd);
+        void update(int state, double z, double variance);
+    };
+
+    static constexpr int64_t NS_PER_SEC = 1000000000;
+    // Fixes further apart than this restart the filter instead of bridging the gap.
+    static constexpr int64_t MAX_GAP_NS = 5 * NS_PER_SEC;
+    static constexpr int64_t MAX_EXTRAPOLATION_NS = 2 * NS_PER_SEC;
+    // Jerk spectral densities (m^2/s^5): a car braking or turning; vertical is much calmer.
+    static constexpr double HORIZONTAL_JERK_PSD = 2.0;
+    static constexpr double VERTICAL_JERK_PSD = 0.2;
+    static constexpr double VELOCITY_SIGMA_MPS = 0.3;
+    static constexpr double BEARING_SIGMA_DEG = 5.0;
+    static constexpr double BLEND_TIME_CONSTANT_S = 0.3;
+    // The frame is re-centred once the position is this far from its origin, to keep the flat
+    // earth approximation well under a centimetre.
+    static constexpr double REBASE_DISTANCE_M = 5000.0;
+
+    void setOrigin(double latitudeDegrees, double longitudeDegrees, double altitudeMeters);
+    void rebase();
+
+    bool mInitialized = false;
+    bool mHasAltitude = false;
+    int64_t mTimeNs = 0;
+    Axis mAxes[3];  // east, north, up
+
+    double mOriginLatitude = 0;
+    double mOriginLongitude = 0;
+    double mOriginAltitude = 0;
+    double mMetersPerDegreeLatitude = 0;
+    double mMetersPerDegreeLongitude = 0;
+
+    // Output offset at mTimeNs, decaying towards zero.
+    double mBlend[3] = {};
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
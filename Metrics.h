@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// A count kept by one thread and read now and then by others (dumpsys). Updates are a relaxed
+// load and store rather than a read-modify-write: no locked instruction and no cache line
+// taken from anyone while nobody reads, and a reader still sees each value whole.
+class Counter {
+public:
+    void add(uint64_t n = 1) {
+        mValue.store(mValue.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    // For totals that are kept elsewhere anyway and only published here.
+    void set(uint64_t value) { mValue.store(value, std::memory_order_relaxed); }
+    uint64_t load() const { return mValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> mValue{0};
+};
+
+// Latencies in power-of-two buckets of microseconds, single writer like Counter: bucket 0 is
+// under 1 us, bucket i from 1 on holds [2^(i-1), 2^i) us, and the last one everything from
+// about 4 s up. Recording is a handful of instructions, with no clock read of its own.
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS = 24;
+
+    struct Snapshot {
+        uint64_t counts[BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t sumUs = 0;
+        int64_t maxNs = 0;
+
+        // Upper bound of the bucket the |fraction| quantile falls in, capped at the maximum.
+        int64_t quantileUs(double fraction) const {
+            if (count == 0) return 0;
+            const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(fraction * count), 1);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++) {
+                seen += counts[i];
+                if (seen >= rank) return std::min(int64_t{1} << i, maxNs / 1000 + 1);
+            }
+            return maxNs / 1000 + 1;
+        }
+        int64_t meanUs() const { return count > 0 ? static_cast<int64_t>(sumUs / count) : 0; }
+    };
+
+    void record(int64_t ns) {
+        const uint64_t us = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+        const size_t bucket = us == 0 ? 0 : std::min<size_t>(64 - __builtin_clzll(us), BUCKETS - 1);
+        mCounts[bucket].add();
+        mSumUs.add(us);
+        if (ns > mMaxNs.load(std::memory_order_relaxed)) {
+            mMaxNs.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            snapshot.counts[i] = mCounts[i].load();
+            snapshot.count += snapshot.counts[i];
+        }
+        snapshot.sumUs = mSumUs.load();
+        snapshot.maxNs = mMaxNs.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+private:
+    Counter mCounts[BUCKETS];
+    Counter mSumUs;
+    std::atomic<int64_t> mMaxNs{0};
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Locale-independent decoders for NMEA fields. Numbers are decoded as scaled integers so
+// coordinates and times keep every digit the receiver sent; nothing here allocates.
+
+enum class SentenceType : uint8_t { UNKNOWN, GGA, RMC, GSV, GSA, VTG, GNS, GLL, ZDA, GST, COUNT };
+
+constexpr uint32_t formatterCode(const char* f) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(f[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(f[1])) << 8) |
+           static_cast<uint32_t>(static_cast<uint8_t>(f[2]));
+}
+
+// Classifies a sentence by the 3-character formatter that follows the 2-character talker ID
+// in the address field ("GNGGA" -> GGA). Proprietary "P..." sentences are never matched.
+inline SentenceType classifySentence(std::string_view address) {
+    if (address.size() != 5 || address[0] == 'P') return SentenceType::UNKNOWN;
+    switch (formatterCode(address.data() + 2)) {
+        case formatterCode("GGA"): return SentenceType::GGA;
+        case formatterCode("RMC"): return SentenceType::RMC;
+        case formatterCode("GSV"): return SentenceType::GSV;
+        case formatterCode("GSA"): return SentenceType::GSA;
+        case formatterCode("VTG"): return SentenceType::VTG;
+        case formatterCode("GNS"): return SentenceType::GNS;
+        case formatterCode("GLL"): return SentenceType::GLL;
+        case formatterCode("ZDA"): return SentenceType::ZDA;
+        case formatterCode("GST"): return SentenceType::GST;
+        default: return SentenceType::UNKNOWN;
+    }
+}
+
+inline constexpr int64_t kPow10[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL,
+    1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL,
+};
+
+// Decimal number held as mantissa * 10^-scale.
+struct FixedPoint {
+    int64_t mantissa = 0;
+    int scale = 0;
+
+    double toDouble() const { return static_cast<double>(mantissa) / static_cast<double>(kPow10[scale]); }
+};
+
+template <typename T>
+inline bool decodeInt(std::string_view field, T& out, int base = 10) {
+    if (field.empty()) return false;
+    auto [end, ec] = std::from_chars(field.data(), field.data() + field.size(), out, base);
+    return ec == std::errc() && end == field.data() + field.size();
+}
+
+inline bool decodeFixed(std::string_view field, FixedPoint& out) {
+    size_t i = 0;
+    bool negative = false;
+    if (!field.empty() && (field[0] == '-' || field[0] == '+')) {
+        negative = field[0] == '-';
+        i = 1;
+    }
+    int64_t mantissa = 0;
+    int scale = 0;
+    int digits = 0;
+    bool point = false;
+    for (; i < field.size(); i++) {
+        char c = field[i];
+        if (c == '.' && !point) {
+            point = true;
+            continue;
+        }
+        unsigned d = static_cast<unsigned>(c - '0');
+        if (d > 9) return false;
+        // Digits past the int64 range or the scale table are below any receiver's resolution.
+        if (digits >= 18 || (point && scale >= 12)) continue;
+        mantissa = mantissa * 10 + d;
+        digits++;
+        if (point) scale++;
+    }
+    if (digits == 0) return false;
+    out.mantissa = negative ? -mantissa : mantissa;
+    out.scale = scale;
+    return true;
+}
+
+inline bool decodeDouble(std::string_view field, double& out) {
+    FixedPoint v;
+    if (!decodeFixed(field, v)) return false;
+    out = v.toDouble();
+    return true;
+}
+
+// "ddmm.mmmm" / "dddmm.mmmm" plus hemisphere to signed decimal degrees. The degree/minute
+// split is done on the integer mantissa so only the final division rounds.
+inline bool decodeCoordinate(std::string_view field, std::string_view hemisphere, double& out) {
+    FixedPoint v;
+    if (!decodeFixed(field, v) || v.mantissa < 0 || hemisphere.size() != 1) return false;
+    const int64_t unit = kPow10[v.scale];
+    const int64_t degrees = v.mantissa / (100 * unit);
+    const int64_t minutes = v.mantissa - degrees * 100 * unit;
+    double value = static_cast<double>(degrees) + static_cast<double>(minutes) / (60.0 * unit);
+    switch (hemisphere[0]) {
+        case 'N': case 'E': break;
+        case 'S': case 'W': value = -value; break;
+        default: return false;
+    }
+    out = value;
+    return true;
+}
+
+// "hhmmss[.sss]" to milliseconds since 00:00 UTC. Fractions finer than 1 ms are truncated.
+inline bool decodeUtcTime(std::string_view field, int32_t& msOfDay) {
+    if (field.size() < 6) return false;
+    int32_t hms[3];
+    for (int k = 0; k < 3; k++) {
+        unsigned hi = static_cast<unsigned>(field[2 * k] - '0');
+        unsigned lo = static_cast<unsigned>(field[2 * k + 1] - '0');
+        if (hi > 9 || lo > 9) return false;
+        hms[k] = static_cast<int32_t>(hi * 10 + lo);
+    }
+    if (hms[0] > 23 || hms[1] > 59 || hms[2] > 60) return false;
+    int32_t ms = 0;
+    if (field.size() > 6) {
+        if (field[6] != '.') return false;
+        int32_t unit = 100;
+        for (size_t i = 7; i < field.size(); i++) {
+            unsigned d = static_cast<unsigned>(field[i] - '0');
+            if (d > 9) return false;
+            ms += static_cast<int32_t>(d) * unit;
+            unit /= 10;
+        }
+    }
+    msOfDay = ((hms[0] * 60 + hms[1]) * 60 + hms[2]) * 1000 + ms;
+    return true;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date, see Howard Hinnant's date algorithms.
+constexpr int32_t daysFromCivil(int32_t year, int32_t month, int32_t day) {
+    // Counted on a March-based year so the leap day is the last day of the year.
+    const int32_t y = year - (month <= 2 ? 1 : 0);
+    const int32_t era = y / 400;
+    const int32_t yoe = y - era * 400;
+    const int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// The inverse: year, month (1-12) and day (1-31) of a day since 1970-01-01.
+constexpr void civilFromDays(int32_t days, int32_t& year, int32_t& month, int32_t& day) {
+    const int32_t z = days + 719468;
+    const int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int32_t doe = z - era * 146097;
+    const int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int32_t mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+// "ddmmyy" (RMC) into days since 1970-01-01. Two-digit years below 80 are taken as 20yy.
+inline bool decodeDate(std::string_view field, int32_t& daysSinceEpoch) {
+    if (field.size() != 6) return false;
+    int32_t dmy[3];
+    for (int k = 0; k < 3; k++) {
+        unsigned hi = static_cast<unsigned>(field[2 * k] - '0');
+        unsigned lo = static_cast<unsigned>(field[2 * k + 1] - '0');
+        if (hi > 9 || lo > 9) return false;
+        dmy[k] = static_cast<int32_t>(hi * 10 + lo);
+    }
+    if (dmy[0] < 1 || dmy[0] > 31 || dmy[1] < 1 || dmy[1] > 12) return false;
+    daysSinceEpoch = daysFromCivil(dmy[2] + (dmy[2] < 80 ? 2000 : 1900), dmy[1], dmy[0]);
+    return true;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
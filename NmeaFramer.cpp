@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "NmeaFramer.h"
+
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static inline bool isDelimiter(char c) {
+    return c == ',' || c == '*' || c == '$' || c == '\r' || c == '\n';
+}
+
+static inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Returns the index of the first ',', '*', '$', CR or LF in p[0, n), or n if there is none.
+static size_t findDelimiter(const char* p, size_t n) {
+    size_t i = 0;
+#if defined(__aarch64__)
+    const uint8x16_t comma = vdupq_n_u8(','), star = vdupq_n_u8('*'), dollar = vdupq_n_u8('$');
+    const uint8x16_t cr = vdupq_n_u8('\r'), lf = vdupq_n_u8('\n');
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p + i));
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, comma), vceqq_u8(v, star)),
+                                  vorrq_u8(vceqq_u8(v, dollar), vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, lf))));
+        if (vmaxvq_u8(hit) != 0) {
+            // Narrow every 0x00/0xFF lane to one nibble so the first hit is a single ctz away.
+            uint64_t mask = vget_lane_u64(
+                vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+            return i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (isDelimiter(p[i])) return i;
+    }
+    return n;
+}
+
+static uint8_t xorBytes(const char* p, size_t n) {
+    uint8_t x = 0;
+    size_t i = 0;
+#if defined(__aarch64__)
+    if (n >= 16) {
+        uint8x16_t acc = vdupq_n_u8(0);
+        for (; i + 16 <= n; i += 16) acc = veorq_u8(acc, vld1q_u8(reinterpret_cast<const uint8_t*>(p + i)));
+        uint64_t w = vget_lane_u64(vreinterpret_u64_u8(veor_u8(vget_low_u8(acc), vget_high_u8(acc))), 0);
+        w ^= w >> 32; w ^= w >> 16; w ^= w >> 8;
+        x = static_cast<uint8_t>(w);
+    }
+#endif
+    for (; i < n; i++) x ^= static_cast<uint8_t>(p[i]);
+    return x;
+}
+
+void NmeaFramer::reset() {
+    mState = State::HUNT;
+    mChecksum = 0;
+    mExpectedChecksum = 0;
+    mLength = 0;
+    mFieldCount = 0;
+    mOverflow = false;
+    mArrivalNs = 0;
+}
+
+void NmeaFramer::beginSentence(const char* dollar) {
+    mLine[0] = '$';
+    mLength = 1;
+    mFieldStart[0] = 1;
+    mFieldCount = 1;
+    mChecksum = 0;
+    mExpectedChecksum = 0;
+    mOverflow = false;
+    mArrivalNs = (mChunkEnd != nullptr && dollar < mChunkEnd)
+            ? mChunkEndTimeNs - (mChunkEnd - dollar) * mByteTimeNs
+            : 0;
+    mState = State::BODY;
+}
+
+bool NmeaFramer::next(const char*& cursor, const char* end, NmeaSentence& out) {
+    while (cursor < end) {
+        switch (mState) {
+            case State::HUNT: {
+                // bionic's memchr is already vectorised, no need for a hand-written scan here.
+                const void* dollar = memchr(cursor, '$', end - cursor);
+                if (dollar == nullptr) {
+                    cursor = end;
+                    return false;
+                }
+                cursor = static_cast<const char*>(dollar) + 1;
+                beginSentence(static_cast<const char*>(dollar));
+                break;
+            }
+            case State::BODY: {
+                size_t run = findDelimiter(cursor, end - cursor);
+                if (!mOverflow && mLength + run < MAX_SENTENCE_LENGTH) {
+                    memcpy(mLine + mLength, cursor, run);
+                    mChecksum ^= xorBytes(cursor, run);
+                    mLength += run;
+                } else {
+                    mOverflow = true;
+                }
+                cursor += run;
+                if (cursor == end) return false;
+
+                char c = *cursor++;
+                if (c == ',') {
+                    mChecksum ^= static_cast<uint8_t>(c);
+                    if (mOverflow || mLength + 1 >= MAX_SENTENCE_LENGTH ||
+                        mFieldCount == NmeaSentence::MAX_FIELDS) {
+                        mOverflow = true;
+                    } else {
+                        mLine[mLength++] = c;
+                        mFieldStart[mFieldCount++] = static_cast<uint16_t>(mLength);
+                    }
+                } else if (c == '*') {
+                    if (mLength + 3 > MAX_SENTENCE_LENGTH) mOverflow = true;
+                    if (!mOverflow) mLine[mLength++] = c;
+                    mState = State::CHECKSUM_HI;
+                } else if (c == '$') {
+                    // Start of the next sentence before this one was terminated.
+                    mStats.malformed++;
+                    beginSentence(cursor - 1);
+                } else {
+                    // CR/LF without a checksum; the LC29H always sends one, so treat it as corrupt.
+                    mStats.malformed++;
+                    mState = State::HUNT;
+                }
+                break;
+            }
+            case State::CHECKSUM_HI:
+            case State::CHECKSUM_LO: {
+                int v = hexValue(*cursor);
+                if (v < 0) {
+                    // Leave the byte in place: it may be the '$' of the next sentence.
+                    mStats.malformed++;
+                    mState = State::HUNT;
+                    break;
+                }
+                if (!mOverflow) mLine[mLength++] = *cursor;
+                cursor++;
+                mExpectedChecksum = static_cast<uint8_t>((mExpectedChecksum << 4) | v);
+                if (mState == State::CHECKSUM_HI) {
+                    mState = State::CHECKSUM_LO;
+                    break;
+                }
+                mState = State::HUNT;
+                if (mOverflow) {
+                    mStats.overflows++;
+                } else if (mExpectedChecksum != mChecksum) {
+                    mStats.checksumErrors++;
+                } else {
+                    emit(out);
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+void NmeaFramer::emit(NmeaSentence& out) {
+    mLine[mLength] = '\0';
+    const size_t star = mLength - 3;
+    out.text = std::string_view(mLine, mLength);
+    out.fieldCount = mFieldCount;
+    out.arrivalNs = mArrivalNs;
+    for (size_t i = 0; i < mFieldCount; i++) {
+        const size_t fieldEnd = (i + 1 < mFieldCount) ? mFieldStart[i + 1] - 1 : star;
+        out.fields[i] = std::string_view(mLine + mFieldStart[i], fieldEnd - mFieldStart[i]);
+    }
+    mStats.sentences++;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// A checksum-verified NMEA sentence. All views point into the framer's line buffer and are
+// only valid until the next call to NmeaFramer::next().
+struct NmeaSentence {
+    static constexpr size_t MAX_FIELDS = 32;
+
+    std::string_view text;                           // "$GPGGA,...*hh", without CR/LF
+    std::array<std::string_view, MAX_FIELDS> fields; // fields[0] is the address ("GPGGA")
+    size_t fieldCount = 0;
+    int64_t arrivalNs = 0;                           // when the '$' arrived, see setChunkTiming()
+
+    // Out-of-range fields read as empty, so parsers do not need their own bounds checks.
+    std::string_view operator[](size_t i) const { return i < fieldCount ? fields[i] : std::string_view(); }
+};
+
+// Streaming NMEA 0183 framer. Bytes are scanned once: the XOR checksum is accumulated and the
+// field delimiters are recorded while the sentence is copied into a fixed line buffer, so a
+// framed sentence costs no heap allocation and corrupted lines never reach a parser.
+class NmeaFramer {
+public:
+    static constexpr size_t MAX_SENTENCE_LENGTH = 256;
+
+    struct Stats {
+        uint64_t sentences = 0;
+        uint64_t checksumErrors = 0;
+        uint64_t overflows = 0;  // longer than MAX_SENTENCE_LENGTH or MAX_FIELDS
+        uint64_t malformed = 0;  // missing checksum, or interrupted by '$' / CR / LF
+    };
+
+    NmeaFramer() { reset(); }
+
+    // Consumes bytes from [cursor, end) until a complete sentence with a valid checksum has been
+    // framed. Returns true and fills |out| in that case, leaving |cursor| just past the sentence
+    // so the caller can loop; returns false once all input is consumed. Partial sentences are
+    // carried over to the next call.
+    bool next(const char*& cursor, const char* end, NmeaSentence& out);
+
+    // Describes the chunk about to be passed to next(): its last byte was received at
+    // |endTimeNs| and every byte takes |byteTimeNs| on the wire, so the arrival time of a '$' is
+    // back-dated by the bytes that followed it. Without timing, arrivalNs stays 0.
+    void setChunkTiming(const char* chunkEnd, int64_t endTimeNs, int64_t byteTimeNs) {
+        mChunkEnd = chunkEnd;
+        mChunkEndTimeNs = endTimeNs;
+        mByteTimeNs = byteTimeNs;
+    }
+
+    void reset();
+    // Drops a partially received sentence, counted as malformed.
+    void interrupt() {
+        if (mState != State::HUNT) mStats.malformed++;
+        mState = State::HUNT;
+    }
+    const Stats& stats() const { return mStats; }
+
+private:
+    enum class State : uint8_t { HUNT, BODY, CHECKSUM_HI, CHECKSUM_LO };
+
+    void beginSentence(const char* dollar);
+    void emit(NmeaSentence& out);
+
+    State mState;
+    uint8_t mChecksum;
+    uint8_t mExpectedChecksum;
+    size_t mLength;
+    size_t mFieldCount;
+    bool mOverflow;
+    int64_t mArrivalNs;
+    const char* mChunkEnd = nullptr;
+    int64_t mChunkEndTimeNs = 0;
+    int64_t mByteTimeNs = 0;
+    uint16_t mFieldStart[NmeaSentence::MAX_FIELDS];
+    char mLine[MAX_SENTENCE_LENGTH + 1];
+    Stats mStats;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "NmeaParser.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Without GST, horizontal accuracy is HDOP times a nominal user range error.
+static constexpr double NOMINAL_UERE_M = 4.0;
+static constexpr double DEFAULT_ACCURACY_M = 5.0;  // without HDOP either
+// GNS mode characters, the best solution first, and the GGA fix quality of each.
+static constexpr std::string_view GNS_MODES = "RFDPAEMS";
+static constexpr int GNS_MODE_QUALITY[] = {4, 5, 2, 3, 1, 6, 7, 8};
+
+template <typename Schema>
+bool NmeaParser::parseWith(const NmeaSentence& sentence) {
+    typename Schema::Record record;
+    return Schema::decode(sentence, record) && apply(record);
+}
+
+SentenceType NmeaParser::parse(const NmeaSentence& sentence) {
+    struct Decoder {
+        bool (NmeaParser::*parse)(const NmeaSentence&);
+        int timeField;  // -1 if the sentence carries no epoch time
+    };
+    static constexpr Decoder kDecoders[static_cast<size_t>(SentenceType::COUNT)] = {
+        {nullptr, -1},  // UNKNOWN
+        {&NmeaParser::parseWith<GgaSchema>, GgaSchema::TIME_FIELD},
+        {&NmeaParser::parseWith<RmcSchema>, RmcSchema::TIME_FIELD},
+        {&NmeaParser::parseGSV, -1},
+        {&NmeaParser::parseWith<GsaSchema>, GsaSchema::TIME_FIELD},
+        {&NmeaParser::parseWith<VtgSchema>, VtgSchema::TIME_FIELD},
+        {&NmeaParser::parseWith<GnsSchema>, GnsSchema::TIME_FIELD},
+        {&NmeaParser::parseWith<GllSchema>, GllSchema::TIME_FIELD},
+        {&NmeaParser::parseWith<ZdaSchema>, ZdaSchema::TIME_FIELD},
+        {&NmeaParser::parseWith<GstSchema>, GstSchema::TIME_FIELD},
+    };
+    std::string_view address = sentence[0];
+    SentenceType type = classifySentence(address);
+    const Decoder& decoder = kDecoders[static_cast<size_t>(type)];
+
+    int32_t utcMsOfDay = -1;
+    if (decoder.timeField >= 0) decodeUtcTime(sentence[decoder.timeField], utcMsOfDay);
+    // Unparsed and proprietary sentences still count towards the shape of the burst.
+    uint32_t formatter = address.size() >= 3 ? formatterCode(address.data() + address.size() - 3) : 0;
+
+    mEpochs.beginSentence(formatter, utcMsOfDay, sentence.arrivalNs);
+    bool accepted = decoder.parse != nullptr && (this->*decoder.parse)(sentence);
+    mEpochs.endSentence();
+    return accepted ? type : SentenceType::UNKNOWN;
+}
+
+void NmeaParser::applyPosition(const PositionSentence& position) {
+    NmeaFix& fix = mEpochs.current();
+    if (position.latitudeDegrees && position.longitudeDegrees) {
+        fix.latitudeDegrees = *position.latitudeDegrees;
+        fix.longitudeDegrees = *position.longitudeDegrees;
+        fix.flags |= FIX_HAS_LAT_LONG;
+    }
+    if (position.numSatellites) fix.numSatellites = *position.numSatellites;
+
+    if (!fix.measuredAccuracy) {
+        const double hdop = position.hdop.value_or(0);
+        fix.horizontalAccuracyMeters = hdop > 0 ? hdop * NOMINAL_UERE_M : DEFAULT_ACCURACY_M;
+        fix.flags |= FIX_HAS_HORIZONTAL_ACCURACY;
+    }
+    if (position.altitudeMeters) {
+        fix.altitudeMeters = *position.altitudeMeters;
+        fix.flags |= FIX_HAS_ALTITUDE;
+    }
+}
+
+bool NmeaParser::apply(const GgaSentence& gga) {
+    NmeaFix& fix = mEpochs.current();
+    fix.fixQuality = gga.fixQuality.value_or(0);
+    if (fix.fixQuality <= 0) return false;
+    applyPosition(gga);
+    return true;
+}
+
+bool NmeaParser::apply(const GnsSentence& gns) {
+    // The best of the constellations' solutions stands for the fix.
+    size_t best = GNS_MODES.size();
+    for (char mode : gns.modes) best = std::min(best, GNS_MODES.find(mode));
+    NmeaFix& fix = mEpochs.current();
+    fix.fixQuality = best < GNS_MODES.size() ? GNS_MODE_QUALITY[best] : 0;
+    if (fix.fixQuality <= 0) return false;
+    applyPosition(gns);
+    return true;
+}
+
+bool NmeaParser::apply(const RmcSentence& rmc) {
+    if (!rmc.valid) return false;
+    NmeaFix& fix = mEpochs.current();
+    if (rmc.speedMetersPerSec) {
+        fix.speedMetersPerSec = *rmc.speedMetersPerSec;
+        fix.flags |= FIX_HAS_SPEED;
+    }
+    if (rmc.bearingDegrees) {
+        fix.bearingDegrees = *rmc.bearingDegrees;
+        fix.flags |= FIX_HAS_BEARING;
+    }
+    if (rmc.utcDaysSinceEpoch) fix.utcDaysSinceEpoch = *rmc.utcDaysSinceEpoch;
+    return true;
+}
+
+bool NmeaParser::apply(const VtgSentence& vtg) {
+    NmeaFix& fix = mEpochs.current();
+    if (vtg.bearingDegrees) {
+        fix.bearingDegrees = *vtg.bearingDegrees;
+        fix.flags |= FIX_HAS_BEARING;
+    }
+    if (vtg.speedMetersPerSec) {
+        fix.speedMetersPerSec = *vtg.speedMetersPerSec;
+        fix.flags |= FIX_HAS_SPEED;
+    }
+    return true;
+}
+
+bool NmeaParser::apply(const GllSentence& gll) {
+    if (!gll.valid) return false;
+    NmeaFix& fix = mEpochs.current();
+    // GGA or GNS, where the receiver sends them, have the position with its quality and accuracy.
+    if (fix.flags & FIX_HAS_LAT_LONG) return true;
+    if (!gll.latitudeDegrees || !gll.longitudeDegrees) return false;
+    fix.latitudeDegrees = *gll.latitudeDegrees;
+    fix.longitudeDegrees = *gll.longitudeDegrees;
+    fix.flags |= FIX_HAS_LAT_LONG;
+    if (fix.fixQuality <= 0) fix.fixQuality = 1;
+    if (!fix.measuredAccuracy) {
+        fix.horizontalAccuracyMeters = DEFAULT_ACCURACY_M;
+        fix.flags |= FIX_HAS_HORIZONTAL_ACCURACY;
+    }
+    return true;
+}
+
+bool NmeaParser::apply(const ZdaSentence& zda) {
+    mEpochs.current().utcDaysSinceEpoch = zda.utcDaysSinceEpoch;
+    return true;
+}
+
+// GnssLocation has no error ellipse. Its horizontal accuracy is a radius, here the ellipse's
+// DRMS, which holds 63 to 68% of fixes depending on its shape; the vertical one is one sigma.
+bool NmeaParser::apply(const GstSentence& gst) {
+    NmeaFix& fix = mEpochs.current();
+    double drms = 0;
+    if (gst.latitudeSigmaMeters && gst.longitudeSigmaMeters) {
+        drms = std::hypot(*gst.latitudeSigmaMeters, *gst.longitudeSigmaMeters);
+    } else if (gst.majorSigmaMeters && gst.minorSigmaMeters) {
+        drms = std::hypot(*gst.majorSigmaMeters, *gst.minorSigmaMeters);
+    }
+    bool applied = false;
+    if (drms > 0) {
+        fix.horizontalAccuracyMeters = drms;
+        fix.measuredAccuracy = true;
+        fix.flags |= FIX_HAS_HORIZONTAL_ACCURACY;
+        applied = true;
+    }
+    if (gst.altitudeSigmaMeters.value_or(0) > 0) {
+        fix.verticalAccuracyMeters = *gst.altitudeSigmaMeters;
+        fix.flags |= FIX_HAS_VERTICAL_ACCURACY;
+        applied = true;
+    }
+    return applied;
+}
+
+bool NmeaParser::parseGSV(const NmeaSentence& fields) {
+    if (fields.fieldCount < 4) return false;
+    Constellation system = talkerConstellation(fields[0].substr(0, 2));
+
+    // NMEA 4.11 appends the signal ID, a single hex digit, after the last satellite group.
+    uint8_t signalId = 0;
+    size_t end = fields.fieldCount;
+    if ((end - 4) % 4 == 1) {
+        int value;
+        if (decodeInt(fields[--end], value, 16) && value > 0 && value <= 0xf) {
+            signalId = static_cast<uint8_t>(value);
+        }
+    }
+
+    int32_t now = mEpochs.burstUtcMsOfDay();
+    if (mEpochs.burstCount() != mAgedBurst) {
+        mAgedBurst = mEpochs.burstCount();
+        mSatellites.age(now);
+    }
+    for (size_t i = 4; i + 3 < end; i += 4) {
+        int nmeaSvid = 0, svid;
+        Constellation constellation;
+        if (!decodeInt(fields[i], nmeaSvid) ||
+            !normalizeSatellite(system, nmeaSvid, constellation, svid) ||
+            mSatellites.blocked(constellation, svid)) {
+            continue;
+        }
+        NmeaSatellite& sv = mSatellites.update(constellation, svid, signalId, now);
+        // Empty fields mean "not known now" (e.g. C/N0 of an SV that is not tracked).
+        double value;
+        sv.elevationDegrees = decodeDouble(fields[i + 1], value) ? value : 0;
+        sv.azimuthDegrees = decodeDouble(fields[i + 2], value) ? value : 0;
+        sv.cn0DbHz = decodeDouble(fields[i + 3], value) ? value : 0;
+    }
+    return true;
+}
+
+bool NmeaParser::apply(const GsaSentence& gsa) {
+    Constellation system = talkerConstellation(gsa.talker);
+    if (gsa.systemId) system = systemIdConstellation(*gsa.systemId);
+
+    // An epoch has one GSA per constellation; the set is rebuilt from the first one of a burst.
+    if (mEpochs.burstCount() != mUsedBurst) {
+        mUsedBurst = mEpochs.burstCount();
+        mSatellites.clearUsedInFix();
+    }
+    if (!gsa.svids) return true;
+    for (size_t i = 0; i < gsa.svids->count; i++) {
+        int svid;
+        Constellation constellation;
+        if (normalizeSatellite(system, gsa.svids->values[i], constellation, svid)) {
+            mSatellites.setUsedInFix(constellation, svid);
+        }
+    }
+    return true;
+}
+
+Constellation NmeaParser::talkerConstellation(std::string_view tid) {
+    if (tid == "GP") return Constellation::GPS;
+    if (tid == "GL") return Constellation::GLONASS;
+    if (tid == "GA") return Constellation::GALILEO;
+    if (tid == "GB" || tid == "BD") return Constellation::BEIDOU;
+    if (tid == "GQ" || tid == "QZ") return Constellation::QZSS;
+    if (tid == "GI") return Constellation::IRNSS;
+    return Constellation::UNKNOWN;
+}
+
+Constellation NmeaParser::systemIdConstellation(int systemId) {
+    switch (systemId) {
+        case 1: return Constellation::GPS;
+        case 2: return Constellation::GLONASS;
+        case 3: return Constellation::GALILEO;
+        case 4: return Constellation::BEIDOU;
+        case 5: return Constellation::QZSS;
+        case 6: return Constellation::IRNSS;
+        default: return Constellation::UNKNOWN;
+    }
+}
+
+bool NmeaParser::normalizeSatellite(Constellation system, int n, Constellation& c, int& svid) {
+    if (n <= 0) return false;
+    switch (system) {
+        case Constellation::GPS:
+            if (n <= 32) { c = Constellation::GPS; svid = n; return true; }
+            if (n <= 64) { c = Constellation::SBAS; svid = n + 87; return true; }
+            if (n >= 193 && n <= 202) { c = Constellation::QZSS; svid = n; return true; }
+            return false;
+        case Constellation::GLONASS:
+            c = Constellation::GLONASS;
+            svid = n > 64 ? n - 64 : n;
+            return svid <= 32;
+        case Constellation::GALILEO:
+            c = Constellation::GALILEO;
+            svid = n > 300 ? n - 300 : n;
+            return svid <= 36;
+        case Constellation::BEIDOU:
+            c = Constellation::BEIDOU;
+            svid = n > 200 ? n - 200 : n;
+            return svid <= 63;
+        case Constellation::QZSS:
+            c = Constellation::QZSS;
+            svid = n < 193 ? n + 192 : n;
+            return svid <= 202;
+        case Constellation::IRNSS:
+            c = Constellation::IRNSS;
+            svid = n;
+            return n <= 14;
+        default:
+            // Legacy "GN" numbering, where the range identifies the constellation.
+            if (n <= 64 || (n >= 193 && n <= 200)) return normalizeSatellite(Constellation::GPS, n, c, svid);
+            if (n >= 65 && n <= 96) return normalizeSatellite(Constellation::GLONASS, n, c, svid);
+            if (n >= 201 && n <= 263) return normalizeSatellite(Constellation::BEIDOU, n, c, svid);
+            if (n >= 301 && n <= 336) return normalizeSatellite(Constellation::GALILEO, n, c, svid);
+            return false;
+    }
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
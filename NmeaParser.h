@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "EpochAssembler.h"
+#include "NmeaDecode.h"
+#include "NmeaFramer.h"
+#include "NmeaSentences.h"
+#include "NmeaTypes.h"
+#include "SatelliteTable.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Decodes framed sentences into per-epoch fixes and the satellite state. Sentences of a fixed
+// layout are decoded by their NmeaSchema (NmeaSentences.h) and applied here; adding one takes
+// its declaration, a SentenceType and an apply(). Not thread-safe: owned and driven by a single
+// reader thread.
+class NmeaParser {
+public:
+    // Returns the type of the sentence if it was recognised and accepted, UNKNOWN otherwise.
+    SentenceType parse(const NmeaSentence& sentence);
+
+    EpochAssembler& epochs() { return mEpochs; }
+    const SatelliteTable& satellites() const { return mSatellites; }
+    // For decoders of other protocols, which merge into the same sky.
+    SatelliteTable& satellites() { return mSatellites; }
+
+    // Constellation implied by a talker ID or a GSA system ID; UNKNOWN for "GN".
+    static Constellation talkerConstellation(std::string_view talkerId);
+    static Constellation systemIdConstellation(int systemId);
+    // Maps an NMEA satellite number onto the Android constellation and svid ranges (SBAS
+    // 120-158, GLONASS slot 1-24, QZSS 193-202, ...). |system| is the constellation the sentence
+    // belongs to, or UNKNOWN to fall back on the legacy combined numbering of the "GN" talker.
+    static bool normalizeSatellite(Constellation system, int nmeaSvid,
+                                   Constellation& constellation, int& svid);
+
+private:
+    template <typename Schema>
+    bool parseWith(const NmeaSentence& sentence);
+    bool parseGSV(const NmeaSentence& fields);
+
+    // Each returns whether the sentence was accepted.
+    bool apply(const GgaSentence& gga);
+    bool apply(const GnsSentence& gns);
+    bool apply(const RmcSentence& rmc);
+    bool apply(const VtgSentence& vtg);
+    bool apply(const GsaSentence& gsa);
+    bool apply(const GllSentence& gll);
+    bool apply(const ZdaSentence& zda);
+    bool apply(const GstSentence& gst);
+    void applyPosition(const PositionSentence& position);
+
+    EpochAssembler mEpochs;
+
+    SatelliteTable mSatellites;
+    // Bursts in which the table was last aged and the used-in-fix set last rebuilt.
+    uint32_t mAgedBurst = 0;
+    uint32_t mUsedBurst = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -7,69 +7,165 @@
 
 #include "NmeaReader.h"
 #include <android-base/logging.h>
-#include <fcntl.h>
-#include <termios.h>
-#include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
+#include <algorithm>
 #include <cstring>
-#include <cstdlib>
 #include <cmath>
+#include <iterator>
 #include <errno.h>
 
 namespace aidl::android::hardware::gnss::implementation {
 
-static constexpr int READ_BUFFER_SIZE = 4096;
+static_assert(FIX_HAS_LAT_LONG == GnssLocation::HAS_LAT_LONG &&
+              FIX_HAS_ALTITUDE == GnssLocation::HAS_ALTITUDE &&
+              FIX_HAS_SPEED == GnssLocation::HAS_SPEED &&
+              FIX_HAS_BEARING == GnssLocation::HAS_BEARING &&
+              FIX_HAS_HORIZONTAL_ACCURACY == GnssLocation::HAS_HORIZONTAL_ACCURACY &&
+              FIX_HAS_VERTICAL_ACCURACY == GnssLocation::HAS_VERTICAL_ACCURACY &&
+              FIX_HAS_SPEED_ACCURACY == GnssLocation::HAS_SPEED_ACCURACY &&
+              FIX_HAS_BEARING_ACCURACY == GnssLocation::HAS_BEARING_ACCURACY,
+              "FixFlags must mirror GnssLocation flags");
+static_assert(MEASUREMENT_STATE_CODE_LOCK == GnssMeasurement::STATE_CODE_LOCK &&
+              MEASUREMENT_STATE_TOW_DECODED == GnssMeasurement::STATE_TOW_DECODED &&
+              MEASUREMENT_STATE_GLO_TOD_DECODED == GnssMeasurement::STATE_GLO_TOD_DECODED &&
+              MEASUREMENT_STATE_GAL_E1BC_CODE_LOCK == GnssMeasurement::STATE_GAL_E1BC_CODE_LOCK &&
+              MEASUREMENT_STATE_TOW_KNOWN == GnssMeasurement::STATE_TOW_KNOWN &&
+              MEASUREMENT_STATE_GLO_TOD_KNOWN == GnssMeasurement::STATE_GLO_TOD_KNOWN &&
+              ADR_STATE_VALID == GnssMeasurement::ADR_STATE_VALID &&
+              ADR_STATE_RESET == GnssMeasurement::ADR_STATE_RESET &&
+              ADR_STATE_HALF_CYCLE_RESOLVED == GnssMeasurement::ADR_STATE_HALF_CYCLE_RESOLVED,
+              "MeasurementState and AdrState must mirror GnssMeasurement");
+// Loop slots taken in start(): four timers of the reader's, and per receiver its input, epoch
+// timer and reconnect timer. More sources than fit would fail addTimer() at run time.
+static_assert(4 + 3 * FixFusion::MAX_SOURCES <= EventLoop::MAX_SLOTS,
+              "EventLoop::MAX_SLOTS too small for FixFusion::MAX_SOURCES receivers");
 
-NmeaReader::NmeaReader(const std::string& device, int,
-                       LocationCallback locationCb, NmeaCallback nmeaCb, SvStatusCallback svCb)
-    : mDevice(device), mUartFd(-1), mRunning(false), mMinIntervalMs(1000),
-      mLastLocationReportMs(0), mLastSvReportMs(0),
-      mLocationCallback(std::move(locationCb)), mNmeaCallback(std::move(nmeaCb)),
-      mSvStatusCallback(std::move(svCb)), mHasValidFix(false), mFixQuality(0), mNumSatellites(0) {
-    memset(&mCurrentLocation, 0, sizeof(mCurrentLocation));
-    LOG(INFO) << "NmeaReader BLOCKING FIX created";
+NmeaReader::NmeaReader(const std::vector<std::string>& devices, int baudRate,
+                       const std::string& ppsDevice, LocationCallback locationCb,
+                       NmeaCallback nmeaCb, SvStatusCallback svCb,
+                       MeasurementCallback measurementCb)
+    : mBaudRate(baudRate), mPreferredBaudRate(0),
+      mOutputTimer(-1), mConfigTimer(-1), mFusionTimer(-1), mDutyTimer(-1), mRunning(false),
+      mSuspended(false), mKeepWarmMs(-1), mMinIntervalMs(1000),
+      mLastLocationReportMs(0), mLastReportedUtcMs(-1),
+      mSvStatusEnabled(false), mSvFilterReset(false),
+      mMeasurementsEnabled(false), mMeasurementIntervalMs(0),
+      mDispatcher(std::move(locationCb), std::move(nmeaCb), std::move(svCb),
+                  std::move(measurementCb)),
+      mCaptureBytes(0), mFusion(devices.size()), mPreferredSource(0), mEngineOn(true),
+      mPublishing(true), mReceivedNs(0), mStartNs(0), mAwaitingFirstFix(false), mAssisted(false),
+      mAssistanceChanged(false), mHaveTimeAid(false), mHavePositionAid(false),
+      mAidingChanged(false), mPendingRestart(-1), mBlocklistChanged(false),
+      mBlockedConstellations(0),
+      mUtcDaysSinceEpoch(-1), mLastEpochUtcMs(-1),
+      mOutputIntervalMs(0), mEpochIntervalMs(0), mLastFixUnixMs(0),
+      mLastFixTimeNs(0), mLastFixTimeUncertaintyNs(0), mLastMeasurementNs(0),
+      mHwClockDiscontinuityCount(0) {
+    for (const std::string& device : devices) {
+        if (mSources.size() == FixFusion::MAX_SOURCES) {
+            LOG(WARNING) << "Only " << FixFusion::MAX_SOURCES << " receivers read, not " << device;
+            break;
+        }
+        mSources.push_back(std::make_unique<Source>(
+                mSources.size(), ByteSource::create(device, mSources.size(), baudRate)));
+    }
+    if (!ppsDevice.empty()) mPps = std::make_unique<PpsSource>(ppsDevice);
+    LOG(INFO) << "NmeaReader created for " << mSources.size() << " receiver(s)";
 }
 
 NmeaReader::~NmeaReader() { stop(); }
 
-bool NmeaReader::openUart() {
-    // Tryb blokujacy (brak O_NONBLOCK)
-    mUartFd = open(mDevice.c_str(), O_RDWR | O_NOCTTY);
-    if (mUartFd < 0) {
-        LOG(ERROR) << "Failed to open UART: " << strerror(errno);
-        return false;
+bool NmeaReader::openInput(Source& source) {
+    if (source.input->open() &&
+        mLoop.watch(source.input->fd(), [this, &source]() { onInputReadable(source); })) {
+        return true;
     }
-    
-    struct termios tty;
-    memset(&tty, 0, sizeof(tty));
-    if (tcgetattr(mUartFd, &tty) != 0) { close(mUartFd); return false; }
-    
-    cfsetospeed(&tty, B115200);
-    cfsetispeed(&tty, B115200);
-    
-    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
-    tty.c_cflag |= (CLOCAL | CREAD);
-    tty.c_cflag &= ~(PARENB | PARODD | CSTOPB | CRTSCTS);
-    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
-    tty.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
-    tty.c_oflag &= ~OPOST;
-    
-    // Czekaj na min. 1 znak
-    tty.c_cc[VMIN] = 1;
-    tty.c_cc[VTIME] = 0;
-    
-    if (tcsetattr(mUartFd, TCSANOW, &tty) != 0) { close(mUartFd); return false; }
-    
-    tcflush(mUartFd, TCIOFLUSH);
-    LOG(INFO) << "UART opened in BLOCKING mode: " << mDevice;
-    return true;
+    source.input->close();
+    return false;
 }
 
-void NmeaReader::closeUart() { if (mUartFd >= 0) { close(mUartFd); mUartFd = -1; } }
+void NmeaReader::closeInput(Source& source) {
+    if (source.input->fd() >= 0) mLoop.unwatch(source.input->fd());
+    source.input->close();
+}
 
 bool NmeaReader::start() {
-    if (mRunning.load()) return true;
-    if (!openUart()) return false;
+    if (mRunning.load()) {
+        // Suspended: the reader thread resumes publishing, the engine wakes if in standby.
+        if (mSuspended.exchange(false)) {
+            {
+                std::lock_guard<std::mutex> lock(mPowerMutex);
+                mDutyCycle.start(getBoottimeNs() / 1000000);
+            }
+            mLoop.wake();
+        }
+        return true;
+    }
+    if (mSources.empty() || !mLoop.open()) return false;
+    if (mConfigTimer < 0) {
+        mOutputTimer = mLoop.addTimer([this]() { publishInterpolated(); });
+        // Nothing to do in the handler: onLoopIteration() runs after every event.
+        mConfigTimer = mLoop.addTimer([]() {});
+        // Sources that are late for an epoch are not waited for any longer.
+        mFusionTimer = mLoop.addTimer([this]() {
+            mFusion.flush([this](const FixFusion::Solution& solution) { publishFix(solution); });
+        });
+        // Also only there to make the loop go round.
+        mDutyTimer = mLoop.addTimer([]() {});
+        for (auto& source : mSources) {
+            Source& s = *source;
+            s.epochTimer = mLoop.addTimer([this, &s]() { onEpochIdle(s); });
+            s.reconnectTimer = mLoop.addTimer([this, &s]() { reconnectInput(s); });
+        }
+        if (mOutputTimer < 0) LOG(WARNING) << "No output timer, no interpolated output";
+    }
+    // One receiver is enough to start; the others are retried from the loop.
+    const int64_t nowMs = getBoottimeNs() / 1000000;
+    size_t opened = 0;
+    for (auto& source : mSources) {
+        Source& s = *source;
+        s.demux.reset();
+        s.clock.reset();
+        s.lastBinaryFixNs = 0;
+        s.reconnectDelayMs = 0;
+        s.config.reset(mBaudRate, nowMs);
+        if (openInput(s)) {
+            opened++;
+        } else {
+            disconnectInput(s, "not available");
+        }
+    }
+    if (opened == 0 || !mDispatcher.start()) {
+        for (auto& source : mSources) closeInput(*source);
+        mLoop.disarmAll();
+        return false;
+    }
+    mOutputIntervalMs = 0;
+    mEpochIntervalMs = 0;
+    mLocationFilter.reset();
+    mFusion.reset();
+    mPreferredSource = 0;
+    mEngineOn = true;
+    {
+        std::lock_guard<std::mutex> lock(mPowerMutex);
+        mDutyCycle.start(nowMs);
+    }
+    mLastReportedUtcMs = -1;
+    mLastMeasurementNs = 0;
+    mSvFilterReset.store(true);
+    mStartNs = getBoottimeNs();
+    mAwaitingFirstFix = true;
+    mAssisted = false;
+    // The receivers' state is unknown, what they were sent before included.
+    mAssistanceChanged.store(true);
+    if (mPps && !mPps->open()) LOG(INFO) << "No PPS, fix times from byte arrival only";
+    if (!mCapturePath.empty() && !mRecorder.isOpen()) {
+        if (mRecorder.open(mCapturePath, mCaptureBytes)) {
+            LOG(INFO) << "Capturing received bytes to " << mCapturePath;
+        } else {
+            LOG(WARNING) << "Cannot capture to " << mCapturePath << ": " << strerror(errno);
+        }
+    }
     mRunning.store(true);
     mReaderThread = std::thread(&NmeaReader::readerThreadFunc, this);
     return true;
@@ -78,215 +174,748 @@ bool NmeaReader::start() {
 void NmeaReader::stop() {
     if (!mRunning.load()) return;
     mRunning.store(false);
-    closeUart(); // Wymusza odblokowanie read()
+    // The loop returns from epoll_wait() at once; nothing is closed until it has.
+    mLoop.stop();
     if (mReaderThread.joinable()) mReaderThread.join();
+    mSuspended.store(false);
+    mPublishing = true;
+    for (auto& source : mSources) {
+        powerOffReceiver(*source);
+        closeInput(*source);
+    }
+    mLoop.disarmAll();
+    {
+        std::lock_guard<std::mutex> lock(mPowerMutex);
+        mDutyCycle.stop(getBoottimeNs() / 1000000);
+    }
+    // Not stopped: a client callback in progress may be waiting on the caller.
+    mDispatcher.discard();
+    if (mPps) mPps->close();
+}
+
+void NmeaReader::suspend() {
+    if (mKeepWarmMs < 0) {
+        stop();
+        return;
+    }
+    if (!mRunning.load() || mSuspended.exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> lock(mPowerMutex);
+        mDutyCycle.suspend(getBoottimeNs() / 1000000, mKeepWarmMs);
+    }
+    mLoop.wake();
+    LOG(INFO) << "Reader suspended, receivers tracking for " << mKeepWarmMs << " ms";
+}
+
+DutyCycle::Stats NmeaReader::powerStats() const {
+    std::lock_guard<std::mutex> lock(mPowerMutex);
+    return mDutyCycle.stats(getBoottimeNs() / 1000000);
+}
+
+NmeaReader::Metrics NmeaReader::metrics() const {
+    Metrics metrics;
+    for (const auto& source : mSources) {
+        Metrics::Input input;
+        input.name = source->input->name();
+        input.bytes = source->bytes.load();
+        input.errors = source->errors.load();
+        input.nmea.sentences = source->sentences.load();
+        input.nmea.checksumErrors = source->checksumErrors.load();
+        input.nmea.overflows = source->overflows.load();
+        input.nmea.malformed = source->malformed.load();
+        input.binary.frames = source->frames.load();
+        input.binary.checksumErrors = source->frameChecksumErrors.load();
+        input.binary.oversize = source->oversizeFrames.load();
+        input.assistanceRecords = source->assistanceRecords.load();
+        input.assistanceTotal = source->assistanceTotal.load();
+        input.assistanceUploads = source->assistanceUploads.load();
+        input.assistanceFailures = source->assistanceFailures.load();
+        metrics.inputs.push_back(std::move(input));
+    }
+    for (size_t i = 0; i < static_cast<size_t>(SentenceType::COUNT); i++) {
+        metrics.sentences[i] = mSentenceCounts[i].load();
+    }
+    for (size_t i = 0; i < std::size(mTtff); i++) {
+        Metrics::TimeToFirstFix& ttff = metrics.ttff[i];
+        ttff.count = mTtff[i].count.load();
+        ttff.lastMs = static_cast<int64_t>(mTtff[i].lastMs.load());
+        ttff.maxMs = static_cast<int64_t>(mTtff[i].maxMs.load());
+        ttff.meanMs = ttff.count > 0 ? static_cast<int64_t>(mTtff[i].sumMs.load() / ttff.count) : 0;
+    }
+    return metrics;
 }
 
-void NmeaReader::setMinInterval(int32_t intervalMs) { mMinIntervalMs.store(intervalMs); }
+void NmeaReader::setAssistanceData(std::shared_ptr<const std::vector<uint8_t>> epo) {
+    {
+        std::lock_guard<std::mutex> lock(mAssistanceMutex);
+        if (epo == mAssistanceData) return;
+        mAssistanceData = std::move(epo);
+    }
+    mAssistanceChanged.store(true);
+    mLoop.wake();
+}
+
+void NmeaReader::setTimeAid(const ReceiverConfig::TimeAid* aid) {
+    {
+        std::lock_guard<std::mutex> lock(mAssistanceMutex);
+        mHaveTimeAid = aid != nullptr;
+        if (aid != nullptr) mTimeAid = *aid;
+    }
+    mAidingChanged.store(true);
+    mLoop.wake();
+}
+
+void NmeaReader::setPositionAid(const ReceiverConfig::PositionAid* aid) {
+    {
+        std::lock_guard<std::mutex> lock(mAssistanceMutex);
+        mHavePositionAid = aid != nullptr;
+        if (aid != nullptr) mPositionAid = *aid;
+    }
+    mAidingChanged.store(true);
+    mLoop.wake();
+}
+
+void NmeaReader::restartReceivers(ReceiverConfig::Restart kind) {
+    mPendingRestart.store(static_cast<int>(kind));
+    mLoop.wake();
+}
+
+void NmeaReader::setBlocklist(const SvBlocklist& blocklist) {
+    {
+        std::lock_guard<std::mutex> lock(mAssistanceMutex);
+        if (blocklist == mBlocklist) return;
+        mBlocklist = blocklist;
+    }
+    mBlocklistChanged.store(true);
+    mLoop.wake();
+}
+
+// Setters wake the loop so the receiver and the output timer follow right away.
+void NmeaReader::setMinInterval(int32_t intervalMs) {
+    mMinIntervalMs.store(intervalMs);
+    mLoop.wake();
+}
+
+void NmeaReader::setSvStatusEnabled(bool enabled) {
+    // A new client gets the current sky on the next epoch, changed or not.
+    if (enabled) mSvFilterReset.store(true);
+    mSvStatusEnabled.store(enabled);
+    mLoop.wake();
+}
+
+void NmeaReader::setMeasurementOptions(bool enabled, int32_t intervalMs) {
+    mMeasurementIntervalMs.store(intervalMs);
+    mMeasurementsEnabled.store(enabled);
+    mLoop.wake();
+}
 
 int64_t NmeaReader::getCurrentTimestampMs() {
-    struct timeval tv; gettimeofday(&tv, nullptr);
-    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    struct timespec ts; clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t NmeaReader::getBoottimeNs() {
+    struct timespec ts; clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
 void NmeaReader::readerThreadFunc() {
-    char buffer[READ_BUFFER_SIZE];
-    char nmeaBuffer[NMEA_MAX_SIZE];
-    int nmeaPos = 0;
-    
-    LOG(INFO) << "Reader thread started (Blocking wait)...";
-    
-    while (mRunning.load()) {
-        if (mUartFd < 0) break;
-
-        // Czekaj na dane
-        int bytesRead = read(mUartFd, buffer, sizeof(buffer) - 1);
-        
-        if (bytesRead > 0) {
-            for (int i = 0; i < bytesRead; i++) {
-                char c = buffer[i];
-                if (c == '$') nmeaPos = 0;
-                if (nmeaPos < NMEA_MAX_SIZE - 1) nmeaBuffer[nmeaPos++] = c;
-                if (c == '\n' || c == '\r') {
-                    if (nmeaPos > 10) {
-                        nmeaBuffer[nmeaPos] = '\0';
-                        processNmeaSentence(std::string(nmeaBuffer));
-                    }
-                    nmeaPos = 0;
-                }
-            }
-            
-            // Raportuj satelity
-            int64_t now = getCurrentTimestampMs();
-            if (now - mLastSvReportMs >= SV_REPORT_INTERVAL_MS) {
-                mLastSvReportMs = now;
-                if (mSvStatusCallback && !mSatellites.empty()) {
-                    std::lock_guard<std::mutex> lock(mSvMutex);
-                    std::vector<GnssSvInfo> svList;
-                    for (const auto& [key, info] : mSatellites) svList.push_back(info);
-                    if (!svList.empty()) mSvStatusCallback(svList);
-                }
+    LOG(INFO) << "Reader thread started";
+    mLoop.run([this]() { onLoopIteration(); });
+    LOG(INFO) << "Reader thread stopped";
+}
+
+void NmeaReader::onLoopIteration() {
+    if (const bool publishing = !mSuspended.load(); publishing != mPublishing) {
+        mPublishing = publishing;
+        if (publishing) onResume();
+    }
+    updateOutputTimer();
+    updateDutyCycle();
+    if (mAssistanceChanged.exchange(false)) {
+        std::shared_ptr<const std::vector<uint8_t>> epo;
+        {
+            std::lock_guard<std::mutex> lock(mAssistanceMutex);
+            epo = mAssistanceData;
+        }
+        const int64_t nowUnixMs = getCurrentTimestampMs();
+        for (auto& source : mSources) source->epo.start(epo, nowUnixMs);
+    }
+    if (mAidingChanged.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mAssistanceMutex);
+        // Each config keeps its copy, to send again after a reset.
+        for (auto& source : mSources) {
+            source->config.setTimeAid(mHaveTimeAid ? &mTimeAid : nullptr);
+            source->config.setPositionAid(mHavePositionAid ? &mPositionAid : nullptr);
+        }
+    }
+    if (mBlocklistChanged.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mAssistanceMutex);
+        for (auto& source : mSources) source->parser.satellites().setBlocklist(mBlocklist);
+        mBlockedConstellations = 0;
+        for (uint8_t c = 1; c < SvBlocklist::CONSTELLATIONS; c++) {
+            if (mBlocklist.constellationBlocked(static_cast<Constellation>(c))) {
+                mBlockedConstellations |= static_cast<uint8_t>(1u << c);
             }
-        } else if (bytesRead < 0) {
-            LOG(ERROR) << "UART Read Error: " << strerror(errno);
-            usleep(1000000); 
         }
     }
+    if (const int restart = mPendingRestart.exchange(-1); restart >= 0) {
+        for (auto& source : mSources) {
+            source->config.restart(static_cast<ReceiverConfig::Restart>(restart));
+        }
+        // A cold restart forgets the time too; the first epochs after it may be behind.
+        mFusion.resync();
+    }
+    int64_t configDeadlineMs = -1;
+    auto earliest = [&configDeadlineMs](int64_t deadlineMs) {
+        if (deadlineMs >= 0 && (configDeadlineMs < 0 || deadlineMs < configDeadlineMs)) {
+            configDeadlineMs = deadlineMs;
+        }
+    };
+    for (auto& source : mSources) {
+        // A replay plays back the receiver as it was set up; nothing here can change that.
+        if (!source->input->writable()) continue;
+        configureReceiver(*source);
+        earliest(source->config.nextDeadlineMs());
+        if (assistanceAllowed(*source)) {
+            uploadAssistance(*source);
+            earliest(source->epo.nextDeadlineMs());
+        }
+    }
+    mLoop.setTimer(mConfigTimer, configDeadlineMs >= 0 ? configDeadlineMs * NS_PER_MS : -1);
+    mLoop.setTimer(mFusionTimer,
+                   mFusion.pending() ? mFusion.pendingSinceNs() + FUSION_WAIT_NS : -1);
+    mDispatcher.wake();
 }
 
-void NmeaReader::processNmeaSentence(const std::string& sentence) {
-    if (sentence.length() < 10) return;
-    
-    int64_t timestamp = getCurrentTimestampMs();
-    if (mNmeaCallback) mNmeaCallback(timestamp, sentence);
-    
-    if (sentence.find("GGA") != std::string::npos) parseGGA(sentence);
-    else if (sentence.find("RMC") != std::string::npos) parseRMC(sentence);
-    else if (sentence.find("GSV") != std::string::npos) parseGSV(sentence);
-    else if (sentence.find("GSA") != std::string::npos) parseGSA(sentence);
-    else if (sentence.find("VTG") != std::string::npos) parseVTG(sentence);
-    
-    if (mHasValidFix && mLocationCallback) {
-        int64_t now = getCurrentTimestampMs();
-        if (now - mLastLocationReportMs >= mMinIntervalMs.load()) {
-            mLastLocationReportMs = now;
-            std::lock_guard<std::mutex> lock(mLocationMutex);
-            mCurrentLocation.timestampMillis = now;
-            mCurrentLocation.elapsedRealtime.flags = ElapsedRealtime::HAS_TIMESTAMP_NS | ElapsedRealtime::HAS_TIME_UNCERTAINTY_NS;
-            mCurrentLocation.elapsedRealtime.timestampNs = now * 1000000LL;
-            mCurrentLocation.elapsedRealtime.timeUncertaintyNs = 1000000.0;
-            mLocationCallback(mCurrentLocation);
+void NmeaReader::updateDutyCycle() {
+    const int64_t nowMs = getBoottimeNs() / 1000000;
+    bool engineOn;
+    int64_t deadlineMs;
+    {
+        std::lock_guard<std::mutex> lock(mPowerMutex);
+        mDutyCycle.setInterval(mMinIntervalMs.load(), !mMeasurementsEnabled.load(), nowMs);
+        engineOn = mDutyCycle.engineOn();
+        deadlineMs = mDutyCycle.nextDeadlineMs();
+    }
+    mLoop.setTimer(mDutyTimer, deadlineMs >= 0 ? deadlineMs * NS_PER_MS : -1);
+    if (engineOn == mEngineOn) return;
+    mEngineOn = engineOn;
+    if (engineOn) {
+        LOG(INFO) << "Receiver waking for the next fix";
+    } else if (deadlineMs >= 0) {
+        LOG(INFO) << "Receiver in standby, waking in " << deadlineMs - nowMs << " ms";
+    } else {
+        LOG(INFO) << "Receiver in standby until resumed";
+    }
+}
+
+void NmeaReader::onResume() {
+    const int64_t nowNs = getBoottimeNs();
+    mSvFilterReset.store(true);
+    mLastReportedUtcMs = -1;
+    mStartNs = nowNs;
+    // The receivers may have been restarted while suspended, their time with them.
+    mFusion.resync();
+    // Built while suspended but not published; see publishFix().
+    const bool fresh = (mCurrentLocation.gnssLocationFlags & GnssLocation::HAS_LAT_LONG) &&
+                       nowNs - mCurrentLocation.elapsedRealtime.timestampNs < MAX_CACHED_FIX_AGE_NS;
+    mAwaitingFirstFix = !fresh;
+    if (!fresh) {
+        LOG(INFO) << "Reader resumed, no fresh fix";
+        return;
+    }
+    LOG(INFO) << "Reader resumed, serving a fix "
+              << (nowNs - mCurrentLocation.elapsedRealtime.timestampNs) / NS_PER_MS << " ms old";
+    // The next receiver epoch is throttled against this one.
+    mLastReportedUtcMs = mLastEpochUtcMs;
+    mLastLocationReportMs = nowNs / NS_PER_MS;
+    mDispatcher.postLocation(mCurrentLocation, 0);
+}
+
+void NmeaReader::onInputReadable(Source& source) {
+    if (source.input->fd() < 0) return;
+    // One read per wake-up: the loop is level-triggered, so whatever is left comes next time,
+    // and the chunk timing below stays right. The buffer is shared by all sources; each chunk
+    // is consumed before the next read.
+    int64_t readNs = 0;
+    ssize_t bytesRead = source.input->read(mReadBuffer, sizeof(mReadBuffer), readNs);
+    if (bytesRead < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    if (bytesRead <= 0) {
+        disconnectInput(source, bytesRead == 0 ? "hung up" : strerror(errno));
+        return;
+    }
+    source.reconnectDelayMs = 0;
+    source.bytes.add(static_cast<uint64_t>(bytesRead));
+    mReceivedNs = getBoottimeNs();
+    const int64_t byteTimeNs = source.input->byteTimeNs();
+    if (mRecorder.isOpen() && !source.input->isReplay()) {
+        mRecorder.append(static_cast<uint8_t>(source.index), readNs, byteTimeNs, mReadBuffer,
+                         static_cast<size_t>(bytesRead));
+    }
+
+    // The chunk's last byte arrived at readNs and the earlier ones one byte time apart before it.
+    source.demux.setChunkTiming(mReadBuffer + bytesRead, readNs, byteTimeNs);
+    const char* cursor = mReadBuffer;
+    for (;;) {
+        StreamDemux::Output output =
+                source.demux.next(cursor, mReadBuffer + bytesRead, mSentence, mFrame);
+        if (output == StreamDemux::Output::NMEA) {
+            processNmeaSentence(source, mSentence);
+        } else if (output == StreamDemux::Output::BINARY) {
+            processBinaryFrame(source, mFrame);
+        } else {
+            break;
         }
     }
+    const NmeaFramer::Stats& nmea = source.demux.nmeaStats();
+    source.sentences.set(nmea.sentences);
+    source.checksumErrors.set(nmea.checksumErrors);
+    source.overflows.set(nmea.overflows);
+    source.malformed.set(nmea.malformed);
+    const BinaryFramer::Stats& binary = source.demux.binaryStats();
+    source.frames.set(binary.frames);
+    source.frameChecksumErrors.set(binary.checksumErrors);
+    source.oversizeFrames.set(binary.oversize);
+
+    // A burst that ends without its usual last sentence is published once the line goes quiet,
+    // on the loop's clock: a fast replay's stamps run ahead of it.
+    mLoop.setTimer(source.epochTimer,
+                   source.parser.epochs().isOpen()
+                           ? std::min(readNs, mReceivedNs) + EPOCH_IDLE_TIMEOUT_MS * NS_PER_MS
+                           : -1);
 }
 
-bool NmeaReader::parseGGA(const std::string& sentence) {
-    auto fields = splitString(sentence, ',');
-    if (fields.size() < 15) return false;
-    
-    mFixQuality = 0;
-    if (!fields[6].empty()) mFixQuality = std::atoi(fields[6].c_str());
-    
-    if (mFixQuality > 0) mHasValidFix = true;
-    else { mHasValidFix = false; return false; }
-    
-    std::lock_guard<std::mutex> lock(mLocationMutex);
-    if (!fields[2].empty()) mCurrentLocation.latitudeDegrees = nmeaToDecimal(std::atof(fields[2].c_str()), fields[3][0]);
-    if (!fields[4].empty()) mCurrentLocation.longitudeDegrees = nmeaToDecimal(std::atof(fields[4].c_str()), fields[5][0]);
-    if (!fields[7].empty()) mNumSatellites = std::atoi(fields[7].c_str());
-    
-    mCurrentLocation.horizontalAccuracyMeters = 5.0;
-    if (!fields[8].empty()) {
-        float hdop = std::atof(fields[8].c_str());
-        if(hdop > 0) mCurrentLocation.horizontalAccuracyMeters = hdop * 4.0;
+void NmeaReader::onEpochIdle(Source& source) {
+    if (source.parser.epochs().flush()) publishEpoch(source);
+}
+
+void NmeaReader::disconnectInput(Source& source, const char* reason) {
+    source.errors.add();
+    source.reconnectDelayMs = source.reconnectDelayMs > 0
+            ? std::min(source.reconnectDelayMs * 2, MAX_RECONNECT_DELAY_MS)
+            : MIN_RECONNECT_DELAY_MS;
+    LOG(ERROR) << source.input->name() << " " << reason << ", reopening in "
+               << source.reconnectDelayMs << " ms";
+    closeInput(source);
+    mLoop.setTimer(source.epochTimer, -1);
+    mLoop.setTimer(source.reconnectTimer, getBoottimeNs() + source.reconnectDelayMs * NS_PER_MS);
+}
+
+void NmeaReader::reconnectInput(Source& source) {
+    if (source.input->fd() >= 0) return;
+    if (!openInput(source)) {
+        source.reconnectDelayMs = std::min(source.reconnectDelayMs * 2, MAX_RECONNECT_DELAY_MS);
+        mLoop.setTimer(source.reconnectTimer,
+                       getBoottimeNs() + source.reconnectDelayMs * NS_PER_MS);
+        return;
     }
-    mCurrentLocation.gnssLocationFlags |= GnssLocation::HAS_HORIZONTAL_ACCURACY | GnssLocation::HAS_LAT_LONG;
-    
-    if (!fields[9].empty()) {
-        mCurrentLocation.altitudeMeters = std::atof(fields[9].c_str());
-        mCurrentLocation.gnssLocationFlags |= GnssLocation::HAS_ALTITUDE;
+    // The receiver may have been power-cycled with the UART: assume nothing about it.
+    source.demux.reset();
+    source.config.reset(mBaudRate, getBoottimeNs() / 1000000);
+    source.epo.restart(getCurrentTimestampMs());
+    mFusion.resync();
+}
+
+void NmeaReader::configureReceiver(Source& source) {
+    if (source.input->fd() < 0) return;
+    ReceiverConfig::Settings settings;
+    settings.fixIntervalMs = mMinIntervalMs.load();
+    settings.satellites = mSvStatusEnabled.load();
+    settings.baudRate = mPreferredBaudRate;
+    settings.measurements = mMeasurementsEnabled.load();
+    settings.engine = mEngineOn;
+    settings.blockedConstellations = mBlockedConstellations;
+    source.config.setDesired(settings);
+
+    const int64_t nowMs = getBoottimeNs() / 1000000;
+    for (;;) {
+        ReceiverConfig::Action action = source.config.poll(nowMs);
+        if (action.kind == ReceiverConfig::Action::NONE) break;
+        switch (action.kind) {
+            case ReceiverConfig::Action::WRITE:
+                if (!source.input->write(action.text)) {
+                    LOG(WARNING) << "PAIR" << action.command << " write failed: " << strerror(errno);
+                    source.errors.add();
+                }
+                break;
+            case ReceiverConfig::Action::SET_HOST_BAUD:
+                LOG(INFO) << source.input->name() << " now at " << action.baudRate;
+                if (!source.input->setBaudRate(action.baudRate)) {
+                    LOG(ERROR) << "Cannot set UART to " << action.baudRate << ": " << strerror(errno);
+                    source.errors.add();
+                    break;
+                }
+                // Bytes already framed at the old rate are garbage at the new one.
+                source.demux.reset();
+                break;
+            case ReceiverConfig::Action::GAVE_UP:
+                LOG(WARNING) << source.input->name() << " did not accept PAIR" << action.command
+                             << (action.result < 0 ? " (no answer)"
+                                                   : " (result " + std::to_string(action.result) + ")");
+                break;
+            default:
+                break;
+        }
     }
-    return true;
 }
 
-bool NmeaReader::parseRMC(const std::string& sentence) {
-    auto fields = splitString(sentence, ',');
-    if (fields.size() < 10) return false;
-    if (fields[2].empty() || fields[2][0] != 'A') return false;
-    
-    { std::lock_guard<std::mutex> svLock(mSvMutex); mSatsUsedInFix.clear(); }
-    std::lock_guard<std::mutex> lock(mLocationMutex);
-    if (!fields[7].empty()) {
-        mCurrentLocation.speedMetersPerSec = std::atof(fields[7].c_str()) * 0.514444;
-        mCurrentLocation.gnssLocationFlags |= GnssLocation::HAS_SPEED;
+bool NmeaReader::assistanceAllowed(const Source& source) const {
+    return source.input->fd() >= 0 && source.config.linkVerified() &&
+           source.config.nextDeadlineMs() < 0 && mEngineOn;
+}
+
+void NmeaReader::uploadAssistance(Source& source) {
+    const int64_t nowMs = getBoottimeNs() / 1000000;
+    for (;;) {
+        EpoUploader::Action action = source.epo.poll(nowMs);
+        if (action.kind == EpoUploader::Action::NONE) break;
+        switch (action.kind) {
+            case EpoUploader::Action::WRITE:
+            case EpoUploader::Action::DONE:
+                // A packet that does not go out is sent again on the timeout.
+                if (!source.input->write(action.data)) {
+                    LOG(WARNING) << "EPO packet write failed: " << strerror(errno);
+                    source.errors.add();
+                }
+                if (action.kind == EpoUploader::Action::DONE) {
+                    LOG(INFO) << source.input->name() << " has " << source.epo.recordsTotal()
+                              << " EPO records";
+                    mAssisted = true;
+                }
+                break;
+            case EpoUploader::Action::GAVE_UP:
+                LOG(WARNING) << source.input->name() << " did not accept EPO packet "
+                             << action.sequence << ", upload abandoned";
+                break;
+            default:
+                break;
+        }
     }
-    if (!fields[8].empty()) {
-        mCurrentLocation.bearingDegrees = std::atof(fields[8].c_str());
-        mCurrentLocation.gnssLocationFlags |= GnssLocation::HAS_BEARING;
+    const EpoUploader::Stats& stats = source.epo.stats();
+    source.assistanceRecords.set(source.epo.recordsDone());
+    source.assistanceTotal.set(source.epo.recordsTotal());
+    source.assistanceUploads.set(stats.uploads);
+    source.assistanceFailures.set(stats.failures);
+}
+
+void NmeaReader::powerOffReceiver(Source& source) {
+    if (source.input->fd() < 0 || !source.input->writable()) return;
+    ReceiverConfig::Action action = source.config.powerOff();
+    if (action.kind != ReceiverConfig::Action::WRITE) return;
+    if (!source.input->write(action.text)) {
+        LOG(WARNING) << "PAIR" << action.command << " write failed: " << strerror(errno);
+        return;
     }
-    return true;
+    source.input->drain();
 }
 
-bool NmeaReader::parseGSV(const std::string& sentence) {
-    auto fields = splitString(sentence, ',');
-    if (fields.size() < 4) return false;
-    std::string talkerId = sentence.substr(1, 2);
+void NmeaReader::processNmeaSentence(Source& source, const NmeaSentence& sentence) {
+    // Acknowledgements of our own commands are not receiver output, keep them to ourselves.
+    const int64_t nowMs = sentence.arrivalNs / 1000000;
+    source.config.onSentence(nowMs);
+    if (source.config.onAck(sentence, nowMs)) return;
+
+    // Several receivers' sentences interleaved would make no stream; pass one through.
+    if (mPublishing && source.index == mPreferredSource) {
+        mDispatcher.postNmea(getCurrentTimestampMs(), sentence.text, mReceivedNs);
+    }
     
-    std::lock_guard<std::mutex> lock(mSvMutex);
-    for (size_t i = 4; i + 3 < fields.size(); i += 4) {
-        if (fields[i].empty()) continue;
-        int svid = std::atoi(fields[i].c_str());
-        if (svid == 0) continue;
-        GnssSvInfo sv; sv.svid = svid;
-        sv.constellation = getConstellationType(talkerId, svid);
-        if (!fields[i+1].empty()) sv.elevationDegrees = std::atof(fields[i+1].c_str());
-        if (!fields[i+2].empty()) sv.azimuthDegrees = std::atof(fields[i+2].c_str());
-        if (i+3 < fields.size() && !fields[i+3].empty()) {
-            std::string snr = fields[i+3]; size_t star = snr.find('*');
-            if (star != std::string::npos) snr = snr.substr(0, star);
-            if (!snr.empty()) { sv.cN0Dbhz = std::atof(snr.c_str()); sv.basebandCN0DbHz = sv.cN0Dbhz; }
-        }
-        sv.svFlag = (sv.cN0Dbhz > 0) ? static_cast<int32_t>(GnssSvFlags::HAS_CARRIER_FREQUENCY) : 0;
-        for (int used : mSatsUsedInFix) if (used == svid) { sv.svFlag |= static_cast<int32_t>(GnssSvFlags::USED_IN_FIX); break; }
-        mSatellites[(static_cast<int>(sv.constellation) << 16) | svid] = sv;
+    const SentenceType type = source.parser.parse(sentence);
+    mSentenceCounts[static_cast<size_t>(type)].add();
+    if (source.parser.epochs().hasCompleted()) publishEpoch(source);
+}
+
+void NmeaReader::processBinaryFrame(Source& source, const BinaryFrame& frame) {
+    source.config.onSentence(frame.arrivalNs / 1000000);
+    if (source.epo.onFrame(frame, frame.arrivalNs / 1000000)) return;
+    if (!source.binaryParser.parse(frame)) return;
+    if (source.binaryParser.hasRawEpoch()) {
+        source.binaryParser.consumeRawEpoch();
+        if (source.index == mPreferredSource) publishMeasurements(source.binaryParser.rawEpoch());
     }
-    return true;
+    if (!source.binaryParser.hasFix()) return;
+    source.binaryParser.consumeFix();
+    source.lastBinaryFixNs = frame.arrivalNs;
+    offerFix(source, source.binaryParser.fix());
+}
+
+void NmeaReader::publishEpoch(Source& source) {
+    EpochAssembler& epochs = source.parser.epochs();
+    const NmeaFix& fix = epochs.completed();
+    epochs.consumeCompleted();
+
+    // The binary solution is the same epoch at full resolution; NMEA still brings the sky.
+    if (source.lastBinaryFixNs > 0 &&
+        fix.arrivalNs - source.lastBinaryFixNs < BINARY_FIX_TIMEOUT_NS) {
+        reportSatellites();
+        return;
+    }
+    offerFix(source, fix);
 }
 
-bool NmeaReader::parseGSA(const std::string& sentence) {
-    auto fields = splitString(sentence, ',');
-    if (fields.size() < 18) return false;
-    std::lock_guard<std::mutex> lock(mSvMutex);
-    // Akumulujemy satelity z wielu GSA - clear w parseRMC
-    for (int i = 3; i <= 14 && i < (int)fields.size(); i++) {
-        if (!fields[i].empty()) {
-            int svid = std::atoi(fields[i].c_str());
-            if (svid > 0) mSatsUsedInFix.push_back(svid);
+void NmeaReader::offerFix(Source& source, const NmeaFix& fix) {
+    // Every epoch feeds its receiver's clock model, published or not. PPS is wired to the first.
+    if (mPps && source.index == 0) source.clock.onPpsEdge(mPps->latestEdgeNs());
+    EpochClock::Stamp stamp = source.clock.stamp(fix.utcMsOfDay, fix.arrivalNs);
+    const int64_t timeNs = stamp.elapsedRealtimeNs > 0 ? stamp.elapsedRealtimeNs : getBoottimeNs();
+    mFusion.offer(source.index, fix, timeNs, stamp.timeUncertaintyNs,
+                  [this](const FixFusion::Solution& solution) { publishFix(solution); });
+}
+
+void NmeaReader::publishFix(const FixFusion::Solution& solution) {
+    const NmeaFix& fix = solution.fix;
+    if (fix.utcDaysSinceEpoch >= 0) {
+        mUtcDaysSinceEpoch = fix.utcDaysSinceEpoch;
+    } else if (mUtcDaysSinceEpoch >= 0 && fix.utcMsOfDay >= 0 && fix.utcMsOfDay < mLastEpochUtcMs) {
+        mUtcDaysSinceEpoch++;
+    }
+    if (fix.utcMsOfDay >= 0) {
+        if (mLastEpochUtcMs >= 0) {
+            int32_t interval = fix.utcMsOfDay - mLastEpochUtcMs;
+            if (interval < 0) interval += MS_PER_DAY;
+            if (interval > 0 && interval <= MAX_EPOCH_INTERVAL_MS) mEpochIntervalMs = interval;
         }
+        mLastEpochUtcMs = fix.utcMsOfDay;
+    }
+
+    // The epoch's GSV/GSA have all been applied by now, so this is a consistent sky.
+    reportSatellites();
+
+    if (fix.fixQuality <= 0 || !(fix.flags & FIX_HAS_LAT_LONG)) return;
+    mPreferredSource = solution.source;
+    const int64_t now = getBoottimeNs() / 1000000;
+    if (mAwaitingFirstFix) {
+        mAwaitingFirstFix = false;
+        const int64_t ttffMs = now - mStartNs / 1000000;
+        TimeToFirstFix& ttff = mTtff[mAssisted ? 1 : 0];
+        ttff.count.add();
+        ttff.sumMs.add(static_cast<uint64_t>(ttffMs));
+        ttff.lastMs.set(static_cast<uint64_t>(ttffMs));
+        if (ttffMs > static_cast<int64_t>(ttff.maxMs.load())) ttff.maxMs.set(ttffMs);
+        LOG(INFO) << "First fix " << ttffMs << " ms after start"
+                  << (mAssisted ? ", with EPO" : "");
     }
-    for (auto& [key, sv] : mSatellites) {
-        sv.svFlag &= ~static_cast<int32_t>(GnssSvFlags::USED_IN_FIX);
-        for (int usedSvid : mSatsUsedInFix) if (sv.svid == usedSvid) { sv.svFlag |= static_cast<int32_t>(GnssSvFlags::USED_IN_FIX); break; }
+    {
+        std::lock_guard<std::mutex> lock(mPowerMutex);
+        mDutyCycle.onFix(now);
     }
-    return true;
+
+    const int64_t fixTimeNs = solution.timeNs;
+    int64_t fixUnixMs = (mUtcDaysSinceEpoch >= 0 && fix.utcMsOfDay >= 0)
+            ? (int64_t)mUtcDaysSinceEpoch * MS_PER_DAY + fix.utcMsOfDay
+            : getCurrentTimestampMs();
+    mLocationFilter.update(fix, fixTimeNs);
+    mLastFixTimeNs = fixTimeNs;
+    mLastFixUnixMs = fixUnixMs;
+    mLastFixTimeUncertaintyNs = solution.timeUncertaintyNs;
+    // Above the receiver's rate, the output timer publishes instead.
+    if (mOutputIntervalMs > 0) return;
+    
+    // Throttle on receiver time: unlike the local clock it does not jitter with the burst.
+    // Suspended, every fix is kept for the resume instead and none is published.
+    if (mPublishing) {
+        if (fix.utcMsOfDay >= 0 && mLastReportedUtcMs >= 0) {
+            int32_t elapsed = fix.utcMsOfDay - mLastReportedUtcMs;
+            if (elapsed < 0) elapsed += MS_PER_DAY;
+            if (elapsed == 0 || elapsed < mMinIntervalMs.load()) return;
+        } else if (now - mLastLocationReportMs < mMinIntervalMs.load()) {
+            return;
+        }
+        mLastReportedUtcMs = fix.utcMsOfDay;
+        mLastLocationReportMs = now;
+    }
+    
+    mCurrentLocation.gnssLocationFlags = static_cast<int32_t>(fix.flags);
+    mCurrentLocation.latitudeDegrees = fix.latitudeDegrees;
+    mCurrentLocation.longitudeDegrees = fix.longitudeDegrees;
+    mCurrentLocation.altitudeMeters = fix.altitudeMeters;
+    mCurrentLocation.speedMetersPerSec = fix.speedMetersPerSec;
+    mCurrentLocation.bearingDegrees = fix.bearingDegrees;
+    mCurrentLocation.horizontalAccuracyMeters = fix.horizontalAccuracyMeters;
+    mCurrentLocation.verticalAccuracyMeters = fix.verticalAccuracyMeters;
+    mCurrentLocation.speedAccuracyMetersPerSecond = fix.speedAccuracyMetersPerSecond;
+    mCurrentLocation.bearingAccuracyDegrees = fix.bearingAccuracyDegrees;
+    mCurrentLocation.timestampMillis = fixUnixMs;
+    mCurrentLocation.elapsedRealtime.flags = ElapsedRealtime::HAS_TIMESTAMP_NS | ElapsedRealtime::HAS_TIME_UNCERTAINTY_NS;
+    mCurrentLocation.elapsedRealtime.timestampNs = fixTimeNs;
+    mCurrentLocation.elapsedRealtime.timeUncertaintyNs = solution.timeUncertaintyNs;
+    if (!mPublishing) return;
+    mDispatcher.postLocation(mCurrentLocation, mReceivedNs);
+    std::lock_guard<std::mutex> lock(mPowerMutex);
+    mDutyCycle.onDelivered(now);
 }
 
-bool NmeaReader::parseVTG(const std::string& sentence) {
-    auto fields = splitString(sentence, ',');
-    if (fields.size() < 8) return false;
-    std::lock_guard<std::mutex> lock(mLocationMutex);
-    if (!fields[1].empty()) { mCurrentLocation.bearingDegrees = std::atof(fields[1].c_str()); mCurrentLocation.gnssLocationFlags |= GnssLocation::HAS_BEARING; }
-    if (!fields[7].empty()) { mCurrentLocation.speedMetersPerSec = std::atof(fields[7].c_str()) / 3.6; mCurrentLocation.gnssLocationFlags |= GnssLocation::HAS_SPEED; }
-    return true;
+void NmeaReader::updateOutputTimer() {
+    if (mOutputTimer < 0) return;
+    // Interpolate only when asked for more than the receiver delivers, and not while suspended.
+    int32_t requested = mMinIntervalMs.load();
+    int32_t interval = (mPublishing && mEpochIntervalMs > 0 && requested < mEpochIntervalMs)
+            ? std::max(requested, MIN_OUTPUT_INTERVAL_MS)
+            : 0;
+    if (interval == mOutputIntervalMs) return;
+    mLoop.setTimer(mOutputTimer, interval > 0 ? getBoottimeNs() + interval * NS_PER_MS : -1,
+                   interval * NS_PER_MS);
+    LOG(INFO) << "Location output: " << (interval > 0 ? "interpolated every " : "receiver epochs")
+              << (interval > 0 ? std::to_string(interval) + " ms" : "");
+    mOutputIntervalMs = interval;
 }
 
-GnssConstellationType NmeaReader::getConstellationType(const std::string& tid, int svid) {
-    if (tid == "GP") return GnssConstellationType::GPS;
-    if (tid == "GL") return GnssConstellationType::GLONASS;
-    if (tid == "GA") return GnssConstellationType::GALILEO;
-    if (tid == "GB" || tid == "BD") return GnssConstellationType::BEIDOU;
-    // POPRAWKA LITERÓWKI PONIŻEJ:
-    if (tid == "GQ" || tid == "QZ") return GnssConstellationType::QZSS;
-    if (tid == "GN") {
-        if (svid >= 1 && svid <= 32) return GnssConstellationType::GPS;
-        if (svid >= 65 && svid <= 96) return GnssConstellationType::GLONASS;
-        if (svid >= 201 && svid <= 237) return GnssConstellationType::BEIDOU;
-        if (svid >= 301 && svid <= 336) return GnssConstellationType::GALILEO;
-        return GnssConstellationType::GPS;
+void NmeaReader::publishInterpolated() {
+    int64_t now = getBoottimeNs();
+    LocationFilter::Estimate estimate;
+    if (!mLocationFilter.predict(now, estimate)) return;
+
+    int32_t flags = GnssLocation::HAS_LAT_LONG | GnssLocation::HAS_SPEED | GnssLocation::HAS_BEARING |
+                    GnssLocation::HAS_HORIZONTAL_ACCURACY | GnssLocation::HAS_SPEED_ACCURACY |
+                    GnssLocation::HAS_BEARING_ACCURACY;
+    if (estimate.hasAltitude) flags |= GnssLocation::HAS_ALTITUDE | GnssLocation::HAS_VERTICAL_ACCURACY;
+    mCurrentLocation.gnssLocationFlags = flags;
+    mCurrentLocation.latitudeDegrees = estimate.latitudeDegrees;
+    mCurrentLocation.longitudeDegrees = estimate.longitudeDegrees;
+    mCurrentLocation.altitudeMeters = estimate.altitudeMeters;
+    mCurrentLocation.speedMetersPerSec = estimate.speedMetersPerSec;
+    mCurrentLocation.bearingDegrees = estimate.bearingDegrees;
+    mCurrentLocation.horizontalAccuracyMeters = estimate.horizontalAccuracyMeters;
+    mCurrentLocation.verticalAccuracyMeters = estimate.verticalAccuracyMeters;
+    mCurrentLocation.speedAccuracyMetersPerSecond = estimate.speedAccuracyMetersPerSecond;
+    mCurrentLocation.bearingAccuracyDegrees = estimate.bearingAccuracyDegrees;
+    mCurrentLocation.timestampMillis = mLastFixUnixMs + (now - mLastFixTimeNs) / 1000000;
+    mCurrentLocation.elapsedRealtime.flags = ElapsedRealtime::HAS_TIMESTAMP_NS | ElapsedRealtime::HAS_TIME_UNCERTAINTY_NS;
+    mCurrentLocation.elapsedRealtime.timestampNs = now;
+    mCurrentLocation.elapsedRealtime.timeUncertaintyNs = mLastFixTimeUncertaintyNs;
+    // Not from bytes just received: no latency to measure.
+    mDispatcher.postLocation(mCurrentLocation, 0);
+}
+
+const SatelliteTable& NmeaReader::currentSky() {
+    if (mSources.size() == 1) return mSources[0]->parser.satellites();
+    // A signal seen by several receivers is reported once, at its best C/N0.
+    mMergedSky.clear();
+    for (const auto& source : mSources) {
+        const SatelliteTable& table = source->parser.satellites();
+        for (const NmeaSatellite& sat : table) {
+            NmeaSatellite& merged = mMergedSky.update(sat.constellation, sat.svid, sat.signalId, -1);
+            if (sat.cn0DbHz >= merged.cn0DbHz) merged = sat;
+            if (table.isUsedInFix(sat.constellation, sat.svid)) {
+                mMergedSky.setUsedInFix(sat.constellation, sat.svid);
+            }
+        }
     }
-    return GnssConstellationType::UNKNOWN;
+    return mMergedSky;
 }
 
-double NmeaReader::nmeaToDecimal(double coord, char dir) {
-    int deg = static_cast<int>(coord / 100);
-    double dec = deg + (coord - deg * 100) / 60.0;
-    return (dir == 'S' || dir == 'W') ? -dec : dec;
+void NmeaReader::reportSatellites() {
+    if (!mPublishing || !mSvStatusEnabled.load(std::memory_order_relaxed)) return;
+    if (mSvFilterReset.exchange(false)) mSvFilter.reset();
+    const SatelliteTable& satellites = currentSky();
+    if (!mSvFilter.shouldReport(satellites, getBoottimeNs() / 1000000)) return;
+
+    std::vector<GnssSvInfo>& svList = mDispatcher.svStatusBuffer();
+    svList.clear();
+    for (const NmeaSatellite& sat : satellites) {
+        GnssSvInfo sv;
+        sv.svid = sat.svid;
+        sv.constellation = static_cast<GnssConstellationType>(sat.constellation);
+        sv.elevationDegrees = sat.elevationDegrees;
+        sv.azimuthDegrees = sat.azimuthDegrees;
+        sv.cN0Dbhz = sat.cn0DbHz;
+        sv.basebandCN0DbHz = sat.cn0DbHz;
+        sv.carrierFrequencyHz = static_cast<int64_t>(sat.carrierFrequencyHz);
+        sv.svFlag = sat.carrierFrequencyHz > 0 ? static_cast<int32_t>(GnssSvFlags::HAS_CARRIER_FREQUENCY) : 0;
+        if (satellites.isUsedInFix(sat.constellation, sat.svid)) {
+            sv.svFlag |= static_cast<int32_t>(GnssSvFlags::USED_IN_FIX);
+        }
+        svList.push_back(sv);
+    }
+    mDispatcher.postSvStatus();
 }
 
-std::vector<std::string> NmeaReader::splitString(const std::string& str, char d) {
-    std::vector<std::string> r; std::string c;
-    for (char ch : str) { if (ch == d) { r.push_back(c); c.clear(); } else if (ch != '\r' && ch != '\n') c += ch; }
-    r.push_back(c); return r;
+void NmeaReader::publishMeasurements(const RawEpoch& epoch) {
+    if (epoch.clockReset) mHwClockDiscontinuityCount++;
+    if (!mPublishing || !mMeasurementsEnabled.load(std::memory_order_relaxed)) return;
+
+    // MSM carries only the time of week; take the week nearest to the last epoch's UTC date.
+    const int32_t leapSeconds = epoch.leapSeconds >= 0 ? epoch.leapSeconds : NOMINAL_LEAP_SECONDS;
+    int64_t week = epoch.gpsWeek;
+    if (week < 0 && epoch.gpsTowNs >= 0 && mUtcDaysSinceEpoch >= 0 && mLastEpochUtcMs >= 0) {
+        const int64_t gpsMs = (int64_t)mUtcDaysSinceEpoch * MS_PER_DAY + mLastEpochUtcMs -
+                              GPS_EPOCH_UNIX_MS + leapSeconds * 1000LL;
+        week = std::llround(static_cast<double>(gpsMs * NS_PER_MS - epoch.gpsTowNs) / NS_PER_WEEK);
+    }
+    const bool hasGpsTime = week >= 0 && epoch.gpsTowNs >= 0;
+    const int64_t gpsTimeNs = hasGpsTime ? week * NS_PER_WEEK + epoch.gpsTowNs : 0;
+
+    // The epoch instant on CLOCK_BOOTTIME: relative to the last fix, whose time the clock
+    // model knows, or failing that the arrival of its first message.
+    int64_t timeNs = epoch.arrivalNs;
+    double timeUncertaintyNs = ARRIVAL_TIME_UNCERTAINTY_NS;
+    if (hasGpsTime && mLastFixTimeNs > 0) {
+        const int64_t offsetNs = gpsTimeNs + (GPS_EPOCH_UNIX_MS - leapSeconds * 1000LL) * NS_PER_MS -
+                                 mLastFixUnixMs * NS_PER_MS;
+        if (std::llabs(offsetNs) <= MAX_MEASUREMENT_CLOCK_GAP_NS) {
+            timeNs = mLastFixTimeNs + offsetNs;
+            timeUncertaintyNs = mLastFixTimeUncertaintyNs;
+        }
+    }
+
+    const int32_t intervalMs = mMeasurementIntervalMs.load(std::memory_order_relaxed);
+    if (mLastMeasurementNs > 0 && intervalMs > MEASUREMENT_INTERVAL_SLACK_MS &&
+        timeNs - mLastMeasurementNs < (intervalMs - MEASUREMENT_INTERVAL_SLACK_MS) * NS_PER_MS) {
+        return;
+    }
+    mLastMeasurementNs = timeNs;
+
+    // Filled in place: the buffer's measurements keep their capacity from earlier epochs.
+    GnssData& data = mDispatcher.measurementBuffer();
+    data.measurements.resize(epoch.count);
+    for (size_t i = 0; i < epoch.count; i++) {
+        const RawMeasurement& m = epoch.measurements[i];
+        GnssMeasurement& out = data.measurements[i];
+        out.flags = m.carrierFrequencyHz > 0 ? GnssMeasurement::HAS_CARRIER_FREQUENCY : 0;
+        out.svid = m.svid;
+        out.signalType.constellation = static_cast<GnssConstellationType>(m.constellation);
+        out.signalType.carrierFrequencyHz = m.carrierFrequencyHz;
+        if (m.codeType != 0) {
+            out.signalType.codeType.assign(1, m.codeType);
+        } else {
+            out.signalType.codeType = GnssSignalType::CODE_TYPE_UNKNOWN;
+        }
+        out.timeOffsetNs = 0;
+        out.state = static_cast<int32_t>(m.state);
+        out.receivedSvTimeInNs = m.receivedSvTimeNs;
+        out.receivedSvTimeUncertaintyInNs = m.receivedSvTimeUncertaintyNs;
+        out.antennaCN0DbHz = m.cn0DbHz;
+        out.basebandCN0DbHz = m.cn0DbHz;
+        out.pseudorangeRateMps = m.pseudorangeRateMps;
+        out.pseudorangeRateUncertaintyMps =
+                m.hasPseudorangeRate ? m.pseudorangeRateUncertaintyMps : UNKNOWN_RATE_UNCERTAINTY_MPS;
+        out.accumulatedDeltaRangeState = m.adrState;
+        out.accumulatedDeltaRangeM = m.accumulatedDeltaRangeMeters;
+        out.accumulatedDeltaRangeUncertaintyM = m.accumulatedDeltaRangeUncertaintyMeters;
+    }
+
+    GnssClock& clock = data.clock;
+    clock.gnssClockFlags = 0;
+    clock.timeNanos = timeNs;
+    clock.hwClockDiscontinuityCount = mHwClockDiscontinuityCount;
+    if (epoch.leapSeconds >= 0) {
+        clock.gnssClockFlags |= GnssClock::HAS_LEAP_SECOND;
+        clock.leapSecond = epoch.leapSeconds;
+    }
+    if (hasGpsTime) {
+        // Local clock minus GPS time, all of it in the full bias.
+        clock.gnssClockFlags |= GnssClock::HAS_FULL_BIAS | GnssClock::HAS_BIAS |
+                                GnssClock::HAS_BIAS_UNCERTAINTY;
+        clock.fullBiasNanos = timeNs - gpsTimeNs;
+        clock.biasNanos = 0;
+        clock.biasUncertaintyNanos = timeUncertaintyNs;
+    }
+    data.elapsedRealtime.flags = ElapsedRealtime::HAS_TIMESTAMP_NS | ElapsedRealtime::HAS_TIME_UNCERTAINTY_NS;
+    data.elapsedRealtime.timestampNs = timeNs;
+    data.elapsedRealtime.timeUncertaintyNs = timeUncertaintyNs;
+    data.isFullTracking = false;
+    mDispatcher.postMeasurement();
 }
 
 }
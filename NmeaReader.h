@@ -4,82 +4,340 @@
 #include <aidl/android/hardware/gnss/IGnssCallback.h>
 #include <aidl/android/hardware/gnss/GnssConstellationType.h>
 #include <aidl/android/hardware/gnss/ElapsedRealtime.h>
+#include <aidl/android/hardware/gnss/GnssClock.h>
+#include <aidl/android/hardware/gnss/GnssMeasurement.h>
+#include <aidl/android/hardware/gnss/GnssSignalType.h>
 #include <atomic>
-#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
-#include <map>
+
+#include "BinaryParser.h"
+#include "ByteSource.h"
+#include "CallbackDispatcher.h"
+#include "DutyCycle.h"
+#include "EpoUploader.h"
+#include "EpochClock.h"
+#include "EventLoop.h"
+#include "FixFusion.h"
+#include "FlightRecorder.h"
+#include "LocationFilter.h"
+#include "Metrics.h"
+#include "NmeaFramer.h"
+#include "NmeaParser.h"
+#include "PpsSource.h"
+#include "ReceiverConfig.h"
+#include "StreamDemux.h"
+#include "SvBlocklist.h"
+#include "SvStatusFilter.h"
 
 namespace aidl::android::hardware::gnss::implementation {
 
 using ::aidl::android::hardware::gnss::GnssLocation;
 using ::aidl::android::hardware::gnss::GnssConstellationType;
 using ::aidl::android::hardware::gnss::ElapsedRealtime;
-using GnssSvInfo = ::aidl::android::hardware::gnss::IGnssCallback::GnssSvInfo;
+using ::aidl::android::hardware::gnss::GnssClock;
+using ::aidl::android::hardware::gnss::GnssMeasurement;
+using ::aidl::android::hardware::gnss::GnssSignalType;
 using GnssSvFlags = ::aidl::android::hardware::gnss::IGnssCallback::GnssSvFlags;
 
-using LocationCallback = std::function<void(const GnssLocation&)>;
-using NmeaCallback = std::function<void(int64_t, const std::string&)>;
-using SvStatusCallback = std::function<void(const std::vector<GnssSvInfo>&)>;
-
+// Reads one or more receivers, each on its own UART (or pty, or capture; see ByteSource), on one
+// thread. Every receiver has its own
+// framing, parsing, clock model and configuration; their epochs meet in a FixFusion, and the
+// satellites they see are merged into one SV status without duplicates. NMEA and raw
+// measurements are passed on from a single receiver, the base of the latest fused fix, since
+// two receivers' streams cannot be interleaved meaningfully.
+//
+// At long fix intervals the receivers are put in standby between fixes (see DutyCycle); the
+// thread then sleeps until it is time to wake them. stop() leaves them in standby too.
+//
+// Between sessions the reader can be suspended instead of stopped: inputs stay open and are
+// still parsed, nothing is published, and the receivers track for a while before standby. The
+// next start() is then a resume with nothing to reopen, and serves the latest fix at once if it
+// is fresh.
+//
+// Everything received can be captured to a FlightRecorder file, to be replayed later through a
+// ReplaySource with the same chunking and timing.
+//
+// Assistance data (EPO) is uploaded to every receiver in the background, a packet whenever its
+// configuration has nothing in flight, and again whenever a receiver may have lost it. The time
+// from start() to the first fix is measured per session.
 class NmeaReader {
 public:
-    NmeaReader(const std::string& device, int baudRate,
-               LocationCallback locationCb, NmeaCallback nmeaCb, SvStatusCallback svCb);
+    // |devices| are the receivers' UARTs or ByteSource devices, the first being the primary (the
+    // one wired to PPS), at most FixFusion::MAX_SOURCES. |baudRate| is their power-on UART rate.
+    // |ppsDevice| is optional; without it fix times are derived from byte arrival alone.
+    NmeaReader(const std::vector<std::string>& devices, int baudRate, const std::string& ppsDevice,
+               LocationCallback locationCb, NmeaCallback nmeaCb, SvStatusCallback svCb,
+               MeasurementCallback measurementCb);
     ~NmeaReader();
     
+    // Also resumes after suspend(), at once.
     bool start();
+    // Joins the reader thread only: events still queued for the dispatcher are dropped, and a
+    // callback in progress is not waited for.
     void stop();
+    // Like stop() unless setKeepWarm() allows it; no-op if not running.
+    void suspend();
+    // How long the receivers keep tracking after suspend() before standby; -1 to stop instead.
+    // Must be called before start().
+    void setKeepWarm(int32_t holdMs) { mKeepWarmMs = holdMs; }
+    bool suspended() const { return mSuspended.load(); }
     void setMinInterval(int32_t intervalMs);
+    // SV snapshots are only built while a client wants them.
+    void setSvStatusEnabled(bool enabled);
+    // Raw measurements are requested from the receiver only while enabled, and reported at
+    // most once per |intervalMs| (0: every epoch).
+    void setMeasurementOptions(bool enabled, int32_t intervalMs);
+    // UART rate to negotiate with the receiver, 0 to keep its default. Must be called before start().
+    void setPreferredBaudRate(int baudRate) { mPreferredBaudRate = baudRate; }
+    // Captures every chunk received, replays excepted, to |path|, keeping the last |bytes| or
+    // so. Empty to capture nothing. Must be called before start().
+    void setCapture(const std::string& path, size_t bytes) {
+        mCapturePath = path;
+        mCaptureBytes = bytes;
+    }
+    // EPO for the receivers, uploaded from the current segment on at once if running, else on
+    // start(); null to upload nothing. Any thread.
+    void setAssistanceData(std::shared_ptr<const std::vector<uint8_t>> epo);
+    // Time and position aiding for the receivers (see ReceiverConfig), null to send none.
+    // Any thread.
+    void setTimeAid(const ReceiverConfig::TimeAid* aid);
+    void setPositionAid(const ReceiverConfig::PositionAid* aid);
+    // Restarts the receivers, at once if running, else once they are. Any thread.
+    void restartReceivers(ReceiverConfig::Restart kind);
+    // Blocked SVs are dropped by the parsers, from SV status and measurements alike, and
+    // blocked constellations are not searched for by the receivers. Any thread.
+    void setBlocklist(const SvBlocklist& blocklist);
+    // Must be called before start().
+    void setSvReportThresholds(const SvStatusFilter::Thresholds& thresholds) {
+        mSvFilter.setThresholds(thresholds);
+    }
+    CallbackDispatcher::Stats dispatchStats() const { return mDispatcher.stats(); }
+    // Any thread.
+    DutyCycle::Stats powerStats() const;
+
+    struct Metrics {
+        struct Input {
+            std::string name;
+            uint64_t bytes = 0;
+            uint64_t errors = 0;  // failed reads, writes and rate changes
+            NmeaFramer::Stats nmea;
+            BinaryFramer::Stats binary;
+            // EPO records acknowledged of the current or last upload, and uploads finished or
+            // given up since the reader was created.
+            uint64_t assistanceRecords = 0;
+            uint64_t assistanceTotal = 0;
+            uint64_t assistanceUploads = 0;
+            uint64_t assistanceFailures = 0;
+        };
+        struct TimeToFirstFix {
+            uint64_t count = 0;
+            int64_t lastMs = 0;
+            int64_t meanMs = 0;
+            int64_t maxMs = 0;
+        };
+        std::vector<Input> inputs;
+        // Parsed sentences of all receivers, acknowledgements excepted.
+        uint64_t sentences[static_cast<size_t>(SentenceType::COUNT)] = {};
+        // From start() to the first fix; [1] for sessions whose assistance upload had finished
+        // by then.
+        TimeToFirstFix ttff[2];
+    };
+    // Any thread. Counts since the reader was created.
+    Metrics metrics() const;
 
 private:
+    // One receiver. Owned by the reader thread, apart from set-up in start() and stop().
+    struct Source {
+        Source(size_t index, std::unique_ptr<ByteSource> input)
+            : index(index), input(std::move(input)), binaryParser(parser.satellites()) {}
+
+        size_t index;
+        std::unique_ptr<ByteSource> input;
+        StreamDemux demux;
+        NmeaParser parser;
+        BinaryParser binaryParser;  // shares parser's satellite table
+        ReceiverConfig config;
+        EpoUploader epo;
+        EpochClock clock;
+        int64_t lastBinaryFixNs = 0;
+        int epochTimer = -1;      // line idle with an epoch open
+        int reconnectTimer = -1;  // reopening the input after an error
+        int32_t reconnectDelayMs = 0;
+
+        // For metrics(). The framers' own counts are published once per chunk.
+        Counter bytes;
+        Counter errors;
+        Counter sentences;
+        Counter checksumErrors;
+        Counter overflows;
+        Counter malformed;
+        Counter frames;
+        Counter frameChecksumErrors;
+        Counter oversizeFrames;
+        Counter assistanceRecords;
+        Counter assistanceTotal;
+        Counter assistanceUploads;
+        Counter assistanceFailures;
+    };
+    struct TimeToFirstFix {
+        Counter count;
+        Counter sumMs;
+        Counter lastMs;
+        Counter maxMs;
+    };
+
     void readerThreadFunc();
-    bool openUart();
-    void closeUart();
+    // Opens the source's input and watches it.
+    bool openInput(Source& source);
+    void closeInput(Source& source);
+    void configureReceiver(Source& source);
+    // EPO goes out only while the link is verified, the configuration idle and the engine on.
+    bool assistanceAllowed(const Source& source) const;
+    void uploadAssistance(Source& source);
+    // Best effort, while stopping: the receiver is not left tracking for nobody.
+    void powerOffReceiver(Source& source);
+    void updateDutyCycle();
+    // Reader thread, once it sees the suspend lifted: serves the latest fix if it is fresh.
+    void onResume();
+    // Event loop handlers, reader thread.
+    void onLoopIteration();
+    void onInputReadable(Source& source);
+    void onEpochIdle(Source& source);
+    void disconnectInput(Source& source, const char* reason);
+    void reconnectInput(Source& source);
     
-    void processNmeaSentence(const std::string& sentence);
-    bool parseGGA(const std::string& sentence);
-    bool parseRMC(const std::string& sentence);
-    bool parseGSV(const std::string& sentence);
-    bool parseGSA(const std::string& sentence);
-    bool parseVTG(const std::string& sentence);
+    void processNmeaSentence(Source& source, const NmeaSentence& sentence);
+    void processBinaryFrame(Source& source, const BinaryFrame& frame);
+    void publishEpoch(Source& source);
+    // Stamps a receiver's solution and hands it to the fusion stage.
+    void offerFix(Source& source, const NmeaFix& fix);
+    void publishFix(const FixFusion::Solution& solution);
+    void updateOutputTimer();
+    void publishInterpolated();
+    // The sky of all receivers: the primary's table itself, or a merge into mMergedSky.
+    const SatelliteTable& currentSky();
+    void reportSatellites();
+    void publishMeasurements(const RawEpoch& epoch);
     
-    double nmeaToDecimal(double nmeaCoord, char direction);
-    bool validateChecksum(const std::string& sentence);
-    std::vector<std::string> splitString(const std::string& str, char delimiter);
-    int64_t getCurrentTimestampMs();
-    GnssConstellationType getConstellationType(const std::string& talkerId, int svid);
-
-    std::string mDevice;
-    int mUartFd;
+    static int64_t getCurrentTimestampMs();
+    static int64_t getBoottimeNs();
+
+    std::vector<std::unique_ptr<Source>> mSources;
+    int mBaudRate;
+    int mPreferredBaudRate;
     
     std::thread mReaderThread;
+    // One thread, one epoll: every input, the timers below and the sources', and wake-ups for
+    // new settings.
+    EventLoop mLoop;
+    int mOutputTimer;   // interpolated output
+    int mConfigTimer;   // receiver configuration retries and link checks, all sources
+    int mFusionTimer;   // a fused epoch still waiting for a receiver
+    int mDutyTimer;     // the next duty cycle transition
     std::atomic<bool> mRunning;
+    std::atomic<bool> mSuspended;
+    int32_t mKeepWarmMs;
     std::atomic<int32_t> mMinIntervalMs;
     
-    int64_t mLastLocationReportMs;
-    int64_t mLastSvReportMs;
+    int64_t mLastLocationReportMs;  // CLOCK_BOOTTIME
+    int32_t mLastReportedUtcMs;
+    std::atomic<bool> mSvStatusEnabled;
+    std::atomic<bool> mSvFilterReset;
+    std::atomic<bool> mMeasurementsEnabled;
+    std::atomic<int32_t> mMeasurementIntervalMs;
     
-    LocationCallback mLocationCallback;
-    NmeaCallback mNmeaCallback;
-    SvStatusCallback mSvStatusCallback;
+    // Callbacks run on the dispatcher's thread, never on the reader thread. It is started with
+    // the first session and stopped only by the destructor.
+    CallbackDispatcher mDispatcher;
     
-    std::mutex mLocationMutex;
+    // Owned by the reader thread.
+    NmeaSentence mSentence;
+    BinaryFrame mFrame;
     GnssLocation mCurrentLocation;
-    bool mHasValidFix;
-    int mFixQuality;
-    int mNumSatellites;
-    
-    std::mutex mSvMutex;
-    std::map<int, GnssSvInfo> mSatellites;
-    std::vector<int> mSatsUsedInFix;
+    SvStatusFilter mSvFilter;
+    std::unique_ptr<PpsSource> mPps;
+    std::string mCapturePath;
+    size_t mCaptureBytes;
+    FlightRecorder mRecorder;  // kept open across sessions, like the file
+    FixFusion mFusion;
+    size_t mPreferredSource;  // base of the latest valid fused fix
+    SatelliteTable mMergedSky;
+    bool mEngineOn;  // as last decided by mDutyCycle
+    bool mPublishing;  // the reader thread's view of !mSuspended
+    int64_t mReceivedNs;  // when the chunk being processed was read, on the local clock
+    Counter mSentenceCounts[static_cast<size_t>(SentenceType::COUNT)];
+    int64_t mStartNs;         // of the session, CLOCK_BOOTTIME
+    bool mAwaitingFirstFix;
+    bool mAssisted;           // an upload finished this session
+    TimeToFirstFix mTtff[2];  // see Metrics
+
+    // Set by setAssistanceData(), the aiding setters and setBlocklist(), taken up by the reader
+    // thread.
+    std::mutex mAssistanceMutex;
+    std::shared_ptr<const std::vector<uint8_t>> mAssistanceData;
+    std::atomic<bool> mAssistanceChanged;
+    bool mHaveTimeAid;
+    ReceiverConfig::TimeAid mTimeAid;
+    bool mHavePositionAid;
+    ReceiverConfig::PositionAid mPositionAid;
+    std::atomic<bool> mAidingChanged;
+    std::atomic<int> mPendingRestart;  // a ReceiverConfig::Restart, -1 for none
+    SvBlocklist mBlocklist;
+    std::atomic<bool> mBlocklistChanged;
+    uint8_t mBlockedConstellations;  // reader thread, see ReceiverConfig::Settings
+
+    // Written by the reader thread, apart from start() and stop(); read by powerStats().
+    mutable std::mutex mPowerMutex;
+    DutyCycle mDutyCycle;
+    int32_t mUtcDaysSinceEpoch;  // last RMC date, rolled over at midnight
+    int32_t mLastEpochUtcMs;
+
+    // Interpolated output, used when setMinInterval() asks for more than the receiver's rate.
+    LocationFilter mLocationFilter;
+    int32_t mOutputIntervalMs;  // 0 while publishing receiver epochs directly
+    int32_t mEpochIntervalMs;   // learned from consecutive epoch times
+    int64_t mLastFixUnixMs;
+    int64_t mLastFixTimeNs;
+    double mLastFixTimeUncertaintyNs;
+
+    int64_t mLastMeasurementNs;  // CLOCK_BOOTTIME of the last reported measurement epoch
+    int32_t mHwClockDiscontinuityCount;
     
-    // NAPRAWA: Musi byc 4096, tak jak w pliku .cpp!
     static constexpr int READ_BUFFER_SIZE = 4096;
-    static constexpr int NMEA_MAX_SIZE = 256;
-    static constexpr int SV_REPORT_INTERVAL_MS = 1000;
+    // Silence on the line after which an open epoch is published without its last sentence.
+    static constexpr int EPOCH_IDLE_TIMEOUT_MS = 20;
+    // Reopening an input that failed backs off from the first to the second, doubling each time.
+    static constexpr int32_t MIN_RECONNECT_DELAY_MS = 100;
+    static constexpr int32_t MAX_RECONNECT_DELAY_MS = 5000;
+    // How long a fused epoch waits for the other receivers' solutions; they output within
+    // a few tens of ms of each other.
+    static constexpr int64_t FUSION_WAIT_NS = 150000000LL;
+    static constexpr int32_t MS_PER_DAY = 24 * 3600 * 1000;
+    static constexpr int32_t MIN_OUTPUT_INTERVAL_MS = 50;
+    // The latest fix is served on resume while younger than this: a receiver epoch or two.
+    static constexpr int64_t MAX_CACHED_FIX_AGE_NS = 2000000000LL;
+    // While binary solutions arrive at least this often, NMEA epochs only carry satellites.
+    static constexpr int64_t BINARY_FIX_TIMEOUT_NS = 2000000000LL;
+    static constexpr int32_t MAX_EPOCH_INTERVAL_MS = 10000;
+    static constexpr int64_t NS_PER_MS = 1000000;
+    static constexpr int64_t NS_PER_WEEK = 7LL * MS_PER_DAY * NS_PER_MS;
+    // 1980-01-06 in Unix time.
+    static constexpr int64_t GPS_EPOCH_UNIX_MS = 3657LL * MS_PER_DAY;
+    // Receiver epochs are this close to the requested measurement interval when they match it.
+    static constexpr int32_t MEASUREMENT_INTERVAL_SLACK_MS = 20;
+    // An epoch more than this far from the last fix is timed by its arrival instead.
+    static constexpr int64_t MAX_MEASUREMENT_CLOCK_GAP_NS = 2000000000LL;
+    // Arrival trails the epoch by the receiver's output latency, typically tens of ms.
+    static constexpr double ARRIVAL_TIME_UNCERTAINTY_NS = 100e6;
+    // Reported when the receiver gives no Doppler (MSM4 and MSM6).
+    static constexpr double UNKNOWN_RATE_UNCERTAINTY_MPS = 1000.0;
+
+    char mReadBuffer[READ_BUFFER_SIZE];
 };
 
 }
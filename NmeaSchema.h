@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#include "NmeaDecode.h"
+#include "NmeaFramer.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Compile-time sentence schemas. A sentence is declared as a record and the list of its fields:
+// where each one is, which record member it fills and how it is decoded (its codec, which also
+// carries the unit). NmeaSchema expands the list into a decoder for that sentence alone, the
+// field count checked once and every index a constant, so nothing is interpreted at run time.
+// See NmeaSentences.h for the declarations.
+//
+// A codec provides:
+//   using Type = ...;                 what it decodes into
+//   static constexpr size_t WIDTH;    fields it spans (2 for a coordinate and its hemisphere)
+//   static bool decode(const NmeaSentence& sentence, size_t index, Type& out);
+
+// Units: the scale that takes the sentence's value to the record's SI one.
+struct Dimensionless { static constexpr double SCALE = 1.0; };
+struct Meters { static constexpr double SCALE = 1.0; };
+struct Degrees { static constexpr double SCALE = 1.0; };
+struct Knots { static constexpr double SCALE = 0.514444; };           // to m/s
+struct KilometersPerHour { static constexpr double SCALE = 1.0 / 3.6; };  // to m/s
+
+namespace codec {
+
+struct Integer {
+    using Type = int;
+    static constexpr size_t WIDTH = 1;
+    static bool decode(const NmeaSentence& s, size_t i, int& out) { return decodeInt(s[i], out); }
+};
+
+template <typename Unit>
+struct Real {
+    using Type = double;
+    static constexpr size_t WIDTH = 1;
+    static bool decode(const NmeaSentence& s, size_t i, double& out) {
+        if (!decodeDouble(s[i], out)) return false;
+        if constexpr (Unit::SCALE != 1.0) out *= Unit::SCALE;
+        return true;
+    }
+};
+
+// "ddmm.mmmm,N" to signed decimal degrees.
+struct Coordinate {
+    using Type = double;
+    static constexpr size_t WIDTH = 2;
+    static bool decode(const NmeaSentence& s, size_t i, double& out) {
+        return decodeCoordinate(s[i], s[i + 1], out);
+    }
+};
+
+// "A" (valid) or "V" (invalid); anything else does not decode.
+struct Status {
+    using Type = bool;
+    static constexpr size_t WIDTH = 1;
+    static bool decode(const NmeaSentence& s, size_t i, bool& out) {
+        const std::string_view field = s[i];
+        if (field != "A" && field != "V") return false;
+        out = field[0] == 'A';
+        return true;
+    }
+};
+
+// The talker ID of an address field ("GN" of "GNGSA").
+struct Talker {
+    using Type = std::string_view;
+    static constexpr size_t WIDTH = 1;
+    static bool decode(const NmeaSentence& s, size_t i, std::string_view& out) {
+        out = s[i].substr(0, 2);
+        return out.size() == 2;
+    }
+};
+
+// Not empty; a view into the framer's line buffer.
+struct Text {
+    using Type = std::string_view;
+    static constexpr size_t WIDTH = 1;
+    static bool decode(const NmeaSentence& s, size_t i, std::string_view& out) {
+        out = s[i];
+        return !out.empty();
+    }
+};
+
+// "ddmmyy" to days since 1970-01-01.
+struct Date {
+    using Type = int32_t;
+    static constexpr size_t WIDTH = 1;
+    static bool decode(const NmeaSentence& s, size_t i, int32_t& out) {
+        return decodeDate(s[i], out);
+    }
+};
+
+// "dd,mm,yyyy" (ZDA) to days since 1970-01-01.
+struct DayMonthYear {
+    using Type = int32_t;
+    static constexpr size_t WIDTH = 3;
+    static bool decode(const NmeaSentence& s, size_t i, int32_t& out) {
+        int32_t day, month, year;
+        if (!decodeInt(s[i], day) || !decodeInt(s[i + 1], month) || !decodeInt(s[i + 2], year) ||
+            day < 1 || day > 31 || month < 1 || month > 12 || year < 1980) {
+            return false;
+        }
+        out = daysFromCivil(year, month, day);
+        return true;
+    }
+};
+
+// Up to N integers in consecutive fields, empty ones skipped (the SVs of a GSA).
+template <size_t N>
+struct IntegerList {
+    struct Type {
+        int values[N];
+        size_t count;
+    };
+    static constexpr size_t WIDTH = N;
+    static bool decode(const NmeaSentence& s, size_t i, Type& out) {
+        out.count = 0;
+        for (size_t k = 0; k < N; k++) {
+            if (decodeInt(s[i + k], out.values[out.count])) out.count++;
+        }
+        return out.count > 0;
+    }
+};
+
+}  // namespace codec
+
+// A field that may be empty or missing: |MEMBER| is a std::optional of the codec's type, left
+// empty unless the field decodes.
+template <size_t INDEX, auto MEMBER, typename Codec>
+struct Field {
+    static constexpr size_t END = INDEX + Codec::WIDTH;
+    static constexpr bool REQUIRED = false;
+    static constexpr bool EPOCH_TIME = false;
+
+    template <typename Record>
+    static bool decode(const NmeaSentence& sentence, Record& record) {
+        static_assert(std::is_same_v<std::remove_reference_t<decltype(record.*MEMBER)>,
+                                     std::optional<typename Codec::Type>>,
+                      "An optional field needs a std::optional member of the codec's type");
+        auto& member = record.*MEMBER;
+        if (!Codec::decode(sentence, INDEX, member.emplace())) member.reset();
+        return true;
+    }
+};
+
+// A field the sentence is rejected without. Declare these first: decoding stops at the first
+// one that fails.
+template <size_t INDEX, auto MEMBER, typename Codec>
+struct Required {
+    static constexpr size_t END = INDEX + Codec::WIDTH;
+    static constexpr bool REQUIRED = true;
+    static constexpr bool EPOCH_TIME = false;
+
+    template <typename Record>
+    static bool decode(const NmeaSentence& sentence, Record& record) {
+        static_assert(std::is_same_v<std::remove_reference_t<decltype(record.*MEMBER)>,
+                                     typename Codec::Type>,
+                      "A required field needs a member of the codec's type");
+        return Codec::decode(sentence, INDEX, record.*MEMBER);
+    }
+};
+
+// The UTC time the sentence's epoch is keyed on. The parser decodes it before the sentence is
+// applied (see EpochAssembler), so the record has no member for it.
+template <size_t INDEX>
+struct EpochTime {
+    static constexpr size_t END = INDEX + 1;
+    static constexpr bool REQUIRED = false;
+    static constexpr bool EPOCH_TIME = true;
+
+    template <typename Record>
+    static bool decode(const NmeaSentence&, Record&) { return true; }
+};
+
+// |MIN_FIELDS| counts the address field too. Optional fields may lie beyond it, for the fields
+// later NMEA versions appended; required ones may not.
+template <typename RecordType, size_t MIN_FIELDS, typename... Fields>
+struct NmeaSchema {
+    using Record = RecordType;
+
+    static_assert(((!Fields::REQUIRED || Fields::END <= MIN_FIELDS) && ...),
+                  "A required field lies beyond the minimum field count");
+    static_assert((size_t(Fields::EPOCH_TIME) + ... + 0) <= 1, "More than one epoch time");
+
+    // Index of the EpochTime field, -1 if the sentence carries none.
+    static constexpr int TIME_FIELD = [] {
+        int index = -1;
+        ((index = Fields::EPOCH_TIME ? static_cast<int>(Fields::END) - 1 : index), ...);
+        return index;
+    }();
+
+    static bool decode(const NmeaSentence& sentence, Record& record) {
+        if (sentence.fieldCount < MIN_FIELDS) return false;
+        return (Fields::decode(sentence, record) && ...);
+    }
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
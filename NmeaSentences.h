@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "NmeaSchema.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// What NmeaParser reads from each fixed-layout sentence, as NmeaSchema declarations; NmeaParser
+// applies the records to the epoch. Fields are declared only if something uses them. GSV, a
+// variable number of satellite groups with an optional signal ID after the last, is decoded by
+// hand.
+
+// GGA and GNS: the position solution.
+struct PositionSentence {
+    std::optional<double> latitudeDegrees;
+    std::optional<double> longitudeDegrees;
+    std::optional<int> numSatellites;
+    std::optional<double> hdop;
+    std::optional<double> altitudeMeters;  // above mean sea level
+};
+
+struct GgaSentence : PositionSentence {
+    std::optional<int> fixQuality;
+};
+using GgaSchema = NmeaSchema<GgaSentence, 15,
+        EpochTime<1>,
+        Field<2, &GgaSentence::latitudeDegrees, codec::Coordinate>,
+        Field<4, &GgaSentence::longitudeDegrees, codec::Coordinate>,
+        Field<6, &GgaSentence::fixQuality, codec::Integer>,
+        Field<7, &GgaSentence::numSatellites, codec::Integer>,
+        Field<8, &GgaSentence::hdop, codec::Real<Dimensionless>>,
+        Field<9, &GgaSentence::altitudeMeters, codec::Real<Meters>>>;
+
+// Multi-constellation GGA: a mode character per constellation (GPS, GLONASS, Galileo, BeiDou,
+// QZSS, NavIC) instead of one fix quality.
+struct GnsSentence : PositionSentence {
+    std::string_view modes;
+};
+using GnsSchema = NmeaSchema<GnsSentence, 13,
+        Required<6, &GnsSentence::modes, codec::Text>,
+        EpochTime<1>,
+        Field<2, &GnsSentence::latitudeDegrees, codec::Coordinate>,
+        Field<4, &GnsSentence::longitudeDegrees, codec::Coordinate>,
+        Field<7, &GnsSentence::numSatellites, codec::Integer>,
+        Field<8, &GnsSentence::hdop, codec::Real<Dimensionless>>,
+        Field<9, &GnsSentence::altitudeMeters, codec::Real<Meters>>>;
+
+struct RmcSentence {
+    bool valid = false;
+    std::optional<double> speedMetersPerSec;
+    std::optional<double> bearingDegrees;
+    std::optional<int32_t> utcDaysSinceEpoch;
+};
+using RmcSchema = NmeaSchema<RmcSentence, 10,
+        Required<2, &RmcSentence::valid, codec::Status>,
+        EpochTime<1>,
+        Field<7, &RmcSentence::speedMetersPerSec, codec::Real<Knots>>,
+        Field<8, &RmcSentence::bearingDegrees, codec::Real<Degrees>>,
+        Field<9, &RmcSentence::utcDaysSinceEpoch, codec::Date>>;
+
+struct VtgSentence {
+    std::optional<double> bearingDegrees;  // true
+    std::optional<double> speedMetersPerSec;
+};
+using VtgSchema = NmeaSchema<VtgSentence, 8,
+        Field<1, &VtgSentence::bearingDegrees, codec::Real<Degrees>>,
+        Field<7, &VtgSentence::speedMetersPerSec, codec::Real<KilometersPerHour>>>;
+
+// One per constellation in an epoch, from NMEA 4.11 with the system ID appended.
+struct GsaSentence {
+    std::string_view talker;
+    std::optional<codec::IntegerList<12>::Type> svids;
+    std::optional<int> systemId;
+};
+using GsaSchema = NmeaSchema<GsaSentence, 18,
+        Required<0, &GsaSentence::talker, codec::Talker>,
+        Field<3, &GsaSentence::svids, codec::IntegerList<12>>,
+        Field<18, &GsaSentence::systemId, codec::Integer>>;
+
+struct GllSentence {
+    bool valid = false;
+    std::optional<double> latitudeDegrees;
+    std::optional<double> longitudeDegrees;
+};
+using GllSchema = NmeaSchema<GllSentence, 7,
+        Required<6, &GllSentence::valid, codec::Status>,
+        Field<1, &GllSentence::latitudeDegrees, codec::Coordinate>,
+        Field<3, &GllSentence::longitudeDegrees, codec::Coordinate>,
+        EpochTime<5>>;
+
+struct ZdaSentence {
+    int32_t utcDaysSinceEpoch = -1;
+};
+using ZdaSchema = NmeaSchema<ZdaSentence, 5,
+        Required<2, &ZdaSentence::utcDaysSinceEpoch, codec::DayMonthYear>,
+        EpochTime<1>>;
+
+// Pseudorange error statistics: one-sigma errors of the solution, the error ellipse included.
+struct GstSentence {
+    std::optional<double> majorSigmaMeters;
+    std::optional<double> minorSigmaMeters;
+    std::optional<double> latitudeSigmaMeters;
+    std::optional<double> longitudeSigmaMeters;
+    std::optional<double> altitudeSigmaMeters;
+};
+using GstSchema = NmeaSchema<GstSentence, 9,
+        EpochTime<1>,
+        Field<3, &GstSentence::majorSigmaMeters, codec::Real<Meters>>,
+        Field<4, &GstSentence::minorSigmaMeters, codec::Real<Meters>>,
+        Field<6, &GstSentence::latitudeSigmaMeters, codec::Real<Meters>>,
+        Field<7, &GstSentence::longitudeSigmaMeters, codec::Real<Meters>>,
+        Field<8, &GstSentence::altitudeSigmaMeters, codec::Real<Meters>>>;
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// The parsing core has no Android dependencies so it can be built and benchmarked on the host.
+// Its enums and flags use the same values as the AIDL types NmeaReader converts them to.
+
+enum class Constellation : uint8_t {
+    UNKNOWN = 0, GPS = 1, SBAS = 2, GLONASS = 3, QZSS = 4, BEIDOU = 5, GALILEO = 6, IRNSS = 7,
+};
+
+// Mirrors GnssLocation::HAS_* so the mask can be copied into gnssLocationFlags as is.
+enum FixFlags : uint32_t {
+    FIX_HAS_LAT_LONG = 1 << 0,
+    FIX_HAS_ALTITUDE = 1 << 1,
+    FIX_HAS_SPEED = 1 << 2,
+    FIX_HAS_BEARING = 1 << 3,
+    FIX_HAS_HORIZONTAL_ACCURACY = 1 << 4,
+    FIX_HAS_VERTICAL_ACCURACY = 1 << 5,
+    FIX_HAS_SPEED_ACCURACY = 1 << 6,
+    FIX_HAS_BEARING_ACCURACY = 1 << 7,
+};
+
+struct NmeaFix {
+    uint32_t flags = 0;
+    double latitudeDegrees = 0;
+    double longitudeDegrees = 0;
+    double altitudeMeters = 0;
+    double speedMetersPerSec = 0;
+    double bearingDegrees = 0;
+    double horizontalAccuracyMeters = 0;
+    double verticalAccuracyMeters = 0;  // NMEA: from GST
+    // Only binary protocols report these; NMEA fixes leave them 0 without their flags.
+    double speedAccuracyMetersPerSecond = 0;
+    double bearingAccuracyDegrees = 0;
+    int fixQuality = 0;
+    int numSatellites = 0;
+    bool measuredAccuracy = false;  // NMEA: horizontal from GST rather than estimated from HDOP
+    int32_t utcMsOfDay = -1;  // -1 until a timed sentence of the epoch has been seen
+    int32_t utcDaysSinceEpoch = -1;  // from the RMC or ZDA date, -1 if the epoch had none
+    int64_t arrivalNs = 0;    // CLOCK_BOOTTIME arrival of the epoch's first byte, 0 if unknown
+};
+
+struct NmeaSatellite {
+    Constellation constellation = Constellation::UNKNOWN;
+    int svid = 0;
+    float elevationDegrees = 0;
+    float azimuthDegrees = 0;
+    float cn0DbHz = 0;
+    uint8_t signalId = 0;          // NMEA 4.11 signal ID, 0 if the receiver did not send one
+    float carrierFrequencyHz = 0;  // 0 if unknown
+};
+
+// GPS - UTC since 2017, for protocols that do not carry it.
+static constexpr int32_t NOMINAL_LEAP_SECONDS = 18;
+
+// Mirror GnssMeasurement::STATE_* and ADR_STATE_*, like FixFlags.
+enum MeasurementState : uint32_t {
+    MEASUREMENT_STATE_CODE_LOCK = 1 << 0,
+    MEASUREMENT_STATE_TOW_DECODED = 1 << 3,
+    MEASUREMENT_STATE_GLO_TOD_DECODED = 1 << 7,
+    MEASUREMENT_STATE_GAL_E1BC_CODE_LOCK = 1 << 10,
+    MEASUREMENT_STATE_TOW_KNOWN = 1 << 14,
+    MEASUREMENT_STATE_GLO_TOD_KNOWN = 1 << 15,
+};
+enum AdrState : uint8_t {
+    ADR_STATE_VALID = 1 << 0,
+    ADR_STATE_RESET = 1 << 1,
+    ADR_STATE_HALF_CYCLE_RESOLVED = 1 << 3,
+};
+
+// One tracked signal of a raw measurement epoch, in GnssMeasurement's terms.
+struct RawMeasurement {
+    Constellation constellation = Constellation::UNKNOWN;
+    int svid = 0;
+    char codeType = 0;              // RINEX attribute ('C', 'P', 'I', 'Q', 'X', ...), 0 if unknown
+    double carrierFrequencyHz = 0;  // 0 if unknown
+    uint32_t state = 0;             // MeasurementState
+    // Transmit time in the constellation's own scale: time of week, or time of day for GLONASS.
+    int64_t receivedSvTimeNs = 0;
+    int64_t receivedSvTimeUncertaintyNs = 0;
+    float cn0DbHz = 0;
+    bool hasPseudorangeRate = false;
+    double pseudorangeRateMps = 0;  // positive when the range grows
+    double pseudorangeRateUncertaintyMps = 0;
+    uint8_t adrState = 0;           // AdrState, 0 without carrier phase
+    double accumulatedDeltaRangeMeters = 0;
+    double accumulatedDeltaRangeUncertaintyMeters = 0;
+};
+
+// The raw measurements of one receiver epoch. Fixed capacity, so an epoch is decoded without
+// allocating; signals beyond CAPACITY are dropped.
+struct RawEpoch {
+    static constexpr size_t CAPACITY = 128;
+
+    int64_t arrivalNs = 0;     // CLOCK_BOOTTIME arrival of the first message of the epoch
+    int64_t gpsTowNs = -1;     // receiver time as GPS time of week, -1 if unknown
+    int32_t gpsWeek = -1;      // -1 if the protocol does not carry it
+    int32_t leapSeconds = -1;  // GPS - UTC, -1 if unknown
+    bool clockReset = false;   // the receiver clock jumped since the previous epoch
+    size_t count = 0;
+    RawMeasurement measurements[CAPACITY];
+
+    RawMeasurement* add() { return count < CAPACITY ? &measurements[count++] : nullptr; }
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
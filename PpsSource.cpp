@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define LOG_TAG "GnssPps"
+
+#include "PpsSource.h"
+
+#include <android-base/logging.h>
+#include <fcntl.h>
+#include <linux/pps.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static int64_t clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+bool PpsSource::open() {
+    if (mFd >= 0) return true;
+    mFd = ::open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFd < 0) return false;
+    struct stat st;
+    mIsDevice = fstat(mFd, &st) == 0 && S_ISCHR(st.st_mode);
+    mSequence = 0;
+    mEdgeNs = 0;
+    LOG(INFO) << "PPS source: " << mPath << (mIsDevice ? " (device)" : " (file)");
+    return true;
+}
+
+void PpsSource::close() {
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+bool PpsSource::fetch(int64_t& realtimeNs, uint32_t& sequence) {
+    if (mIsDevice) {
+        // A zero timeout returns the latest edge immediately instead of waiting for the next.
+        struct pps_fdata data;
+        memset(&data, 0, sizeof(data));
+        if (ioctl(mFd, PPS_FETCH, &data) != 0) return false;
+        realtimeNs = static_cast<int64_t>(data.info.assert_tu.sec) * 1000000000LL +
+                     data.info.assert_tu.nsec;
+        sequence = data.info.assert_sequence;
+        return true;
+    }
+
+    char buf[64];
+    ssize_t n = pread(mFd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return false;
+    std::string_view text(buf, static_cast<size_t>(n));
+    size_t dot = text.find('.');
+    size_t hash = text.find('#');
+    if (dot == std::string_view::npos || hash == std::string_view::npos || hash < dot) return false;
+    int64_t sec = 0, nsec = 0;
+    const char* end = buf + n;
+    if (std::from_chars(buf, buf + dot, sec).ptr != buf + dot) return false;
+    if (std::from_chars(buf + dot + 1, buf + hash, nsec).ptr != buf + hash) return false;
+    if (std::from_chars(buf + hash + 1, end, sequence).ec != std::errc()) return false;
+    realtimeNs = sec * 1000000000LL + nsec;
+    return true;
+}
+
+int64_t PpsSource::latestEdgeNs() {
+    if (mFd < 0) return 0;
+    int64_t realtimeNs;
+    uint32_t sequence;
+    if (!fetch(realtimeNs, sequence) || realtimeNs <= 0) return mEdgeNs;
+    if (sequence != mSequence || mEdgeNs == 0) {
+        mSequence = sequence;
+        // The edge is converted when first seen, within a second of it; only a step of the
+        // wall clock in between would skew it.
+        mEdgeNs = realtimeNs + (clockNs(CLOCK_BOOTTIME) - clockNs(CLOCK_REALTIME));
+    }
+    return mEdgeNs;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
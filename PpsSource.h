@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Optional pulse-per-second input (the LC29H 1PPS pin wired to a pps-gpio line). Reads the
+// latest assert edge without blocking, either from a RFC 2783 /dev/pps* device or from a text
+// file in the sysfs "assert" format ("<sec>.<nsec>#<sequence>"), which also serves as a stand-in
+// for testing. Edges are CLOCK_REALTIME and are converted to CLOCK_BOOTTIME here.
+class PpsSource {
+public:
+    explicit PpsSource(const std::string& path) : mPath(path) {}
+    ~PpsSource() { close(); }
+
+    bool open();
+    void close();
+    bool isOpen() const { return mFd >= 0; }
+
+    // Returns the most recent assert edge in CLOCK_BOOTTIME, or 0 if none has been seen.
+    int64_t latestEdgeNs();
+
+private:
+    bool fetch(int64_t& realtimeNs, uint32_t& sequence);
+
+    std::string mPath;
+    int mFd = -1;
+    bool mIsDevice = false;
+    uint32_t mSequence = 0;
+    int64_t mEdgeNs = 0;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
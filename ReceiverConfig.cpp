@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ReceiverConfig.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+#include "NmeaDecode.h"
+#include "NmeaTypes.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr int PAIR_ACK = 1;
+static constexpr int PAIR_GNSS_POWER_ON = 2;
+static constexpr int PAIR_GNSS_POWER_OFF = 3;
+static constexpr int PAIR_HOT_START = 4;  // warm and cold follow
+static constexpr int PAIR_SET_FIX_INTERVAL = 50;
+static constexpr int PAIR_SET_NMEA_RATE = 62;
+static constexpr int PAIR_SET_SEARCH_MODE = 66;
+static constexpr int PAIR_SET_SBAS = 410;
+static constexpr int PAIR_SET_RTCM_OUTPUT = 432;
+static constexpr int PAIR_SET_REF_UTC = 590;
+static constexpr int PAIR_SET_REF_LOCATION = 600;
+static constexpr int PAIR_SET_BAUD_RATE = 864;
+// PAIR001 result codes.
+static constexpr int ACK_SUCCESS = 0;
+static constexpr int ACK_PROCESSING = 1;
+static constexpr int ACK_BUSY = 5;
+// PAIR432 modes.
+static constexpr int32_t RTCM_OFF = -1;
+static constexpr int32_t RTCM_MSM7 = 1;
+static constexpr int64_t MS_PER_DAY = 24LL * 3600 * 1000;
+// PAIR066 fields, in order.
+static constexpr Constellation SEARCH_MODE_FIELDS[] = {
+        Constellation::GPS, Constellation::GLONASS, Constellation::GALILEO,
+        Constellation::BEIDOU, Constellation::QZSS, Constellation::IRNSS,
+};
+
+static bool isBlocked(uint8_t blockedConstellations, Constellation constellation) {
+    return (blockedConstellations >> static_cast<unsigned>(constellation)) & 1;
+}
+
+int ReceiverConfig::commandFor(Item item, int32_t value) const {
+    switch (item) {
+        case BAUD: return PAIR_SET_BAUD_RATE;
+        case ENGINE: return value ? PAIR_GNSS_POWER_ON : PAIR_GNSS_POWER_OFF;
+        case SEARCH_MODE: return PAIR_SET_SEARCH_MODE;
+        case SBAS: return PAIR_SET_SBAS;
+        case RESTART: return PAIR_HOT_START + static_cast<int>(mRestart);
+        case AID_TIME: return PAIR_SET_REF_UTC;
+        case AID_POSITION: return PAIR_SET_REF_LOCATION;
+        case RTCM_OUTPUT: return PAIR_SET_RTCM_OUTPUT;
+        case FIX_INTERVAL: return PAIR_SET_FIX_INTERVAL;
+        default: return PAIR_SET_NMEA_RATE;
+    }
+}
+
+int32_t ReceiverConfig::fixIntervalFor(int32_t minIntervalMs) {
+    if (minIntervalMs <= 100) return 100;
+    if (minIntervalMs >= 1000) return 1000;
+    return minIntervalMs / 100 * 100;
+}
+
+size_t ReceiverConfig::formatCommand(char* out, size_t size, int command, const int32_t* args,
+                                     size_t count) {
+    char fields[64];
+    int length = 0;
+    fields[0] = '\0';
+    for (size_t i = 0; i < count && length >= 0 && static_cast<size_t>(length) < sizeof(fields);
+         i++) {
+        length += snprintf(fields + length, sizeof(fields) - length, i > 0 ? ",%d" : "%d", args[i]);
+    }
+    if (length < 0 || static_cast<size_t>(length) >= sizeof(fields)) return 0;
+    return formatCommand(out, size, command, count > 0 ? fields : nullptr);
+}
+
+size_t ReceiverConfig::formatCommand(char* out, size_t size, int command, const char* fields) {
+    int length = fields != nullptr ? snprintf(out, size, "$PAIR%03d,%s", command, fields)
+                                   : snprintf(out, size, "$PAIR%03d", command);
+    if (length <= 0 || static_cast<size_t>(length) + 5 >= size) return 0;
+    uint8_t checksum = 0;
+    for (int i = 1; i < length; i++) checksum ^= static_cast<uint8_t>(out[i]);
+    length += snprintf(out + length, size - length, "*%02X\r\n", checksum);
+    return static_cast<size_t>(length);
+}
+
+void ReceiverConfig::reset(int32_t baudRate, int64_t nowMs) {
+    std::fill(mDesired, mDesired + ITEM_COUNT, UNKNOWN);
+    std::fill(mApplied, mApplied + ITEM_COUNT, UNKNOWN);
+    std::fill(mGivenUp, mGivenUp + ITEM_COUNT, false);
+    // Until told otherwise the receiver is assumed to be at its power-on rate.
+    mDesired[BAUD] = mApplied[BAUD] = baudRate;
+    // A pending restart is dropped, the aids are sent again.
+    if (mHaveTimeAid) request(AID_TIME);
+    if (mHavePositionAid) request(AID_POSITION);
+    mInFlight = -1;
+    mAckedBaudRate = 0;
+    mRejectedCommand = 0;
+    mDefaultBaudRate = mHostBaudRate = baudRate;
+    mFallbackBaudRate = 0;
+    mLinkVerified = false;
+    mLinkDeadlineMs = nowMs + LINK_TIMEOUT_MS;
+    mProbeEngine = true;
+}
+
+void ReceiverConfig::setDesired(const Settings& settings) {
+    const int32_t satellites = settings.satellites ? 1 : 0;
+    // Receivers without RTCM output reject PAIR432, so it is not sent unless asked for.
+    const int32_t rtcm = settings.measurements ? RTCM_MSM7
+            : mDesired[RTCM_OUTPUT] == UNKNOWN ? UNKNOWN : RTCM_OFF;
+    // The enabled constellations as PAIR066 field bits.
+    mConstellationsSet = mConstellationsSet || settings.blockedConstellations != 0;
+    int32_t searchMode = 0;
+    for (size_t i = 0; i < std::size(SEARCH_MODE_FIELDS); i++) {
+        if (!isBlocked(settings.blockedConstellations, SEARCH_MODE_FIELDS[i])) {
+            searchMode |= 1 << i;
+        }
+    }
+    const int32_t sbas = isBlocked(settings.blockedConstellations, Constellation::SBAS) ? 0 : 1;
+    const int32_t values[ITEM_COUNT] = {
+        settings.baudRate > 0 ? settings.baudRate : mDefaultBaudRate,
+        settings.engine ? 1 : 0,
+        mConstellationsSet ? searchMode : UNKNOWN, mConstellationsSet ? sbas : UNKNOWN,
+        mDesired[RESTART], mDesired[AID_TIME], mDesired[AID_POSITION],
+        1, 0, satellites, satellites, 1, 1, 0, 0, 1,  // GGA GLL GSA GSV RMC VTG ZDA GRS GST
+        rtcm,
+        fixIntervalFor(settings.fixIntervalMs),
+    };
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        if (mDesired[i] == values[i]) continue;
+        mDesired[i] = values[i];
+        mGivenUp[i] = false;
+    }
+}
+
+void ReceiverConfig::request(Item item) {
+    mDesired[item] = ++mGeneration;
+    mGivenUp[item] = false;
+}
+
+void ReceiverConfig::setTimeAid(const TimeAid* aid) {
+    mHaveTimeAid = aid != nullptr;
+    if (aid == nullptr) {
+        mDesired[AID_TIME] = UNKNOWN;
+        return;
+    }
+    mTimeAid = *aid;
+    request(AID_TIME);
+}
+
+void ReceiverConfig::setPositionAid(const PositionAid* aid) {
+    mHavePositionAid = aid != nullptr;
+    if (aid == nullptr) {
+        mDesired[AID_POSITION] = UNKNOWN;
+        return;
+    }
+    mPositionAid = *aid;
+    request(AID_POSITION);
+}
+
+void ReceiverConfig::restart(Restart kind) {
+    mRestart = kind;
+    request(RESTART);
+    // After the restart, which is sent first; a cold start forgets them.
+    if (mHaveTimeAid) request(AID_TIME);
+    if (mHavePositionAid) request(AID_POSITION);
+}
+
+void ReceiverConfig::onSentence(int64_t nowMs) {
+    if (mLinkVerified) return;
+    mLinkVerified = true;
+    mFallbackBaudRate = 0;
+    mLinkDeadlineMs = -1;
+}
+
+bool ReceiverConfig::onAck(const NmeaSentence& sentence, int64_t nowMs) {
+    if (sentence[0] != "PAIR001") return false;
+    int command, result;
+    if (!decodeInt(sentence[1], command) || !decodeInt(sentence[2], result)) return true;
+    if (mInFlight < 0 || command != commandFor(static_cast<Item>(mInFlight), mInFlightValue)) {
+        return true;
+    }
+
+    if (result == ACK_SUCCESS) {
+        mApplied[mInFlight] = mInFlightValue;
+        if (mInFlight == BAUD) mAckedBaudRate = mInFlightValue;
+        // The engine searches the new set from its next start; a restart already pending does.
+        if (mInFlight == SEARCH_MODE &&
+            (mDesired[RESTART] == mApplied[RESTART] || mGivenUp[RESTART])) {
+            restart(Restart::HOT);
+        }
+        mInFlight = -1;
+    } else if (result == ACK_PROCESSING) {
+        mDeadlineMs = nowMs + ACK_TIMEOUT_MS;
+    } else if (result != ACK_BUSY) {
+        // Busy is retried on the timeout; anything else will not get better by repeating it.
+        mStats.rejected++;
+        mGivenUp[mInFlight] = true;
+        mRejectedCommand = command;
+        mRejectedResult = result;
+        mInFlight = -1;
+    }
+    return true;
+}
+
+ReceiverConfig::Action ReceiverConfig::setHostBaud(int32_t baudRate, int64_t nowMs) {
+    mHostBaudRate = baudRate;
+    mLinkVerified = false;
+    mLinkDeadlineMs = nowMs + LINK_TIMEOUT_MS;
+    mProbeEngine = true;
+    mInFlight = -1;
+    Action action;
+    action.kind = Action::SET_HOST_BAUD;
+    action.baudRate = baudRate;
+    return action;
+}
+
+ReceiverConfig::Action ReceiverConfig::write(int command, const int32_t* args, size_t count) {
+    Action action;
+    action.command = command;
+    size_t length = formatCommand(mCommand, sizeof(mCommand), command, args, count);
+    action.kind = Action::WRITE;
+    action.text = std::string_view(mCommand, length);
+    return action;
+}
+
+ReceiverConfig::Action ReceiverConfig::write(int command, const char* fields) {
+    Action action;
+    action.command = command;
+    size_t length = formatCommand(mCommand, sizeof(mCommand), command, fields);
+    action.kind = Action::WRITE;
+    action.text = std::string_view(mCommand, length);
+    return action;
+}
+
+ReceiverConfig::Action ReceiverConfig::send(int64_t nowMs) {
+    const Item item = static_cast<Item>(mInFlight);
+    mDeadlineMs = nowMs + ACK_TIMEOUT_MS;
+    mStats.sent++;
+    if (item == AID_TIME) {
+        // The time as it goes out, to the nearest second.
+        const int64_t unixMs = mTimeAid.unixMs + (nowMs - mTimeAid.atMs) + 500;
+        const int64_t days = unixMs / MS_PER_DAY;
+        const int32_t secondOfDay = static_cast<int32_t>(unixMs % MS_PER_DAY / 1000);
+        int32_t utc[6];
+        civilFromDays(static_cast<int32_t>(days), utc[0], utc[1], utc[2]);
+        utc[3] = secondOfDay / 3600;
+        utc[4] = secondOfDay / 60 % 60;
+        utc[5] = secondOfDay % 60;
+        return write(PAIR_SET_REF_UTC, utc, 6);
+    }
+    if (item == AID_POSITION) {
+        // Latitude, longitude, altitude, error ellipse axes and bearing, vertical error.
+        const PositionAid& aid = mPositionAid;
+        char fields[96];
+        snprintf(fields, sizeof(fields), "%.6f,%.6f,%.1f,%.1f,%.1f,0.0,%.1f",
+                 aid.latitudeDegrees, aid.longitudeDegrees, aid.altitudeMeters,
+                 aid.accuracyMeters, aid.accuracyMeters, aid.accuracyMeters);
+        return write(PAIR_SET_REF_LOCATION, fields);
+    }
+    int32_t args[std::size(SEARCH_MODE_FIELDS)];
+    size_t count = 0;
+    if (item == SEARCH_MODE) {
+        for (; count < std::size(SEARCH_MODE_FIELDS); count++) {
+            args[count] = (mInFlightValue >> count) & 1;
+        }
+        return write(PAIR_SET_SEARCH_MODE, args, count);
+    }
+    if (item == BAUD) {
+        args[count++] = 0;  // UART
+        args[count++] = 0;  // port index
+    } else if (item >= RATE_GGA && item <= RATE_GST) {
+        args[count++] = item - RATE_GGA;
+    }
+    if (item != ENGINE && item != RESTART) args[count++] = mInFlightValue;
+    return write(commandFor(item, mInFlightValue), args, count);
+}
+
+ReceiverConfig::Action ReceiverConfig::poll(int64_t nowMs) {
+    Action action;
+    if (mRejectedCommand != 0) {
+        action.kind = Action::GAVE_UP;
+        action.command = mRejectedCommand;
+        action.result = mRejectedResult;
+        mRejectedCommand = 0;
+        return action;
+    }
+    if (mAckedBaudRate != 0) {
+        int32_t baudRate = mAckedBaudRate;
+        mAckedBaudRate = 0;
+        mFallbackBaudRate = mHostBaudRate;
+        return setHostBaud(baudRate, nowMs);
+    }
+
+    if (!mLinkVerified) {
+        if (probePending()) {
+            // Not tracked: its acknowledgement, or any output at all, verifies the link.
+            mProbeEngine = false;
+            return write(PAIR_GNSS_POWER_ON, nullptr, 0);
+        }
+        if (nowMs < mLinkDeadlineMs) return action;
+        if (mFallbackBaudRate != 0) {
+            // The receiver is not talking at the new rate: go back and stay there.
+            mStats.baudFallbacks++;
+            int32_t baudRate = mFallbackBaudRate;
+            mFallbackBaudRate = 0;
+            mApplied[BAUD] = baudRate;
+            mGivenUp[BAUD] = true;
+            return setHostBaud(baudRate, nowMs);
+        }
+        int32_t other = mHostBaudRate == mDefaultBaudRate ? mDesired[BAUD] : mDefaultBaudRate;
+        if (other > 0 && other != mHostBaudRate) {
+            mApplied[BAUD] = other;
+            return setHostBaud(other, nowMs);
+        }
+        mLinkDeadlineMs = nowMs + LINK_TIMEOUT_MS;
+        return action;
+    }
+
+    if (mInFlight >= 0) {
+        if (nowMs < mDeadlineMs) return action;
+        if (mAttempts < MAX_ATTEMPTS) {
+            mAttempts++;
+            mStats.retries++;
+            return send(nowMs);
+        }
+        mStats.timeouts++;
+        const Item item = static_cast<Item>(mInFlight);
+        mInFlight = -1;
+        if (item == BAUD) {
+            // Some firmware switches before it acknowledges; listen at the new rate and fall
+            // back if nothing valid arrives there either.
+            mApplied[BAUD] = mInFlightValue;
+            mFallbackBaudRate = mHostBaudRate;
+            return setHostBaud(mInFlightValue, nowMs);
+        }
+        mGivenUp[item] = true;
+        action.kind = Action::GAVE_UP;
+        action.command = commandFor(item, mInFlightValue);
+        return action;
+    }
+
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        if (!pending(i)) continue;
+        mInFlight = i;
+        mInFlightValue = mDesired[i];
+        mAttempts = 1;
+        return send(nowMs);
+    }
+    return action;
+}
+
+ReceiverConfig::Action ReceiverConfig::powerOff() {
+    if (!mLinkVerified) return Action();
+    mInFlight = -1;
+    mDesired[ENGINE] = mApplied[ENGINE] = 0;
+    return write(PAIR_GNSS_POWER_OFF, nullptr, 0);
+}
+
+bool ReceiverConfig::probePending() const {
+    return mProbeEngine && mDesired[ENGINE] == 1 && mApplied[ENGINE] != 1;
+}
+
+int64_t ReceiverConfig::nextDeadlineMs() const {
+    if (mRejectedCommand != 0 || mAckedBaudRate != 0) return 0;
+    if (!mLinkVerified) return probePending() ? 0 : mLinkDeadlineMs;
+    if (mInFlight >= 0) return mDeadlineMs;
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        if (pending(i)) return 0;
+    }
+    return -1;
+}
+
+bool ReceiverConfig::pending(int item) const {
+    if (mGivenUp[item] || mDesired[item] == UNKNOWN || mDesired[item] == mApplied[item]) {
+        return false;
+    }
+    // One-offs wait for the engine: a receiver in standby has nothing to apply them to.
+    return !isOneOff(item) || (mDesired[ENGINE] == 1 && mApplied[ENGINE] == 1);
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
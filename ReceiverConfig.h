@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "NmeaFramer.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Keeps the receiver configured for what the current session needs, with the PAIR commands of
+// Airoha-based receivers such as the Quectel LC29H: UART baud rate (PAIR864), engine on or in
+// standby (PAIR002/PAIR003), constellations searched for (PAIR066, SBAS PAIR410), NMEA sentence
+// rates (PAIR062), RTCM 3 MSM raw measurement output (PAIR432) and fix interval (PAIR050).
+// Commands go out one at a time; each waits for its $PAIR001 acknowledgement and is retried a
+// few times before that setting is given up until it changes again.
+//
+// One-off commands go the same way, once the engine is on: a hot, warm or cold restart
+// (PAIR004 to PAIR006) and time and position aiding (PAIR590, PAIR600), which is sent again
+// after every reset() and restart since the receiver may have lost it.
+//
+// After reset() and after every baud change the link is unverified: nothing is sent until a
+// sentence with a valid checksum arrives. A new baud rate that yields no sentences reverts to
+// the previous one, and a receiver that is silent at start-up (left at the higher rate by an
+// earlier session) is looked for at the other rate. A receiver left in standby is silent too,
+// so at each rate tried the engine is first started blind.
+//
+// No I/O here: the reader writes the commands poll() returns and applies host baud changes.
+class ReceiverConfig {
+public:
+    struct Settings {
+        int32_t fixIntervalMs = 1000;
+        bool satellites = true;  // GSV and GSA
+        int32_t baudRate = 0;    // preferred UART rate, 0 to stay at the receiver's default
+        bool measurements = false;  // RTCM MSM7; only ever turned off after being turned on
+        bool engine = true;      // false: standby, UART still up, hot start on the way back
+        // Bit per Constellation value: not searched for (PAIR066, SBAS PAIR410). Neither is
+        // sent until something has been blocked, and a change is followed by a hot restart.
+        uint8_t blockedConstellations = 0;
+    };
+
+    struct Action {
+        enum Kind : uint8_t { NONE, WRITE, SET_HOST_BAUD, GAVE_UP } kind = NONE;
+        std::string_view text;  // WRITE: the command, valid until the next poll()
+        int32_t baudRate = 0;   // SET_HOST_BAUD
+        int command = 0;        // WRITE, GAVE_UP: PAIR command number
+        int result = -1;        // GAVE_UP: the receiver's result code, -1 if it never answered
+    };
+
+    struct Stats {
+        uint32_t sent = 0;
+        uint32_t retries = 0;
+        uint32_t rejected = 0;
+        uint32_t timeouts = 0;
+        uint32_t baudFallbacks = 0;
+    };
+
+    enum class Restart : uint8_t { HOT, WARM, COLD };
+
+    // UTC time, |unixMs| at CLOCK_BOOTTIME |atMs|; sent as the time when it goes out.
+    struct TimeAid {
+        int64_t unixMs = 0;
+        int64_t atMs = 0;
+    };
+    struct PositionAid {
+        double latitudeDegrees = 0;
+        double longitudeDegrees = 0;
+        double altitudeMeters = 0;
+        float accuracyMeters = 0;
+    };
+
+    ReceiverConfig() { reset(0, 0); }
+
+    // The receiver's state is unknown; the host UART is at |baudRate|, the receiver's default.
+    void reset(int32_t baudRate, int64_t nowMs);
+    void setDesired(const Settings& settings);
+    // Null clears; the aid is then not sent again.
+    void setTimeAid(const TimeAid* aid);
+    void setPositionAid(const PositionAid* aid);
+    // A pending restart not sent yet is replaced. The aids follow it again.
+    void restart(Restart kind);
+
+    // Called for every sentence with a valid checksum, before onAck().
+    void onSentence(int64_t nowMs);
+    // Consumes $PAIR001 acknowledgements; returns false for any other sentence.
+    bool onAck(const NmeaSentence& sentence, int64_t nowMs);
+    // Next thing to do. Call until it returns NONE.
+    Action poll(int64_t nowMs);
+    // The command that puts the receiver in standby as the UART is closed, not acknowledged.
+    // NONE if the link is not verified, as it would go out at the wrong rate.
+    Action powerOff();
+    // When poll() next has timed work, or -1 if it only waits for input.
+    int64_t nextDeadlineMs() const;
+
+    int32_t hostBaudRate() const { return mHostBaudRate; }
+    bool linkVerified() const { return mLinkVerified; }
+    const Stats& stats() const { return mStats; }
+
+    // The LC29H runs fixes every 100 to 1000 ms; intervals in between round down to 100 ms.
+    static int32_t fixIntervalFor(int32_t minIntervalMs);
+    // Writes "$PAIRnnn,a,b*hh\r\n" into |out| and returns its length, or 0 if it does not fit.
+    static size_t formatCommand(char* out, size_t size, int command, const int32_t* args,
+                                size_t count);
+    // The same with |fields|, already comma separated, as the arguments.
+    static size_t formatCommand(char* out, size_t size, int command, const char* fields);
+
+private:
+    // Settings in the order they are sent: baud first so the rest goes out at the final rate,
+    // sentence rates before the fix interval so a faster interval never meets a full link.
+    enum Item : uint8_t {
+        BAUD,
+        ENGINE,
+        SEARCH_MODE, SBAS,
+        RESTART, AID_TIME, AID_POSITION,  // one-off: values are generations
+        RATE_GGA, RATE_GLL, RATE_GSA, RATE_GSV, RATE_RMC, RATE_VTG, RATE_ZDA, RATE_GRS, RATE_GST,
+        RTCM_OUTPUT,
+        FIX_INTERVAL,
+        ITEM_COUNT,
+    };
+    static constexpr int32_t UNKNOWN = INT32_MIN;  // -1 is a valid PAIR432 argument
+    static constexpr int MAX_ATTEMPTS = 3;
+    static constexpr int64_t ACK_TIMEOUT_MS = 1000;
+    // A receiver outputs at least once a second, so this much silence means a wrong baud rate.
+    static constexpr int64_t LINK_TIMEOUT_MS = 2500;
+
+    int commandFor(Item item, int32_t value) const;
+    static bool isOneOff(int item) { return item >= RESTART && item <= AID_POSITION; }
+    // Arms a one-off item: a new generation to send.
+    void request(Item item);
+    Action write(int command, const int32_t* args, size_t count);
+    Action write(int command, const char* fields);
+    Action send(int64_t nowMs);
+    bool probePending() const;
+    bool pending(int item) const;
+    Action setHostBaud(int32_t baudRate, int64_t nowMs);
+
+    Restart mRestart = Restart::HOT;
+    bool mHaveTimeAid = false;
+    TimeAid mTimeAid;
+    bool mHavePositionAid = false;
+    PositionAid mPositionAid;
+    int32_t mGeneration = 0;
+    bool mConstellationsSet = false;  // survives reset(): the receiver may still have them
+
+    int32_t mDesired[ITEM_COUNT];
+    int32_t mApplied[ITEM_COUNT];
+    bool mGivenUp[ITEM_COUNT];
+
+    int mInFlight = -1;  // Item awaiting its acknowledgement
+    int32_t mInFlightValue = 0;
+    int mAttempts = 0;
+    int64_t mDeadlineMs = -1;
+    int32_t mAckedBaudRate = 0;  // receiver acknowledged PAIR864, host not switched yet
+    int mRejectedCommand = 0;    // to be reported by the next poll()
+    int mRejectedResult = -1;
+
+    int32_t mDefaultBaudRate = 0;
+    int32_t mHostBaudRate = 0;
+    int32_t mFallbackBaudRate = 0;  // rate before an unverified switch, 0 if none
+    bool mLinkVerified = false;
+    int64_t mLinkDeadlineMs = -1;
+    bool mProbeEngine = false;  // at this rate, before the link is verified
+
+    char mCommand[96];
+    Stats mStats;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
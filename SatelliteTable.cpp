@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SatelliteTable.h"
+
+#include <cstring>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+static constexpr int32_t MS_PER_DAY = 24 * 3600 * 1000;
+
+static constexpr float L1_HZ = 1575.42e6f;   // also E1, B1C
+static constexpr float L2_HZ = 1227.60e6f;
+static constexpr float L5_HZ = 1176.45e6f;   // also E5a, B2a
+static constexpr float E5B_HZ = 1207.14e6f;  // also B2I, B2b
+static constexpr float E5_HZ = 1191.795e6f;
+static constexpr float E6_HZ = 1278.75e6f;   // also QZSS L6
+static constexpr float B1I_HZ = 1561.098e6f;
+static constexpr float B3_HZ = 1268.52e6f;
+static constexpr float G1_HZ = 1602.0e6f;    // FDMA centre; NMEA does not carry the channel
+static constexpr float G2_HZ = 1246.0e6f;
+static constexpr float S_HZ = 2492.028e6f;
+
+float SatelliteTable::carrierFrequencyHz(Constellation constellation, uint8_t signalId) {
+    switch (constellation) {
+        case Constellation::GPS:
+        case Constellation::SBAS:
+            if (signalId >= 1 && signalId <= 3) return L1_HZ;
+            if (signalId >= 4 && signalId <= 6) return L2_HZ;
+            if (signalId == 7 || signalId == 8) return L5_HZ;
+            return 0;
+        case Constellation::GLONASS:
+            if (signalId == 1 || signalId == 2) return G1_HZ;
+            if (signalId == 3 || signalId == 4) return G2_HZ;
+            return 0;
+        case Constellation::GALILEO:
+            switch (signalId) {
+                case 1: return L5_HZ;
+                case 2: return E5B_HZ;
+                case 3: return E5_HZ;
+                case 4: case 5: return E6_HZ;
+                case 6: case 7: return L1_HZ;
+            }
+            return 0;
+        case Constellation::BEIDOU:
+            switch (signalId) {
+                case 1: case 2: return B1I_HZ;
+                case 3: case 4: return L1_HZ;
+                case 5: return L5_HZ;
+                case 6: case 11: case 12: return E5B_HZ;
+                case 7: return E5_HZ;
+                case 8: case 9: case 10: return B3_HZ;
+            }
+            return 0;
+        case Constellation::QZSS:
+            if (signalId >= 1 && signalId <= 4) return L1_HZ;
+            if (signalId == 5 || signalId == 6) return L2_HZ;
+            if (signalId == 7 || signalId == 8) return L5_HZ;
+            if (signalId == 9 || signalId == 10) return E6_HZ;
+            return 0;
+        case Constellation::IRNSS:
+            if (signalId == 1 || signalId == 3) return L5_HZ;
+            if (signalId == 2 || signalId == 4) return S_HZ;
+            if (signalId == 5) return L1_HZ;
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+int32_t SatelliteTable::ageMs(int32_t lastSeen, int32_t now) {
+    if (now < 0) return 0;
+    if (lastSeen < 0) return MS_PER_DAY;
+    int32_t age = now - lastSeen;
+    return age < 0 ? age + MS_PER_DAY : age;
+}
+
+NmeaSatellite& SatelliteTable::update(Constellation constellation, int svid, uint8_t signalId,
+                                      int32_t utcMsOfDay) {
+    const uint16_t k = key(constellation, svid, signalId);
+    size_t slot = slotFor(k);
+    while (mIndex[slot] != 0 && mKeys[mIndex[slot] - 1] != k) slot = (slot + 1) & (INDEX_SIZE - 1);
+    if (mIndex[slot] != 0) {
+        size_t i = mIndex[slot] - 1;
+        mLastSeen[i] = utcMsOfDay;
+        return mEntries[i];
+    }
+
+    size_t i;
+    if (mSize < CAPACITY) {
+        i = mSize++;
+        mKeys[i] = k;
+        mIndex[slot] = static_cast<uint8_t>(i + 1);
+    } else {
+        // Replace the stalest entry rather than dropping the SV that is in view right now.
+        i = 0;
+        for (size_t j = 1; j < mSize; j++) {
+            if (ageMs(mLastSeen[j], utcMsOfDay) > ageMs(mLastSeen[i], utcMsOfDay)) i = j;
+        }
+        mKeys[i] = k;
+        rebuildIndex();
+    }
+    mLastSeen[i] = utcMsOfDay;
+    mEntries[i] = NmeaSatellite();
+    mEntries[i].constellation = constellation;
+    mEntries[i].svid = svid;
+    mEntries[i].signalId = signalId;
+    mEntries[i].carrierFrequencyHz = carrierFrequencyHz(constellation, signalId);
+    return mEntries[i];
+}
+
+void SatelliteTable::age(int32_t utcMsOfDay) {
+    if (utcMsOfDay < 0) return;
+    const size_t before = mSize;
+    for (size_t i = 0; i < mSize;) {
+        if (ageMs(mLastSeen[i], utcMsOfDay) > MAX_AGE_MS) {
+            remove(i);
+        } else {
+            i++;
+        }
+    }
+    // Removal moves entries, so the index is rebuilt rather than patched; this happens at most
+    // once per epoch.
+    if (mSize != before) rebuildIndex();
+}
+
+void SatelliteTable::remove(size_t i) {
+    // Order is not significant, so move the last entry into the hole.
+    mSize--;
+    mKeys[i] = mKeys[mSize];
+    mLastSeen[i] = mLastSeen[mSize];
+    mEntries[i] = mEntries[mSize];
+}
+
+void SatelliteTable::rebuildIndex() {
+    memset(mIndex, 0, sizeof(mIndex));
+    for (size_t i = 0; i < mSize; i++) {
+        size_t slot = slotFor(mKeys[i]);
+        while (mIndex[slot] != 0) slot = (slot + 1) & (INDEX_SIZE - 1);
+        mIndex[slot] = static_cast<uint8_t>(i + 1);
+    }
+}
+
+void SatelliteTable::setBlocklist(const SvBlocklist& blocklist) {
+    mBlocklist = blocklist;
+    const size_t before = mSize;
+    for (size_t i = 0; i < mSize;) {
+        if (mBlocklist.blocked(mEntries[i].constellation, mEntries[i].svid)) {
+            mUsed[static_cast<size_t>(mEntries[i].constellation)].reset(mEntries[i].svid);
+            remove(i);
+        } else {
+            i++;
+        }
+    }
+    if (mSize != before) rebuildIndex();
+}
+
+void SatelliteTable::clear() {
+    mSize = 0;
+    memset(mIndex, 0, sizeof(mIndex));
+    clearUsedInFix();
+}
+
+void SatelliteTable::clearUsedInFix() {
+    for (auto& used : mUsed) used.reset();
+}
+
+void SatelliteTable::setUsedInFix(Constellation constellation, int svid) {
+    size_t c = static_cast<size_t>(constellation);
+    if (c >= CONSTELLATIONS || svid <= 0 || svid >= MAX_SVID) return;
+    if (!mBlocklist.blocked(constellation, svid)) mUsed[c].set(svid);
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+#include "NmeaTypes.h"
+#include "SvBlocklist.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Satellites in view, one entry per (constellation, svid, signal) so the L1 and L5 signals of
+// the same SV are reported separately. Fixed capacity and no allocation: entries are stored
+// densely (so snapshots iterate a flat array) and found through a small open-addressed index.
+// Entries not refreshed by GSV for MAX_AGE_MS are dropped, and when the table is full the
+// stalest entry is replaced.
+//
+// Used-in-fix is kept apart, as one bitset per constellation indexed by svid, since GSA names
+// SVs without signals.
+//
+// Blocklisted SVs are left out: parsers check blocked() before update(), and setUsedInFix()
+// ignores them. The blocklist outlives clear().
+class SatelliteTable {
+public:
+    static constexpr size_t CAPACITY = 128;
+    static constexpr int32_t MAX_AGE_MS = 5000;
+
+    // Returns the entry for the key, adding it if needed, and marks it seen at |utcMsOfDay|
+    // (-1 if the receiver has no time yet).
+    NmeaSatellite& update(Constellation constellation, int svid, uint8_t signalId,
+                          int32_t utcMsOfDay);
+    // Drops entries last seen more than MAX_AGE_MS before |utcMsOfDay|.
+    void age(int32_t utcMsOfDay);
+    void clear();
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    const NmeaSatellite& operator[](size_t i) const { return mEntries[i]; }
+    const NmeaSatellite* begin() const { return mEntries; }
+    const NmeaSatellite* end() const { return mEntries + mSize; }
+
+    // Also drops the entries it now blocks.
+    void setBlocklist(const SvBlocklist& blocklist);
+    bool blocked(Constellation constellation, int svid) const {
+        return mBlocklist.blocked(constellation, svid);
+    }
+
+    void clearUsedInFix();
+    void setUsedInFix(Constellation constellation, int svid);
+    bool isUsedInFix(Constellation constellation, int svid) const {
+        size_t c = static_cast<size_t>(constellation);
+        return c < CONSTELLATIONS && svid > 0 && svid < MAX_SVID && mUsed[c].test(svid);
+    }
+
+    // Carrier frequency of an NMEA 4.11 signal ID, or 0 if the signal is not known.
+    static float carrierFrequencyHz(Constellation constellation, uint8_t signalId);
+
+private:
+    static constexpr size_t CONSTELLATIONS = 8;
+    static constexpr int MAX_SVID = 256;
+    // Power of two, four times CAPACITY so probe chains stay short. Slots hold entry index + 1.
+    static constexpr size_t INDEX_SIZE = 4 * CAPACITY;
+    static_assert(CAPACITY < 255, "index slots are uint8_t");
+
+    // constellation:4 | svid:8 | signal:4
+    static uint16_t key(Constellation constellation, int svid, uint8_t signalId) {
+        return static_cast<uint16_t>((static_cast<unsigned>(constellation) << 12) |
+                                     ((static_cast<unsigned>(svid) & 0xff) << 4) | (signalId & 0xf));
+    }
+    static size_t slotFor(uint16_t key) { return (key * 40503u >> 7) & (INDEX_SIZE - 1); }
+    static int32_t ageMs(int32_t lastSeen, int32_t now);
+    void remove(size_t i);
+    void rebuildIndex();
+
+    uint16_t mKeys[CAPACITY];
+    int32_t mLastSeen[CAPACITY];
+    NmeaSatellite mEntries[CAPACITY];
+    size_t mSize = 0;
+    uint8_t mIndex[INDEX_SIZE] = {};
+    std::bitset<MAX_SVID> mUsed[CONSTELLATIONS];
+    SvBlocklist mBlocklist;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
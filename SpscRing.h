@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread. Slots are
+// filled and drained in place, so nothing is copied twice and nothing is allocated.
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    static constexpr size_t CAPACITY = N;
+
+    // Producer: slot to fill, or nullptr if the ring is full. Publish it with commit().
+    T* reserve() {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == N) return nullptr;
+        return &mSlots[tail & (N - 1)];
+    }
+    void commit() { mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: oldest published slot, or nullptr if empty. Release it with pop().
+    const T* front() {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) return nullptr;
+        return &mSlots[head & (N - 1)];
+    }
+    void pop() { mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Approximate when called from a third thread.
+    size_t size() const {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+private:
+    // Indices on separate cache lines so the two threads do not false-share.
+    alignas(64) std::atomic<size_t> mHead{0};
+    alignas(64) std::atomic<size_t> mTail{0};
+    alignas(64) T mSlots[N];
+};
+
+// Latest-wins mailbox for one producer and one consumer (a triple buffer). The producer always
+// has a buffer to write and never waits; the consumer only ever sees the newest published value.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer: the buffer to fill. Its previous contents are stale but keep their capacity.
+    T& back() { return mBuffers[mBack]; }
+    // Producer: publishes back(). Returns true if an unread value was overwritten.
+    bool publish() {
+        uint8_t old = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel);
+        mBack = old & INDEX;
+        return (old & FRESH) != 0;
+    }
+
+    // Consumer: the newest value if one was published since the last take(), else nullptr.
+    const T* take() {
+        if (!(mMiddle.load(std::memory_order_relaxed) & FRESH)) return nullptr;
+        uint8_t old = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = old & INDEX;
+        return &mBuffers[mFront];
+    }
+
+private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    T mBuffers[3];
+    std::atomic<uint8_t> mMiddle{1};
+    uint8_t mBack = 0;   // producer-owned
+    uint8_t mFront = 2;  // consumer-owned
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
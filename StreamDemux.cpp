@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "StreamDemux.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+StreamDemux::Output StreamDemux::next(const char*& cursor, const char* end,
+                                      NmeaSentence& sentence, BinaryFrame& frame) {
+    while (cursor < end) {
+        if (mBinary.inFrame()) {
+            if (mBinary.next(cursor, end, frame)) return Output::BINARY;
+            continue;
+        }
+        if (mSync == nullptr || mSync < cursor) mSync = BinaryFramer::findSync(cursor, end);
+        if (mNmea.next(cursor, mSync, sentence)) return Output::NMEA;
+        if (cursor == end) break;
+        mNmea.interrupt();
+        if (mBinary.next(cursor, end, frame)) return Output::BINARY;
+    }
+    return Output::NONE;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
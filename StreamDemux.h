@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "BinaryFramer.h"
+#include "NmeaFramer.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Splits one receiver byte stream into NMEA sentences and binary frames. Everything up to the
+// next binary sync byte belongs to NMEA; a sync byte in the middle of a sentence means the
+// sentence was cut short, since receivers only switch protocol between messages.
+class StreamDemux {
+public:
+    enum class Output : uint8_t { NONE, NMEA, BINARY };
+
+    // Returns what was completed, or NONE once [cursor, end) is consumed. Partial messages are
+    // carried over to the next call. Call setChunkTiming() before each new chunk.
+    Output next(const char*& cursor, const char* end, NmeaSentence& sentence, BinaryFrame& frame);
+
+    void setChunkTiming(const char* chunkEnd, int64_t endTimeNs, int64_t byteTimeNs) {
+        mNmea.setChunkTiming(chunkEnd, endTimeNs, byteTimeNs);
+        mBinary.setChunkTiming(chunkEnd, endTimeNs, byteTimeNs);
+        mSync = nullptr;
+    }
+    void reset() {
+        mNmea.reset();
+        mBinary.reset();
+        mSync = nullptr;
+    }
+
+    const NmeaFramer::Stats& nmeaStats() const { return mNmea.stats(); }
+    const BinaryFramer::Stats& binaryStats() const { return mBinary.stats(); }
+
+private:
+    NmeaFramer mNmea;
+    BinaryFramer mBinary;
+    // Next sync byte in the current chunk, so a chunk is searched once rather than per sentence.
+    const char* mSync = nullptr;
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+#include "NmeaTypes.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Satellites the framework does not want used (IGnssConfiguration::setBlocklist): whole
+// constellations as one mask, single SVs as one bitset per constellation indexed by svid, so
+// a lookup is two bit tests. Small enough to copy between threads whole.
+class SvBlocklist {
+public:
+    static constexpr size_t CONSTELLATIONS = 8;
+    static constexpr int MAX_SVID = 256;
+
+    void clear() { *this = SvBlocklist(); }
+    // |svid| 0 blocks the whole constellation, as in BlocklistedSource. Out of range is ignored.
+    void add(Constellation constellation, int svid) {
+        const size_t c = static_cast<size_t>(constellation);
+        if (c == 0 || c >= CONSTELLATIONS || svid < 0 || svid >= MAX_SVID) return;
+        if (svid == 0) {
+            mConstellations |= static_cast<uint8_t>(1u << c);
+        } else {
+            mSvs[c].set(svid);
+        }
+    }
+
+    bool blocked(Constellation constellation, int svid) const {
+        const size_t c = static_cast<size_t>(constellation);
+        if (c >= CONSTELLATIONS) return false;
+        return (mConstellations >> c & 1) || (svid > 0 && svid < MAX_SVID && mSvs[c].test(svid));
+    }
+    bool constellationBlocked(Constellation constellation) const {
+        const size_t c = static_cast<size_t>(constellation);
+        return c < CONSTELLATIONS && (mConstellations >> c & 1);
+    }
+    bool empty() const {
+        if (mConstellations != 0) return false;
+        for (const auto& svs : mSvs) {
+            if (svs.any()) return false;
+        }
+        return true;
+    }
+
+    bool operator==(const SvBlocklist& other) const {
+        if (mConstellations != other.mConstellations) return false;
+        for (size_t c = 0; c < CONSTELLATIONS; c++) {
+            if (mSvs[c] != other.mSvs[c]) return false;
+        }
+        return true;
+    }
+    bool operator!=(const SvBlocklist& other) const { return !(*this == other); }
+
+private:
+    uint8_t mConstellations = 0;  // bit per Constellation value
+    std::bitset<MAX_SVID> mSvs[CONSTELLATIONS];
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
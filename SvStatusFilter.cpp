@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SvStatusFilter.h"
+
+#include <cmath>
+
+namespace aidl::android::hardware::gnss::implementation {
+
+bool SvStatusFilter::changed(const SatelliteTable& table) const {
+    if (table.size() != mSize) return true;
+    // The table only reorders entries when one is added or removed, and that changes the set
+    // anyway, so comparing position by position is exact.
+    for (size_t i = 0; i < mSize; i++) {
+        const NmeaSatellite& sv = table[i];
+        const Reported& last = mReported[i];
+        if (sv.constellation != last.constellation || sv.svid != last.svid ||
+            sv.signalId != last.signalId) {
+            return true;
+        }
+        if (table.isUsedInFix(sv.constellation, sv.svid) != last.usedInFix) return true;
+        if (std::fabs(sv.cn0DbHz - last.cn0DbHz) >= mThresholds.cn0DeltaDbHz) return true;
+    }
+    return false;
+}
+
+bool SvStatusFilter::shouldReport(const SatelliteTable& table, int64_t nowMs) {
+    if (mValid && nowMs - mLastReportMs < mThresholds.refreshIntervalMs && !changed(table)) {
+        return false;
+    }
+    mValid = true;
+    mLastReportMs = nowMs;
+    mSize = table.size();
+    for (size_t i = 0; i < mSize; i++) {
+        const NmeaSatellite& sv = table[i];
+        mReported[i] = {sv.constellation, sv.signalId, table.isUsedInFix(sv.constellation, sv.svid),
+                        sv.svid, sv.cn0DbHz};
+    }
+    return true;
+}
+
+}  // namespace aidl::android::hardware::gnss::implementation
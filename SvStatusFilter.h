@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "NmeaTypes.h"
+#include "SatelliteTable.h"
+
+namespace aidl::android::hardware::gnss::implementation {
+
+// Decides whether the satellites in view changed enough since the last report to be worth a
+// binder call. A report is due when the set of signals changes, an SV enters or leaves the fix,
+// a C/N0 moves by the threshold from its last reported value, or the refresh interval passes
+// (so clients still see a heartbeat while the sky is static).
+class SvStatusFilter {
+public:
+    struct Thresholds {
+        float cn0DeltaDbHz = 3.0f;
+        int64_t refreshIntervalMs = 10000;
+    };
+
+    void setThresholds(const Thresholds& thresholds) { mThresholds = thresholds; }
+    const Thresholds& thresholds() const { return mThresholds; }
+
+    // Returns true if |table| should be reported at |nowMs| (a monotonic clock) and makes it the
+    // reference for the next comparison.
+    bool shouldReport(const SatelliteTable& table, int64_t nowMs);
+    // Forces the next shouldReport() to return true.
+    void reset() { mValid = false; }
+
+private:
+    struct Reported {
+        Constellation constellation;
+        uint8_t signalId;
+        bool usedInFix;
+        int svid;
+        float cn0DbHz;
+    };
+
+    bool changed(const SatelliteTable& table) const;
+
+    Thresholds mThresholds;
+    bool mValid = false;
+    int64_t mLastReportMs = 0;
+    size_t mSize = 0;
+    Reported mReported[SatelliteTable::CAPACITY];
+};
+
+}  // namespace aidl::android::hardware::gnss::implementation
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Throughput benchmarks for the framing and parsing core, driven by the recorded streams in
+// benchmarks/corpus. Run on the host or on the device:
+//   atest gnss_rpi5_nmea_benchmark
+//   $ANDROID_HOST_OUT/benchmarktest64/gnss_rpi5_nmea_benchmark/gnss_rpi5_nmea_benchmark
+
+#include <android-base/file.h>
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "BinaryParser.h"
+#include "FixBatch.h"
+#include "GeofenceIndex.h"
+#include "LocationFilter.h"
+#include "Metrics.h"
+#include "NmeaFramer.h"
+#include "NmeaParser.h"
+#include "StreamDemux.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+// Every heap allocation in the process is counted so the benchmarks can report how many the
+// pipeline makes per epoch. Steady state should be zero.
+static std::atomic<uint64_t> gAllocations{0};
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) abort();
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Matches the reader's read() buffer so sentences straddle chunk boundaries the same way.
+static constexpr size_t READ_CHUNK = 4096;
+
+static const std::string& loadCorpus(const std::string& name) {
+    static std::map<std::string, std::string> cache;
+    auto it = cache.find(name);
+    if (it == cache.end()) {
+        std::string data;
+        android::base::ReadFileToString(
+                android::base::GetExecutableDirectory() + "/benchmarks/corpus/" + name, &data);
+        it = cache.emplace(name, std::move(data)).first;
+    }
+    return it->second;
+}
+
+// An owned copy of a framed sentence, for benchmarks that exclude framing.
+struct StoredSentence {
+    std::string text;
+    NmeaSentence sentence;
+};
+
+static std::vector<StoredSentence> frameCorpus(const std::string& data, SentenceType type) {
+    std::vector<StoredSentence> out;
+    NmeaFramer framer;
+    NmeaSentence s;
+    const char* cursor = data.data();
+    while (framer.next(cursor, data.data() + data.size(), s)) {
+        if (classifySentence(s[0]) != type) continue;
+        out.push_back({std::string(s.text), s});
+    }
+    // Rebase the views onto the owned strings now that the vector no longer moves.
+    for (StoredSentence& stored : out) {
+        const char* oldBase = stored.sentence.text.data();
+        stored.sentence.text = stored.text;
+        for (size_t i = 0; i < stored.sentence.fieldCount; i++) {
+            std::string_view& field = stored.sentence.fields[i];
+            field = std::string_view(stored.text.data() + (field.data() - oldBase), field.size());
+        }
+    }
+    return out;
+}
+
+static void setSentenceCounters(benchmark::State& state, uint64_t sentences) {
+    state.counters["sentences_per_sec"] = benchmark::Counter(sentences, benchmark::Counter::kIsRate);
+    // Printed with an SI prefix, e.g. "450ns".
+    state.counters["time_per_sentence"] = benchmark::Counter(
+            sentences, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// Framing and parsing of a whole stream, as the reader thread sees it.
+static void BM_Pipeline(benchmark::State& state, const char* corpus) {
+    const std::string& data = loadCorpus(corpus);
+    if (data.empty()) {
+        state.SkipWithError("corpus not found next to the benchmark binary");
+        return;
+    }
+    NmeaFramer framer;
+    NmeaParser parser;
+    NmeaSentence sentence;
+    uint64_t sentences = 0;
+    uint64_t epochs = 0;
+    const uint64_t allocationsBefore = gAllocations.load();
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < data.size(); offset += READ_CHUNK) {
+            const char* cursor = data.data() + offset;
+            const char* end = data.data() + std::min(data.size(), offset + READ_CHUNK);
+            while (framer.next(cursor, end, sentence)) {
+                sentences++;
+                parser.parse(sentence);
+                if (parser.epochs().hasCompleted()) {
+                    benchmark::DoNotOptimize(parser.epochs().completed());
+                    parser.epochs().consumeCompleted();
+                    epochs++;
+                }
+            }
+        }
+    }
+    const uint64_t allocations = gAllocations.load() - allocationsBefore;
+    setSentenceCounters(state, sentences);
+    state.counters["allocs_per_epoch"] = epochs ? static_cast<double>(allocations) / epochs : 0;
+    state.counters["bytes_per_epoch"] =
+            epochs ? static_cast<double>(state.iterations() * data.size()) / epochs : 0;
+    state.counters["checksum_errors"] = framer.stats().checksumErrors / static_cast<double>(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK_CAPTURE(BM_Pipeline, lc29h_1hz, "lc29h_1hz.nmea");
+BENCHMARK_CAPTURE(BM_Pipeline, lc29h_10hz, "lc29h_10hz.nmea");
+BENCHMARK_CAPTURE(BM_Pipeline, gsv_storm, "gsv_storm.nmea");
+BENCHMARK_CAPTURE(BM_Pipeline, noisy, "noisy.nmea");
+
+// Framing only: checksum verification and field splitting.
+static void BM_Frame(benchmark::State& state, const char* corpus) {
+    const std::string& data = loadCorpus(corpus);
+    if (data.empty()) {
+        state.SkipWithError("corpus not found next to the benchmark binary");
+        return;
+    }
+    NmeaFramer framer;
+    NmeaSentence sentence;
+    uint64_t sentences = 0;
+    for (auto _ : state) {
+        const char* cursor = data.data();
+        while (framer.next(cursor, data.data() + data.size(), sentence)) {
+            benchmark::DoNotOptimize(sentence.fieldCount);
+            sentences++;
+        }
+    }
+    setSentenceCounters(state, sentences);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK_CAPTURE(BM_Frame, lc29h_10hz, "lc29h_10hz.nmea");
+BENCHMARK_CAPTURE(BM_Frame, noisy, "noisy.nmea");
+
+// Decode cost of one sentence type, framing excluded.
+static void BM_Parse(benchmark::State& state, SentenceType type) {
+    const std::vector<StoredSentence> sentences = frameCorpus(loadCorpus("gsv_storm.nmea"), type);
+    if (sentences.empty()) {
+        state.SkipWithError("no sentences of this type in the corpus");
+        return;
+    }
+    NmeaParser parser;
+    uint64_t parsed = 0;
+    for (auto _ : state) {
+        for (const StoredSentence& stored : sentences) {
+            benchmark::DoNotOptimize(parser.parse(stored.sentence));
+        }
+        parsed += sentences.size();
+    }
+    setSentenceCounters(state, parsed);
+}
+BENCHMARK_CAPTURE(BM_Parse, GGA, SentenceType::GGA);
+BENCHMARK_CAPTURE(BM_Parse, RMC, SentenceType::RMC);
+BENCHMARK_CAPTURE(BM_Parse, GSV, SentenceType::GSV);
+BENCHMARK_CAPTURE(BM_Parse, GSA, SentenceType::GSA);
+BENCHMARK_CAPTURE(BM_Parse, VTG, SentenceType::VTG);
+BENCHMARK_CAPTURE(BM_Parse, GLL, SentenceType::GLL);
+BENCHMARK_CAPTURE(BM_Parse, GST, SentenceType::GST);
+
+static std::string ubxFrame(uint8_t messageClass, uint8_t messageId, const std::vector<uint8_t>& payload) {
+    std::string frame = {'\xB5', '\x62', static_cast<char>(messageClass), static_cast<char>(messageId),
+                         static_cast<char>(payload.size() & 0xff), static_cast<char>(payload.size() >> 8)};
+    frame.append(payload.begin(), payload.end());
+    uint8_t a = 0, b = 0;
+    for (size_t i = 2; i < frame.size(); i++) {
+        a += static_cast<uint8_t>(frame[i]);
+        b += a;
+    }
+    frame += static_cast<char>(a);
+    frame += static_cast<char>(b);
+    return frame;
+}
+
+// The binary counterpart of BM_Pipeline: UBX-NAV-PVT plus UBX-NAV-SAT with 40 SVs per epoch,
+// through the same demultiplexer, to compare bytes and time per epoch with the NMEA corpora.
+static void BM_UbxPipeline(benchmark::State& state) {
+    std::vector<uint8_t> pvt(92, 0);
+    const uint16_t year = 2024;
+    memcpy(&pvt[4], &year, sizeof(year));
+    pvt[6] = 3; pvt[7] = 15; pvt[11] = 0x07;  // date, time valid
+    pvt[20] = 3; pvt[21] = 0x01; pvt[23] = 24;  // 3D, fix OK
+    std::vector<uint8_t> sat(8 + 40 * 12, 0);
+    sat[5] = 40;
+    static constexpr uint8_t kGnssIds[] = {0, 2, 3, 6};  // GPS, Galileo, BeiDou, GLONASS
+    for (int i = 0; i < 40; i++) {
+        uint8_t* block = &sat[8 + i * 12];
+        block[0] = kGnssIds[i % 4];
+        block[1] = static_cast<uint8_t>(1 + i / 4);
+        block[2] = static_cast<uint8_t>(20 + i % 25);
+        block[3] = static_cast<uint8_t>(5 + i * 2);
+        block[8] = i < 24 ? 0x08 : 0;
+    }
+    std::string data;
+    for (int epoch = 0; epoch < 100; epoch++) {
+        pvt[10] = static_cast<uint8_t>(epoch % 60);
+        data += ubxFrame(0x01, 0x07, pvt) + ubxFrame(0x01, 0x35, sat);
+    }
+
+    StreamDemux demux;
+    NmeaParser nmea;
+    BinaryParser parser(nmea.satellites());
+    NmeaSentence sentence;
+    BinaryFrame frame;
+    uint64_t epochs = 0;
+    const uint64_t allocationsBefore = gAllocations.load();
+    for (auto _ : state) {
+        for (size_t offset = 0; offset < data.size(); offset += READ_CHUNK) {
+            const char* cursor = data.data() + offset;
+            const char* end = data.data() + std::min(data.size(), offset + READ_CHUNK);
+            demux.setChunkTiming(end, 0, 0);
+            while (demux.next(cursor, end, sentence, frame) != StreamDemux::Output::NONE) {
+                if (parser.parse(frame) && parser.hasFix()) {
+                    benchmark::DoNotOptimize(parser.fix());
+                    parser.consumeFix();
+                    epochs++;
+                }
+            }
+        }
+    }
+    const uint64_t allocations = gAllocations.load() - allocationsBefore;
+    state.counters["allocs_per_epoch"] = epochs ? static_cast<double>(allocations) / epochs : 0;
+    state.counters["bytes_per_epoch"] = static_cast<double>(data.size()) / 100;
+    state.counters["time_per_epoch"] = benchmark::Counter(
+            epochs, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_UbxPipeline);
+
+// Builds an RTCM 3 MSM7 payload for |satellites| satellites tracked on two signals each.
+static std::vector<uint8_t> msm7Payload(uint16_t messageNumber, uint32_t epochTime, bool more,
+                                        int satellites) {
+    std::vector<uint8_t> out;
+    size_t bit = 0;
+    auto put = [&](uint64_t value, unsigned bits) {
+        for (unsigned i = 0; i < bits; i++, bit++) {
+            if (bit / 8 >= out.size()) out.push_back(0);
+            if ((value >> (bits - 1 - i)) & 1) out[bit / 8] |= 0x80 >> (bit % 8);
+        }
+    };
+    const int cells = satellites * 2;
+    put(messageNumber, 12);
+    put(0, 12);
+    put(epochTime, 30);
+    put(more, 1);
+    put(0, 3 + 7 + 2 + 2 + 1 + 3);
+    uint64_t satelliteMask = 0;
+    for (int i = 0; i < satellites; i++) satelliteMask |= 1ULL << (63 - 2 * i);
+    put(satelliteMask >> 32, 32);
+    put(satelliteMask & 0xffffffff, 32);
+    put(1u << 30 | 1u << 16, 32);  // signals 2 and 16
+    put((1ULL << cells) - 1, cells);
+    for (int i = 0; i < satellites; i++) put(70 + i % 10, 8);
+    for (int i = 0; i < satellites; i++) put(0, 4);
+    for (int i = 0; i < satellites; i++) put(17 * i, 10);
+    for (int i = 0; i < satellites; i++) put(100 * i, 14);
+    for (int i = 0; i < cells; i++) put(1000 * i, 20);
+    for (int i = 0; i < cells; i++) put(3000 * i, 24);
+    for (int i = 0; i < cells; i++) put(600, 10);
+    for (int i = 0; i < cells; i++) put(0, 1);
+    for (int i = 0; i < cells; i++) put(45 * 16, 10);
+    for (int i = 0; i < cells; i++) put(12 * i, 15);
+    return out;
+}
+
+// Raw measurement decoding as the LC29H outputs it: one MSM7 message per constellation per
+// epoch, about 60 signals in all.
+static void BM_MsmEpoch(benchmark::State& state) {
+    const std::vector<uint8_t> messages[] = {
+        msm7Payload(1077, 345600000, true, 12),  // GPS
+        msm7Payload(1087, 10782000, true, 8),    // GLONASS, same instant
+        msm7Payload(1097, 345600000, true, 9),   // Galileo
+        msm7Payload(1127, 345586000, false, 6),  // BeiDou
+    };
+    static constexpr uint16_t kNumbers[] = {1077, 1087, 1097, 1127};
+    NmeaParser nmea;
+    BinaryParser parser(nmea.satellites());
+    BinaryFrame frame;
+    frame.protocol = BinaryProtocol::RTCM3;
+    uint64_t epochs = 0, measurements = 0;
+    const uint64_t allocationsBefore = gAllocations.load();
+    for (auto _ : state) {
+        for (size_t i = 0; i < std::size(messages); i++) {
+            frame.messageId = kNumbers[i];
+            frame.payload = messages[i].data();
+            frame.payloadLength = messages[i].size();
+            if (parser.parse(frame) && parser.hasRawEpoch()) {
+                benchmark::DoNotOptimize(parser.rawEpoch());
+                measurements += parser.rawEpoch().count;
+                parser.consumeRawEpoch();
+                epochs++;
+            }
+        }
+    }
+    const uint64_t allocations = gAllocations.load() - allocationsBefore;
+    state.counters["allocs_per_epoch"] = epochs ? static_cast<double>(allocations) / epochs : 0;
+    state.counters["measurements_per_epoch"] = epochs ? static_cast<double>(measurements) / epochs : 0;
+}
+BENCHMARK(BM_MsmEpoch);
+
+// One receiver epoch followed by nine interpolated outputs, as at 1 Hz in and 10 Hz out.
+static void BM_LocationFilter(benchmark::State& state) {
+    NmeaFix fix;
+    fix.flags = FIX_HAS_LAT_LONG | FIX_HAS_ALTITUDE | FIX_HAS_SPEED | FIX_HAS_BEARING |
+                FIX_HAS_HORIZONTAL_ACCURACY;
+    fix.latitudeDegrees = 52.2297;
+    fix.longitudeDegrees = 21.0122;
+    fix.altitudeMeters = 110;
+    fix.speedMetersPerSec = 13.9;
+    fix.bearingDegrees = 45;
+    fix.horizontalAccuracyMeters = 2.5f;
+    LocationFilter filter;
+    LocationFilter::Estimate estimate;
+    int64_t timeNs = 0;
+    for (auto _ : state) {
+        timeNs += 1000000000;
+        fix.latitudeDegrees += 9.8 / 111000;
+        fix.longitudeDegrees += 9.8 / 68000;
+        filter.update(fix, timeNs);
+        for (int i = 1; i < 10; i++) {
+            filter.predict(timeNs + i * 100000000LL, estimate);
+            benchmark::DoNotOptimize(estimate);
+        }
+    }
+}
+BENCHMARK(BM_LocationFilter);
+
+// Batching a drive at 1 Hz until the ring is full, then draining it as flush() does.
+static void BM_FixBatch(benchmark::State& state) {
+    BatchedFix fix;
+    fix.flags = FIX_HAS_LAT_LONG | FIX_HAS_ALTITUDE | FIX_HAS_SPEED | FIX_HAS_BEARING |
+                FIX_HAS_HORIZONTAL_ACCURACY | FIX_HAS_VERTICAL_ACCURACY;
+    fix.latitudeDegrees = 52.2297;
+    fix.longitudeDegrees = 21.0122;
+    fix.altitudeMeters = 110;
+    fix.speedMetersPerSec = 13.9;
+    fix.bearingDegrees = 45;
+    fix.horizontalAccuracyMeters = 2.5f;
+    fix.verticalAccuracyMeters = 3.8f;
+    fix.timestampMillis = 1700000000000;
+    fix.elapsedRealtimeNs = 1000000000;
+    FixBatch batch;
+    uint64_t fixes = 0, bytes = 0;
+    const uint64_t allocationsBefore = gAllocations.load();
+    for (auto _ : state) {
+        while (!batch.full()) {
+            fix.latitudeDegrees += 9.8 / 111000;
+            fix.longitudeDegrees += 9.8 / 68000;
+            fix.bearingDegrees = 45 + (fixes % 7);
+            fix.timestampMillis += 1000;
+            fix.elapsedRealtimeNs += 1000000000 + (fixes % 5) * 1000;
+            batch.push(fix);
+            fixes++;
+        }
+        bytes += batch.bytesUsed();
+        batch.drain([](const BatchedFix& f) { benchmark::DoNotOptimize(f); });
+    }
+    const uint64_t allocations = gAllocations.load() - allocationsBefore;
+    state.counters["allocs_per_fix"] = fixes ? static_cast<double>(allocations) / fixes : 0;
+    state.counters["bytes_per_fix"] = fixes ? static_cast<double>(bytes) / fixes : 0;
+    state.counters["time_per_fix"] = benchmark::Counter(
+            static_cast<double>(fixes), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_FixBatch);
+
+// A drive at 1 Hz past N fences of 50 to 500 m scattered over a few hundred km, as a fleet or
+// reminder app would register them. The cost per fix should not depend on N.
+static void BM_Geofence(benchmark::State& state) {
+    const int fences = static_cast<int>(state.range(0));
+    GeofenceIndex index;
+    uint32_t seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525 + 1013904223;
+        return static_cast<double>(seed >> 8) / (1 << 24);
+    };
+    for (int i = 0; i < fences; i++) {
+        index.add(i, 50 + 4 * random(), 16 + 6 * random(), 50 + 450 * random(),
+                  GeofenceIndex::UNCERTAIN, GeofenceIndex::ENTERED | GeofenceIndex::EXITED, 60000, 0);
+    }
+    std::vector<GeofenceIndex::Event> events;
+    events.reserve(64);
+    double latitude = 52.2297, longitude = 21.0122;
+    int64_t timeMs = 0;
+    uint64_t transitions = 0;
+    const GeofenceIndex::Stats before = index.stats();
+    const uint64_t allocationsBefore = gAllocations.load();
+    for (auto _ : state) {
+        latitude += 9.8 / 111000;
+        longitude += 9.8 / 68000;
+        if (latitude > 54) latitude = 50;
+        if (longitude > 22) longitude = 16;
+        timeMs += 1000;
+        events.clear();
+        index.update(latitude, longitude, 4.0f, timeMs, events);
+        transitions += events.size();
+    }
+    const uint64_t allocations = gAllocations.load() - allocationsBefore;
+    const uint64_t fixes = index.stats().fixes - before.fixes;
+    state.counters["allocs_per_fix"] = fixes ? static_cast<double>(allocations) / fixes : 0;
+    state.counters["evaluations_per_fix"] =
+            fixes ? static_cast<double>(index.stats().evaluations - before.evaluations) / fixes : 0;
+    state.counters["transitions"] = static_cast<double>(transitions);
+}
+BENCHMARK(BM_Geofence)->Arg(10)->Arg(1000)->Arg(10000);
+
+// The hot-path instrumentation: a counter bump and a latency sample, as per sentence and
+// per callback. Should stay within a few ns.
+static void BM_Metrics(benchmark::State& state) {
+    Counter counter;
+    LatencyHistogram histogram;
+    int64_t ns = 0;
+    for (auto _ : state) {
+        counter.add();
+        histogram.record(ns);
+        ns = (ns + 7919) & 0xffffff;
+    }
+    benchmark::DoNotOptimize(counter.load());
+    benchmark::DoNotOptimize(histogram.snapshot().count);
+}
+BENCHMARK(BM_Metrics);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+# SPDX-License-Identifier: Apache-2.0
+#
+# Regenerates the benchmark corpora. The streams follow the LC29H output format (NMEA 4.11
+# with signal IDs, GN-talker GSA with system IDs, sentence order RMC/GGA/GSV/GSA/VTG/GLL, then
+# the GST the HAL turns on) and are deterministic so benchmark numbers stay comparable across
+# runs. Real captures can be dropped into this directory under the same names.
+
+import functools
+import math
+import os
+import random
+
+OUT = os.path.dirname(os.path.abspath(__file__))
+
+# talker, GSA system ID, NMEA svid range, signal IDs per band
+SYSTEMS = {
+    "GP": (1, range(1, 33), ("1", "8")),     # L1 C/A, L5 Q
+    "GL": (2, range(65, 89), ("1",)),        # G1 C/A
+    "GA": (3, range(1, 37), ("7", "1")),     # E1, E5a
+    "GB": (4, range(1, 64), ("1", "5")),     # B1I, B2a
+    "GQ": (5, range(1, 8), ("1", "8")),      # L1 C/A, L5 Q
+}
+
+
+def checksum(body):
+    return functools.reduce(lambda a, b: a ^ b, body.encode(), 0)
+
+
+def sentence(body):
+    return "$%s*%02X\r\n" % (body, checksum(body))
+
+
+def ddmm(value, positive, negative, width):
+    hemi = positive if value >= 0 else negative
+    value = abs(value)
+    deg = int(value)
+    return "%0*d%07.4f" % (width, deg, (value - deg) * 60.0), hemi
+
+
+class Sky:
+    def __init__(self, rng, counts, dual_band):
+        self.sats = []
+        for talker, count in counts.items():
+            system_id, svids, signals = SYSTEMS[talker]
+            for svid in rng.sample(list(svids), count):
+                # Signals of one SV share its position in the sky.
+                pos = {"el": rng.uniform(5, 85), "az": rng.uniform(0, 359)}
+                bands = signals if dual_band else signals[:1]
+                for signal in bands:
+                    if signal != bands[0] and rng.random() < 0.4:
+                        continue
+                    self.sats.append({
+                        "talker": talker, "system": system_id, "svid": svid, "signal": signal,
+                        "pos": pos, "cn0": rng.uniform(18, 48),
+                    })
+
+    def step(self, rng, dt):
+        for pos in {id(s["pos"]): s["pos"] for s in self.sats}.values():
+            pos["el"] = min(89.0, max(1.0, pos["el"] + rng.uniform(-0.002, 0.002) * dt))
+            pos["az"] = (pos["az"] + 0.004 * dt) % 360
+        for s in self.sats:
+            s["cn0"] = min(50.0, max(10.0, s["cn0"] + rng.uniform(-1, 1)))
+
+
+def epoch(t, lat, lon, alt, speed, course, sky, rng):
+    hhmmss = "%02d%02d%06.3f" % (t // 3600 % 24, t // 60 % 60, t % 60)
+    lat_s, ns = ddmm(lat, "N", "S", 2)
+    lon_s, ew = ddmm(lon, "E", "W", 3)
+    used = [s for s in sky.sats if s["cn0"] > 25 and s["signal"] == SYSTEMS[s["talker"]][2][0]]
+    out = [
+        sentence("GNRMC,%s,A,%s,%s,%s,%s,%.2f,%.2f,150324,,,A,V" % (hhmmss, lat_s, ns, lon_s, ew, speed / 0.514444, course)),
+        sentence("GNGGA,%s,%s,%s,%s,%s,1,%02d,%.2f,%.1f,M,%.1f,M,," % (hhmmss, lat_s, ns, lon_s, ew, min(len(used), 99), rng.uniform(0.5, 1.2), alt, 34.6)),
+    ]
+    for talker in SYSTEMS:
+        for signal in SYSTEMS[talker][2]:
+            group = [s for s in sky.sats if s["talker"] == talker and s["signal"] == signal]
+            pages = (len(group) + 3) // 4
+            for page in range(pages):
+                body = "%sGSV,%d,%d,%02d" % (talker, pages, page + 1, len(group))
+                for s in group[page * 4:page * 4 + 4]:
+                    body += ",%02d,%02d,%03d,%02d" % (s["svid"], s["pos"]["el"], s["pos"]["az"], s["cn0"])
+                out.append(sentence(body + "," + signal))
+    for talker, (system_id, _, _) in SYSTEMS.items():
+        svids = [s["svid"] for s in used if s["talker"] == talker][:12]
+        if not svids:
+            continue
+        body = "GNGSA,A,3," + ",".join("%02d" % v for v in svids) + "," * (12 - len(svids))
+        out.append(sentence(body + ",1.21,0.68,1.00,%d" % system_id))
+    out.append(sentence("GNVTG,%.2f,T,,M,%.2f,N,%.2f,K,A" % (course, speed / 0.514444, speed * 3.6)))
+    out.append(sentence("GNGLL,%s,%s,%s,%s,%s,A,A" % (lat_s, ns, lon_s, ew, hhmmss)))
+    out.append(sentence("GNGST,%s,1.2,2.9,1.8,34.5,2.4,2.1,4.3" % hhmmss))
+    return out
+
+
+def stream(seed, epochs, rate_hz, counts, dual_band):
+    rng = random.Random(seed)
+    sky = Sky(rng, counts, dual_band)
+    lat, lon, alt, speed, course = 52.229676, 21.012229, 112.0, 12.0, 73.0
+    dt = 1.0 / rate_hz
+    t = 8 * 3600 + 12 * 60
+    lines = []
+    for _ in range(epochs):
+        lines += epoch(t, lat, lon, alt, speed, course, sky, rng)
+        course = (course + rng.uniform(-2, 2)) % 360
+        lat += speed * dt * math.cos(math.radians(course)) / 111320.0
+        lon += speed * dt * math.sin(math.radians(course)) / (111320.0 * math.cos(math.radians(lat)))
+        sky.step(rng, dt)
+        t = round(t + dt, 3)
+    return lines
+
+
+def noisy(lines, seed):
+    rng = random.Random(seed)
+    out = []
+    for line in lines:
+        r = rng.random()
+        if r < 0.08:
+            # Single corrupted byte: the checksum no longer matches.
+            i = rng.randrange(1, len(line) - 6)
+            line = line[:i] + chr((ord(line[i]) ^ 0x04) or 0x41) + line[i + 1:]
+        elif r < 0.11:
+            # Truncated line, as after a UART overrun.
+            line = line[:rng.randrange(3, len(line) - 2)]
+        elif r < 0.12:
+            # Overlong line that must be discarded by the framer.
+            line = sentence("GNTXT," + "X" * 300)
+        elif r < 0.15:
+            line = "".join(chr(rng.randrange(0x80, 0xff)) for _ in range(rng.randrange(4, 40))) + line
+        out.append(line)
+    return out
+
+
+def write(name, lines):
+    with open(os.path.join(OUT, name), "w", encoding="latin-1", newline="") as f:
+        f.write("".join(lines))
+
+
+if __name__ == "__main__":
+    base = {"GP": 10, "GL": 6, "GA": 7, "GB": 8, "GQ": 2}
+    write("lc29h_1hz.nmea", stream(1, 60, 1, base, True))
+    write("lc29h_10hz.nmea", stream(2, 100, 10, base, True))
+    write("gsv_storm.nmea", stream(3, 30, 1, {"GP": 14, "GL": 12, "GA": 14, "GB": 24, "GQ": 5}, True))
+    write("noisy.nmea", noisy(stream(4, 60, 1, base, True), 5))
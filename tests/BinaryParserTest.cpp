@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <vector>
+
+#include "BinaryFramer.h"
+#include "BinaryParser.h"
+#include "RawFrames.h"
+#include "SatelliteTable.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+static constexpr uint32_t GPS_STATE =
+        MEASUREMENT_STATE_CODE_LOCK | MEASUREMENT_STATE_TOW_DECODED | MEASUREMENT_STATE_TOW_KNOWN;
+
+class BinaryParserTest : public ::testing::Test {
+protected:
+    // Frames |bytes| as the reader would and parses the frame.
+    bool parse(const uint8_t* bytes, size_t size) {
+        const char* cursor = reinterpret_cast<const char*>(bytes);
+        const char* end = cursor + size;
+        BinaryFrame frame;
+        if (!framer.next(cursor, end, frame)) return false;
+        EXPECT_EQ(cursor, end);
+        return parser.parse(frame);
+    }
+
+    BinaryFramer framer;
+    SatelliteTable satellites;
+    BinaryParser parser{satellites};
+};
+
+TEST_F(BinaryParserTest, DecodesMsm7) {
+    ASSERT_TRUE(parse(MSM7_FRAME, sizeof(MSM7_FRAME)));
+    ASSERT_TRUE(parser.hasRawEpoch());
+    const RawEpoch& epoch = parser.rawEpoch();
+    EXPECT_EQ(epoch.gpsTowNs, 345600000LL * 1000000);
+    EXPECT_EQ(epoch.gpsWeek, -1);
+    EXPECT_EQ(epoch.leapSeconds, -1);
+    ASSERT_EQ(epoch.count, 3u);
+
+    const RawMeasurement& l1 = epoch.measurements[0];
+    EXPECT_EQ(l1.constellation, Constellation::GPS);
+    EXPECT_EQ(l1.svid, 5);
+    EXPECT_EQ(l1.codeType, 'C');
+    EXPECT_EQ(l1.carrierFrequencyHz, 1575.42e6);
+    EXPECT_EQ(l1.state, GPS_STATE);
+    EXPECT_EQ(l1.receivedSvTimeNs, 345599929499998LL);
+    EXPECT_EQ(l1.receivedSvTimeUncertaintyNs, 10);
+    EXPECT_FLOAT_EQ(l1.cn0DbHz, 45.0f);
+    EXPECT_TRUE(l1.hasPseudorangeRate);
+    EXPECT_NEAR(l1.pseudorangeRateMps, -249.8766, 1e-9);
+    EXPECT_EQ(l1.adrState, ADR_STATE_VALID | ADR_STATE_HALF_CYCLE_RESOLVED);
+    EXPECT_NEAR(l1.accumulatedDeltaRangeMeters, 21135368.707805227, 1e-6);
+    EXPECT_EQ(l1.accumulatedDeltaRangeUncertaintyMeters, 0.01);
+
+    const RawMeasurement& l5 = epoch.measurements[1];
+    EXPECT_EQ(l5.svid, 5);
+    EXPECT_EQ(l5.codeType, 'I');
+    EXPECT_EQ(l5.carrierFrequencyHz, 1176.45e6);
+    EXPECT_EQ(l5.receivedSvTimeNs, 345599929500004LL);
+    EXPECT_FLOAT_EQ(l5.cn0DbHz, 38.5f);
+    EXPECT_NEAR(l5.pseudorangeRateMps, -250.5678, 1e-9);
+    EXPECT_EQ(l5.adrState, 0);
+    EXPECT_EQ(l5.accumulatedDeltaRangeMeters, 0);
+
+    const RawMeasurement& g12 = epoch.measurements[2];
+    EXPECT_EQ(g12.svid, 12);
+    EXPECT_EQ(g12.receivedSvTimeNs, 345599924902251LL);
+    EXPECT_FLOAT_EQ(g12.cn0DbHz, 30.25f);
+    EXPECT_FALSE(g12.hasPseudorangeRate);
+    EXPECT_EQ(g12.pseudorangeRateMps, 0);
+    EXPECT_EQ(g12.pseudorangeRateUncertaintyMps, 0);
+    EXPECT_EQ(g12.adrState, ADR_STATE_VALID | ADR_STATE_RESET);
+    EXPECT_NEAR(g12.accumulatedDeltaRangeMeters, 22513716.54129624, 1e-6);
+}
+
+TEST_F(BinaryParserTest, DecodesRawx) {
+    ASSERT_TRUE(parse(RAWX_FRAME, sizeof(RAWX_FRAME)));
+    ASSERT_TRUE(parser.hasRawEpoch());
+    const RawEpoch& epoch = parser.rawEpoch();
+    EXPECT_EQ(epoch.gpsTowNs, 345600500000000LL);
+    EXPECT_EQ(epoch.gpsWeek, 2330);
+    EXPECT_EQ(epoch.leapSeconds, 18);
+    EXPECT_FALSE(epoch.clockReset);
+    ASSERT_EQ(epoch.count, 2u);
+
+    const RawMeasurement& gps = epoch.measurements[0];
+    EXPECT_EQ(gps.constellation, Constellation::GPS);
+    EXPECT_EQ(gps.svid, 7);
+    EXPECT_EQ(gps.codeType, 'C');
+    EXPECT_EQ(gps.carrierFrequencyHz, 1575.42e6);
+    EXPECT_EQ(gps.state, GPS_STATE);
+    EXPECT_EQ(gps.receivedSvTimeNs, 345600429951540LL);
+    EXPECT_EQ(gps.receivedSvTimeUncertaintyNs, 1);
+    EXPECT_FLOAT_EQ(gps.cn0DbHz, 42.0f);
+    EXPECT_TRUE(gps.hasPseudorangeRate);
+    // Doppler is positive approaching, the range rate positive receding.
+    EXPECT_NEAR(gps.pseudorangeRateMps, 234.91753906958144, 1e-9);
+    EXPECT_NEAR(gps.pseudorangeRateUncertaintyMps, 0.006089397529547676, 1e-12);
+    EXPECT_EQ(gps.adrState, ADR_STATE_VALID | ADR_STATE_HALF_CYCLE_RESOLVED);
+    EXPECT_NEAR(gps.accumulatedDeltaRangeMeters, 20999858.35681039, 1e-6);
+    EXPECT_NEAR(gps.accumulatedDeltaRangeUncertaintyMeters, 0.0022835240735803787, 1e-12);
+
+    // GLONASS transmit time is Moscow time of day.
+    const RawMeasurement& glonass = epoch.measurements[1];
+    EXPECT_EQ(glonass.constellation, Constellation::GLONASS);
+    EXPECT_EQ(glonass.svid, 10);
+    EXPECT_EQ(glonass.carrierFrequencyHz, 1600.3125e6);
+    EXPECT_EQ(glonass.state, MEASUREMENT_STATE_CODE_LOCK | MEASUREMENT_STATE_GLO_TOD_DECODED |
+                                     MEASUREMENT_STATE_GLO_TOD_KNOWN);
+    EXPECT_EQ(glonass.receivedSvTimeNs, 10782434955001LL);
+    EXPECT_EQ(glonass.receivedSvTimeUncertaintyNs, 2);
+    EXPECT_NEAR(glonass.pseudorangeRateMps, -149.8669581097442, 1e-9);
+    EXPECT_EQ(glonass.adrState, 0);
+}
+
+TEST_F(BinaryParserTest, BlockedSatellitesAreDropped) {
+    SvBlocklist blocklist;
+    blocklist.add(Constellation::GPS, 5);
+    blocklist.add(Constellation::GPS, 7);
+    satellites.setBlocklist(blocklist);
+    ASSERT_TRUE(parse(MSM7_FRAME, sizeof(MSM7_FRAME)));
+    ASSERT_EQ(parser.rawEpoch().count, 1u);
+    // The blocked satellite's cells are stepped over, not read as the next one's.
+    EXPECT_EQ(parser.rawEpoch().measurements[0].svid, 12);
+    EXPECT_EQ(parser.rawEpoch().measurements[0].receivedSvTimeNs, 345599924902251LL);
+    parser.consumeRawEpoch();
+
+    ASSERT_TRUE(parse(RAWX_FRAME, sizeof(RAWX_FRAME)));
+    ASSERT_EQ(parser.rawEpoch().count, 1u);
+    EXPECT_EQ(parser.rawEpoch().measurements[0].constellation, Constellation::GLONASS);
+}
+
+TEST_F(BinaryParserTest, CorruptFramesAreNotDecoded) {
+    for (const std::vector<uint8_t>& good : {std::vector<uint8_t>(std::begin(MSM7_FRAME),
+                                                                  std::end(MSM7_FRAME)),
+                                             std::vector<uint8_t>(std::begin(RAWX_FRAME),
+                                                                  std::end(RAWX_FRAME))}) {
+        std::vector<uint8_t> bad(good);
+        bad[20] ^= 0x01;
+        framer.reset();
+        EXPECT_FALSE(parse(bad.data(), bad.size()));
+    }
+    EXPECT_EQ(framer.stats().checksumErrors, 2u);
+    EXPECT_FALSE(parser.hasRawEpoch());
+}
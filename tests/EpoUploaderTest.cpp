@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "BinaryFramer.h"
+#include "EpoUploader.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+static constexpr size_t RECORD = EpoUploader::RECORD_SIZE;
+// Sync, length, id, sequence, three records, checksum, CR LF.
+static constexpr size_t PACKET = 8 + 3 * RECORD + 3;
+static constexpr int64_t MS_PER_HOUR = 3600 * 1000;
+static constexpr int64_t GPS_EPOCH_UNIX_MS = 3657LL * 24 * MS_PER_HOUR;
+// A segment start in 2023.
+static constexpr int64_t FIRST_HOUR = 384456;
+
+static int64_t unixMs(int64_t gpsHour) {
+    return GPS_EPOCH_UNIX_MS + gpsHour * MS_PER_HOUR;
+}
+
+// |perSegment| records in each of |segments| six-hour segments; each record's bytes past the
+// hour are its index, so packets can be checked against it.
+static std::shared_ptr<const std::vector<uint8_t>> epo(int segments, int perSegment) {
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    for (int segment = 0; segment < segments; segment++) {
+        const int64_t hour = FIRST_HOUR + 6 * segment;
+        for (int i = 0; i < perSegment; i++) {
+            const size_t index = data->size() / RECORD;
+            data->push_back(hour & 0xFF);
+            data->push_back((hour >> 8) & 0xFF);
+            data->push_back((hour >> 16) & 0xFF);
+            data->resize(data->size() + RECORD - 3, static_cast<uint8_t>(index + 1));
+        }
+    }
+    return data;
+}
+
+static uint16_t sequenceOf(std::string_view packet) {
+    return static_cast<uint8_t>(packet[6]) | static_cast<uint8_t>(packet[7]) << 8;
+}
+
+// The record index a packet's |slot| carries, from epo(), or -1 for padding.
+static int recordIn(std::string_view packet, int slot) {
+    const uint8_t tag = packet[8 + slot * RECORD + 3];
+    return tag == 0 ? -1 : tag - 1;
+}
+
+class EpoUploaderTest : public ::testing::Test {
+protected:
+    bool ack(uint16_t sequence, uint8_t result = 1, int64_t nowMs = 0) {
+        const uint8_t payload[] = {static_cast<uint8_t>(sequence & 0xFF),
+                                   static_cast<uint8_t>(sequence >> 8), result};
+        BinaryFrame frame;
+        frame.protocol = BinaryProtocol::AIROHA;
+        frame.messageId = 723;
+        frame.payload = payload;
+        frame.payloadLength = sizeof(payload);
+        return uploader.onFrame(frame, nowMs);
+    }
+
+    EpoUploader uploader;
+};
+
+TEST_F(EpoUploaderTest, PacketLayoutAndChecksum) {
+    auto data = epo(1, 4);
+    uploader.start(data, unixMs(FIRST_HOUR));
+    const EpoUploader::Action action = uploader.poll(0);
+    ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(action.sequence, 0);
+    const std::string_view p = action.data;
+    ASSERT_EQ(p.size(), PACKET);
+    EXPECT_EQ(static_cast<uint8_t>(p[0]), 0x04);
+    EXPECT_EQ(static_cast<uint8_t>(p[1]), 0x24);
+    EXPECT_EQ(static_cast<uint8_t>(p[2]) | static_cast<uint8_t>(p[3]) << 8, PACKET);
+    EXPECT_EQ(static_cast<uint8_t>(p[4]) | static_cast<uint8_t>(p[5]) << 8, 722);
+    EXPECT_EQ(sequenceOf(p), 0);
+    EXPECT_EQ(p.substr(8, 3 * RECORD),
+              std::string_view(reinterpret_cast<const char*>(data->data()), 3 * RECORD));
+    uint8_t checksum = 0;
+    for (size_t i = 2; i < PACKET - 3; i++) checksum ^= static_cast<uint8_t>(p[i]);
+    EXPECT_EQ(static_cast<uint8_t>(p[PACKET - 3]), checksum);
+    EXPECT_EQ(p.substr(PACKET - 2), "\r\n");
+
+    // What the receiver's own framing accepts.
+    BinaryFramer framer;
+    const char* cursor = p.data();
+    BinaryFrame frame;
+    ASSERT_TRUE(framer.next(cursor, p.data() + p.size(), frame));
+    EXPECT_EQ(frame.protocol, BinaryProtocol::AIROHA);
+    EXPECT_EQ(frame.messageId, 722);
+    EXPECT_EQ(frame.payloadLength, 2 + 3 * RECORD);
+}
+
+TEST_F(EpoUploaderTest, UploadsInOrderAndClosesWithTheEndPacket) {
+    uploader.start(epo(2, 4), unixMs(FIRST_HOUR));
+    EXPECT_EQ(uploader.recordsTotal(), 8u);
+    std::vector<int> sent;
+    for (uint16_t sequence = 0; sequence < 3; sequence++) {
+        const EpoUploader::Action action = uploader.poll(0);
+        ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+        EXPECT_EQ(sequenceOf(action.data), sequence);
+        for (int slot = 0; slot < 3; slot++) sent.push_back(recordIn(action.data, slot));
+        // One in flight at a time.
+        EXPECT_EQ(uploader.poll(0).kind, EpoUploader::Action::NONE);
+        EXPECT_TRUE(ack(sequence));
+    }
+    // The short last packet is padded.
+    EXPECT_EQ(sent, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, -1}));
+    EXPECT_EQ(uploader.recordsDone(), 8u);
+
+    const EpoUploader::Action action = uploader.poll(0);
+    ASSERT_EQ(action.kind, EpoUploader::Action::DONE);
+    ASSERT_EQ(action.data.size(), PACKET);
+    EXPECT_EQ(sequenceOf(action.data), 0xFFFF);
+    for (int slot = 0; slot < 3; slot++) EXPECT_EQ(recordIn(action.data, slot), -1);
+    EXPECT_FALSE(uploader.active());
+    EXPECT_EQ(uploader.nextDeadlineMs(), -1);
+    EXPECT_EQ(uploader.poll(0).kind, EpoUploader::Action::NONE);
+    EXPECT_EQ(uploader.stats().uploads, 1u);
+    EXPECT_EQ(uploader.stats().packets, 3u);
+}
+
+TEST_F(EpoUploaderTest, IgnoresOtherAcknowledgementsAndFrames) {
+    uploader.start(epo(1, 6), unixMs(FIRST_HOUR));
+    ASSERT_EQ(uploader.poll(0).kind, EpoUploader::Action::WRITE);
+    EXPECT_TRUE(ack(1));
+    EXPECT_EQ(uploader.poll(0).kind, EpoUploader::Action::NONE);
+    EXPECT_EQ(uploader.recordsDone(), 0u);
+
+    BinaryFrame other;
+    other.protocol = BinaryProtocol::UBX;
+    other.messageId = 723;
+    EXPECT_FALSE(uploader.onFrame(other, 0));
+
+    EXPECT_TRUE(ack(0));
+    // A duplicate acknowledgement does not skip a packet.
+    EXPECT_TRUE(ack(0));
+    const EpoUploader::Action action = uploader.poll(0);
+    ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(action.sequence, 1);
+    EXPECT_EQ(recordIn(action.data, 0), 3);
+}
+
+TEST_F(EpoUploaderTest, RetriesOnTimeoutThenGivesUp) {
+    uploader.start(epo(1, 6), unixMs(FIRST_HOUR));
+    ASSERT_EQ(uploader.poll(0).kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(uploader.nextDeadlineMs(), 1000);
+    EXPECT_EQ(uploader.poll(999).kind, EpoUploader::Action::NONE);
+    EpoUploader::Action action = uploader.poll(1000);
+    ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(action.sequence, 0);
+    ASSERT_EQ(uploader.poll(2000).kind, EpoUploader::Action::WRITE);
+    action = uploader.poll(3000);
+    EXPECT_EQ(action.kind, EpoUploader::Action::GAVE_UP);
+    EXPECT_EQ(action.sequence, 0);
+    EXPECT_FALSE(uploader.active());
+    EXPECT_EQ(uploader.stats().retries, 2u);
+    EXPECT_EQ(uploader.stats().failures, 1u);
+}
+
+TEST_F(EpoUploaderTest, RejectedPacketIsSentAgainAtOnce) {
+    uploader.start(epo(1, 6), unixMs(FIRST_HOUR));
+    ASSERT_EQ(uploader.poll(0).kind, EpoUploader::Action::WRITE);
+    EXPECT_TRUE(ack(0, 0, 100));
+    EpoUploader::Action action = uploader.poll(100);
+    ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(action.sequence, 0);
+    EXPECT_EQ(uploader.stats().rejected, 1u);
+
+    // Attempts are per packet: a success resets them.
+    EXPECT_TRUE(ack(0, 1, 200));
+    ASSERT_EQ(uploader.poll(200).kind, EpoUploader::Action::WRITE);
+    EXPECT_TRUE(ack(1, 0, 300));
+    ASSERT_EQ(uploader.poll(300).kind, EpoUploader::Action::WRITE);
+    EXPECT_TRUE(ack(1, 0, 400));
+    ASSERT_EQ(uploader.poll(400).kind, EpoUploader::Action::WRITE);
+    EXPECT_TRUE(ack(1, 0, 500));
+    EXPECT_EQ(uploader.poll(500).kind, EpoUploader::Action::GAVE_UP);
+}
+
+TEST_F(EpoUploaderTest, SkipsSegmentsAlreadyOver) {
+    auto data = epo(3, 2);
+    // An hour into the second segment.
+    uploader.start(data, unixMs(FIRST_HOUR + 7));
+    EXPECT_EQ(uploader.recordsTotal(), 4u);
+    EpoUploader::Action action = uploader.poll(0);
+    ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(recordIn(action.data, 0), 2);
+    EXPECT_TRUE(ack(0));
+
+    // Starting over, later: from the third segment, sequence numbers from 0.
+    uploader.restart(unixMs(FIRST_HOUR + 12));
+    EXPECT_EQ(uploader.recordsTotal(), 2u);
+    EXPECT_EQ(uploader.recordsDone(), 0u);
+    action = uploader.poll(0);
+    ASSERT_EQ(action.kind, EpoUploader::Action::WRITE);
+    EXPECT_EQ(action.sequence, 0);
+    EXPECT_EQ(recordIn(action.data, 0), 4);
+
+    // All over: nothing to do.
+    uploader.start(data, unixMs(FIRST_HOUR + 18));
+    EXPECT_FALSE(uploader.active());
+    EXPECT_EQ(uploader.poll(0).kind, EpoUploader::Action::NONE);
+}
+
+TEST_F(EpoUploaderTest, ValidityCoversFirstToLastSegment) {
+    auto data = epo(4, 2);
+    int64_t start = 0, end = 0;
+    ASSERT_TRUE(EpoUploader::validity(data->data(), data->size(), start, end));
+    EXPECT_EQ(start, unixMs(FIRST_HOUR));
+    EXPECT_EQ(end, unixMs(FIRST_HOUR + 24));
+}
+
+TEST_F(EpoUploaderTest, RejectsWhatIsNotEpo) {
+    auto data = epo(1, 2);
+    int64_t start = 0, end = 0;
+    EXPECT_FALSE(EpoUploader::validity(data->data(), 0, start, end));
+    EXPECT_FALSE(EpoUploader::validity(data->data(), RECORD - 1, start, end));
+    EXPECT_FALSE(EpoUploader::validity(data->data(), RECORD + 1, start, end));
+    std::vector<uint8_t> zeroHour(*data);
+    zeroHour[RECORD] = zeroHour[RECORD + 1] = zeroHour[RECORD + 2] = 0;
+    EXPECT_FALSE(EpoUploader::validity(zeroHour.data(), zeroHour.size(), start, end));
+
+    auto truncated = std::make_shared<std::vector<uint8_t>>(data->begin(), data->end() - 1);
+    uploader.start(truncated, unixMs(FIRST_HOUR));
+    EXPECT_FALSE(uploader.active());
+    EXPECT_EQ(uploader.recordsTotal(), 0u);
+}
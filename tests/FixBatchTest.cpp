@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "FixBatch.h"
+#include "NmeaTypes.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+static constexpr uint8_t ALL_FLAGS = 0xFF;
+
+// A walk at 1 Hz: a few metres a second north-east.
+static BatchedFix walking(int i) {
+    BatchedFix fix;
+    fix.flags = ALL_FLAGS;
+    fix.latitudeDegrees = 52.0 + i * 2.5e-5;
+    fix.longitudeDegrees = 21.0 + i * 3.1e-5;
+    fix.altitudeMeters = 110.0 + (i % 7) * 0.1;
+    fix.speedMetersPerSec = 1.4;
+    fix.bearingDegrees = 42.0;
+    fix.horizontalAccuracyMeters = 3.5f;
+    fix.verticalAccuracyMeters = 5.0f;
+    fix.speedAccuracyMetersPerSecond = 0.3f;
+    fix.bearingAccuracyDegrees = 12.0f;
+    fix.timestampMillis = 1790000000000LL + i * 1000LL;
+    fix.elapsedRealtimeNs = 5000000000LL + i * 1000000000LL;
+    fix.timeUncertaintyNs = 1000000;
+    return fix;
+}
+
+// As far from the previous one in every field as the encoding allows: alternating extremes.
+static BatchedFix extreme(int i) {
+    const bool odd = i % 2 != 0;
+    BatchedFix fix;
+    fix.flags = ALL_FLAGS;
+    fix.latitudeDegrees = odd ? -90 : 90;
+    fix.longitudeDegrees = odd ? -180 : 179.9999999;
+    fix.altitudeMeters = odd ? -1e7 : 1e7;
+    fix.speedMetersPerSec = 1e8;
+    fix.bearingDegrees = 359.9;
+    fix.horizontalAccuracyMeters = fix.verticalAccuracyMeters = 1e9f;
+    fix.speedAccuracyMetersPerSecond = fix.bearingAccuracyDegrees = 1e9f;
+    fix.timestampMillis = odd ? -(1LL << 62) + 1 : 1LL << 62;
+    fix.elapsedRealtimeNs = odd ? std::numeric_limits<int64_t>::min()
+                                : std::numeric_limits<int64_t>::max();
+    fix.timeUncertaintyNs = 1e13;
+    return fix;
+}
+
+static std::vector<BatchedFix> drain(FixBatch& batch) {
+    std::vector<BatchedFix> fixes;
+    batch.drain([&](const BatchedFix& fix) { fixes.push_back(fix); });
+    return fixes;
+}
+
+TEST(FixBatchTest, RoundTripsAtItsResolution) {
+    FixBatch batch;
+    BatchedFix in = walking(0);
+    in.latitudeDegrees = -33.8568123;
+    in.longitudeDegrees = 151.2152967;
+    in.altitudeMeters = -12.345;
+    in.speedMetersPerSec = 13.456;
+    in.bearingDegrees = 359.96;  // rounds to 360, which is 0
+    in.horizontalAccuracyMeters = 3.21f;
+    in.verticalAccuracyMeters = 4.0f;
+    in.speedAccuracyMetersPerSecond = 0.01f;
+    in.bearingAccuracyDegrees = 0.0f;
+    in.elapsedRealtimeNs = 123456789012345LL;
+    in.timeUncertaintyNs = 1500.5;
+    batch.push(in);
+    const std::vector<BatchedFix> out = drain(batch);
+    ASSERT_EQ(out.size(), 1u);
+    const BatchedFix& fix = out[0];
+    EXPECT_EQ(fix.flags, ALL_FLAGS);
+    EXPECT_NEAR(fix.latitudeDegrees, -33.8568123, 1e-12);
+    EXPECT_NEAR(fix.longitudeDegrees, 151.2152967, 1e-12);
+    EXPECT_DOUBLE_EQ(fix.altitudeMeters, -12.35);
+    EXPECT_DOUBLE_EQ(fix.speedMetersPerSec, 13.46);
+    EXPECT_DOUBLE_EQ(fix.bearingDegrees, 0.0);
+    // Accuracies are rounded up, never made better.
+    EXPECT_FLOAT_EQ(fix.horizontalAccuracyMeters, 3.3f);
+    EXPECT_FLOAT_EQ(fix.verticalAccuracyMeters, 4.0f);
+    EXPECT_FLOAT_EQ(fix.speedAccuracyMetersPerSecond, 0.1f);
+    EXPECT_FLOAT_EQ(fix.bearingAccuracyDegrees, 0.0f);
+    EXPECT_EQ(fix.timestampMillis, in.timestampMillis);
+    EXPECT_EQ(fix.elapsedRealtimeNs, 123456789012000LL);
+    EXPECT_DOUBLE_EQ(fix.timeUncertaintyNs, 2000.0);
+}
+
+TEST(FixBatchTest, AbsentFieldsAreNotStored) {
+    FixBatch batch;
+    BatchedFix full = walking(0);
+    batch.push(full);
+    const size_t fullBytes = batch.bytesUsed();
+    BatchedFix bare = walking(1);
+    bare.flags = FIX_HAS_LAT_LONG;
+    batch.push(bare);
+    EXPECT_LT(batch.bytesUsed() - fullBytes, fullBytes / 2);
+    // The altitude after a fix without one is relative to the last one that had it.
+    batch.push(walking(2));
+
+    const std::vector<BatchedFix> out = drain(batch);
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_EQ(out[1].flags, FIX_HAS_LAT_LONG);
+    EXPECT_NEAR(out[1].latitudeDegrees, bare.latitudeDegrees, 1e-7);
+    EXPECT_EQ(out[1].altitudeMeters, 0);
+    EXPECT_EQ(out[1].speedMetersPerSec, 0);
+    EXPECT_EQ(out[1].horizontalAccuracyMeters, 0);
+    EXPECT_NEAR(out[2].altitudeMeters, walking(2).altitudeMeters, 0.005);
+}
+
+TEST(FixBatchTest, DeltasWrapAcrossTheAntimeridian) {
+    FixBatch batch;
+    for (int i = 0; i < 4; i++) {
+        BatchedFix fix = walking(i);
+        fix.longitudeDegrees = i % 2 ? -179.9999990 : 179.9999990;
+        fix.latitudeDegrees = i % 2 ? -89.9999999 : 89.9999999;
+        batch.push(fix);
+    }
+    const std::vector<BatchedFix> out = drain(batch);
+    ASSERT_EQ(out.size(), 4u);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_NEAR(out[i].longitudeDegrees, i % 2 ? -179.999999 : 179.999999, 1e-12) << i;
+        EXPECT_NEAR(out[i].latitudeDegrees, i % 2 ? -89.9999999 : 89.9999999, 1e-12) << i;
+    }
+}
+
+TEST(FixBatchTest, TypicalFixesTakeAboutTwentyBytes) {
+    FixBatch batch;
+    for (int i = 0; i < 1000; i++) batch.push(walking(i));
+    // Every field present, the 1 ms time uncertainty included.
+    EXPECT_LE(batch.bytesUsed(), 1000u * 22);
+}
+
+TEST(FixBatchTest, WrapsAroundEvictingTheOldestFirst) {
+    FixBatch batch;
+    // Several times round the ring, so records straddle its end.
+    const int pushed = 3 * FixBatch::CAPACITY_BYTES / 16;
+    size_t maxSize = 0;
+    for (int i = 0; i < pushed; i++) {
+        batch.push(walking(i));
+        ASSERT_LE(batch.bytesUsed(), FixBatch::CAPACITY_BYTES);
+        maxSize = std::max(maxSize, batch.size());
+    }
+    EXPECT_LT(batch.size(), static_cast<size_t>(pushed));
+    EXPECT_GE(batch.size(), maxSize - 1);
+
+    const std::vector<BatchedFix> out = drain(batch);
+    ASSERT_FALSE(out.empty());
+    const int first = pushed - static_cast<int>(out.size());
+    for (size_t k = 0; k < out.size(); k++) {
+        const BatchedFix expected = walking(first + static_cast<int>(k));
+        ASSERT_EQ(out[k].timestampMillis, expected.timestampMillis) << k;
+        ASSERT_EQ(out[k].elapsedRealtimeNs, expected.elapsedRealtimeNs) << k;
+        ASSERT_NEAR(out[k].latitudeDegrees, expected.latitudeDegrees, 6e-8) << k;
+        ASSERT_NEAR(out[k].longitudeDegrees, expected.longitudeDegrees, 6e-8) << k;
+        ASSERT_NEAR(out[k].altitudeMeters, expected.altitudeMeters, 0.005) << k;
+    }
+    EXPECT_EQ(batch.size(), 0u);
+    EXPECT_EQ(batch.bytesUsed(), 0u);
+
+    // Drained mid-ring: the next fixes are relative to the last one drained.
+    batch.push(walking(pushed));
+    const std::vector<BatchedFix> next = drain(batch);
+    ASSERT_EQ(next.size(), 1u);
+    EXPECT_EQ(next[0].timestampMillis, walking(pushed).timestampMillis);
+    EXPECT_NEAR(next[0].latitudeDegrees, walking(pushed).latitudeDegrees, 6e-8);
+}
+
+TEST(FixBatchTest, FullLeavesRoomForOneMoreRecord) {
+    FixBatch batch;
+    size_t pushes = 0;
+    while (!batch.full()) {
+        const size_t before = batch.size();
+        batch.push(walking(static_cast<int>(pushes++)));
+        // Nothing is evicted before full().
+        ASSERT_EQ(batch.size(), before + 1);
+    }
+    EXPECT_GT(batch.bytesUsed() + FixBatch::MAX_RECORD_BYTES, FixBatch::CAPACITY_BYTES);
+    EXPECT_EQ(batch.size(), pushes);
+    batch.clear();
+    EXPECT_FALSE(batch.full());
+}
+
+TEST(FixBatchTest, GuaranteedFixesFitWhateverTheyAre) {
+    // getBatchSize() reports this.
+    EXPECT_EQ(FixBatch::GUARANTEED_FIXES, 3855u);
+    EXPECT_LE(FixBatch::GUARANTEED_FIXES * FixBatch::MAX_RECORD_BYTES, FixBatch::CAPACITY_BYTES);
+    EXPECT_GT((FixBatch::GUARANTEED_FIXES + 1) * FixBatch::MAX_RECORD_BYTES,
+              FixBatch::CAPACITY_BYTES);
+
+    FixBatch batch;
+    for (size_t i = 0; i < FixBatch::GUARANTEED_FIXES; i++) {
+        EXPECT_FALSE(batch.full()) << i;
+        batch.push(extreme(static_cast<int>(i)));
+    }
+    ASSERT_EQ(batch.size(), FixBatch::GUARANTEED_FIXES);
+    // Within a few bytes of the bound: only elapsed realtime, in microseconds, cannot use all
+    // of its varint.
+    EXPECT_GE(batch.bytesUsed(), (FixBatch::MAX_RECORD_BYTES - 2) * FixBatch::GUARANTEED_FIXES);
+
+    // Beyond them, each one evicts the oldest once the ring is full.
+    size_t pushed = FixBatch::GUARANTEED_FIXES;
+    while (!batch.full()) batch.push(extreme(static_cast<int>(pushed++)));
+    const size_t kept = batch.size();
+    batch.push(extreme(static_cast<int>(pushed++)));
+    EXPECT_EQ(batch.size(), kept);
+    const std::vector<BatchedFix> out = drain(batch);
+    const size_t first = pushed - out.size();
+    for (size_t k = 0; k < out.size(); k++) {
+        const BatchedFix expected = extreme(static_cast<int>(first + k));
+        ASSERT_EQ(out[k].timestampMillis, expected.timestampMillis) << k;
+        ASSERT_NEAR(out[k].latitudeDegrees, expected.latitudeDegrees, 1e-7) << k;
+        ASSERT_NEAR(out[k].longitudeDegrees, expected.longitudeDegrees, 1e-7) << k;
+    }
+}
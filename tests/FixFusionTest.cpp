@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "FixFusion.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+static constexpr int64_t NS_PER_MS = 1000000;
+
+static NmeaFix fixAt(int32_t utcMsOfDay, double latitudeDegrees = 52.0) {
+    NmeaFix fix;
+    fix.flags = FIX_HAS_LAT_LONG | FIX_HAS_HORIZONTAL_ACCURACY;
+    fix.fixQuality = 1;
+    fix.latitudeDegrees = latitudeDegrees;
+    fix.longitudeDegrees = 21.0;
+    fix.horizontalAccuracyMeters = 3.0;
+    fix.utcMsOfDay = utcMsOfDay;
+    return fix;
+}
+
+class FixFusionTest : public ::testing::Test {
+protected:
+    void offer(FixFusion& fusion, size_t source, int32_t utcMsOfDay, int64_t timeMs) {
+        fusion.offer(source, fixAt(utcMsOfDay), timeMs * NS_PER_MS, 0,
+                     [this](const FixFusion::Solution& solution) {
+                         published.push_back(solution.fix.utcMsOfDay);
+                     });
+    }
+
+    std::vector<int32_t> published;
+};
+
+TEST_F(FixFusionTest, SingleSourcePublishesEveryEpochAtOnce) {
+    FixFusion fusion(1);
+    for (int i = 0; i < 3; i++) offer(fusion, 0, 1000 * i, 1000 * (i + 1));
+    EXPECT_EQ(published, (std::vector<int32_t>{0, 1000, 2000}));
+    EXPECT_FALSE(fusion.pending());
+}
+
+TEST_F(FixFusionTest, SingleSourceDropsRepeatedEpoch) {
+    FixFusion fusion(1);
+    offer(fusion, 0, 5000, 1000);
+    offer(fusion, 0, 5000, 1050);
+    EXPECT_EQ(published, (std::vector<int32_t>{5000}));
+    EXPECT_EQ(fusion.stats().late, 1u);
+}
+
+// A cold restart or a replugged receiver: its UTC goes back, and output must go on.
+TEST_F(FixFusionTest, SingleSourceResyncsWhenTimeStepsBack) {
+    FixFusion fusion(1);
+    offer(fusion, 0, 36000000, 1000);
+    offer(fusion, 0, 36001000, 2000);
+    offer(fusion, 0, 35982000, 3000);  // 19 s back, as when UTC parameters are lost
+    offer(fusion, 0, 35983000, 4000);
+    offer(fusion, 0, 36000500, 5000);  // back again by less than a second
+    EXPECT_EQ(published,
+              (std::vector<int32_t>{36000000, 36001000, 35982000, 35983000, 36000500}));
+    EXPECT_EQ(fusion.stats().late, 0u);
+}
+
+TEST_F(FixFusionTest, TwoSourcesCloseWhenBothReported) {
+    FixFusion fusion(2);
+    offer(fusion, 0, 0, 1000);
+    offer(fusion, 1, 0, 1010);
+    published.clear();
+
+    offer(fusion, 0, 1000, 2000);
+    EXPECT_TRUE(published.empty());
+    offer(fusion, 1, 1000, 2020);
+    EXPECT_EQ(published, (std::vector<int32_t>{1000}));
+}
+
+TEST_F(FixFusionTest, TwoSourcesDropStragglerButResyncOnLargeStep) {
+    FixFusion fusion(2);
+    offer(fusion, 0, 0, 1000);
+    offer(fusion, 1, 0, 1010);
+    offer(fusion, 0, 1000, 2000);
+    fusion.flush([this](const FixFusion::Solution& s) { published.push_back(s.fix.utcMsOfDay); });
+    published.clear();
+    const uint64_t late = fusion.stats().late;
+
+    // Source 1's solution for the epoch that was flushed without it.
+    offer(fusion, 1, 1000, 2200);
+    EXPECT_TRUE(published.empty());
+    EXPECT_EQ(fusion.stats().late, late + 1);
+
+    // Both restarted and went back a minute: that is no straggler.
+    offer(fusion, 0, 24 * 3600 * 1000 - 59000, 3000);
+    offer(fusion, 1, 24 * 3600 * 1000 - 59000, 3010);
+    EXPECT_EQ(published, (std::vector<int32_t>{24 * 3600 * 1000 - 59000}));
+}
+
+TEST_F(FixFusionTest, ResyncAcceptsTheClosedEpochAgain) {
+    FixFusion fusion(1);
+    offer(fusion, 0, 5000, 1000);
+    fusion.resync();
+    offer(fusion, 0, 5000, 2000);
+    EXPECT_EQ(published, (std::vector<int32_t>{5000, 5000}));
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "GeofenceIndex.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+static constexpr uint8_t ALL = GeofenceIndex::ENTERED | GeofenceIndex::EXITED |
+                               GeofenceIndex::UNCERTAIN;
+// As GeofenceIndex's spherical earth.
+static constexpr double METERS_PER_DEGREE = 6371000.0 * M_PI / 180.0;
+
+static double north(double latitude, double meters) {
+    return latitude + meters / METERS_PER_DEGREE;
+}
+
+class GeofenceIndexTest : public ::testing::Test {
+protected:
+    std::vector<GeofenceIndex::Event> update(double latitude, double longitude, float accuracy,
+                                             int64_t timeMs) {
+        std::vector<GeofenceIndex::Event> events;
+        index.update(latitude, longitude, accuracy, timeMs, events);
+        return events;
+    }
+    std::vector<GeofenceIndex::Event> expire(int64_t timeMs) {
+        std::vector<GeofenceIndex::Event> events;
+        index.expire(timeMs, events);
+        return events;
+    }
+
+    GeofenceIndex index;
+};
+
+static bool has(const std::vector<GeofenceIndex::Event>& events, int32_t id,
+                GeofenceIndex::Transition transition) {
+    for (const auto& event : events) {
+        if (event.id == id && event.transition == transition) return true;
+    }
+    return false;
+}
+
+TEST_F(GeofenceIndexTest, RejectsBadArguments) {
+    EXPECT_EQ(index.add(1, 91, 0, 100, GeofenceIndex::EXITED, ALL, 0, 0),
+              GeofenceIndex::INVALID_ARGUMENT);
+    EXPECT_EQ(index.add(1, 0, 181, 100, GeofenceIndex::EXITED, ALL, 0, 0),
+              GeofenceIndex::INVALID_ARGUMENT);
+    EXPECT_EQ(index.add(1, 0, 0, 0, GeofenceIndex::EXITED, ALL, 0, 0),
+              GeofenceIndex::INVALID_ARGUMENT);
+    EXPECT_EQ(index.add(1, 0, 0, NAN, GeofenceIndex::EXITED, ALL, 0, 0),
+              GeofenceIndex::INVALID_ARGUMENT);
+    EXPECT_EQ(index.add(1, 0, 0, 100, 3, ALL, 0, 0), GeofenceIndex::INVALID_TRANSITION);
+    EXPECT_EQ(index.add(1, 0, 0, 100, GeofenceIndex::EXITED, 0, 0, 0),
+              GeofenceIndex::INVALID_TRANSITION);
+    EXPECT_EQ(index.add(1, 0, 0, 100, GeofenceIndex::EXITED, 8, 0, 0),
+              GeofenceIndex::INVALID_TRANSITION);
+    EXPECT_EQ(index.add(1, 0, 0, 100, GeofenceIndex::EXITED, ALL, 0, 0), GeofenceIndex::OK);
+    EXPECT_EQ(index.add(1, 1, 1, 100, GeofenceIndex::EXITED, ALL, 0, 0), GeofenceIndex::ID_EXISTS);
+    EXPECT_EQ(index.remove(2), GeofenceIndex::ID_UNKNOWN);
+    EXPECT_EQ(index.pause(2), GeofenceIndex::ID_UNKNOWN);
+    EXPECT_EQ(index.resume(1, 0, 0), GeofenceIndex::INVALID_TRANSITION);
+    EXPECT_EQ(index.size(), 1u);
+}
+
+// Radius 100 m, accuracy 10 m: enters within 90 m, exits beyond 110 m.
+TEST_F(GeofenceIndexTest, EntersAndExitsWithHysteresis) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    EXPECT_TRUE(update(north(52.0, 95), 21.0, 10, 1000).empty());
+    auto events = update(north(52.0, 89), 21.0, 10, 2000);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].transition, GeofenceIndex::ENTERED);
+    // Across the boundary but within the margin: still inside.
+    EXPECT_TRUE(update(north(52.0, 105), 21.0, 10, 3000).empty());
+    EXPECT_TRUE(update(north(52.0, 95), 21.0, 10, 4000).empty());
+    events = update(north(52.0, 111), 21.0, 10, 5000);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].transition, GeofenceIndex::EXITED);
+    EXPECT_TRUE(update(north(52.0, 200), 21.0, 10, 6000).empty());
+}
+
+TEST_F(GeofenceIndexTest, MarginFollowsAccuracyWithinBounds) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    // Accuracy 1 m: the margin is still MIN_MARGIN_M.
+    EXPECT_TRUE(update(north(52.0, 96), 21.0, 1, 1000).empty());
+    EXPECT_TRUE(has(update(north(52.0, 94), 21.0, 1, 2000), 1, GeofenceIndex::ENTERED));
+    // Accuracy 80 m: the margin is half the radius, but exit waits for the full accuracy.
+    EXPECT_TRUE(update(north(52.0, 170), 21.0, 80, 3000).empty());
+    EXPECT_TRUE(has(update(north(52.0, 181), 21.0, 80, 4000), 1, GeofenceIndex::EXITED));
+    // Less accurate than the radius: never enters, even at the centre.
+    EXPECT_TRUE(update(52.0, 21.0, 150, 5000).empty());
+}
+
+TEST_F(GeofenceIndexTest, UnknownAccuracyUsesTypicalMargin) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    // Taken as 10 m.
+    EXPECT_TRUE(update(north(52.0, 91), 21.0, 0, 1000).empty());
+    EXPECT_TRUE(has(update(north(52.0, 89), 21.0, 0, 2000), 1, GeofenceIndex::ENTERED));
+}
+
+TEST_F(GeofenceIndexTest, AmbiguousFixesMakeItUncertainAfterItsTimer) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::ENTERED, ALL, 5000, 0);
+    // On the boundary, within the margin either way.
+    for (int64_t t = 1000; t < 6000; t += 1000) {
+        EXPECT_TRUE(update(north(52.0, 100), 21.0, 10, t).empty()) << t;
+    }
+    auto events = update(north(52.0, 100), 21.0, 10, 6000);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].transition, GeofenceIndex::UNCERTAIN);
+    EXPECT_TRUE(has(update(52.0, 21.0, 10, 7000), 1, GeofenceIndex::ENTERED));
+}
+
+TEST_F(GeofenceIndexTest, OnlyMonitoredTransitionsAreReported) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, GeofenceIndex::EXITED, 60000, 0);
+    EXPECT_TRUE(update(52.0, 21.0, 5, 1000).empty());
+    EXPECT_TRUE(has(update(53.0, 21.0, 5, 2000), 1, GeofenceIndex::EXITED));
+}
+
+TEST_F(GeofenceIndexTest, PausedFenceCatchesUpOnResume) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    index.pause(1);
+    EXPECT_EQ(index.activeCount(), 0u);
+    EXPECT_TRUE(update(52.0, 21.0, 5, 1000).empty());
+    index.resume(1, ALL, 1500);
+    EXPECT_EQ(index.activeCount(), 1u);
+    // Wherever the next fix is, the fence is evaluated.
+    EXPECT_TRUE(has(update(52.0, 21.0, 5, 2000), 1, GeofenceIndex::ENTERED));
+}
+
+// An entered fence is evaluated wherever the fix is, so an exit far away is seen.
+TEST_F(GeofenceIndexTest, ExitIsSeenFromAnotherCell) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    update(52.0, 21.0, 5, 1000);
+    EXPECT_TRUE(has(update(-33.9, 151.2, 5, 2000), 1, GeofenceIndex::EXITED));
+}
+
+TEST_F(GeofenceIndexTest, FixesOnlyEvaluateFencesNearby) {
+    // A row of 100 m fences every 0.1°: 871 m grid cells, one fence in each neighbourhood.
+    for (int i = 0; i < 100; i++) {
+        index.add(i, 52.0, 10.0 + 0.1 * i, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    }
+    update(0.0, 0.0, 5, 1000);  // settles the new ones
+    const uint64_t before = index.stats().evaluations;
+    update(52.0, 15.0, 5, 2000);
+    EXPECT_LE(index.stats().evaluations - before, 1u);
+    // Large and polar fences are in the global list, evaluated on every fix.
+    index.add(1000, 0.0, 0.0, 400000, GeofenceIndex::EXITED, ALL, 60000, 0);
+    index.add(1001, 89.999, 0.0, 1000, GeofenceIndex::EXITED, ALL, 60000, 0);
+    update(-30.0, 0.0, 5, 3000);
+    const uint64_t global = index.stats().evaluations;
+    EXPECT_TRUE(has(update(3.0, 0.0, 5, 4000), 1000, GeofenceIndex::ENTERED));
+    EXPECT_TRUE(has(update(89.9995, 120.0, 5, 5000), 1001, GeofenceIndex::ENTERED));
+    EXPECT_GE(index.stats().evaluations - global, 2u);
+}
+
+TEST_F(GeofenceIndexTest, CoarserLevelsFindLargerFences) {
+    // 5 km and 100 km: the 14 km and 220 km levels.
+    index.add(1, 10.0, 10.0, 5000, GeofenceIndex::EXITED, ALL, 60000, 0);
+    index.add(2, -20.0, -40.0, 100000, GeofenceIndex::EXITED, ALL, 60000, 0);
+    update(0.0, 0.0, 5, 1000);
+    EXPECT_TRUE(has(update(north(10.0, 4000), 10.0, 5, 2000), 1, GeofenceIndex::ENTERED));
+    EXPECT_TRUE(has(update(north(-20.0, -90000), -40.0, 5, 3000), 2, GeofenceIndex::ENTERED));
+}
+
+TEST_F(GeofenceIndexTest, WrapsAroundTheAntimeridian) {
+    index.add(1, 0.0, 179.999, 500, GeofenceIndex::EXITED, ALL, 60000, 0);
+    index.add(2, 0.0, -179.999, 500, GeofenceIndex::EXITED, ALL, 60000, 0);
+    update(10.0, 0.0, 5, 1000);
+    // 167 m east of the first, across the antimeridian, and 56 m west of the second.
+    auto events = update(0.0, -179.9995, 5, 2000);
+    EXPECT_TRUE(has(events, 1, GeofenceIndex::ENTERED));
+    EXPECT_TRUE(has(events, 2, GeofenceIndex::ENTERED));
+}
+
+TEST_F(GeofenceIndexTest, RemovedSlotIsReused) {
+    index.add(1, 52.0, 21.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    update(52.0, 21.0, 5, 1000);
+    EXPECT_EQ(index.remove(1), GeofenceIndex::OK);
+    // Different place, same slot: the old one's cells and tracking are gone.
+    index.add(2, 10.0, 10.0, 100, GeofenceIndex::EXITED, ALL, 60000, 0);
+    auto events = update(52.0, 21.0, 5, 2000);
+    EXPECT_FALSE(has(events, 1, GeofenceIndex::EXITED));
+    EXPECT_TRUE(events.empty());
+    EXPECT_TRUE(has(update(10.0, 10.0, 5, 3000), 2, GeofenceIndex::ENTERED));
+}
+
+TEST_F(GeofenceIndexTest, ExpiresFromTheLastFixOnceFixesStop) {
+    ASSERT_EQ(index.add(1, 52.0, 21.0, 100, GeofenceIndex::UNCERTAIN, ALL, 10000, 0),
+              GeofenceIndex::OK);
+    auto events = update(52.0, 21.0, 5, 1000);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].transition, GeofenceIndex::ENTERED);
+
+    EXPECT_EQ(index.nextExpiryMs(), 11000);
+    EXPECT_TRUE(expire(10999).empty());
+    events = expire(11000);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].transition, GeofenceIndex::UNCERTAIN);
+    EXPECT_TRUE(expire(20000).empty());
+
+    // The next fix settles it again, wherever it is.
+    events = update(40.0, 10.0, 5, 30000);
+    EXPECT_TRUE(has(events, 1, GeofenceIndex::EXITED));
+}
+
+// Fixes far from an exited fence never evaluate it, but they do prove it is still exited.
+TEST_F(GeofenceIndexTest, DistantExitedFenceDoesNotExpireWhileFixesArrive) {
+    index.add(1, 10.0, 10.0, 100, GeofenceIndex::EXITED, ALL, 0, 0);
+    index.add(2, -30.0, 150.0, 100, GeofenceIndex::EXITED, ALL, 5000, 0);
+    for (int64_t t = 1000; t <= 60000; t += 1000) {
+        EXPECT_TRUE(update(52.0, 21.0, 5, t).empty());
+        ASSERT_GT(index.nextExpiryMs(), t);
+        EXPECT_TRUE(expire(t + 999).empty()) << t;
+    }
+    // The shorter timer is floored at MIN_EXPIRY_MS, so it still goes first.
+    EXPECT_EQ(index.nextExpiryMs(), 60000 + GeofenceIndex::MIN_EXPIRY_MS);
+    auto events = expire(60000 + GeofenceIndex::MIN_EXPIRY_MS);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].id, 1);
+    EXPECT_EQ(index.nextExpiryMs(), 65000);
+    events = expire(65000);
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_EQ(events[0].id, 2);
+}
+
+TEST_F(GeofenceIndexTest, FenceAddedAfterTheLastFixRunsFromItsStart) {
+    update(52.0, 21.0, 5, 1000);
+    index.add(1, 10.0, 10.0, 100, GeofenceIndex::EXITED, ALL, 10000, 50000);
+    EXPECT_TRUE(expire(11000).empty());
+    EXPECT_EQ(index.nextExpiryMs(), 60000);
+    EXPECT_TRUE(has(expire(60000), 1, GeofenceIndex::UNCERTAIN));
+}
+
+TEST_F(GeofenceIndexTest, PausedAndRemovedFencesDoNotExpire) {
+    index.add(1, 10.0, 10.0, 100, GeofenceIndex::EXITED, ALL, 10000, 0);
+    index.add(2, 11.0, 10.0, 100, GeofenceIndex::EXITED, ALL, 10000, 0);
+    update(52.0, 21.0, 5, 1000);
+    index.pause(1);
+    index.remove(2);
+    EXPECT_TRUE(expire(100000).empty());
+
+    index.resume(1, ALL, 200000);
+    EXPECT_TRUE(expire(209999).empty());
+    EXPECT_TRUE(has(expire(210000), 1, GeofenceIndex::UNCERTAIN));
+}
+
+TEST_F(GeofenceIndexTest, UnmonitoredUncertainIsNotReported) {
+    index.add(1, 10.0, 10.0, 100, GeofenceIndex::EXITED,
+              GeofenceIndex::ENTERED | GeofenceIndex::EXITED, 10000, 0);
+    update(52.0, 21.0, 5, 1000);
+    EXPECT_TRUE(expire(11000).empty());
+    EXPECT_EQ(index.nextExpiryMs(), -1);
+    // Still, it went UNCERTAIN: the next fix reports it exited again.
+    EXPECT_TRUE(has(update(52.0, 21.0, 5, 12000), 1, GeofenceIndex::EXITED));
+}
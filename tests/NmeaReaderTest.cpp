@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NmeaReader.h"
+#include "RawFrames.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+// Two receivers on pty: sources, fed by the test through the pseudo-terminals' slave ends the
+// reader links for it.
+class NmeaReaderTest : public ::testing::Test {
+protected:
+    static constexpr int SOURCES = 2;
+
+    void SetUp() override {
+        std::vector<std::string> devices;
+        for (int i = 0; i < SOURCES; i++) {
+            mLinks.push_back(::testing::TempDir() + "/gnss" + std::to_string(i) + "-" +
+                             std::to_string(getpid()));
+            devices.push_back("pty:" + mLinks.back());
+        }
+        mReader = std::make_unique<NmeaReader>(
+                devices, 115200, "",
+                [this](const GnssLocation& location) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mLocations.push_back(location);
+                    mCondition.notify_all();
+                },
+                nullptr,
+                [this](const std::vector<GnssSvInfo>& svs) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mSvs = svs;
+                },
+                [this](const GnssData& data) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mMeasurements.push_back(data);
+                    mCondition.notify_all();
+                });
+        mReader->setSvStatusEnabled(true);
+        ASSERT_TRUE(mReader->start());
+        for (const std::string& link : mLinks) {
+            const int fd = open(link.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+            ASSERT_GE(fd, 0) << link;
+            // Binary frames go through unchanged.
+            struct termios tio;
+            ASSERT_EQ(tcgetattr(fd, &tio), 0);
+            cfmakeraw(&tio);
+            ASSERT_EQ(tcsetattr(fd, TCSANOW, &tio), 0);
+            mSlaves.push_back(fd);
+        }
+    }
+
+    void TearDown() override {
+        mReader.reset();
+        for (int fd : mSlaves) close(fd);
+    }
+
+    // Appends the checksum and line ending.
+    static std::string sentence(const std::string& body) {
+        uint8_t sum = 0;
+        for (char c : body) sum ^= static_cast<uint8_t>(c);
+        char tail[8];
+        snprintf(tail, sizeof(tail), "*%02X\r\n", sum);
+        return "$" + body + tail;
+    }
+
+    // One epoch of receiver |source|: a solution at |latitude| with 3 m one-sigma errors, and
+    // the GPS satellites in |svids|, all used in the fix.
+    void writeEpoch(int source, int second, const char* latitude, const std::vector<int>& svids) {
+        char time[16];
+        snprintf(time, sizeof(time), "1200%02d.00", second);
+        std::string used, sky;
+        for (int svid : svids) {
+            char field[32];
+            snprintf(field, sizeof(field), "%02d,", svid);
+            used += field;
+            snprintf(field, sizeof(field), ",%02d,45,%03d,%d", svid, svid * 10, 30 + svid % 10);
+            sky += field;
+        }
+        for (size_t i = svids.size(); i < 12; i++) used += ",";
+        std::string text;
+        text += sentence(std::string("GPGGA,") + time + "," + latitude +
+                         ",N,02100.0000,E,1,08,0.9,100.0,M,40.0,M,,");
+        text += sentence(std::string("GPRMC,") + time + ",A," + latitude +
+                         ",N,02100.0000,E,0.0,0.0,171026,,,A");
+        text += sentence("GNGSA,A,3," + used + "1.5,0.9,1.2,1");
+        text += sentence("GPGSV,1,1," + std::to_string(svids.size()) + sky);
+        text += sentence(std::string("GPGST,") + time + ",1.0,3.0,3.0,0.0,3.0,3.0,5.0");
+        ASSERT_EQ(write(mSlaves[source], text.data(), text.size()),
+                  static_cast<ssize_t>(text.size()));
+    }
+
+    // Waits for a location published for UTC second |second|.
+    bool waitForLocation(int second, GnssLocation* out) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCondition.wait_for(lock, std::chrono::seconds(3), [&] {
+            for (const GnssLocation& location : mLocations) {
+                if (location.timestampMillis % 60000 == second * 1000) {
+                    *out = location;
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    std::unique_ptr<NmeaReader> mReader;
+    std::vector<std::string> mLinks;
+    std::vector<int> mSlaves;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<GnssLocation> mLocations;
+    std::vector<GnssSvInfo> mSvs;
+    std::vector<GnssData> mMeasurements;
+};
+
+TEST_F(NmeaReaderTest, FusesTwoReceiversAndMergesTheirSky) {
+    // 52°0.0000' and 52°0.0012', 2.2 m apart: consistent, so averaged with equal weights.
+    for (int second = 0; second < 4; second++) {
+        writeEpoch(0, second, "5200.0000", {5, 12, 25});
+        writeEpoch(1, second, "5200.0012", {12, 25, 29});
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    GnssLocation location;
+    ASSERT_TRUE(waitForLocation(3, &location));
+    EXPECT_NEAR(location.latitudeDegrees, 52.00001, 1e-7);
+    EXPECT_NEAR(location.longitudeDegrees, 21.0, 1e-9);
+    EXPECT_TRUE(location.gnssLocationFlags & GnssLocation::HAS_HORIZONTAL_ACCURACY);
+
+    // Fused epochs only: none for a receiver's epoch alone after the first.
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const GnssLocation& published : mLocations) {
+            if (published.timestampMillis % 60000 == 0) continue;
+            EXPECT_NEAR(published.latitudeDegrees, 52.00001, 1e-7);
+        }
+    }
+
+    std::map<int, int> seen;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const GnssSvInfo& sv : mSvs) {
+            if (sv.constellation == GnssConstellationType::GPS) seen[sv.svid]++;
+        }
+    }
+    EXPECT_EQ(seen, (std::map<int, int>{{5, 1}, {12, 1}, {25, 1}, {29, 1}}));
+}
+
+TEST_F(NmeaReaderTest, OneReceiverAloneIsPublished) {
+    for (int second = 10; second < 13; second++) {
+        writeEpoch(1, second, "5200.0012", {12, 25, 29});
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    GnssLocation location;
+    ASSERT_TRUE(waitForLocation(12, &location));
+    EXPECT_NEAR(location.latitudeDegrees, 52.00002, 1e-7);
+}
+
+TEST_F(NmeaReaderTest, MapsRawMeasurementsToGnssData) {
+    mReader->setMeasurementOptions(true, 1000);
+    for (int second = 20; second < 22; second++) {
+        writeEpoch(0, second, "5200.0000", {5, 12});
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    GnssLocation location;
+    ASSERT_TRUE(waitForLocation(21, &location));
+    ASSERT_EQ(write(mSlaves[0], MSM7_FRAME, sizeof(MSM7_FRAME)),
+              static_cast<ssize_t>(sizeof(MSM7_FRAME)));
+
+    GnssData data;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        ASSERT_TRUE(mCondition.wait_for(lock, std::chrono::seconds(3),
+                                        [this] { return !mMeasurements.empty(); }));
+        data = mMeasurements.front();
+    }
+    ASSERT_EQ(data.measurements.size(), 3u);
+    const GnssMeasurement& l1 = data.measurements[0];
+    EXPECT_EQ(l1.svid, 5);
+    EXPECT_EQ(l1.signalType.constellation, GnssConstellationType::GPS);
+    EXPECT_EQ(l1.signalType.carrierFrequencyHz, 1575.42e6);
+    EXPECT_EQ(l1.signalType.codeType, "C");
+    EXPECT_TRUE(l1.flags & GnssMeasurement::HAS_CARRIER_FREQUENCY);
+    EXPECT_EQ(l1.state, GnssMeasurement::STATE_CODE_LOCK | GnssMeasurement::STATE_TOW_DECODED |
+                                GnssMeasurement::STATE_TOW_KNOWN);
+    EXPECT_EQ(l1.receivedSvTimeInNs, 345599929499998LL);
+    EXPECT_EQ(l1.receivedSvTimeUncertaintyInNs, 10);
+    EXPECT_DOUBLE_EQ(l1.antennaCN0DbHz, 45.0);
+    EXPECT_DOUBLE_EQ(l1.basebandCN0DbHz, 45.0);
+    EXPECT_NEAR(l1.pseudorangeRateMps, -249.8766, 1e-9);
+    EXPECT_EQ(l1.accumulatedDeltaRangeState,
+              GnssMeasurement::ADR_STATE_VALID | GnssMeasurement::ADR_STATE_HALF_CYCLE_RESOLVED);
+    EXPECT_NEAR(l1.accumulatedDeltaRangeM, 21135368.707805227, 1e-6);
+    EXPECT_EQ(data.measurements[1].signalType.codeType, "I");
+    // No range rate: reported, as the interface requires, with a huge uncertainty.
+    EXPECT_GT(data.measurements[2].pseudorangeRateUncertaintyMps, 100);
+    EXPECT_EQ(data.measurements[2].accumulatedDeltaRangeState,
+              GnssMeasurement::ADR_STATE_VALID | GnssMeasurement::ADR_STATE_RESET);
+
+    // MSM carries no week or leap seconds: the week comes from the RMC date.
+    EXPECT_TRUE(data.clock.gnssClockFlags & GnssClock::HAS_FULL_BIAS);
+    EXPECT_FALSE(data.clock.gnssClockFlags & GnssClock::HAS_LEAP_SECOND);
+    EXPECT_EQ(data.clock.timeNanos - data.clock.fullBiasNanos, 2440LL * 604800000000000 +
+                                                                345600000LL * 1000000);
+    EXPECT_EQ(data.elapsedRealtime.timestampNs, data.clock.timeNanos);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+#include "NmeaFramer.h"
+#include "NmeaParser.h"
+#include "NmeaSentences.h"
+
+using namespace aidl::android::hardware::gnss::implementation;
+
+class NmeaSchemaTest : public ::testing::Test {
+protected:
+    // Frames "$|body|*hh"; the sentence's fields point into the framer, valid until the next call.
+    const NmeaSentence& frame(const std::string& body) {
+        uint8_t sum = 0;
+        for (char c : body) sum ^= static_cast<uint8_t>(c);
+        char tail[8];
+        snprintf(tail, sizeof(tail), "*%02X\r\n", sum);
+        mText = "$" + body + tail;
+        const char* cursor = mText.data();
+        EXPECT_TRUE(framer.next(cursor, mText.data() + mText.size(), mSentence)) << body;
+        return mSentence;
+    }
+
+    template <typename Schema>
+    bool decode(const std::string& body, typename Schema::Record& record) {
+        return Schema::decode(frame(body), record);
+    }
+
+    // Parses |bodies| as one epoch and returns it.
+    NmeaFix epoch(std::initializer_list<const char*> bodies) {
+        for (const char* body : bodies) parser.parse(frame(body));
+        parser.epochs().flush();
+        EXPECT_TRUE(parser.epochs().hasCompleted());
+        NmeaFix fix = parser.epochs().completed();
+        parser.epochs().consumeCompleted();
+        return fix;
+    }
+
+    NmeaFramer framer;
+    NmeaParser parser;
+
+private:
+    std::string mText;
+    NmeaSentence mSentence;
+};
+
+TEST_F(NmeaSchemaTest, EpochTimeFields) {
+    EXPECT_EQ(GgaSchema::TIME_FIELD, 1);
+    EXPECT_EQ(GnsSchema::TIME_FIELD, 1);
+    EXPECT_EQ(RmcSchema::TIME_FIELD, 1);
+    EXPECT_EQ(GllSchema::TIME_FIELD, 5);
+    EXPECT_EQ(ZdaSchema::TIME_FIELD, 1);
+    EXPECT_EQ(GstSchema::TIME_FIELD, 1);
+    EXPECT_EQ(VtgSchema::TIME_FIELD, -1);
+    EXPECT_EQ(GsaSchema::TIME_FIELD, -1);
+}
+
+TEST_F(NmeaSchemaTest, Gga) {
+    GgaSentence gga;
+    ASSERT_TRUE(decode<GgaSchema>("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,",
+                                  gga));
+    EXPECT_NEAR(*gga.latitudeDegrees, 48.1173, 1e-9);
+    EXPECT_NEAR(*gga.longitudeDegrees, 11.516666667, 1e-9);
+    EXPECT_EQ(*gga.fixQuality, 1);
+    EXPECT_EQ(*gga.numSatellites, 8);
+    EXPECT_DOUBLE_EQ(*gga.hdop, 0.9);
+    EXPECT_DOUBLE_EQ(*gga.altitudeMeters, 545.4);
+
+    // Southern and western hemispheres.
+    ASSERT_TRUE(decode<GgaSchema>("GPGGA,123519,3351.000,S,15112.000,W,1,08,0.9,5.0,M,,M,,", gga));
+    EXPECT_NEAR(*gga.latitudeDegrees, -33.85, 1e-9);
+    EXPECT_NEAR(*gga.longitudeDegrees, -151.2, 1e-9);
+    // No fix: empty fields are left unset.
+    ASSERT_TRUE(decode<GgaSchema>("GPGGA,123519,,,,,0,00,,,M,,M,,", gga));
+    EXPECT_FALSE(gga.latitudeDegrees);
+    EXPECT_FALSE(gga.longitudeDegrees);
+    EXPECT_EQ(*gga.fixQuality, 0);
+    EXPECT_FALSE(gga.hdop);
+    EXPECT_FALSE(gga.altitudeMeters);
+
+    // One field short.
+    EXPECT_FALSE(decode<GgaSchema>("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,",
+                                   gga));
+}
+
+TEST_F(NmeaSchemaTest, Gns) {
+    GnsSentence gns;
+    ASSERT_TRUE(decode<GnsSchema>(
+            "GNGNS,014035.00,4332.69262,S,17235.48549,E,RR,13,0.9,25.63,11.24,,", gns));
+    EXPECT_EQ(gns.modes, "RR");
+    EXPECT_NEAR(*gns.latitudeDegrees, -43.544877, 1e-6);
+    EXPECT_NEAR(*gns.longitudeDegrees, 172.591425, 1e-6);
+    EXPECT_EQ(*gns.numSatellites, 13);
+    EXPECT_DOUBLE_EQ(*gns.hdop, 0.9);
+    EXPECT_DOUBLE_EQ(*gns.altitudeMeters, 25.63);
+    // The modes are required.
+    EXPECT_FALSE(decode<GnsSchema>(
+            "GNGNS,014035.00,4332.69262,S,17235.48549,E,,13,0.9,25.63,11.24,,", gns));
+}
+
+TEST_F(NmeaSchemaTest, RmcScalesKnots) {
+    RmcSentence rmc;
+    ASSERT_TRUE(decode<RmcSchema>(
+            "GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W", rmc));
+    EXPECT_TRUE(rmc.valid);
+    EXPECT_NEAR(*rmc.speedMetersPerSec, 22.4 * 0.514444, 1e-9);
+    EXPECT_DOUBLE_EQ(*rmc.bearingDegrees, 84.4);
+    EXPECT_EQ(*rmc.utcDaysSinceEpoch, 8847);
+    ASSERT_TRUE(decode<RmcSchema>("GPRMC,123519,V,,,,,,,040724,,", rmc));
+    EXPECT_FALSE(rmc.valid);
+    EXPECT_FALSE(rmc.speedMetersPerSec);
+    EXPECT_EQ(*rmc.utcDaysSinceEpoch, 19908);
+    // A status that is neither A nor V rejects the sentence.
+    EXPECT_FALSE(decode<RmcSchema>("GPRMC,123519,X,,,,,,,040724,,", rmc));
+    EXPECT_FALSE(decode<RmcSchema>("GPRMC,123519,,,,,,,,040724,,", rmc));
+}
+
+TEST_F(NmeaSchemaTest, VtgScalesKilometersPerHour) {
+    VtgSentence vtg;
+    ASSERT_TRUE(decode<VtgSchema>("GPVTG,054.7,T,034.4,M,005.5,N,010.8,K", vtg));
+    EXPECT_DOUBLE_EQ(*vtg.bearingDegrees, 54.7);
+    EXPECT_NEAR(*vtg.speedMetersPerSec, 3.0, 1e-12);
+    // Knots are ignored: km/h alone is decoded.
+    ASSERT_TRUE(decode<VtgSchema>("GPVTG,,T,,M,005.5,N,,K", vtg));
+    EXPECT_FALSE(vtg.bearingDegrees);
+    EXPECT_FALSE(vtg.speedMetersPerSec);
+}
+
+TEST_F(NmeaSchemaTest, GsaSystemIdIsOptional) {
+    GsaSentence gsa;
+    ASSERT_TRUE(decode<GsaSchema>("GNGSA,A,3,05,,12,25,,,,,,,,,1.5,0.9,1.2,1", gsa));
+    EXPECT_EQ(gsa.talker, "GN");
+    ASSERT_TRUE(gsa.svids);
+    ASSERT_EQ(gsa.svids->count, 3u);
+    EXPECT_EQ(gsa.svids->values[0], 5);
+    EXPECT_EQ(gsa.svids->values[1], 12);
+    EXPECT_EQ(gsa.svids->values[2], 25);
+    EXPECT_EQ(*gsa.systemId, 1);
+
+    // NMEA before 4.11: no system ID, past MIN_FIELDS.
+    ASSERT_TRUE(decode<GsaSchema>("GPGSA,A,3,05,12,,,,,,,,,,,1.5,0.9,1.2", gsa));
+    EXPECT_EQ(gsa.talker, "GP");
+    EXPECT_EQ(gsa.svids->count, 2u);
+    EXPECT_FALSE(gsa.systemId);
+
+    ASSERT_TRUE(decode<GsaSchema>("GPGSA,A,1,,,,,,,,,,,,,,,", gsa));
+    EXPECT_FALSE(gsa.svids);
+    EXPECT_FALSE(decode<GsaSchema>("GPGSA,A,3,05,12,,,,,,,,,,,1.5,0.9", gsa));
+}
+
+TEST_F(NmeaSchemaTest, Gll) {
+    GllSentence gll;
+    ASSERT_TRUE(decode<GllSchema>("GPGLL,4916.45,N,12311.12,W,225444,A", gll));
+    EXPECT_TRUE(gll.valid);
+    EXPECT_NEAR(*gll.latitudeDegrees, 49.274166667, 1e-9);
+    EXPECT_NEAR(*gll.longitudeDegrees, -123.185333333, 1e-9);
+    ASSERT_TRUE(decode<GllSchema>("GPGLL,,,,,225444,V", gll));
+    EXPECT_FALSE(gll.valid);
+    EXPECT_FALSE(gll.latitudeDegrees);
+    EXPECT_FALSE(decode<GllSchema>("GPGLL,4916.45,N,12311.12,W,225444,", gll));
+}
+
+TEST_F(NmeaSchemaTest, Zda) {
+    ZdaSentence zda;
+    ASSERT_TRUE(decode<ZdaSchema>("GPZDA,201530.00,04,07,2024,00,00", zda));
+    EXPECT_EQ(zda.utcDaysSinceEpoch, 19908);
+    EXPECT_FALSE(decode<ZdaSchema>("GPZDA,201530.00,32,07,2024,00,00", zda));
+    EXPECT_FALSE(decode<ZdaSchema>("GPZDA,201530.00,04,13,2024,00,00", zda));
+    EXPECT_FALSE(decode<ZdaSchema>("GPZDA,201530.00,04,07,,00,00", zda));
+    EXPECT_FALSE(decode<ZdaSchema>("GPZDA,201530.00,04,07", zda));
+}
+
+TEST_F(NmeaSchemaTest, Gst) {
+    GstSentence gst;
+    ASSERT_TRUE(decode<GstSchema>("GPGST,024603.00,3.2,6.6,4.7,47.3,5.8,5.6,22.0", gst));
+    EXPECT_DOUBLE_EQ(*gst.majorSigmaMeters, 6.6);
+    EXPECT_DOUBLE_EQ(*gst.minorSigmaMeters, 4.7);
+    EXPECT_DOUBLE_EQ(*gst.latitudeSigmaMeters, 5.8);
+    EXPECT_DOUBLE_EQ(*gst.longitudeSigmaMeters, 5.6);
+    EXPECT_DOUBLE_EQ(*gst.altitudeSigmaMeters, 22.0);
+    ASSERT_TRUE(decode<GstSchema>("GPGST,024603.00,,,,,,,", gst));
+    EXPECT_FALSE(gst.majorSigmaMeters);
+    EXPECT_FALSE(gst.altitudeSigmaMeters);
+}
+
+TEST_F(NmeaSchemaTest, AccuracyFromHdopWithoutGst) {
+    const NmeaFix fix = epoch({"GPGGA,123519.00,4807.038,N,01131.000,E,1,08,1.5,545.4,M,46.9,M,,"});
+    EXPECT_TRUE(fix.flags & FIX_HAS_HORIZONTAL_ACCURACY);
+    EXPECT_DOUBLE_EQ(fix.horizontalAccuracyMeters, 6.0);
+    EXPECT_FALSE(fix.flags & FIX_HAS_VERTICAL_ACCURACY);
+    EXPECT_FALSE(fix.measuredAccuracy);
+}
+
+TEST_F(NmeaSchemaTest, AccuracyFromGstErrorEllipse) {
+    NmeaFix fix = epoch({"GPGGA,123519.00,4807.038,N,01131.000,E,1,08,1.5,545.4,M,46.9,M,,",
+                         "GPGST,123519.00,1.0,4.0,3.0,0.0,3.0,4.0,7.5"});
+    EXPECT_DOUBLE_EQ(fix.horizontalAccuracyMeters, 5.0);
+    EXPECT_TRUE(fix.flags & FIX_HAS_VERTICAL_ACCURACY);
+    EXPECT_DOUBLE_EQ(fix.verticalAccuracyMeters, 7.5);
+    EXPECT_TRUE(fix.measuredAccuracy);
+
+    // Without the latitude and longitude sigmas, the ellipse's axes.
+    fix = epoch({"GPGGA,123521.00,4807.038,N,01131.000,E,1,08,1.5,545.4,M,46.9,M,,",
+                 "GPGST,123521.00,1.0,6.0,8.0,0.0,,,"});
+    EXPECT_DOUBLE_EQ(fix.horizontalAccuracyMeters, 10.0);
+    EXPECT_FALSE(fix.flags & FIX_HAS_VERTICAL_ACCURACY);
+
+    // An empty GST leaves the HDOP estimate.
+    fix = epoch({"GPGGA,123522.00,4807.038,N,01131.000,E,1,08,1.5,545.4,M,46.9,M,,",
+                 "GPGST,123522.00,,,,,,,"});
+    EXPECT_DOUBLE_EQ(fix.horizontalAccuracyMeters, 6.0);
+    EXPECT_FALSE(fix.measuredAccuracy);
+}
+
+TEST_F(NmeaSchemaTest, GstBeforeGgaIsNotOverridden) {
+    // The GGA that follows does not replace it with the HDOP estimate.
+    const NmeaFix fix = epoch({"GPGST,123520.00,1.0,4.0,3.0,0.0,3.0,4.0,7.5",
+                               "GPGGA,123520.00,4807.038,N,01131.000,E,1,08,1.5,545.4,M,46.9,M,,"});
+    EXPECT_DOUBLE_EQ(fix.horizontalAccuracyMeters, 5.0);
+    EXPECT_TRUE(fix.measuredAccuracy);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2024 Custom GNSS HAL for Raspberry Pi 5
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Known-answer raw measurement frames, encoded independently of BinaryParser, with their
+// checksums. The decoded values are spelled out in BinaryParserTest.
+
+// RTCM 3 message 1077, GPS MSM7 at time of week 345600000 ms, the last of its epoch:
+//  - G05 on L1 C/A (signal 2) and L5 I (22): rough range 70 + 512/1024 ms, rough rate -250 m/s;
+//    fine ranges 1000 and -2000, fine phases 3000 and invalid, lock 600 and 0, CNR 720 and
+//    616 (1/16 dB-Hz), fine rates 1234 and -5678 (0.1 mm/s);
+//  - G12 on L1 C/A: rough range 75 + 100/1024 ms, rough rate 400 m/s, fine range 50000, fine
+//    phase 40000 with a half-cycle ambiguity, lock 0, CNR 484, fine rate invalid.
+static constexpr uint8_t MSM7_FRAME[] = {
+        0xd3, 0x00, 0x3d, 0x43, 0x50, 0x00, 0x52, 0x65, 0xc0, 0x00, 0x00, 0x00,
+        0x04, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x02, 0x00,
+        0x72, 0x32, 0x58, 0x04, 0x00, 0x32, 0x7e, 0x0c, 0x0c, 0x80, 0x01, 0xf4,
+        0x7f, 0xc1, 0x80, 0x61, 0xa8, 0x00, 0x05, 0xdc, 0x40, 0x00, 0x00, 0x00,
+        0x4e, 0x20, 0x4b, 0x00, 0x00, 0x00, 0x6d, 0x09, 0xa1, 0xe4, 0x09, 0xa5,
+        0xa7, 0x4a, 0x00, 0x00, 0xbc, 0xea, 0x40,
+};
+
+// UBX-RXM-RAWX at 345600.5 s of week 2330, 18 leap seconds known:
+//  - G07 L1 C/A: pseudorange 21000000.123 m, carrier phase 110355000.5 cycles, Doppler
+//    -1234.5 Hz, lock time 1500 ms, C/N0 42, stdev indices 5, 3 and 4, phase and half cycle
+//    valid;
+//  - R10 G1 on frequency channel -3: pseudorange 19500000 m, Doppler 800 Hz, C/N0 35, no phase;
+//  - E03 without a valid pseudorange, so not reported.
+static constexpr uint8_t RAWX_FRAME[] = {
+        0xb5, 0x62, 0x02, 0x15, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x18,
+        0x15, 0x41, 0x1a, 0x09, 0x12, 0x03, 0x01, 0x01, 0x00, 0x00, 0xd9, 0xce,
+        0xf7, 0x01, 0xf4, 0x06, 0x74, 0x41, 0x00, 0x00, 0x00, 0xe2, 0x88, 0x4f,
+        0x9a, 0x41, 0x00, 0x50, 0x9a, 0xc4, 0x00, 0x07, 0x00, 0x00, 0xdc, 0x05,
+        0x2a, 0x05, 0x03, 0x04, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbe, 0x98,
+        0x72, 0x41, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x48, 0x44, 0x06, 0x0a, 0x00, 0x04, 0x00, 0x00, 0x23, 0x06, 0x00, 0x05,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd0, 0x12, 0x73, 0x41, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03,
+        0x00, 0x00, 0x00, 0x00, 0x1e, 0x06, 0x00, 0x05, 0x00, 0x00, 0x82, 0x21,
+};